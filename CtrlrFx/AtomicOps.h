@@ -0,0 +1,139 @@
+/// @file AtomicOps.h
+/// Low-level atomic operations on plain integers and pointers.
+///
+/// These are thin wrappers around the compiler's atomic builtins, for use
+/// by the lock-free containers in the library. Each takes the memory
+/// ordering that it needs as part of its name, so that the intent is
+/// visible at the call site. Application code should normally use the
+/// higher-level objects, like @ref AtomicCounter, instead.
+
+#ifndef __CtrlrFx_AtomicOps_h
+#define __CtrlrFx_AtomicOps_h
+
+#include "CtrlrFx/xtypes.h"
+
+#if !defined(__GNUC__)
+	#error "AtomicOps.h requires the GCC (or compatible) atomic builtins"
+#endif
+
+namespace CtrlrFx {
+
+// The __atomic builtins appeared in GCC 4.7. Before that, we fall back
+// to the __sync builtins, which are all full barriers.
+
+#if defined(__ATOMIC_ACQUIRE)
+
+/// Loads a value, with no ordering constraints.
+template <typename T>
+inline T atomic_load_relaxed(const volatile T* p) {
+	return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+/// Loads a value, with acquire semantics.
+template <typename T>
+inline T atomic_load_acquire(const volatile T* p) {
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+/// Stores a value, with no ordering constraints.
+template <typename T>
+inline void atomic_store_relaxed(volatile T* p, T val) {
+	__atomic_store_n(p, val, __ATOMIC_RELAXED);
+}
+
+/// Stores a value, with release semantics.
+template <typename T>
+inline void atomic_store_release(volatile T* p, T val) {
+	__atomic_store_n(p, val, __ATOMIC_RELEASE);
+}
+
+/// Atomically replaces a value, returning the old one (full barrier).
+template <typename T>
+inline T atomic_exchange(volatile T* p, T val) {
+	return __atomic_exchange_n(p, val, __ATOMIC_SEQ_CST);
+}
+
+/// Atomically adds to a value, returning the old one (full barrier).
+template <typename T>
+inline T atomic_fetch_add(volatile T* p, T val) {
+	return __atomic_fetch_add(p, val, __ATOMIC_SEQ_CST);
+}
+
+/// Compare-and-swap (full barrier).
+/// @return @em true if the value was @em expected, and was replaced.
+template <typename T>
+inline bool atomic_cas(volatile T* p, T expected, T desired) {
+	return __atomic_compare_exchange_n(p, &expected, desired, false,
+									   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/// Full memory barrier.
+inline void atomic_fence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+/// Release barrier.
+inline void atomic_fence_release() { __atomic_thread_fence(__ATOMIC_RELEASE); }
+
+/// Acquire barrier.
+inline void atomic_fence_acquire() { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+
+#else
+
+template <typename T>
+inline T atomic_load_relaxed(const volatile T* p) { return *p; }
+
+template <typename T>
+inline T atomic_load_acquire(const volatile T* p) {
+	T val = *p;
+	__sync_synchronize();
+	return val;
+}
+
+template <typename T>
+inline void atomic_store_relaxed(volatile T* p, T val) { *p = val; }
+
+template <typename T>
+inline void atomic_store_release(volatile T* p, T val) {
+	__sync_synchronize();
+	*p = val;
+}
+
+template <typename T>
+inline T atomic_exchange(volatile T* p, T val) {
+	__sync_synchronize();
+	return __sync_lock_test_and_set(p, val);
+}
+
+template <typename T>
+inline T atomic_fetch_add(volatile T* p, T val) {
+	return __sync_fetch_and_add(p, val);
+}
+
+template <typename T>
+inline bool atomic_cas(volatile T* p, T expected, T desired) {
+	return __sync_bool_compare_and_swap(p, expected, desired);
+}
+
+inline void atomic_fence() { __sync_synchronize(); }
+inline void atomic_fence_release() { __sync_synchronize(); }
+inline void atomic_fence_acquire() { __sync_synchronize(); }
+
+#endif
+
+/// Hint to the CPU that we're in a spin-wait loop.
+inline void cpu_relax()
+{
+	#if defined(__i386__) || defined(__x86_64__)
+		__asm__ __volatile__("pause" ::: "memory");
+	#elif defined(__aarch64__)
+		__asm__ __volatile__("yield" ::: "memory");
+	#else
+		__asm__ __volatile__("" ::: "memory");
+	#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_AtomicOps_h
+
@@ -16,6 +16,7 @@
 #define __CtrlrFx_CircQueue_h
 
 #include "CtrlrFx/xtypes.h"
+#include <string.h>
 
 namespace CtrlrFx {
 
@@ -53,7 +54,7 @@ protected:
 	void dealloc();
 	void copy_elem(T* dest, const T* src, size_t n);
 
-	T* next(T* p) {
+	T* next(T* p) const {
 		if (++p == end_)
 			p = base_;
 		return p;
@@ -368,7 +369,7 @@ template<typename T> size_t CircQueue<T>::get(T buf[], size_t n)
 // enough room, it will push as many elements as possible.
 
 template <>
-size_t CircQueue<byte>::put(const byte buf[], size_t n)
+inline size_t CircQueue<byte>::put(const byte buf[], size_t n)
 {
 	n = min(n, remaining());
 
@@ -376,8 +377,7 @@ size_t CircQueue<byte>::put(const byte buf[], size_t n)
 
 	if (n < nwrap) {
 		memcpy(put_, buf, n);
-		T* p = put_ + n;
-		put_ = p;
+		put_ += n;
 	}
 	else if (n == nwrap) {
 		memcpy(put_, buf, n);
@@ -400,9 +400,9 @@ size_t CircQueue<byte>::put(const byte buf[], size_t n)
 // obtained.
 
 template <>
-size_t CircQueue<byte>::get(byte buf[], size_t n)
+inline size_t CircQueue<byte>::get(byte buf[], size_t n)
 {
-	if (empty_)
+	if (empty())
 		return 0;
 
 	n = min(n, size());
@@ -411,8 +411,7 @@ size_t CircQueue<byte>::get(byte buf[], size_t n)
 
 	if (n < nwrap) {
 		memcpy(buf, get_, n);
-		T* g = get_ + n;
-		get_ = g;
+		get_ += n;
 	}
 	else if (n == nwrap) {
 		memcpy(buf, get_, n);
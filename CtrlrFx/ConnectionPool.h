@@ -0,0 +1,194 @@
+/// @file ConnectionPool.h
+/// Definition of the @ref ConnectionPool class, which keeps client TCP
+/// connections open for reuse.
+
+#ifndef __CtrlrFx_ConnectionPool_h
+#define __CtrlrFx_ConnectionPool_h
+
+#include "CtrlrFx/TcpConnector.h"
+#include "CtrlrFx/Mutex.h"
+#include "CtrlrFx/Time.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A pool of idle client connections, keyed by server address.
+///
+/// A client that makes a burst of requests to the same server can get a
+/// connection from the pool, and put it back when it's done, rather than
+/// paying for a new TCP handshake each time. When no idle connection is
+/// available, a new one is made, with a timeout on the connect.
+///
+/// Idle connections are checked before they're handed out. One that the
+/// server closed, that has an error pending, or that has stray data
+/// waiting is discarded. Connections that sit idle longer than the idle
+/// timeout are closed, as are the oldest ones once the pool is full.
+///
+/// The pool is thread-safe. A connection belongs to just one client from
+/// the time it's taken from the pool until it's put back.
+
+class ConnectionPool
+{
+public:
+	/// The default number of idle connections kept
+	enum { DFLT_MAX_IDLE = 16 };
+
+private:
+	/// An idle connection
+	struct Entry {
+		SockAddr		addr;	///< The server address
+		socket_t		sock;	///< The socket
+		MonotonicTime	last;	///< When it was put back
+	};
+
+	mutable Mutex	lock_;			///< Lock for the pool
+	Entry*			idle_;			///< The idle connections, oldest first
+	size_t			cap_;			///< The most idle connections kept
+	size_t			n_;				///< The number of idle connections
+	Duration		idleTimeout_;	///< How long a connection can sit idle
+	Duration		connTimeout_;	///< The timeout for new connections
+	uint64_t		nreused_;		///< The number of connections reused
+	uint64_t		nnew_;			///< The number of new connections made
+
+	/// Removes the connection at position i. The lock must be held.
+	socket_t remove_locked(size_t i);
+
+	/// Closes the connections that have been idle too long.
+	/// The lock must be held.
+	void expire_locked(const MonotonicTime& now);
+
+	/// Determines if an idle connection is still usable.
+	static bool is_healthy(socket_t sock);
+
+	/// Closes a socket handle.
+	static void close(socket_t sock);
+
+	// Non-copyable
+	ConnectionPool(const ConnectionPool&);
+	ConnectionPool& operator=(const ConnectionPool&);
+
+public:
+	/**
+	 * Creates an empty pool.
+	 * @param maxIdle The most idle connections to keep.
+	 * @param idleTimeout How long a connection can sit idle in the pool
+	 *  				  before it's closed.
+	 * @param connTimeout The timeout for making new connections.
+	 */
+	ConnectionPool(size_t maxIdle=DFLT_MAX_IDLE,
+				   const Duration& idleTimeout=Duration(sec(60)),
+				   const Duration& connTimeout=Duration(sec(5)));
+	/**
+	 * Closes all the idle connections.
+	 */
+	~ConnectionPool();
+	/**
+	 * Gets a connection to a server.
+	 * This is the most recently used healthy idle connection to the
+	 * address, if there is one, or otherwise a new connection.
+	 * @param addr The server address.
+	 * @param sock Gets the connection.
+	 * @return 0 if an idle connection was reused, 1 if a new connection
+	 *  	   was made, or -1 if the connect failed.
+	 */
+	int get(const SockAddr& addr, TcpSocket& sock);
+	/**
+	 * Puts a connection back into the pool.
+	 * The pool takes the socket, leaving @em sock closed. A client should
+	 * only put back a connection that's in a good state, with no partial
+	 * request or response left on it; otherwise it should just close it.
+	 * @param addr The server address that the connection was made to.
+	 * @param sock The connection.
+	 */
+	void put(const SockAddr& addr, TcpSocket& sock);
+	/**
+	 * Closes any connections that have been idle too long.
+	 * This happens anyway on each get() and put(), but an application can
+	 * call it from a timer to release connections when the pool isn't
+	 * being used.
+	 */
+	void expire();
+	/**
+	 * Closes all the idle connections.
+	 */
+	void clear();
+	/**
+	 * Gets the number of idle connections in the pool.
+	 * @return The number of idle connections.
+	 */
+	size_t size() const;
+	/**
+	 * Gets the number of connections that were reused from the pool.
+	 * @return The number of connections reused.
+	 */
+	uint64_t reused() const { return nreused_; }
+	/**
+	 * Gets the number of new connections that the pool had to make.
+	 * @return The number of new connections.
+	 */
+	uint64_t created() const { return nnew_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A connection taken from a @ref ConnectionPool for the life of this
+/// object.
+///
+/// The connection goes back into the pool when the object is destroyed.
+/// If anything goes wrong with it, call discard() so that it's closed
+/// instead.
+
+class PooledConnection
+{
+	ConnectionPool&	pool_;	///< The pool
+	SockAddr		addr_;	///< The server address
+	TcpSocket		sock_;	///< The connection
+	int				ret_;	///< The result of getting the connection
+
+	// Non-copyable
+	PooledConnection(const PooledConnection&);
+	PooledConnection& operator=(const PooledConnection&);
+
+public:
+	/**
+	 * Gets a connection to a server from the pool.
+	 * @param pool The pool.
+	 * @param addr The server address.
+	 */
+	PooledConnection(ConnectionPool& pool, const SockAddr& addr)
+			: pool_(pool), addr_(addr) { ret_ = pool_.get(addr_, sock_); }
+	/**
+	 * Puts the connection back into the pool, unless it was discarded.
+	 */
+	~PooledConnection() {
+		if (sock_.is_open())
+			pool_.put(addr_, sock_);
+	}
+	/**
+	 * Determines if a connection was had.
+	 * @return @em true if the connection is open.
+	 */
+	bool is_open() const { return sock_.is_open(); }
+	/**
+	 * Determines if the connection was reused from the pool.
+	 * @return @em true if it was reused, @em false if it's new.
+	 */
+	bool is_reused() const { return ret_ == 0; }
+	/**
+	 * Gets the connection.
+	 * @return The connected socket.
+	 */
+	TcpSocket& socket() { return sock_; }
+	/**
+	 * Closes the connection, rather than putting it back into the pool.
+	 */
+	void discard() { sock_.close(); }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_ConnectionPool_h
+
@@ -50,6 +50,42 @@ int write(fd_t fd, ByteBuffer& buf);
 
 int write_n(fd_t fd, ByteBuffer& buf);
 
+/**
+ * Scatter read from the device into a sequence of buffers, with a single
+ * call to readv(). Each buffer's position is advanced past the data it
+ * received.
+ * @param fd File handle for the device.
+ * @param bufs The buffers to fill, in order.
+ * @param n The number of buffers.
+ * @return The number of bytes read, or <0 on error.
+ */
+int readv(fd_t fd, ByteBuffer* const bufs[], size_t n);
+
+/**
+ * Best effort to fill all of the buffers from the device.
+ * @return The number of bytes read. This is the total space available in
+ *         the buffers unless an error or end-of-file is detected.
+ */
+int readv_n(fd_t fd, ByteBuffer* const bufs[], size_t n);
+
+/**
+ * Gather write to the device from a sequence of buffers, with a single
+ * call to writev(). Each buffer's position is advanced past the data that
+ * was taken from it.
+ * @param fd File handle for the device.
+ * @param bufs The buffers to write, in order.
+ * @param n The number of buffers.
+ * @return The number of bytes written, or <0 on error.
+ */
+int writev(fd_t fd, ByteBuffer* const bufs[], size_t n);
+
+/**
+ * Best effort to write all of the buffers to the device.
+ * @return The number of bytes written. This is the total data available in
+ *         the buffers unless an error is detected.
+ */
+int writev_n(fd_t fd, ByteBuffer* const bufs[], size_t n);
+
 /////////////////////////////////////////////////////////////////////////////
 /// The base class for device comm ports.
 /// This class manipulates the file descriptor.
@@ -207,6 +243,16 @@ public:
 	virtual int read_n(ByteBuffer& buf) {
 		return CtrlrFx::read_n(fd_, buf);
 	}
+
+	/// Scatter read into a sequence of buffers.
+	virtual int readv(ByteBuffer* const bufs[], size_t n) {
+		return CtrlrFx::readv(fd_, bufs, n);
+	}
+
+	/// Best-effort attempt to fill all of the buffers from the device.
+	virtual int readv_n(ByteBuffer* const bufs[], size_t n) {
+		return CtrlrFx::readv_n(fd_, bufs, n);
+	}
 	/**
      * Set a timeout for read operations.
      * Sets the timout that the device uses for read operations. Not all
@@ -279,6 +325,16 @@ public:
 	virtual int write_n(ByteBuffer& buf) {
 		return CtrlrFx::write_n(fd_, buf);
 	}
+
+	/// Gather write from a sequence of buffers.
+	virtual int writev(ByteBuffer* const bufs[], size_t n) {
+		return CtrlrFx::writev(fd_, bufs, n);
+	}
+
+	/// Best-effort attempt to write all of the buffers to the device.
+	virtual int writev_n(ByteBuffer* const bufs[], size_t n) {
+		return CtrlrFx::writev_n(fd_, bufs, n);
+	}
 	/**
      * Set a timeout for write operations.
      * Sets the timout that the device uses for write operations. Not all
@@ -14,6 +14,9 @@
 
 namespace CtrlrFx {
 
+class ConnectionPool;
+class SockAddr;
+
 /////////////////////////////////////////////////////////////////////////////
 
 class DistObjSrvr
@@ -38,6 +41,9 @@ private:
 
 	int get_pkt_hdr(BinPktHdr *pkt_hdr);
 
+	static int transact(IDevice& port, byte msg_type, ByteBuffer& packet,
+						ByteBuffer& rsp);
+
 	// Non-copyable
 	DistObjSrvr(const DistObjSrvr&);
 	DistObjSrvr& operator=(const DistObjSrvr&);
@@ -66,6 +72,14 @@ public:
 	/// Send a message to a remote server
 	int send(byte msg_type, ByteBuffer& packet, ByteBuffer& rsp);
 
+	/// Send a message to a remote server over a pooled TCP connection.
+	/// The connection is returned to the pool for the next request, unless
+	/// the exchange failed, in which case it's closed. This doesn't use
+	/// the server's port, so requests to different servers, or on
+	/// different connections to the same one, can go out in parallel.
+	int send(ConnectionPool& pool, const SockAddr& addr, byte msg_type,
+			 ByteBuffer& packet, ByteBuffer& rsp);
+
 	/// Run this server to process incoming messages.
 	virtual int run();
 
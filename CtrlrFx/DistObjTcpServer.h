@@ -0,0 +1,149 @@
+/// @file DistObjTcpServer.h
+/// Definition of the @ref DistObjTcpServer class, which serves distributed
+/// objects to many TCP clients from a set of reactors.
+/// This is Linux-specific.
+
+#ifndef __CtrlrFx_DistObjTcpServer_h
+#define __CtrlrFx_DistObjTcpServer_h
+
+#if defined(__linux__)
+
+#include "CtrlrFx/Reactor.h"
+#include "CtrlrFx/DistObj.h"
+#include "CtrlrFx/DistObjSrvr.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A distributed object server for many TCP clients at once.
+///
+/// Where a @ref DistObjSrvr blocks a thread on a single port, this server
+/// accepts connections on every reactor of a @ref ReactorPool, and each
+/// connection is then serviced, non-blocking, by the reactor that accepted
+/// it. So a few event-loop threads can serve dozens of clients.
+///
+/// Each connection reads whatever the client sends, frames it into packets
+/// with the same wire protocol as DistObjSrvr, and dispatches the commands
+/// to the objects in the server's registry. The responses are collected in
+/// the connection's output buffer and go back to that client with as few
+/// writes as possible. A client that doesn't read its responses only stops
+/// its own connection: once its output buffer is full, no more of its
+/// commands are read until it catches up.
+///
+/// The I/O and framing for different connections run in parallel, but the
+/// dispatches are serialized with a lock, since the objects aren't expected
+/// to be thread-safe.
+
+class DistObjTcpServer
+{
+public:
+	/// The default limit on the size of a command or response payload
+	static const size_t DFLT_MAX_PKT_SIZE = DistObjSrvr::DFLT_CMD_RSP_SIZE;
+
+	/// The default size of each connection's output buffer
+	static const size_t DFLT_OUT_BUF_SIZE = 16*1024;
+
+	typedef DistObjRegistry::key_t key_t;
+
+private:
+	class Connection;
+
+	/// Hands the connections from all the reactors to the server.
+	class Acceptor : public ShardedAcceptor
+	{
+		DistObjTcpServer& srvr_;
+	public:
+		Acceptor(ReactorPool& pool, DistObjTcpServer& srvr)
+				: ShardedAcceptor(pool), srvr_(srvr) {}
+		virtual void on_accept(TcpSocket& sock, Reactor& r) {
+			srvr_.on_accept(sock, r);
+		}
+	};
+
+	typedef Guard<Mutex> MyGuard;
+
+	Acceptor		acc_;		///< Takes the new connections
+	DistObjRegistry	obj_reg_;	///< The objects being served
+	Mutex			lock_;		///< Serializes the dispatches
+	size_t			maxPkt_;	///< The largest payload allowed
+	size_t			outSize_;	///< The size of the output buffers
+	Connection*		conns_;		///< The list of open connections
+	size_t			nconn_;		///< The number of open connections
+	mutable Mutex	connLock_;	///< Lock for the connection list
+
+	/// Starts servicing a new connection.
+	void on_accept(TcpSocket& sock, Reactor& r);
+
+	/// Takes a closed connection off the list.
+	void remove(Connection* conn);
+
+	/// Dispatches a command to the registry.
+	int dispatch(key_t obj, IDistObj::op_t op, BufDecoder& param,
+				 BufEncoder& rsp);
+
+	// Non-copyable
+	DistObjTcpServer(const DistObjTcpServer&);
+	DistObjTcpServer& operator=(const DistObjTcpServer&);
+
+public:
+	/**
+	 * Creates a server that runs on the reactors in a pool.
+	 * @param pool The reactors that service the connections.
+	 * @param maxPktSize The largest command or response payload. A client
+	 *  				 that sends a bigger one is disconnected.
+	 * @param outBufSize The size of each connection's output buffer. This
+	 *  				 is raised, if need be, to hold at least one full
+	 *  				 response.
+	 */
+	DistObjTcpServer(ReactorPool& pool, size_t maxPktSize=DFLT_MAX_PKT_SIZE,
+					 size_t outBufSize=DFLT_OUT_BUF_SIZE);
+	/**
+	 * Closes the listeners and all the connections.
+	 * The reactor pool must be stopped first.
+	 */
+	~DistObjTcpServer();
+	/**
+	 * Registers an object for incoming commands from the clients.
+	 * @param key The key the clients use to address the object.
+	 * @param obj The object.
+	 * @return A non-negative value on success, or -CFXE_NO_MEM if the
+	 *  	   registry is full.
+	 */
+	int register_obj(key_t key, IDistObj* obj);
+	/**
+	 * Starts listening for clients.
+	 * @param addr The address to listen on. If the port is zero, the
+	 *  		   system picks one.
+	 * @param queSize The listen queue size for each reactor.
+	 * @param opts Additional @ref TcpAcceptor options.
+	 * @return 0 on success, -1 on error.
+	 */
+	int open(const SockAddr& addr, int queSize=TcpAcceptor::MAX_QUE_SIZE,
+			 int opts=0) {
+		return acc_.open(addr, queSize, opts);
+	}
+	/**
+	 * Gets the address that the server is listening on.
+	 * @return The address, or an empty one if not open.
+	 */
+	SockAddr addr() const { return acc_.addr(); }
+	/**
+	 * Stops listening and closes all the connections.
+	 * The reactor pool must be stopped first.
+	 */
+	void close();
+	/**
+	 * Gets the number of clients connected.
+	 * @return The number of open connections.
+	 */
+	size_t num_connections() const;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __linux__
+#endif		// __CtrlrFx_DistObjTcpServer_h
+
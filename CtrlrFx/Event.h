@@ -12,9 +12,19 @@ namespace CtrlrFx {
 typedef int16_t evt_sig_t;
 
 /// Base for CtrlrFx events.
+/// Events that are allocated from an @ref EventPool are reference counted,
+/// so that one event can be posted or published to several active objects
+/// and then recycled when the last of them is done with it. Events that
+/// aren't from a pool (static or automatic events) have a pool id of zero
+/// and are never recycled.
 struct Event
 {
-	evt_sig_t sig;
+	evt_sig_t			sig;		///< The event signal
+	uint8_t				poolId;		///< The pool holding the event (zero if none)
+	volatile uint8_t	refCnt;		///< The number of outstanding references
+
+	/// Creates an event that isn't from a pool.
+	explicit Event(evt_sig_t s=0) : sig(s), poolId(0), refCnt(0) {}
 };
 
 
@@ -0,0 +1,305 @@
+/// @file HierStateMachine.h
+/// Definition of the CtrlrFx @ref HierStateMachine class.
+
+#ifndef __CtrlrFx_HierStateMachine_h
+#define __CtrlrFx_HierStateMachine_h
+
+#include "CtrlrFx/Event.h"
+#include <assert.h>
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A hierarchical, table-driven state machine.
+///
+/// The states are identified by small integers, from zero to N-1, and are
+/// described by a constant table of @ref StateDef entries, indexed by the
+/// state id. Each entry gives the parent of the state (or @ref TOP), its
+/// default sub-state, its event handler, and its optional entry and exit
+/// actions. Since the table is a constant aggregate, the parent links are
+/// fixed at compile time, and don't cost anything at run time.
+///
+/// An event is first given to the handler of the current (innermost)
+/// state. If that handler returns @em false, the event is passed up to the
+/// handler of the parent, and so on up to the top, so behavior that's
+/// common to several states is written once, in their common parent.
+///
+/// A handler requests a transition by calling @ref tran(). The transition
+/// is taken after the handler returns. The exit actions are run from the
+/// current state up to (but not including) the least common ancestor of
+/// the current and target states, then the entry actions are run down to
+/// the target, and on through its default sub-states. The depth at which
+/// each transition turns around is computed for every pair of states, so
+/// taking a transition is just a walk over the states that are actually
+/// exited and entered.
+///
+/// Those transition tables only depend on the state definitions, so they
+/// are built once, in a @ref Table, which is normally a static member of
+/// the derived class, and shared by all of its instances. Each machine only
+/// holds its current state:
+///
+/// @code
+/// class Motor : public HierStateMachine<Motor, N_STATE>
+/// {
+/// 	static const StateDef STATES[N_STATE];
+/// 	static const Table TABLE;
+/// public:
+/// 	Motor() : HierStateMachine<Motor, N_STATE>(TABLE) { init(ST_IDLE); }
+/// 	...
+/// };
+///
+/// const Motor::Table Motor::TABLE(Motor::STATES);
+/// @endcode
+///
+/// A table is built by its constructor, so a machine that's created during
+/// static initialization should get its table from a function-local static
+/// instead.
+///
+/// @param T The derived class.
+/// @param N The number of states.
+/// @param EvtType The event type.
+/// @param MAX_DEPTH The maximum nesting depth of the states.
+
+template <typename T, int N, typename EvtType=const Event*, int MAX_DEPTH=8>
+class HierStateMachine
+{
+public:
+	/// The event handler method type.
+	/// A handler returns @em true if it handled the event, or @em false to
+	/// pass it up to the parent state.
+	typedef bool (T::*Handler)(EvtType evt);
+
+	/// The entry and exit action method type.
+	typedef void (T::*Action)();
+
+	/// The parent of the top-level states, and the "none" value for the
+	/// default sub-state.
+	enum { TOP = -1 };
+
+	/// The definition of a single state.
+	struct StateDef
+	{
+		int			parent;		///< The parent state, or TOP
+		int			initial;	///< The default sub-state, or TOP if none
+		Handler		handler;	///< The event handler (may be null)
+		Action		entry;		///< The entry action (may be null)
+		Action		exit;		///< The exit action (may be null)
+	};
+
+	/// The state definitions, along with the transition tables that are
+	/// built from them.
+	/// This is constant once it's constructed, and can be shared by any
+	/// number of machines.
+	class Table
+	{
+		friend class HierStateMachine;
+
+		const StateDef*	defs_;					///< The state definitions
+		uint8_t			depth_[N];				///< The depth of each state
+		int8_t			path_[N][MAX_DEPTH];	///< The ancestors of each state, from the top
+		uint8_t			keep_[N][N];			///< The depth kept by each transition
+
+		// Non-copyable
+		Table(const Table&);
+		Table& operator=(const Table&);
+
+	public:
+		/**
+		 * Builds the transition tables from the state definitions.
+		 * @param defs The table of N state definitions, indexed by state
+		 *  		   id. This must outlive the table.
+		 */
+		explicit Table(const StateDef* defs);
+	};
+
+private:
+	const Table&	tbl_;		///< The shared state tables
+	int				state_;		///< The current state
+	int				target_;	///< A pending transition, or TOP
+
+	/// Runs the entry action of a state.
+	void enter_state(int st) {
+		Action a = tbl_.defs_[st].entry;
+		if (a)
+			(static_cast<T*>(this)->*a)();
+	}
+
+	/// Runs the exit action of a state.
+	void exit_state(int st) {
+		Action a = tbl_.defs_[st].exit;
+		if (a)
+			(static_cast<T*>(this)->*a)();
+	}
+
+	/// Enters the default sub-states, down from the current state.
+	void enter_initial() {
+		int st;
+		while ((st = tbl_.defs_[state_].initial) != TOP) {
+			assert(tbl_.defs_[st].parent == state_);
+			enter_state(st);
+			state_ = st;
+		}
+	}
+
+	/// Takes a transition from the current state to the target.
+	void take(int target);
+
+	// Non-copyable
+	HierStateMachine(const HierStateMachine&);
+	HierStateMachine& operator=(const HierStateMachine&);
+
+protected:
+	/**
+	 * Creates the state machine.
+	 * This doesn't enter any state. The derived class calls @ref init()
+	 * when it is ready to run.
+	 * @param tbl The state tables. This must outlive the state machine.
+	 */
+	explicit HierStateMachine(const Table& tbl)
+					: tbl_(tbl), state_(TOP), target_(TOP) {}
+	/**
+	 * Enters the initial state.
+	 * This runs the entry actions from the top down to the state, then on
+	 * through its default sub-states.
+	 * @param st The initial state.
+	 */
+	void init(int st);
+	/**
+	 * Requests a transition to another state.
+	 * This is called from an event handler. The transition is taken when
+	 * the handler returns. A transition to the current state exits and
+	 * re-enters it.
+	 * @param st The target state.
+	 */
+	void tran(int st) {
+		assert(st >= 0 && st < N);
+		target_ = st;
+	}
+
+public:
+	/// Virtual destructor
+	virtual ~HierStateMachine() {}
+	/**
+	 * Gets the current (innermost) state.
+	 * @return The current state, or TOP if the machine hasn't been
+	 *  	   initialized.
+	 */
+	int state() const { return state_; }
+	/**
+	 * Determines if the machine is in a state, either directly, or in one
+	 * of its sub-states.
+	 * @param st The state to test.
+	 * @return @em true if the machine is in the state.
+	 */
+	bool in_state(int st) const {
+		int d = tbl_.depth_[st];
+		return state_ != TOP && d <= tbl_.depth_[state_]
+					&& tbl_.path_[state_][d-1] == st;
+	}
+	/**
+	 * Dispatches an event to the state machine.
+	 * @param evt The event.
+	 * @return @em true if some state handled the event.
+	 */
+	bool dispatch(EvtType evt);
+};
+
+// --------------------------------------------------------------------------
+// The depth kept by a transition is the length of the common prefix of the
+// ancestor paths of the two states. If the target is the source or one of
+// its ancestors, the target itself is exited and re-entered, so the kept
+// depth is one less.
+
+template <typename T, int N, typename EvtType, int MAX_DEPTH>
+HierStateMachine<T,N,EvtType,MAX_DEPTH>::Table::Table(const StateDef* defs)
+												: defs_(defs)
+{
+	assert(N > 0 && N <= 127);
+
+	for (int st=0; st<N; ++st) {
+		int d = 0;
+		for (int s=st; s != TOP; s=defs_[s].parent) {
+			assert(s >= 0 && s < N && d < MAX_DEPTH);
+			++d;
+		}
+		depth_[st] = uint8_t(d);
+		for (int s=st; s != TOP; s=defs_[s].parent)
+			path_[st][--d] = int8_t(s);
+	}
+
+	for (int src=0; src<N; ++src) {
+		for (int dst=0; dst<N; ++dst) {
+			int n = (depth_[src] < depth_[dst]) ? depth_[src] : depth_[dst],
+				k = 0;
+
+			while (k < n && path_[src][k] == path_[dst][k])
+				++k;
+
+			if (k == depth_[dst])
+				--k;
+
+			keep_[src][dst] = uint8_t(k);
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T, int N, typename EvtType, int MAX_DEPTH>
+void HierStateMachine<T,N,EvtType,MAX_DEPTH>::init(int st)
+{
+	assert(st >= 0 && st < N && state_ == TOP);
+
+	for (int i=0; i<tbl_.depth_[st]; ++i)
+		enter_state(tbl_.path_[st][i]);
+
+	state_ = st;
+	enter_initial();
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T, int N, typename EvtType, int MAX_DEPTH>
+void HierStateMachine<T,N,EvtType,MAX_DEPTH>::take(int target)
+{
+	int keep = tbl_.keep_[state_][target];
+
+	for (int i=tbl_.depth_[state_]-1; i>=keep; --i)
+		exit_state(tbl_.path_[state_][i]);
+
+	for (int i=keep; i<tbl_.depth_[target]; ++i)
+		enter_state(tbl_.path_[target][i]);
+
+	state_ = target;
+	enter_initial();
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T, int N, typename EvtType, int MAX_DEPTH>
+bool HierStateMachine<T,N,EvtType,MAX_DEPTH>::dispatch(EvtType evt)
+{
+	T* obj = static_cast<T*>(this);
+	bool handled = false;
+
+	for (int st=state_; st != TOP && !handled; st=tbl_.defs_[st].parent) {
+		Handler h = tbl_.defs_[st].handler;
+		if (h)
+			handled = (obj->*h)(evt);
+	}
+
+	if (target_ != TOP) {
+		int target = target_;
+		target_ = TOP;
+		take(target);
+	}
+	return handled;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_HierStateMachine_h
+
@@ -25,6 +25,14 @@ interface IInDevice
 
 	/// Best-effort attempt to read the whole buffer from the device.
 	virtual int read_n(ByteBuffer& buf) =0;
+
+	/// Scatter read into a sequence of buffers, with a single call to the
+	/// OS where possible. The buffers are filled in order, and each one's
+	/// position is advanced past the data it received.
+	virtual int readv(ByteBuffer* const bufs[], size_t n) =0;
+
+	/// Best-effort attempt to fill all of the buffers from the device.
+	virtual int readv_n(ByteBuffer* const bufs[], size_t n) =0;
 	/**
      * Set a timeout for read operations.
      * Sets the timout that the device uses for read operations. Not all
@@ -55,6 +63,14 @@ interface IOutDevice
 
 	/// Best-effort attempt to write the whole buffer to the device
 	virtual int write_n(ByteBuffer& buf) =0;
+
+	/// Gather write from a sequence of buffers, with a single call to the
+	/// OS where possible. Each buffer's position is advanced past the data
+	/// that was taken from it, so a partial write can be resumed.
+	virtual int writev(ByteBuffer* const bufs[], size_t n) =0;
+
+	/// Best-effort attempt to write all of the buffers to the device
+	virtual int writev_n(ByteBuffer* const bufs[], size_t n) =0;
 	/**
      * Set a timeout for write operations.
      * Sets the timout that the device uses for write operations. Not all
@@ -78,6 +94,27 @@ class IDevice : public virtual IInDevice, public virtual IOutDevice
 {
 };
 
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Advances the positions of a sequence of buffers past the data that a
+ * scatter/gather operation transferred. The buffers are consumed in order,
+ * each up to its limit, until the count is used up.
+ * @param bufs The buffers.
+ * @param nbuf The number of buffers.
+ * @param n The number of bytes transferred.
+ */
+inline void advance_buffers(ByteBuffer* const bufs[], size_t nbuf, size_t n)
+{
+	for (size_t i=0; i<nbuf && n > 0; ++i) {
+		size_t nx = bufs[i]->available();
+		if (nx > n)
+			nx = n;
+		bufs[i]->incr_position(int(nx));
+		n -= nx;
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // end namespace CtrlrFx
 };
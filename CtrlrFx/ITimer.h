@@ -21,6 +21,17 @@ public:
 	/// Handler for a timer event.
 	virtual void on_timer(ITimer& tmr) =0;
 
+	/// Handler for a timer event that reports missed expirations.
+	/// Timers that can tell when the client fell behind (such as a
+	/// periodic timer that expired more than once since the last event)
+	/// call this, with the number of expirations since the last event.
+	/// The default implementation ignores the count and calls
+	/// on_timer(ITimer&).
+	/// @param tmr The timer that expired.
+	/// @param nExpired The number of times the timer expired since the
+	///  			   last event. This is normally one.
+	virtual void on_timer(ITimer& tmr, uint64_t /*nExpired*/) { on_timer(tmr); }
+
 	/// Virtual destructor
 	virtual ~ITimerClient() {}
 };
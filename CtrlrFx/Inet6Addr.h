@@ -0,0 +1,159 @@
+/// @file Inet6Addr.h
+/// Class for an IPv6 socket address.
+
+#ifndef __CtrlrFx_Inet6Addr_h
+#define __CtrlrFx_Inet6Addr_h
+
+#include <cstring>
+#include "CtrlrFx/CtrlrFx.h"
+
+#if !defined(WIN32)
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+#endif
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+/// Class that represents an IPv6 internet address.
+/// This inherits from the IPv6 form of a socket address, @em sockaddr_in6,
+/// in the same way that InetAddr inherits from @em sockaddr_in.
+
+class Inet6Addr : public sockaddr_in6
+{
+	// NOTE: As with InetAddr, this class must stay binary compatible with
+	// a sockaddr_in6. Do not add any member variables.
+
+	/// Sets the contents of this object to all zero
+	void zero();
+
+public:
+	/// Constructs an empty address.
+	/// The address is initialized to all zeroes.
+	Inet6Addr();
+
+	/// Constructs an address for any local address, using the specified
+	/// port.
+	Inet6Addr(uint16_t port);
+
+	/// Constructs an address for the specified host and port.
+	Inet6Addr(const in6_addr& addr, uint16_t port);
+
+	/// Constructs an address using the name of the host and the specified
+	/// port. This attempts to resolve the host name to an address. A host
+	/// with only an IPv4 address gets the IPv4-mapped form.
+	Inet6Addr(const char* saddr, uint16_t port);
+
+	/// Constructs the address by copying the specified structure.
+	Inet6Addr(const sockaddr_in6& addr);
+
+	/// Constructs the address by copying the specified address.
+	Inet6Addr(const Inet6Addr& addr);
+
+	/// Creates an address for the loopback interface (::1).
+	static Inet6Addr loopback(uint16_t port);
+
+	/// Checks if the address is set to some value.
+	bool is_set() const;
+
+	/// Equality comparator.
+	/// This does a bitwise comparison.
+	bool operator==(const Inet6Addr& rhs) const;
+
+	/// Inequality comparator
+	/// This does a bitwise comparison.
+	bool operator!=(const Inet6Addr& rhs) const;
+
+	/// Attempts to resolve the host name into an IPv6 address.
+	/// @param saddr The host name, or a numeric address string.
+	/// @param addr Gets the address.
+	/// @return @em true if the name was resolved.
+	static bool resolve_name(const char* saddr, in6_addr* addr);
+
+	/// Creates the socket address using the specified host address and
+	/// port number.
+	void create(const in6_addr& addr, uint16_t port);
+
+	/// Creates the socket address using the specified host name and
+	/// port number.
+	void create(const char* saddr, uint16_t port);
+
+	/// Gets the 128-bit Internet Address.
+	const in6_addr& address() const { return sin6_addr; }
+
+	/// Gets the port number.
+	/// @ return The port number in the local host's byte order.
+	uint16_t port() const { return ntohs(this->sin6_port); }
+
+	/// Gets the size of this structure.
+	size_t size() const { return sizeof(Inet6Addr); }
+
+	/// Returns a pointer to this object cast to a @em sockaddr.
+	sockaddr* sockaddr_ptr() const { return (sockaddr*) this; }
+
+	/// Returns a pointer to this object cast to a @em sockaddr_in6.
+	sockaddr_in6* sockaddr_in6_ptr() const { return (sockaddr_in6*) this; }
+};
+
+// --------------------------------------------------------------------------
+
+inline Inet6Addr::Inet6Addr()
+{
+	zero();
+}
+
+inline Inet6Addr::Inet6Addr(uint16_t port)
+{
+	create(in6addr_any, port);
+}
+
+inline Inet6Addr::Inet6Addr(const in6_addr& addr, uint16_t port)
+{
+	create(addr, port);
+}
+
+inline Inet6Addr::Inet6Addr(const char* saddr, uint16_t port)
+{
+	create(saddr, port);
+}
+
+inline Inet6Addr::Inet6Addr(const sockaddr_in6& addr)
+{
+	std::memcpy(sockaddr_in6_ptr(), &addr, sizeof(sockaddr_in6));
+}
+
+inline Inet6Addr::Inet6Addr(const Inet6Addr& addr)
+{
+	std::memcpy(this, &addr, sizeof(Inet6Addr));
+}
+
+inline Inet6Addr Inet6Addr::loopback(uint16_t port)
+{
+	return Inet6Addr(in6addr_loopback, port);
+}
+
+// --------------------------------------------------------------------------
+
+inline bool Inet6Addr::operator==(const Inet6Addr& rhs) const
+{
+	return std::memcmp(this, &rhs, sizeof(Inet6Addr)) == 0;
+}
+
+inline bool Inet6Addr::operator!=(const Inet6Addr& rhs) const
+{
+	return !operator==(rhs);
+}
+
+// --------------------------------------------------------------------------
+
+inline void Inet6Addr::zero()
+{
+	std::memset(this, 0, sizeof(Inet6Addr));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_Inet6Addr_h
+
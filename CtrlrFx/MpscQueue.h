@@ -0,0 +1,134 @@
+/// @file MpscQueue.h
+/// Definition of the lock-free, intrusive, multi-producer/single-consumer
+/// queue.
+
+#ifndef __CtrlrFx_MpscQueue_h
+#define __CtrlrFx_MpscQueue_h
+
+#include "CtrlrFx/xtypes.h"
+#include "CtrlrFx/AtomicOps.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// The link that an item needs to be placed in an @ref MpscQueue.
+/// Items derive from this (or contain it) and are never copied by the
+/// queue.
+
+struct MpscNode
+{
+	MpscNode* volatile	mpscNext;	///< The next item in the queue
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// An intrusive, unbounded, multi-producer/single-consumer queue.
+///
+/// This is D. Vyukov's MPSC queue. A push is a single atomic exchange
+/// followed by a store, so it is wait-free: a producer never loops and
+/// never waits for another thread, no matter how many are pushing at the
+/// same time. The consumer's pop is a few plain loads and stores.
+///
+/// The one catch is that a producer which has swapped itself in as the
+/// head, but not yet linked the previous item to its own, briefly hides
+/// the items behind it. The consumer spins over that window, which is
+/// only a couple of instructions long (unless the producer is preempted
+/// right there).
+///
+/// Any number of threads may call @ref push() at the same time, but only
+/// one thread at a time may call @ref pop().
+
+class MpscQueue
+{
+	MpscNode* volatile	head_;		///< The last item pushed (producers)
+	char				pad_[64];	///< Keeps the ends on separate cache lines
+	MpscNode*			tail_;		///< The next item to pop (consumer)
+	MpscNode			stub_;		///< Placeholder that keeps the list non-empty
+
+	/// Waits for a producer to link the item following the node.
+	static MpscNode* wait_next(MpscNode* node) {
+		MpscNode* next;
+		while ((next = atomic_load_acquire(&node->mpscNext)) == 0)
+			cpu_relax();
+		return next;
+	}
+
+	// Non-copyable
+	MpscQueue(const MpscQueue&);
+	MpscQueue& operator=(const MpscQueue&);
+
+public:
+	/**
+	 * Creates an empty queue.
+	 */
+	MpscQueue() : head_(&stub_), tail_(&stub_) {
+		stub_.mpscNext = 0;
+	}
+	/**
+	 * Appends an item to the queue.
+	 * This is wait-free and can be called from any thread.
+	 * @param node The item. It must not already be in a queue.
+	 */
+	void push(MpscNode* node) {
+		atomic_store_relaxed(&node->mpscNext, (MpscNode*) 0);
+		MpscNode* prev = atomic_exchange(&head_, node);
+		atomic_store_release(&prev->mpscNext, node);
+	}
+	/**
+	 * Removes the item at the front of the queue.
+	 * This must only be called from the consumer thread.
+	 * @return The item, or null if the queue is empty.
+	 */
+	MpscNode* pop();
+	/**
+	 * Determines if the queue is empty.
+	 * This must only be called from the consumer thread. Producers might
+	 * add items at any time, so the answer is only a snapshot.
+	 * @return @em true if the queue is empty.
+	 */
+	bool empty() const {
+		return tail_ == &stub_ && atomic_load_acquire(&stub_.mpscNext) == 0
+				&& atomic_load_acquire(&head_) == &stub_;
+	}
+};
+
+// --------------------------------------------------------------------------
+// The stub is skipped when it's at the front, and pushed back in when the
+// last real item is about to be taken, so the list is never truly empty
+// and the producers never have to touch the tail.
+
+inline MpscNode* MpscQueue::pop()
+{
+	MpscNode* tail = tail_;
+	MpscNode* next = atomic_load_acquire(&tail->mpscNext);
+
+	if (tail == &stub_) {
+		if (next == 0) {
+			if (atomic_load_acquire(&head_) == &stub_)
+				return 0;
+			next = wait_next(tail);
+		}
+		tail_ = tail = next;
+		next = atomic_load_acquire(&tail->mpscNext);
+	}
+
+	if (next == 0) {
+		if (atomic_load_acquire(&head_) == tail) {
+			push(&stub_);
+			next = atomic_load_acquire(&tail->mpscNext);
+		}
+		if (next == 0)
+			next = wait_next(tail);
+	}
+
+	tail_ = next;
+	return tail;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_MpscQueue_h
+
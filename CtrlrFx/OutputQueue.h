@@ -0,0 +1,178 @@
+/// @file OutputQueue.h
+/// Definition of the @ref OutputQueue class, a bounded queue of outgoing
+/// buffers for a non-blocking socket or device.
+
+#ifndef __CtrlrFx_OutputQueue_h
+#define __CtrlrFx_OutputQueue_h
+
+#include "CtrlrFx/IDevice.h"
+#include "CtrlrFx/ConditionVar.h"
+#include "CtrlrFx/Guard.h"
+
+namespace CtrlrFx {
+
+class OutputQueue;
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// Callbacks from an @ref OutputQueue.
+/// These are never made with the queue's lock held, so they can call back
+/// into the queue.
+
+class IOutputQueueClient
+{
+public:
+	virtual ~IOutputQueueClient() {}
+	/**
+	 * Called when the queue is done with a buffer, whether it was written,
+	 * dropped, or discarded when the queue was closed. The buffer can then
+	 * be reused, such as by returning it to its pool.
+	 * @param buf The buffer.
+	 */
+	virtual void on_release(ByteBuffer* buf) =0;
+	/**
+	 * Called when the queued data reaches the high watermark.
+	 * A producer can use this to stop generating data.
+	 */
+	virtual void on_high_water(OutputQueue&) {}
+	/**
+	 * Called when the queued data drops back to the low watermark after
+	 * having reached the high one.
+	 */
+	virtual void on_low_water(OutputQueue&) {}
+	/**
+	 * Called when the queue is closed under the @em DISCONNECT policy.
+	 * The client normally closes the connection here.
+	 */
+	virtual void on_overflow(OutputQueue&) {}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A bounded queue of buffers waiting to be written to a non-blocking
+/// socket or device.
+///
+/// Producers write() buffers into the queue, and the data goes out with a
+/// gather write each time the device becomes writable and flush() is
+/// called, typically from a reactor. So one slow consumer only backs up its
+/// own queue, rather than stalling the thread that serves everyone.
+///
+/// The queue is bounded by a high watermark. What happens when a write
+/// would pass it is the slow-consumer policy:
+/// @li @em BLOCK The producer waits until the queue drains to the low
+///  	watermark. This must not be the thread that calls flush().
+/// @li @em DROP The new buffer is dropped.
+/// @li @em DISCONNECT The queue is closed, and the client told to drop
+///  	the connection.
+///
+/// Buffers are passed by pointer, and the queue owns them until it calls
+/// the client's on_release(). The queue is thread-safe.
+
+class OutputQueue
+{
+public:
+	/// The slow-consumer policies.
+	enum Policy { BLOCK, DROP, DISCONNECT };
+
+	/// The most buffers written with a single call.
+	enum { MAX_WRITE_BUFS = 64 };
+
+private:
+	IOutDevice&			dev_;		///< The device to write
+	IOutputQueueClient*	client_;	///< Gets the callbacks
+	size_t				hiWater_;	///< The high watermark, in bytes
+	size_t				loWater_;	///< The low watermark, in bytes
+	Policy				policy_;	///< The slow-consumer policy
+	ByteBuffer**		bufs_;		///< The ring of queued buffers
+	size_t				cap_;		///< The capacity of the ring
+	size_t				head_;		///< The first queued buffer
+	size_t				n_;			///< The number of queued buffers
+	size_t				nbytes_;	///< The number of bytes queued
+	bool				high_;		///< Whether we passed the high watermark
+	bool				closed_;	///< Whether the queue was closed
+	uint64_t			ndropped_;	///< The number of buffers dropped
+	ConditionVar		cond_;		///< Lock and signal for the queue
+
+	/// Writes as much as the device will take. The lock must be held.
+	/// @param done Gets the buffers that were completely written.
+	/// @param ndone Gets the number of buffers that were written.
+	int flush_locked(ByteBuffer* done[], size_t* ndone);
+
+	/// Releases a set of buffers to the client.
+	void release(ByteBuffer* const bufs[], size_t n);
+
+	/// Empties the queue. The lock must be held.
+	size_t clear_locked(ByteBuffer* bufs[]);
+
+	// Non-copyable
+	OutputQueue(const OutputQueue&);
+	OutputQueue& operator=(const OutputQueue&);
+
+public:
+	/**
+	 * Creates a queue for a device.
+	 * @param dev The device to write. It should be non-blocking.
+	 * @param hiWater The high watermark, in bytes.
+	 * @param loWater The low watermark, in bytes.
+	 * @param policy What to do when a write would pass the high watermark.
+	 * @param client Gets the callbacks. If null, buffers are just left to
+	 *  			 the caller.
+	 * @param maxBufs The most buffers that can be queued at once.
+	 */
+	OutputQueue(IOutDevice& dev, size_t hiWater, size_t loWater,
+				Policy policy=BLOCK, IOutputQueueClient* client=0,
+				size_t maxBufs=256);
+	/**
+	 * Closes the queue, releasing any buffers still in it.
+	 */
+	~OutputQueue();
+	/**
+	 * Queues a buffer's available data to be written.
+	 * If the queue is empty, this first tries to write the data right away,
+	 * so a fast consumer never sees the queue at all.
+	 * @param buf The buffer. The queue owns it until on_release().
+	 * @return 0 if the data was written or queued, 1 if it was dropped,
+	 *  	   or -1 on an error or if the queue is closed (EPIPE).
+	 */
+	int write(ByteBuffer* buf);
+	/**
+	 * Writes as much of the queued data as the device will take.
+	 * This is called when the device becomes writable.
+	 * @return 0 if the queue is now empty, 1 if data is still waiting, or
+	 *  	   -1 on a write error.
+	 */
+	int flush();
+	/**
+	 * Closes the queue.
+	 * Queued buffers are released, blocked producers are woken, and later
+	 * writes fail.
+	 */
+	void close();
+	/**
+	 * Determines if the queue has data waiting for the device.
+	 * @return @em true if the queue isn't empty.
+	 */
+	bool pending() const { return n_ != 0; }
+	/**
+	 * Gets the number of bytes waiting in the queue.
+	 * @return The number of bytes waiting.
+	 */
+	size_t size() const { return nbytes_; }
+	/**
+	 * Determines if the queue has been closed.
+	 * @return @em true if the queue was closed.
+	 */
+	bool is_closed() const { return closed_; }
+	/**
+	 * Gets the number of buffers dropped under the @em DROP policy.
+	 * @return The number of buffers dropped.
+	 */
+	uint64_t dropped() const { return ndropped_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_OutputQueue_h
+
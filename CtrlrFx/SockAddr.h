@@ -0,0 +1,119 @@
+/// @file SockAddr.h
+/// Class for a socket address of any family.
+
+#ifndef __CtrlrFx_SockAddr_h
+#define __CtrlrFx_SockAddr_h
+
+#include <cstring>
+#include "CtrlrFx/InetAddr.h"
+#include "CtrlrFx/Inet6Addr.h"
+
+#if !defined(WIN32)
+	#include "CtrlrFx/UnixAddr.h"
+#endif
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+/// A socket address of any family.
+/// This holds a @em sockaddr_storage and the length of the address that
+/// it contains. It can be made implicitly from any of the specific
+/// address classes, so a single socket method can take an IPv4, IPv6, or
+/// Unix-domain address. The socket to use with it can be created from its
+/// family().
+
+class SockAddr
+{
+	sockaddr_storage	addr_;	///< The address
+	socklen_t			len_;	///< The number of bytes used in the address
+
+public:
+	/// Constructs an empty address.
+	SockAddr() : len_(0) {
+		std::memset(&addr_, 0, sizeof(addr_));
+	}
+	/// Constructs the address by copying a generic address.
+	/// @param addr The address.
+	/// @param len The length of the address, in bytes.
+	SockAddr(const sockaddr* addr, socklen_t len) {
+		create(addr, len);
+	}
+	/// Constructs the address from an IPv4 address.
+	SockAddr(const InetAddr& addr) {
+		create(addr.sockaddr_ptr(), socklen_t(addr.size()));
+	}
+	/// Constructs the address from an IPv6 address.
+	SockAddr(const Inet6Addr& addr) {
+		create(addr.sockaddr_ptr(), socklen_t(addr.size()));
+	}
+	#if !defined(WIN32)
+		/// Constructs the address from a Unix-domain address.
+		SockAddr(const UnixAddr& addr) {
+			create(addr.sockaddr_ptr(), socklen_t(addr.size()));
+		}
+	#endif
+
+	/// Sets the address by copying a generic address.
+	/// Anything that doesn't fit in a @em sockaddr_storage is dropped.
+	void create(const sockaddr* addr, socklen_t len);
+
+	/// Checks if the address is set to some value.
+	bool is_set() const { return len_ != 0; }
+
+	/// Gets the address family, such as AF_INET, AF_INET6, or AF_UNIX.
+	int family() const { return addr_.ss_family; }
+
+	/// Gets the length of the address, in bytes.
+	socklen_t size() const { return len_; }
+
+	/// Gets the largest address this object can hold.
+	static socklen_t capacity() { return socklen_t(sizeof(sockaddr_storage)); }
+
+	/// Sets the length of the address.
+	/// This is for use after the address is filled in by a system call,
+	/// such as accept() or getpeername().
+	void set_size(socklen_t len) {
+		len_ = (len > capacity()) ? capacity() : len;
+	}
+
+	/// Returns a pointer to the address cast to a @em sockaddr.
+	sockaddr* sockaddr_ptr() const { return (sockaddr*) &addr_; }
+
+	/// Gets the address as IPv4.
+	/// This is only meaningful if family() is AF_INET.
+	InetAddr inet_addr() const { return InetAddr(*(const sockaddr_in*) &addr_); }
+
+	/// Gets the address as IPv6.
+	/// This is only meaningful if family() is AF_INET6.
+	Inet6Addr inet6_addr() const { return Inet6Addr(*(const sockaddr_in6*) &addr_); }
+
+	#if !defined(WIN32)
+		/// Gets the address as Unix-domain.
+		/// This is only meaningful if family() is AF_UNIX.
+		UnixAddr unix_addr() const { return UnixAddr(*(const sockaddr_un*) &addr_); }
+	#endif
+
+	/// Equality comparator.
+	/// This does a bitwise comparison of the used part of the address.
+	bool operator==(const SockAddr& rhs) const {
+		return len_ == rhs.len_ && std::memcmp(&addr_, &rhs.addr_, len_) == 0;
+	}
+	/// Inequality comparator
+	bool operator!=(const SockAddr& rhs) const { return !operator==(rhs); }
+};
+
+// --------------------------------------------------------------------------
+
+inline void SockAddr::create(const sockaddr* addr, socklen_t len)
+{
+	std::memset(&addr_, 0, sizeof(addr_));
+	len_ = (len > capacity()) ? capacity() : len;
+	std::memcpy(&addr_, addr, len_);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_SockAddr_h
+
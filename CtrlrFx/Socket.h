@@ -17,12 +17,14 @@
 #define __CtrlrFx_Socket_h
 
 #include "CtrlrFx/CtrlrFx.h"
-#include "CtrlrFx/InetAddr.h"
+#include "CtrlrFx/SockAddr.h"
 #include "CtrlrFx/Buffer.h"
 #include "CtrlrFx/IDevice.h"
+#include "CtrlrFx/BufPool.h"
 
 #if !defined(WIN32)
 	#include <sys/socket.h>
+	#include <errno.h>
 #endif
 
 namespace CtrlrFx {
@@ -112,6 +114,124 @@ public:
 	/// Gets the code for the last errror.
 	int last_error() const;
 
+	/// Gets the local address to which the socket is bound.
+	/// @return The address, which is empty on error.
+	SockAddr local_addr() const;
+
+	/// Gets the address of the peer to which the socket is connected.
+	/// @return The address, which is empty on error.
+	SockAddr peer_addr() const;
+
+	/// Puts the socket into (or out of) non-blocking mode.
+	/// In non-blocking mode, an operation that can't complete right away
+	/// fails with EWOULDBLOCK instead of waiting. This is how sockets are
+	/// normally used with an event loop, like the Reactor.
+	/// @param on Whether the socket should be non-blocking.
+	/// @return 0 on success, -1 on error.
+	int set_non_blocking(bool on=true);
+
+	// ----- Options -----
+
+	/// Sets a socket option.
+	/// @return 0 on success, -1 on error.
+	int set_option(int level, int name, const void* val, socklen_t len);
+
+	/// Sets an integer (or boolean) socket option.
+	/// @return 0 on success, -1 on error.
+	int set_option(int level, int name, int val) {
+		return set_option(level, name, &val, socklen_t(sizeof(int)));
+	}
+
+	/// Gets a socket option.
+	/// @return 0 on success, -1 on error.
+	int get_option(int level, int name, void* val, socklen_t* len) const;
+
+	/// Gets an integer (or boolean) socket option.
+	/// @return 0 on success, -1 on error.
+	int get_option(int level, int name, int* val) const;
+
+	/// Sets the size of the kernel's send buffer (SO_SNDBUF).
+	/// @return 0 on success, -1 on error.
+	int send_buffer_size(int sz) { return set_option(SOL_SOCKET, SO_SNDBUF, sz); }
+
+	/// Gets the size of the kernel's send buffer.
+	/// @return The size in bytes, or -1 on error.
+	int send_buffer_size() const;
+
+	/// Sets the size of the kernel's receive buffer (SO_RCVBUF).
+	/// @return 0 on success, -1 on error.
+	int recv_buffer_size(int sz) { return set_option(SOL_SOCKET, SO_RCVBUF, sz); }
+
+	/// Gets the size of the kernel's receive buffer.
+	/// @return The size in bytes, or -1 on error.
+	int recv_buffer_size() const;
+
+	/// Sets the time to busy-poll the device queue on a blocking read when
+	/// there's no data (SO_BUSY_POLL). This trades CPU for latency.
+	/// @param usec The time to poll, in microseconds. Zero disables it.
+	/// @return 0 on success, -1 on error.
+	int busy_poll(int usec);
+
+	#if !defined(WIN32)
+		// ----- Kernel timestamps -----
+
+		/// Flags for timestamping()
+		enum {
+			TS_RX_SOFTWARE = 0x01,	///< Stamp arrivals in the kernel
+			TS_RX_HARDWARE = 0x02,	///< Stamp arrivals in the network card
+			TS_TX_SOFTWARE = 0x04,	///< Stamp sends as they leave the kernel
+			TS_TX_HARDWARE = 0x08	///< Stamp sends in the network card
+		};
+
+		/// Enables or disables kernel receive timestamps (SO_TIMESTAMPNS).
+		/// When enabled, the stamped recv() and the batch receives report
+		/// the time that the kernel received the data, which is unaffected
+		/// by scheduling delays in the application.
+		/// @return 0 on success, -1 on error.
+		int rx_timestamps(bool on=true);
+
+		/// Enables timestamping of received and sent data (SO_TIMESTAMPING).
+		/// This is Linux-specific. Hardware stamps also need the network
+		/// card's timestamping to be turned on, which is a system setting.
+		/// Transmit stamps are read with tx_timestamp(). They share the
+		/// error queue with zero-copy completions, so the two shouldn't be
+		/// used on the same socket.
+		/// @param flags A combination of the TS_ flags, or zero to disable.
+		/// @return 0 on success, -1 on error (ENOPROTOOPT if the OS doesn't
+		///  		support it).
+		int timestamping(int flags);
+
+		/// Receives data along with the time that the kernel received it.
+		/// For a datagram socket this is one datagram. For a stream socket
+		/// it's the time of the most recent segment in the data read.
+		/// @param buf The buffer to receive into.
+		/// @param n The size of the buffer.
+		/// @param stamp Gets the receive time, or zero if timestamps aren't
+		///  			 enabled. A hardware stamp is used if there is one.
+		/// @param addr If not null, gets the sender's address.
+		/// @return The number of bytes received, or -1 on error.
+		int recv(void* buf, size_t n, Time& stamp, SockAddr* addr=0);
+
+		/// Receives data into a buffer along with the time that the kernel
+		/// received it.
+		/// The data goes in at the buffer's position, and the position is
+		/// advanced past it.
+		/// @return The number of bytes received, or -1 on error.
+		int recv(ByteBuffer& buf, Time& stamp, SockAddr* addr=0);
+
+		/// Reads the transmit timestamp of a send.
+		/// This never blocks. Pending stamps make the socket report an
+		/// error condition (POLLERR) when polled.
+		/// @param id Gets the id of the send that was stamped. For a
+		///  		  datagram socket this counts datagrams, from zero. For
+		///  		  a stream socket it's the offset in the stream of the
+		///  		  last byte of the send.
+		/// @param stamp Gets the time of the send.
+		/// @return 1 if a stamp was read, 0 if there was none, or -1 on
+		///  		error.
+		int tx_timestamp(uint32_t* id, Time& stamp);
+	#endif
+
 	/// Releases ownership of the underlying socket handle.
 	/// This is typically used to manually transfer ownership of the socket. 
 	/// It sets the current handle to @em invalid and returns the previous 
@@ -147,16 +267,32 @@ public:
 };
 
 /////////////////////////////////////////////////////////////////////////////
-/// Class that wraps UDP sockets
 
 #if !defined(WIN32)
 
+/// The details of one datagram from a batch receive.
+
+struct UdpMsgInfo
+{
+	SockAddr	addr;		///< The sender's address
+	size_t		len;		///< The number of bytes received
+	bool		truncated;	///< Whether the datagram didn't fit in the buffer
+	Time		stamp;		///< The kernel receive time, or zero if not enabled
+};
+
+/////////////////////////////////////////////////////////////////////////////
+/// Class that wraps UDP sockets
+
 class UdpSocket : public Socket
 {
 protected:
-	static socket_t create();
+	/// Creates a UDP socket for the address family.
+	static socket_t create(int family=PF_INET);
 
 public:
+	/// The most datagrams moved by a single batch call.
+	enum { MAX_BATCH = 32 };
+
 	/// Creates an unbound UDP socket.
 	/// This can be used as a client or later bound as a server socket.
 	UdpSocket() : Socket(create()) {}
@@ -167,13 +303,17 @@ public:
 	/// Creates a UDP socket and binds it to the address.
 	UdpSocket(const InetAddr& addr);
 
+	/// Creates a UDP socket for the family of the address, such as IPv6,
+	/// and binds it to the address.
+	UdpSocket(const SockAddr& addr);
+
 	//int open();
 
 	/// Binds the socket to the address.
-	int bind(const InetAddr& addr);
+	int bind(const SockAddr& addr);
 
 	// Connects the socket to an address.
-	int connect(const InetAddr& addr);
+	int connect(const SockAddr& addr);
 
 	// ----- I/O -----
 
@@ -183,6 +323,12 @@ public:
 	/// Sends a UDP packet to the specified internet address
 	int	sendto(ByteBuffer& buf, const InetAddr& addr);
 
+	/// Sends a UDP packet to an address of any family
+	int	sendto(const void* buf, size_t n, const SockAddr& addr);
+
+	/// Sends a UDP packet to an address of any family
+	int	sendto(ByteBuffer& buf, const SockAddr& addr);
+
 	/// Sends a UDP packet to the connected peer
 	/// Note that this is only appropriate if the socket is connected.
 	int	send(const void* buf, size_t n);
@@ -197,28 +343,122 @@ public:
 	/// Receives a UDP packet
 	int	recvfrom(ByteBuffer& buf, InetAddr& addr);
 
+	/// Receives a UDP packet from an address of any family
+	int	recvfrom(void* buf, size_t n, SockAddr& addr);
+
+	/// Receives a UDP packet from an address of any family
+	int	recvfrom(ByteBuffer& buf, SockAddr& addr);
+
 	/// Receives a UDP packet
 	int	recv(void* buf, size_t n);
 
 	/// Receives a UDP packet without caring about the peer address
 	int	recv(ByteBuffer& buf);
+
+	// The timestamped receives
+	using Socket::recv;
+
+	// ----- Batch I/O -----
+
+	/// Receives a batch of datagrams, with a single system call where the
+	/// OS supports it (recvmmsg under Linux).
+	/// Each datagram goes into the next buffer, at its position, and the
+	/// position is advanced past the data, as with recv(ByteBuffer&). On a
+	/// blocking socket this waits for the first datagram, then takes any
+	/// others that are already queued, without waiting for more.
+	/// @param bufs The buffers to receive into.
+	/// @param n The number of buffers. At most MAX_BATCH are filled.
+	/// @param info If not null, gets the sender, size, and timestamp of
+	///  			each datagram received.
+	/// @return The number of datagrams received, or -1 on error.
+	int recv_batch(ByteBuffer* const bufs[], size_t n, UdpMsgInfo info[]=0);
+
+	/// Receives a batch of datagrams into buffers taken from a pool.
+	/// Buffers are taken from the pool without waiting, cleared, and
+	/// filled. The ones that received data are flipped and returned in
+	/// @em bufs; the rest go back to the pool. The caller returns the
+	/// filled buffers to the pool when it's done with them.
+	/// @param pool The buffer pool.
+	/// @param bufs Gets the filled buffers.
+	/// @param n The most datagrams to receive.
+	/// @param info If not null, gets the details of each datagram.
+	/// @return The number of datagrams received, or -1 on error. This is
+	///  		also -1, with EAGAIN, if the pool is empty.
+	template <typename LockType>
+	int recv_batch(BufPool<byte,LockType>& pool, ByteBuffer* bufs[],
+				   size_t n, UdpMsgInfo info[]=0);
+
+	/// Sends a batch of datagrams to the connected peer, or to a separate
+	/// address for each, with a single system call where the OS supports
+	/// it (sendmmsg under Linux).
+	/// Each buffer's available data is one datagram, and the position of
+	/// each buffer that was sent is advanced past it.
+	/// @param bufs The buffers to send.
+	/// @param n The number of buffers. At most MAX_BATCH are sent.
+	/// @param addrs The destination of each datagram, or null if the
+	///  			 socket is connected.
+	/// @return The number of datagrams sent, or -1 on error.
+	int send_batch(ByteBuffer* const bufs[], size_t n, const SockAddr addrs[]=0);
+
+	/// Sends a batch of datagrams to a single address.
+	/// @param bufs The buffers to send.
+	/// @param n The number of buffers. At most MAX_BATCH are sent.
+	/// @param addr The destination of all the datagrams.
+	/// @return The number of datagrams sent, or -1 on error.
+	int send_batch(ByteBuffer* const bufs[], size_t n, const SockAddr& addr);
 };
 
 // --------------------------------------------------------------------------
 
-inline socket_t UdpSocket::create()
+template <typename LockType>
+int UdpSocket::recv_batch(BufPool<byte,LockType>& pool, ByteBuffer* bufs[],
+						  size_t n, UdpMsgInfo info[] /*=0*/)
+{
+	if (n > MAX_BATCH)
+		n = MAX_BATCH;
+
+	size_t nbuf = 0;
+	while (nbuf < n && pool.tryget(&bufs[nbuf])) {
+		if (!bufs[nbuf]) {		// A release() marker; leave it for a waiter
+			pool.release();
+			break;
+		}
+		bufs[nbuf++]->clear();
+	}
+
+	if (nbuf == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	int ret = recv_batch(bufs, nbuf, info);
+
+	for (size_t i=0; i<nbuf; ++i) {
+		if (int(i) < ret)
+			bufs[i]->flip();
+		else {
+			pool.put(bufs[i]);
+			bufs[i] = 0;
+		}
+	}
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+
+inline socket_t UdpSocket::create(int family /*=PF_INET*/)
 {
-	return (socket_t) ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	return (socket_t) ::socket(family, SOCK_DGRAM, IPPROTO_UDP);
 }
 
-inline int UdpSocket::bind(const InetAddr& addr)
+inline int UdpSocket::bind(const SockAddr& addr)
 {
-	return ::bind(handle(), addr.sockaddr_ptr(), sizeof(sockaddr_in));
+	return ::bind(handle(), addr.sockaddr_ptr(), addr.size());
 }
 
-inline int UdpSocket::connect(const InetAddr& addr)
+inline int UdpSocket::connect(const SockAddr& addr)
 {
-	return ::connect(handle(), addr.sockaddr_ptr(), sizeof(sockaddr_in));
+	return ::connect(handle(), addr.sockaddr_ptr(), addr.size());
 }
 
 inline int UdpSocket::sendto(const void* buf, size_t n, const InetAddr& addr)
@@ -226,6 +466,11 @@ inline int UdpSocket::sendto(const void* buf, size_t n, const InetAddr& addr)
 	return ::sendto(handle(), buf, n, 0, addr.sockaddr_ptr(), addr.size());
 }
 
+inline int UdpSocket::sendto(const void* buf, size_t n, const SockAddr& addr)
+{
+	return ::sendto(handle(), buf, n, 0, addr.sockaddr_ptr(), addr.size());
+}
+
 inline int UdpSocket::send(const void* buf, size_t n)
 {
 	return ::send(handle(), buf, n, 0);
@@ -239,49 +484,28 @@ inline int UdpSocket::recv(void* buf, size_t n)
 #endif	// !WIN32
 
 /////////////////////////////////////////////////////////////////////////////
-/// Wrapper class for TCP sockets.
-/// This is the streaming connection between two TCP peers. It looks like
-/// a readable/writeable device.
+/// Base class for connected, streaming sockets.
+/// This is the streaming connection between two peers, for any address
+/// family that supports it, such as TCP or Unix-domain. It looks like a
+/// readable/writeable device.
 
-class TcpSocket : public virtual IDevice, public Socket
+class StreamSocket : public virtual IDevice, public Socket
 {
-protected:
-	friend class TcpAcceptor;
-
-	/// Creates a TCP socket.
-	static socket_t create();
-
 public:
-	/// Creates an unconnected TCP socket.
-	TcpSocket() {}
+	/// Creates an unconnected socket.
+	StreamSocket() {}
 
-	/// Creates a TCP socket from an existing OS socket handle and claims
+	/// Creates a socket from an existing OS socket handle and claims
 	/// ownership of the handle.
-	explicit TcpSocket(socket_t sock) : Socket(sock) {}
+	explicit StreamSocket(socket_t sock) : Socket(sock) {}
 
-	/// Creates a TCP socket by copying the socket handle from the specified
+	/// Creates a socket by copying the socket handle from the specified
 	/// socket object and transfers ownership of the socket.
-	TcpSocket(TcpSocket& sock) : Socket(sock) {}
+	StreamSocket(StreamSocket& sock) : Socket(sock) {}
 
-	/// Open the socket.
-	int open();
+	// ----- Conversions from SockRef -----
 
-	/// Assigns an OS socket handle to this device and claims
-	/// ownership of the socket handle.
-	/// @param s the OS socket handle.
-	//TcpSocket& operator=(socket_t s);
-
-	/// Copies the socket and transfers ownership to this object.
-	TcpSocket& operator=(TcpSocket& s);
-
-	// ----- Conversions to and from SockRef -----
-
-	TcpSocket(SocketRef ref) : Socket(ref.sock_) {}
-
-	TcpSocket& operator=(SocketRef ref) {
-		reset(ref.sock_);
-		return *this;
-	}
+	StreamSocket(SocketRef ref) : Socket(ref.sock_) {}
 
 	// ----- IDevice Interface -----
 
@@ -296,6 +520,12 @@ public:
 
 	/// Best effort attempt to read the whole buffer
 	virtual int read_n(ByteBuffer& buf);
+
+	/// Scatter read into a sequence of buffers
+	virtual int readv(ByteBuffer* const bufs[], size_t n);
+
+	/// Best effort attempt to fill all of the buffers
+	virtual int readv_n(ByteBuffer* const bufs[], size_t n);
 	/**
      * Set a timeout for read operations.
      * Sets the timout that the device uses for read operations. Not all
@@ -316,6 +546,12 @@ public:
 
 	/// Best effort attempt to write the whole buffer to the port
 	virtual int write_n(ByteBuffer& buf);
+
+	/// Gather write from a sequence of buffers
+	virtual int writev(ByteBuffer* const bufs[], size_t n);
+
+	/// Best effort attempt to write all of the buffers to the port
+	virtual int writev_n(ByteBuffer* const bufs[], size_t n);
 	/**
      * Set a timeout for write operations.
      * Sets the timout that the device uses for write operations. Not all
@@ -326,11 +562,117 @@ public:
 	virtual bool write_timeout(const Duration& d);
 };
 
+/////////////////////////////////////////////////////////////////////////////
+/// Wrapper class for TCP sockets.
+/// This is the streaming connection between two TCP peers, over IPv4 or
+/// IPv6.
+
+class TcpSocket : public StreamSocket
+{
+protected:
+	friend class TcpAcceptor;
+
+	/// Creates a TCP socket for the address family.
+	static socket_t create(int family=PF_INET);
+
+public:
+	/// Creates an unconnected TCP socket.
+	TcpSocket() {}
+
+	/// Creates a TCP socket from an existing OS socket handle and claims
+	/// ownership of the handle.
+	explicit TcpSocket(socket_t sock) : StreamSocket(sock) {}
+
+	/// Creates a TCP socket by copying the socket handle from the specified
+	/// socket object and transfers ownership of the socket.
+	TcpSocket(TcpSocket& sock) : StreamSocket(sock) {}
+
+	/// Open the socket.
+	int open();
+
+	/// Assigns an OS socket handle to this device and claims
+	/// ownership of the socket handle.
+	/// @param s the OS socket handle.
+	//TcpSocket& operator=(socket_t s);
+
+	/// Copies the socket and transfers ownership to this object.
+	TcpSocket& operator=(TcpSocket& s);
+
+	// ----- Conversions to and from SockRef -----
+
+	TcpSocket(SocketRef ref) : StreamSocket(ref) {}
+
+	TcpSocket& operator=(SocketRef ref) {
+		reset(ref.sock_);
+		return *this;
+	}
+
+	// ----- TCP Options -----
+
+	/// Disables (or enables) Nagle's algorithm (TCP_NODELAY), so that
+	/// small writes go out immediately.
+	/// @return 0 on success, -1 on error.
+	int no_delay(bool on=true);
+
+	/// Corks (or uncorks) the socket (TCP_CORK).
+	/// While corked, only full segments are sent. Uncorking sends anything
+	/// that's left. This batches a message written in several pieces.
+	/// @return 0 on success, -1 on error.
+	int cork(bool on=true);
+
+	/// Enables (or disables) quick ACK mode (TCP_QUICKACK).
+	/// The kernel can leave this mode on its own, so it's typically set
+	/// again after each read.
+	/// @return 0 on success, -1 on error.
+	int quick_ack(bool on=true);
+
+	/// Writes data with more to follow (MSG_MORE).
+	/// This holds the data back, like cork(), until a normal write.
+	/// @return The number of bytes written, or -1 on error.
+	int write_more(const void* buf, size_t n);
+
+	/// Writes a buffer with more to follow (MSG_MORE).
+	/// The buffer's position is advanced past the data written.
+	/// @return The number of bytes written, or -1 on error.
+	int write_more(ByteBuffer& buf);
+
+	#if defined(__linux__)
+		// ----- Zero-copy sends -----
+
+		/// Enables (or disables) zero-copy sends (SO_ZEROCOPY).
+		/// @return 0 on success, -1 on error.
+		int zero_copy(bool on=true);
+
+		/// Sends from a buffer without copying it into the kernel
+		/// (MSG_ZEROCOPY).
+		/// The buffer's position is advanced past the data sent, but the
+		/// memory must not be touched until the kernel reports the send as
+		/// complete. Each successful call is numbered in sequence, starting
+		/// at zero. This is only worthwhile for large buffers. See
+		/// @ref ZeroCopySender for a class that manages the buffers.
+		/// @return The number of bytes sent, or -1 on error.
+		int send_zerocopy(ByteBuffer& buf);
+
+		/// Reads a completion notification for zero-copy sends.
+		/// This never blocks. Completions make the socket report an
+		/// error condition (POLLERR) when polled. Anything else in the
+		/// socket's error queue, such as a transmit timestamp or an ICMP
+		/// error, is read and discarded along the way.
+		/// @param lo Gets the sequence number of the first send completed.
+		/// @param hi Gets the sequence number of the last send completed.
+		/// @param copied Gets whether the kernel had to copy the data
+		///  			  after all, in which case zero-copy isn't helping.
+		/// @return 1 if a notification was read, 0 if there was none, or
+		///  		-1 on error.
+		int zerocopy_completion(uint32_t* lo, uint32_t* hi, bool* copied);
+	#endif
+};
+
 // --------------------------------------------------------------------------
 
-inline socket_t TcpSocket::create()
+inline socket_t TcpSocket::create(int family /*=PF_INET*/)
 {
-	return (socket_t) ::socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+	return (socket_t) ::socket(family, SOCK_STREAM, IPPROTO_TCP);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,227 @@
+/// @file SocketBinStream.h
+/// Binary byte streams over sockets.
+///
+/// The stream buffer keeps large input and output buffers in user space, so
+/// that a stream of small inserts and extracts turns into a few large
+/// system calls. Output is flushed with a gather write, and input is read
+/// with recv() into whatever space is free in the input buffer.
+///
+/// The buffer also frames messages as length-prefixed records. A record can
+/// be built in place in the output buffer, or written straight from the
+/// caller's memory, and an incoming record is handed back as a pointer into
+/// the input buffer. Either way, the payload isn't copied through an
+/// intermediate buffer.
+
+#ifndef __CtrlrFx_SocketBinStream_h
+#define __CtrlrFx_SocketBinStream_h
+
+#include "BinStream.h"
+#include "Socket.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+//							SocketBinStreamBuf
+/////////////////////////////////////////////////////////////////////////////
+
+/// A buffered stream buffer over a connected socket.
+///
+/// This works with stream sockets, such as a TcpSocket, and with connected
+/// datagram sockets, such as a UdpSocket. For a datagram socket, each flush
+/// of the output buffer is sent as a single datagram, and the input buffer
+/// is only refilled, a whole datagram at a time, once it's empty. So each
+/// buffer should be big enough for the largest datagram.
+///
+/// A record is a 32-bit length, in network byte order, followed by that
+/// many bytes of payload. The socket is used in blocking mode. The buffer
+/// doesn't own the socket.
+
+class SocketBinStreamBuf : public BinStreamBuf
+{
+public:
+	/// The default size of each of the buffers
+	enum { DFLT_BUF_SIZE = 64*1024 };
+
+	/// The size of a record header
+	enum { HDR_SIZE = 4 };
+
+private:
+	/// The bytes kept ahead of the input for putback
+	enum { BACK_BUF_SIZE = 4 };
+
+	Socket&	sock_;		///< The socket
+	bool	dgram_;		///< Whether it's a datagram socket
+	byte*	ibuf_;		///< The input buffer, including the putback area
+	size_t	isize_;		///< The size of the input buffer
+	byte*	obuf_;		///< The output buffer
+	size_t	osize_;		///< The size of the output buffer
+	byte*	rec_;		///< The header of the open output record, or null
+	int		err_;		///< The last error
+
+	/// Makes sure that at least n bytes are in the get area.
+	int fill(size_t n);
+
+	/// Writes out the put area up to an open record, followed by some
+	/// other data.
+	int flush(const void* buf, size_t n);
+
+	// Non-copyable
+	SocketBinStreamBuf(const SocketBinStreamBuf&);
+	SocketBinStreamBuf& operator=(const SocketBinStreamBuf&);
+
+protected:
+	// get area
+	virtual streamsize	xsgetn(void* buf, streamsize n);
+	virtual int			underflow();
+
+	// put area
+	virtual streamsize	xsputn(const void* buf, streamsize n);
+	virtual int 		overflow(int c);
+	virtual int			sync();
+
+public:
+	/**
+	 * Creates a stream buffer for a connected socket.
+	 * @param sock The socket.
+	 * @param inSize The size of the input buffer.
+	 * @param outSize The size of the output buffer.
+	 */
+	SocketBinStreamBuf(Socket& sock, size_t inSize=DFLT_BUF_SIZE,
+					   size_t outSize=DFLT_BUF_SIZE);
+	/**
+	 * Flushes any output and frees the buffers.
+	 */
+	virtual ~SocketBinStreamBuf();
+	/**
+	 * Gets the socket.
+	 * @return The socket.
+	 */
+	Socket& socket() { return sock_; }
+	/**
+	 * Starts building an output record in place.
+	 * This reserves the header, and everything put into the buffer until
+	 * end_record() is the payload. The whole record must fit into the
+	 * output buffer; anything bigger should go out with write_record().
+	 * @return 0 on success, -1 on error.
+	 */
+	int begin_record();
+	/**
+	 * Finishes the output record started by begin_record(), filling in its
+	 * length. The record stays in the buffer until the next flush.
+	 * @return The length of the payload, or -1 on error.
+	 */
+	int end_record();
+	/**
+	 * Writes a complete record.
+	 * The header is added to the output buffer. A payload that fits in the
+	 * free space is appended to it. A bigger one is written right from the
+	 * caller's memory, in the same gather write as the buffered data.
+	 * @param buf The payload.
+	 * @param n The length of the payload.
+	 * @return 0 on success, -1 on error.
+	 */
+	int write_record(const void* buf, size_t n);
+	/**
+	 * Reads the next complete record.
+	 * The payload is left in the input buffer, and is valid until the next
+	 * read from the buffer. The whole record must fit in the input buffer.
+	 * @param data Gets a pointer to the payload.
+	 * @return The length of the payload, or -1 on an error or the end of
+	 *  	   the stream.
+	 */
+	int read_record(const byte** data);
+	/**
+	 * Gets the size of the input buffer.
+	 * @return The size of the input buffer.
+	 */
+	size_t in_size() const { return isize_; }
+	/**
+	 * Gets the size of the output buffer.
+	 * @return The size of the output buffer.
+	 */
+	size_t out_size() const { return osize_; }
+	/**
+	 * Gets the last error.
+	 * @return The last error, or 0 at the end of the stream.
+	 */
+	int error() const { return err_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//							SocketBinStream
+/////////////////////////////////////////////////////////////////////////////
+
+/// A binary input/output stream over a connected socket.
+
+class SocketBinStream : public IOBinStream
+{
+protected:
+	SocketBinStreamBuf	sbuf_;
+
+public:
+	/**
+	 * Creates a stream for a connected socket.
+	 * @param sock The socket.
+	 * @param inSize The size of the input buffer.
+	 * @param outSize The size of the output buffer.
+	 */
+	SocketBinStream(Socket& sock,
+					size_t inSize=SocketBinStreamBuf::DFLT_BUF_SIZE,
+					size_t outSize=SocketBinStreamBuf::DFLT_BUF_SIZE);
+
+	// record framing
+	SocketBinStream& begin_record();
+	SocketBinStream& end_record();
+	SocketBinStream& write_record(const void* buf, size_t n);
+	int read_record(const byte** data);
+
+	int error() const { return sbuf_.error(); }
+};
+
+// --------------------------------------------------------------------------
+
+inline SocketBinStream::SocketBinStream(Socket& sock, size_t inSize, size_t outSize)
+								: sbuf_(sock, inSize, outSize)
+{
+	init(&sbuf_);
+}
+
+inline SocketBinStream& SocketBinStream::begin_record()
+{
+	state_ = goodbit;
+	if (sbuf_.begin_record() < 0)
+		state_ |= failbit;
+	return *this;
+}
+
+inline SocketBinStream& SocketBinStream::end_record()
+{
+	state_ = goodbit;
+	if (sbuf_.end_record() < 0)
+		state_ |= failbit;
+	return *this;
+}
+
+inline SocketBinStream& SocketBinStream::write_record(const void* buf, size_t n)
+{
+	state_ = goodbit;
+	if (sbuf_.write_record(buf, n) < 0)
+		state_ |= failbit;
+	return *this;
+}
+
+inline int SocketBinStream::read_record(const byte** data)
+{
+	state_ = goodbit;
+	int n = sbuf_.read_record(data);
+	if (n < 0)
+		state_ |= eofbit | failbit;
+	return n;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_SocketBinStream_h
+
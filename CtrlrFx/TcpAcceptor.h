@@ -17,7 +17,7 @@
 #ifndef __CtrlrFx_TcpAcceptor_h
 #define __CtrlrFx_TcpAcceptor_h
 
-#include "InetAddr.h"
+#include "SockAddr.h"
 #include "Socket.h"
 
 namespace CtrlrFx {
@@ -30,17 +30,45 @@ namespace CtrlrFx {
 /// on the call to accept incoming connections. The call to accept creates
 /// and returns a @ref TcpSocket which can then be used for the actual 
 /// communications.
+///
+/// To spread a heavy connection load over several threads, each thread can
+/// open its own acceptor on the same address with the @em REUSE_PORT
+/// option. The kernel then balances the incoming connections across the
+/// listeners, so there's no single accept thread or backlog to overflow.
 
 class TcpAcceptor : public Socket
 {
+public:
 	/// The default listener queue size.
 	static const int DFLT_QUE_SIZE = 4;
 
+	/// The largest listener queue size that the system allows.
+	static const int MAX_QUE_SIZE = SOMAXCONN;
+
+	/// Options for opening the acceptor.
+	/// These are bit flags that can be OR'ed together.
+	enum {
+		REUSE_PORT		= 0x01,	///< Let several listeners share the port (SO_REUSEPORT)
+		DEFER_ACCEPT	= 0x02,	///< Only accept once the client sends data (TCP_DEFER_ACCEPT)
+		FAST_OPEN		= 0x04,	///< Allow data in the SYN (TCP_FASTOPEN)
+		NON_BLOCK		= 0x08	///< Accept sockets in non-blocking mode
+	};
+
+private:
 	/// The address to which the acceptor will bind.
-	InetAddr addr_;
+	SockAddr addr_;
+
+	/// The options that the acceptor was opened with.
+	int opts_;
+
+	/// Sets the socket options that must be in place before binding.
+	int set_bind_options(int opts);
+
+	/// Sets the socket options that apply once listening.
+	int set_listen_options(int opts, int queSize);
 
 	/// Binds the socket to the specified address.
-	int bind(const InetAddr& addr);
+	int bind(const SockAddr& addr);
 
 	/// Sets the socket listening on the port to which it is bound.
 	int	listen(int queSize);
@@ -51,49 +79,62 @@ class TcpAcceptor : public Socket
 
 public:
 	/// Creates an unconnected acceptor.
-	TcpAcceptor() {}
+	TcpAcceptor() : opts_(0) {}
 
 	/// Creates a acceptor and starts it listening on the specified port.
 	/// The acceptor binds to the specified port for any address on the 
 	/// local host.
-	TcpAcceptor(uint16_t port, int queSize=DFLT_QUE_SIZE);
+	TcpAcceptor(uint16_t port, int queSize=DFLT_QUE_SIZE, int opts=0);
 
-	/// Creates a acceptor and starts it listening on the specified port.
-	TcpAcceptor(const InetAddr& addr, int queSize=DFLT_QUE_SIZE);
+	/// Creates a acceptor and starts it listening on the specified address.
+	/// The address can be IPv4 or IPv6.
+	TcpAcceptor(const SockAddr& addr, int queSize=DFLT_QUE_SIZE, int opts=0);
 
 	/// Gets the address to which we are bound.
-	const InetAddr& addr() const { return addr_; }
+	const SockAddr& addr() const { return addr_; }
+
+	/// Gets the options that the acceptor was opened with.
+	int options() const { return opts_; }
 
 	/// Opens the acceptor socket.
 	/// This binds the socket and starts it listening.
-	virtual int	open(uint16_t port, int queSize=DFLT_QUE_SIZE);
-
-	/// Opens the acceptor socket and binds it to the specified address
-	virtual int	open(const InetAddr& addr, int queSize=DFLT_QUE_SIZE);
+	virtual int	open(uint16_t port, int queSize=DFLT_QUE_SIZE, int opts=0);
+
+	/// Opens the acceptor socket and binds it to the specified address.
+	/// The socket is created for the family of the address.
+	/// @param addr The address to bind to.
+	/// @param queSize The listener queue size (backlog). For a busy
+	///  			   server, use something large, like MAX_QUE_SIZE.
+	/// @param opts The options, as a set of flags. An option that isn't
+	///  			supported by the OS causes the open to fail.
+	/// @return 0 on success, -1 on error.
+	virtual int	open(const SockAddr& addr, int queSize=DFLT_QUE_SIZE, int opts=0);
 	
-	/// Accepts an incoming TCP connection
+	/// Accepts an incoming TCP connection.
+	/// The new socket is close-on-exec, and is non-blocking if the
+	/// acceptor was opened with the @em NON_BLOCK option.
 	TcpSocket accept();
 };
 
 // --------------------------------------------------------------------------
 
-inline TcpAcceptor::TcpAcceptor(uint16_t port, int queSize /*=DFLT_QUE_SIZE*/)
-									: addr_(port)
+inline TcpAcceptor::TcpAcceptor(uint16_t port, int queSize /*=DFLT_QUE_SIZE*/,
+								int opts /*=0*/) : addr_(InetAddr(port)), opts_(0)
 {
-	open(port, queSize);
+	open(port, queSize, opts);
 }
 
-inline TcpAcceptor::TcpAcceptor(const InetAddr& addr, int queSize /*=DFLT_QUE_SIZE*/)
-									: addr_(addr)
+inline TcpAcceptor::TcpAcceptor(const SockAddr& addr, int queSize /*=DFLT_QUE_SIZE*/,
+								int opts /*=0*/) : addr_(addr), opts_(0)
 {
-	open(addr, queSize);
+	open(addr, queSize, opts);
 }
 
 // --------------------------------------------------------------------------
 
-inline int TcpAcceptor::bind(const InetAddr& addr)
+inline int TcpAcceptor::bind(const SockAddr& addr)
 {
-	return ::bind(handle(), addr.sockaddr_ptr(), sizeof(sockaddr_in));
+	return ::bind(handle(), addr.sockaddr_ptr(), addr.size());
 }
 
 inline int TcpAcceptor::listen(int que_limit /*=DFLT_QUEUE_LIMIT*/)
@@ -103,9 +144,10 @@ inline int TcpAcceptor::listen(int que_limit /*=DFLT_QUEUE_LIMIT*/)
 
 // --------------------------------------------------------------------------
 
-inline int TcpAcceptor::open(uint16_t port, int queSize /*=DFLT_QUE_SIZE*/)
+inline int TcpAcceptor::open(uint16_t port, int queSize /*=DFLT_QUE_SIZE*/,
+							 int opts /*=0*/)
 {
-	return open(InetAddr(port), queSize);
+	return open(InetAddr(port), queSize, opts);
 }
 
 /////////////////////////////////////////////////////////////////////////////
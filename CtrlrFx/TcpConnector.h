@@ -29,12 +29,27 @@ public:
 	TcpConnector() {}
 
 	/// Creates the connector and attempts to connect to the specified address.
-	TcpConnector(const InetAddr& addr);
+	/// The address can be IPv4 or IPv6.
+	TcpConnector(const SockAddr& addr);
+
+	/// Creates the connector and attempts to connect to the specified
+	/// address, giving up after a timeout.
+	TcpConnector(const SockAddr& addr, const Duration& timeout);
 
 	/// Attempts to connects to the specified server.
 	/// If the socket is currently connected, this will close the current
-	/// connection and open the new one.
-	int	connect(const InetAddr& addr);
+	/// connection and open the new one. The socket is created for the
+	/// family of the address.
+	int	connect(const SockAddr& addr);
+
+	/// Attempts to connect to the specified server, giving up after a
+	/// timeout.
+	/// The connect is done in non-blocking mode, so an unreachable host
+	/// doesn't hold up the caller for the system's full connect timeout.
+	/// The socket is left in blocking mode.
+	/// @return 0 on success, -1 on error, with errno set to ETIMEDOUT if
+	///  		the time ran out.
+	int	connect(const SockAddr& addr, const Duration& timeout);
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,128 @@
+/// @file UnixAddr.h
+/// Class for a Unix-domain socket address.
+
+#ifndef __CtrlrFx_UnixAddr_h
+#define __CtrlrFx_UnixAddr_h
+
+#if !defined(WIN32)
+
+#include <cstring>
+#include <cstddef>
+#include "CtrlrFx/CtrlrFx.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+/// Class that represents a Unix-domain socket address.
+/// This inherits from @em sockaddr_un. The address is normally a path in
+/// the filesystem. On Linux, a name that starts with an '@' is placed in
+/// the abstract namespace, which has no file and disappears when the last
+/// socket bound to it is closed.
+
+class UnixAddr : public sockaddr_un
+{
+	// NOTE: This class must stay binary compatible with a sockaddr_un.
+	// Do not add any member variables.
+
+	/// Sets the contents of this object to all zero
+	void zero();
+
+public:
+	/// The maximum length of a path, not counting the NUL terminator.
+	static const size_t MAX_PATH_LEN = sizeof(((sockaddr_un*) 0)->sun_path) - 1;
+
+	/// Constructs an empty address.
+	UnixAddr();
+
+	/// Constructs an address for the specified path.
+	/// If the path is too long to fit, the address is left empty.
+	UnixAddr(const char* path);
+
+	/// Constructs the address by copying the specified structure.
+	UnixAddr(const sockaddr_un& addr);
+
+	/// Constructs the address by copying the specified address.
+	UnixAddr(const UnixAddr& addr);
+
+	/// Creates the address from the specified path.
+	/// If the path is too long to fit, the address is left empty.
+	void create(const char* path);
+
+	/// Checks if the address is set to some value.
+	bool is_set() const { return sun_path[0] != '\0' || sun_path[1] != '\0'; }
+
+	/// Determines if this is an address in the Linux abstract namespace.
+	bool is_abstract() const { return sun_path[0] == '\0' && sun_path[1] != '\0'; }
+
+	/// Gets the path.
+	/// For an abstract address this is the name without the leading NUL.
+	const char* path() const { return is_abstract() ? sun_path+1 : sun_path; }
+
+	/// Equality comparator.
+	bool operator==(const UnixAddr& rhs) const;
+
+	/// Inequality comparator
+	bool operator!=(const UnixAddr& rhs) const { return !operator==(rhs); }
+
+	/// Gets the size of the address.
+	/// This is the significant part of the structure, as required by bind()
+	/// and connect() for abstract names.
+	size_t size() const;
+
+	/// Returns a pointer to this object cast to a @em sockaddr.
+	sockaddr* sockaddr_ptr() const { return (sockaddr*) this; }
+
+	/// Returns a pointer to this object cast to a @em sockaddr_un.
+	sockaddr_un* sockaddr_un_ptr() const { return (sockaddr_un*) this; }
+};
+
+// --------------------------------------------------------------------------
+
+inline UnixAddr::UnixAddr()
+{
+	zero();
+}
+
+inline UnixAddr::UnixAddr(const char* path)
+{
+	create(path);
+}
+
+inline UnixAddr::UnixAddr(const sockaddr_un& addr)
+{
+	std::memcpy(sockaddr_un_ptr(), &addr, sizeof(sockaddr_un));
+}
+
+inline UnixAddr::UnixAddr(const UnixAddr& addr)
+{
+	std::memcpy(this, &addr, sizeof(UnixAddr));
+}
+
+inline void UnixAddr::zero()
+{
+	std::memset(this, 0, sizeof(UnixAddr));
+	sun_family = AF_UNIX;
+}
+
+inline size_t UnixAddr::size() const
+{
+	size_t n = is_abstract() ? (std::strlen(sun_path+1) + 1)
+							 : std::strlen(sun_path);
+	return offsetof(sockaddr_un, sun_path) + n;
+}
+
+inline bool UnixAddr::operator==(const UnixAddr& rhs) const
+{
+	size_t n = size();
+	return n == rhs.size() && std::memcmp(this, &rhs, n) == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// !WIN32
+#endif		// __CtrlrFx_UnixAddr_h
+
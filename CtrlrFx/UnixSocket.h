@@ -0,0 +1,228 @@
+/// @file UnixSocket.h
+/// Classes for Unix-domain stream and datagram sockets.
+
+#ifndef __CtrlrFx_UnixSocket_h
+#define __CtrlrFx_UnixSocket_h
+
+#if !defined(WIN32)
+
+#include "CtrlrFx/Socket.h"
+#include "CtrlrFx/UnixAddr.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+/// A Unix-domain stream socket.
+/// This is the streaming connection between two processes on the same
+/// host. It has the same device interface as a @ref TcpSocket, but avoids
+/// the TCP/IP stack entirely.
+
+class UnixStreamSocket : public StreamSocket
+{
+protected:
+	friend class UnixAcceptor;
+
+	/// Creates a Unix-domain stream socket.
+	static socket_t create();
+
+public:
+	/// Creates an unconnected socket.
+	UnixStreamSocket() {}
+
+	/// Creates a socket from an existing OS socket handle and claims
+	/// ownership of the handle.
+	explicit UnixStreamSocket(socket_t sock) : StreamSocket(sock) {}
+
+	/// Creates a socket and attempts to connect it to the specified
+	/// address.
+	explicit UnixStreamSocket(const UnixAddr& addr);
+
+	/// Creates a socket by copying the socket handle from the specified
+	/// socket object and transfers ownership of the socket.
+	UnixStreamSocket(UnixStreamSocket& sock) : StreamSocket(sock) {}
+
+	/// Attempts to connect to the specified server.
+	/// If the socket is currently connected, this will close the current
+	/// connection and open the new one.
+	/// @return 0 on success, -1 on error.
+	int connect(const UnixAddr& addr);
+
+	/// Creates a pair of connected sockets.
+	/// This is a handy way to connect two threads, or a parent and child
+	/// process.
+	/// @return 0 on success, -1 on error.
+	static int pair(UnixStreamSocket& sock1, UnixStreamSocket& sock2);
+
+	// ----- Conversions to and from SockRef -----
+
+	UnixStreamSocket(SocketRef ref) : StreamSocket(ref) {}
+
+	UnixStreamSocket& operator=(SocketRef ref) {
+		reset(ref.sock_);
+		return *this;
+	}
+};
+
+// --------------------------------------------------------------------------
+
+inline socket_t UnixStreamSocket::create()
+{
+	return (socket_t) ::socket(PF_UNIX, SOCK_STREAM, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// Class for creating a Unix-domain stream server.
+/// This works like a @ref TcpAcceptor, but binds to a path in the
+/// filesystem (or an abstract name). Any stale file left at the path by a
+/// previous server is removed before binding, and the file is removed
+/// again when the acceptor is destroyed.
+
+class UnixAcceptor : public Socket
+{
+	/// The default listener queue size.
+	static const int DFLT_QUE_SIZE = 4;
+
+	/// The address to which the acceptor is bound.
+	UnixAddr addr_;
+
+	// Non-copyable
+	UnixAcceptor(const UnixAcceptor&);
+	UnixAcceptor& operator=(const UnixAcceptor&);
+
+public:
+	/// Creates an unconnected acceptor.
+	UnixAcceptor() {}
+
+	/// Creates an acceptor and starts it listening on the specified
+	/// address.
+	UnixAcceptor(const UnixAddr& addr, int queSize=DFLT_QUE_SIZE);
+
+	/// Destructor closes the socket and removes the file.
+	virtual ~UnixAcceptor();
+
+	/// Gets the address to which we are bound.
+	const UnixAddr& addr() const { return addr_; }
+
+	/// Opens the acceptor socket.
+	/// This binds the socket to the address and starts it listening.
+	/// A socket file left at the path by a server that's no longer running
+	/// is removed first. If another server is listening there, or the path
+	/// is some other kind of file, this fails with EADDRINUSE.
+	/// @return 0 on success, -1 on error.
+	virtual int	open(const UnixAddr& addr, int queSize=DFLT_QUE_SIZE);
+
+	/// Accepts an incoming connection
+	UnixStreamSocket accept();
+};
+
+// --------------------------------------------------------------------------
+
+inline UnixAcceptor::UnixAcceptor(const UnixAddr& addr,
+								  int queSize /*=DFLT_QUE_SIZE*/)
+{
+	open(addr, queSize);
+}
+
+inline UnixStreamSocket UnixAcceptor::accept()
+{
+	return UnixStreamSocket((socket_t) ::accept(handle(), 0, 0));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// A Unix-domain datagram socket.
+/// Unlike UDP, Unix-domain datagrams are reliable and are delivered in
+/// order.
+
+class UnixDgramSocket : public Socket
+{
+protected:
+	/// Creates a Unix-domain datagram socket.
+	static socket_t create();
+
+public:
+	/// Creates an unbound socket.
+	UnixDgramSocket() : Socket(create()) {}
+
+	/// Creates a socket from an existing OS socket handle and claims
+	/// ownership of the handle.
+	explicit UnixDgramSocket(socket_t sock) : Socket(sock) {}
+
+	/// Creates a socket and binds it to the address.
+	UnixDgramSocket(const UnixAddr& addr);
+
+	/// Creates a pair of connected datagram sockets.
+	/// @return 0 on success, -1 on error.
+	static int pair(UnixDgramSocket& sock1, UnixDgramSocket& sock2);
+
+	/// Binds the socket to the address.
+	int bind(const UnixAddr& addr);
+
+	// Connects the socket to an address.
+	int connect(const UnixAddr& addr);
+
+	// ----- I/O -----
+
+	/// Sends a datagram to the specified address
+	int	sendto(const void* buf, size_t n, const UnixAddr& addr);
+
+	/// Sends a datagram to the specified address
+	int	sendto(ByteBuffer& buf, const UnixAddr& addr);
+
+	/// Sends a datagram to the connected peer
+	int	send(const void* buf, size_t n);
+
+	/// Sends a datagram to the connected peer
+	int	send(ByteBuffer& buf);
+
+	/// Receives a datagram
+	int	recvfrom(void* buf, size_t n, UnixAddr& addr);
+
+	/// Receives a datagram
+	int	recvfrom(ByteBuffer& buf, UnixAddr& addr);
+
+	/// Receives a datagram
+	int	recv(void* buf, size_t n);
+
+	/// Receives a datagram without caring about the peer address
+	int	recv(ByteBuffer& buf);
+};
+
+// --------------------------------------------------------------------------
+
+inline socket_t UnixDgramSocket::create()
+{
+	return (socket_t) ::socket(PF_UNIX, SOCK_DGRAM, 0);
+}
+
+inline int UnixDgramSocket::bind(const UnixAddr& addr)
+{
+	return ::bind(handle(), addr.sockaddr_ptr(), addr.size());
+}
+
+inline int UnixDgramSocket::connect(const UnixAddr& addr)
+{
+	return ::connect(handle(), addr.sockaddr_ptr(), addr.size());
+}
+
+inline int UnixDgramSocket::sendto(const void* buf, size_t n, const UnixAddr& addr)
+{
+	return ::sendto(handle(), buf, n, 0, addr.sockaddr_ptr(), addr.size());
+}
+
+inline int UnixDgramSocket::send(const void* buf, size_t n)
+{
+	return ::send(handle(), buf, n, 0);
+}
+
+inline int UnixDgramSocket::recv(void* buf, size_t n)
+{
+	return ::recv(handle(), buf, n, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// !WIN32
+#endif		// __CtrlrFx_UnixSocket_h
+
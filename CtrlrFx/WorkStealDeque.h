@@ -0,0 +1,189 @@
+/// @file WorkStealDeque.h
+/// Definition of the lock-free work-stealing deque.
+
+#ifndef __CtrlrFx_WorkStealDeque_h
+#define __CtrlrFx_WorkStealDeque_h
+
+#include "CtrlrFx/xtypes.h"
+#include "CtrlrFx/AtomicOps.h"
+#include <assert.h>
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+/// A Chase-Lev work-stealing deque.
+/// This is a lock-free double-ended queue with a single owner thread and
+/// any number of thieves. The owner pushes and pops items at the bottom,
+/// in LIFO order, which keeps its working set warm in the cache. Other
+/// threads steal from the top, in FIFO order, which tends to give them
+/// the largest pieces of outstanding work.
+///
+/// The owner's push and pop are a handful of plain loads and stores in the
+/// common case. Only the race for the last item, and steals, need an
+/// atomic compare-and-swap.
+///
+/// The capacity is fixed when the deque is created and rounded up to a
+/// power of two. A push to a full deque fails, and the caller needs to
+/// put the item somewhere else.
+///
+/// @param T The item type. This must be a type that can be loaded and
+///  		 stored atomically, normally a pointer.
+
+template <typename T>
+class WorkStealDeque
+{
+	volatile int64_t	top_;		///< Next item to steal
+	char				pad_[64];	///< Keeps top and bottom on separate cache lines
+	volatile int64_t	bottom_;	///< Next free slot for the owner
+	T*					buf_;		///< The circular buffer
+	int64_t				mask_;		///< Capacity - 1
+
+	// Non-copyable
+	WorkStealDeque(const WorkStealDeque&);
+	WorkStealDeque& operator=(const WorkStealDeque&);
+
+public:
+	/// The result of a steal that lost a race with another thread.
+	/// The deque might not be empty, and the caller can try again.
+	enum { EMPTY = 0, ABORT = -1, SUCCESS = 1 };
+
+	/**
+	 * Creates a deque.
+	 * @param cap The capacity. This is rounded up to a power of two.
+	 */
+	explicit WorkStealDeque(size_t cap=1024);
+	/**
+	 * Destroys the deque.
+	 */
+	~WorkStealDeque() { delete[] buf_; }
+	/**
+	 * Gets the capacity of the deque.
+	 * @return The capacity of the deque.
+	 */
+	size_t capacity() const { return size_t(mask_ + 1); }
+	/**
+	 * Gets an estimate of the number of items in the deque.
+	 * This is exact when called by the owner with no steals in progress.
+	 * @return An estimate of the number of items in the deque.
+	 */
+	size_t size() const {
+		int64_t n = atomic_load_acquire(&bottom_) - atomic_load_acquire(&top_);
+		return (n > 0) ? size_t(n) : 0;
+	}
+	/**
+	 * Determines if the deque appears to be empty.
+	 * @return @em true if the deque appears to be empty.
+	 */
+	bool empty() const { return size() == 0; }
+	/**
+	 * Pushes an item onto the bottom of the deque.
+	 * This can only be called by the owner thread.
+	 * @param item The item to push.
+	 * @return @em true on success, @em false if the deque is full.
+	 */
+	bool push(T item);
+	/**
+	 * Pops an item from the bottom of the deque.
+	 * This can only be called by the owner thread.
+	 * @param item Gets the item.
+	 * @return @em true if an item was popped, @em false if the deque was
+	 *  	   empty.
+	 */
+	bool pop(T* item);
+	/**
+	 * Steals an item from the top of the deque.
+	 * This can be called by any thread.
+	 * @param item Gets the item.
+	 * @return
+	 * @li SUCCESS if an item was stolen
+	 * @li EMPTY if the deque was empty
+	 * @li ABORT if the steal lost a race with another thread
+	 */
+	int steal(T* item);
+};
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+WorkStealDeque<T>::WorkStealDeque(size_t cap) : top_(0), bottom_(0)
+{
+	size_t n = 2;
+	while (n < cap)
+		n <<= 1;
+
+	buf_ = new T[n];
+	mask_ = int64_t(n - 1);
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool WorkStealDeque<T>::push(T item)
+{
+	int64_t b = atomic_load_relaxed(&bottom_),
+			t = atomic_load_acquire(&top_);
+
+	if (b - t > mask_)
+		return false;
+
+	atomic_store_relaxed(&buf_[b & mask_], item);
+	atomic_fence_release();
+	atomic_store_relaxed(&bottom_, b+1);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+// The owner reserves the bottom item by decrementing 'bottom', then checks
+// for thieves. If there's more than one item left, it's ours. If it's the
+// last one, we race the thieves for it with a CAS on 'top'.
+
+template <typename T>
+bool WorkStealDeque<T>::pop(T* item)
+{
+	int64_t b = atomic_load_relaxed(&bottom_) - 1;
+	atomic_store_relaxed(&bottom_, b);
+	atomic_fence();
+	int64_t t = atomic_load_relaxed(&top_);
+
+	if (t > b) {
+		atomic_store_relaxed(&bottom_, b+1);
+		return false;
+	}
+
+	*item = atomic_load_relaxed(&buf_[b & mask_]);
+
+	if (t == b) {
+		bool won = atomic_cas(&top_, t, t+1);
+		atomic_store_relaxed(&bottom_, b+1);
+		return won;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+int WorkStealDeque<T>::steal(T* item)
+{
+	int64_t t = atomic_load_acquire(&top_);
+	atomic_fence();
+	int64_t b = atomic_load_acquire(&bottom_);
+
+	if (t >= b)
+		return EMPTY;
+
+	T x = atomic_load_relaxed(&buf_[t & mask_]);
+
+	if (!atomic_cas(&top_, t, t+1))
+		return ABORT;
+
+	*item = x;
+	return SUCCESS;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_WorkStealDeque_h
+
@@ -0,0 +1,293 @@
+/// @file ZeroCopySender.h
+/// Zero-copy TCP sends of pooled buffers.
+/// This is Linux-specific.
+
+#ifndef __CtrlrFx_ZeroCopySender_h
+#define __CtrlrFx_ZeroCopySender_h
+
+#if defined(__linux__)
+
+#include "CtrlrFx/Socket.h"
+#include "CtrlrFx/BufPool.h"
+#include <poll.h>
+#include <errno.h>
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+/// Sends buffers from a pool over a TCP socket, without copying them into
+/// the kernel.
+/// The network card reads the data right out of the buffer, so the buffer
+/// can't be reused until the kernel reports that it's done with it. The
+/// sender keeps track of the buffers in flight and returns each one to its
+/// pool as its completion arrives. Completions are picked up by reap(),
+/// which send() also does as it goes.
+///
+/// Zero-copy has a fixed cost per send, so buffers smaller than a minimum
+/// size are sent with a normal copy. If the socket doesn't support
+/// zero-copy, all the buffers are copied.
+///
+/// The sender must be the only user of zero-copy sends on its socket, and
+/// is meant for a blocking socket. It's not thread-safe.
+
+template <typename LockType=Mutex>
+class ZeroCopySender
+{
+public:
+	/// The type of buffer pool
+	typedef BufPool<byte,LockType> pool_type;
+
+	/// The default size below which buffers are copied
+	enum { DFLT_MIN_SIZE = 16*1024 };
+
+private:
+	/// A buffer in flight.
+	struct Pending {
+		ByteBuffer*	buf;	///< The buffer
+		uint32_t	first;	///< The sequence number of its first send
+		uint32_t	last;	///< The sequence number of its last send
+		uint32_t	ndone;	///< The number of its sends completed
+		bool		open;	///< Whether more of it is still being sent
+	};
+
+	TcpSocket&	sock_;		///< The socket
+	pool_type&	pool_;		///< The pool to return buffers to
+	size_t		minSize_;	///< The smallest buffer sent zero-copy
+	bool		enabled_;	///< Whether the socket has zero-copy on
+	Pending*	pend_;		///< The ring of buffers in flight
+	size_t		cap_;		///< The capacity of the ring
+	size_t		head_;		///< The oldest buffer in flight
+	size_t		n_;			///< The number of buffers in flight
+	uint32_t	seq_;		///< The sequence number of the next send
+	size_t		ncopied_;	///< The number of completions that were copied
+
+	/// Compares sequence numbers, allowing for wrap.
+	static int32_t seq_diff(uint32_t a, uint32_t b) { return int32_t(a - b); }
+
+	/// Applies a range of completed sends to the buffers in flight.
+	void complete(uint32_t lo, uint32_t hi);
+
+	/// Waits for the socket to report completions.
+	int wait();
+
+	// Non-copyable
+	ZeroCopySender(const ZeroCopySender&);
+	ZeroCopySender& operator=(const ZeroCopySender&);
+
+public:
+	/**
+	 * Creates a sender, and turns on zero-copy for the socket.
+	 * @param sock The connected socket.
+	 * @param pool The pool that the buffers come from.
+	 * @param minSize The smallest buffer to send zero-copy.
+	 */
+	ZeroCopySender(TcpSocket& sock, pool_type& pool,
+				   size_t minSize=DFLT_MIN_SIZE);
+	/**
+	 * Waits for the buffers in flight, and returns them to the pool.
+	 * If the socket fails, they're returned without waiting.
+	 */
+	~ZeroCopySender();
+	/**
+	 * Determines if the socket is actually doing zero-copy sends.
+	 * @return @em true if zero-copy is enabled on the socket.
+	 */
+	bool is_enabled() const { return enabled_; }
+	/**
+	 * Sends the data in a buffer and takes ownership of it.
+	 * The buffer's available data is sent completely, and the buffer goes
+	 * back to the pool once the kernel is done with it. If the kernel
+	 * runs out of memory for zero-copy sends, this waits for completions.
+	 * @param buf The buffer, which came from the pool.
+	 * @return The number of bytes sent, or -1 on error.
+	 */
+	int send(ByteBuffer* buf);
+	/**
+	 * Picks up any completions, without waiting, and returns the finished
+	 * buffers to the pool.
+	 * @return The number of buffers returned to the pool, or -1 on error.
+	 */
+	int reap();
+	/**
+	 * Waits for all the buffers in flight to complete.
+	 * @return 0 on success, -1 on error.
+	 */
+	int flush();
+	/**
+	 * Gets the number of buffers in flight.
+	 * @return The number of buffers in flight.
+	 */
+	size_t pending() const { return n_; }
+	/**
+	 * Gets the number of completions for which the kernel copied the data
+	 * after all, such as for a loopback connection. If this is most of
+	 * them, zero-copy isn't helping.
+	 * @return The number of copied completions.
+	 */
+	size_t copied() const { return ncopied_; }
+};
+
+// --------------------------------------------------------------------------
+
+template <typename LockType>
+ZeroCopySender<LockType>::ZeroCopySender(TcpSocket& sock, pool_type& pool,
+										 size_t minSize /*=DFLT_MIN_SIZE*/)
+	: sock_(sock), pool_(pool), minSize_(minSize), cap_(pool.capacity()+1),
+		head_(0), n_(0), seq_(0), ncopied_(0)
+{
+	enabled_ = (sock_.zero_copy(true) == 0);
+	pend_ = new Pending[cap_];
+}
+
+template <typename LockType>
+ZeroCopySender<LockType>::~ZeroCopySender()
+{
+	if (flush() < 0) {
+		for (; n_ > 0; --n_, head_ = (head_ + 1) % cap_)
+			pool_.put(pend_[head_].buf);
+	}
+	delete[] pend_;
+}
+
+// --------------------------------------------------------------------------
+// A buffer may take several sends. It's only in flight if at least one of
+// them succeeded; otherwise it can go right back to the pool. It's added to
+// the ring after its first send, but held open until the last, so that the
+// completions of its early sends are counted, and an ENOBUFS part way
+// through can wait on them, without the buffer being reaped too soon.
+
+template <typename LockType>
+int ZeroCopySender<LockType>::send(ByteBuffer* buf)
+{
+	if (!enabled_ || buf->available() < minSize_) {
+		int n = sock_.write_n(*buf);
+		pool_.put(buf);
+		return n;
+	}
+
+	while (n_ == cap_) {
+		if (wait() < 0 || reap() < 0)
+			return -1;
+	}
+
+	Pending& p = pend_[(head_ + n_) % cap_];
+	int nsent = 0;
+	bool inFlight = false;
+
+	while (buf->available() > 0) {
+		int n = sock_.send_zerocopy(*buf);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS && n_ > 0 && wait() == 0 && reap() >= 0)
+				continue;
+			nsent = -1;
+			break;
+		}
+
+		if (!inFlight) {
+			p.buf = buf;
+			p.first = seq_;
+			p.ndone = 0;
+			p.open = inFlight = true;
+			++n_;
+		}
+		p.last = seq_++;
+		nsent += n;
+	}
+
+	if (inFlight)
+		p.open = false;
+	else
+		pool_.put(buf);
+
+	reap();
+	return nsent;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename LockType>
+void ZeroCopySender<LockType>::complete(uint32_t lo, uint32_t hi)
+{
+	for (size_t i=0; i<n_; ++i) {
+		Pending& p = pend_[(head_ + i) % cap_];
+
+		uint32_t a = (seq_diff(lo, p.first) > 0) ? lo : p.first,
+				 b = (seq_diff(hi, p.last) < 0) ? hi : p.last;
+
+		if (seq_diff(b, a) >= 0)
+			p.ndone += b - a + 1;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+template <typename LockType>
+int ZeroCopySender<LockType>::reap()
+{
+	uint32_t lo, hi;
+	bool copied;
+	int ret;
+
+	while ((ret = sock_.zerocopy_completion(&lo, &hi, &copied)) > 0) {
+		complete(lo, hi);
+		if (copied)
+			++ncopied_;
+	}
+
+	int nbuf = 0;
+	while (n_ > 0) {
+		Pending& p = pend_[head_];
+		if (p.open || p.ndone < p.last - p.first + 1)
+			break;
+		pool_.put(p.buf);
+		head_ = (head_ + 1) % cap_;
+		--n_;
+		++nbuf;
+	}
+	return (ret < 0) ? -1 : nbuf;
+}
+
+// --------------------------------------------------------------------------
+// Completions are reported as an error condition on the socket, which poll
+// always checks for, even with no events requested.
+
+template <typename LockType>
+int ZeroCopySender<LockType>::wait()
+{
+	pollfd pfd;
+	pfd.fd = sock_.handle();
+	pfd.events = 0;
+	pfd.revents = 0;
+
+	int ret;
+	while ((ret = ::poll(&pfd, 1, -1)) < 0 && errno == EINTR)
+		;
+
+	if (ret < 0 || (pfd.revents & POLLNVAL))
+		return -1;
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename LockType>
+int ZeroCopySender<LockType>::flush()
+{
+	while (n_ > 0) {
+		if (reap() < 0)
+			return -1;
+		if (n_ > 0 && wait() < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __linux__
+#endif		// __CtrlrFx_ZeroCopySender_h
+
@@ -0,0 +1,245 @@
+/// @file ActiveObject.h
+/// Definition of the active-object runtime: @ref ActiveObject, @ref Active
+/// and @ref ActiveScheduler.
+
+#ifndef __CtrlrFx_ActiveObject_h
+#define __CtrlrFx_ActiveObject_h
+
+#include "CtrlrFx/Thread.h"
+#include "CtrlrFx/ConditionVar.h"
+#include "CtrlrFx/Guard.h"
+#include "CtrlrFx/CircQueue.h"
+#include "CtrlrFx/HierStateMachine.h"
+#include "CtrlrFx/EventPool.h"
+
+namespace CtrlrFx {
+
+class ActiveScheduler;
+
+/////////////////////////////////////////////////////////////////////////////
+//								ActiveObject
+/////////////////////////////////////////////////////////////////////////////
+
+/// An object with its own event queue, run by an @ref ActiveScheduler.
+/// Other parts of the application communicate with an active object only
+/// by posting events to it, or by publishing events that it subscribes
+/// to. The scheduler hands the events to the object one at a time, and
+/// each is run to completion before the object gets the next one, so the
+/// object never needs to lock its own data.
+///
+/// Each active object has a unique priority, which also serves as its id
+/// within the scheduler. When several objects have events waiting, the
+/// one with the highest priority is run first.
+
+class ActiveObject
+{
+	friend class ActiveScheduler;
+
+	ActiveScheduler*			sched_;		///< The scheduler running us
+	int							prio_;		///< Our priority (and id)
+	CircQueue<const Event*>		que_;		///< Our event queue
+	bool						running_;	///< Whether a thread is dispatching to us
+
+	// Non-copyable
+	ActiveObject(const ActiveObject&);
+	ActiveObject& operator=(const ActiveObject&);
+
+protected:
+	/**
+	 * Called when the object is started, from the thread that starts it.
+	 * This is where a state machine would take its initial transition.
+	 */
+	virtual void init() {}
+	/**
+	 * Handles an event.
+	 * This is called from one of the scheduler's threads, once for each
+	 * event posted to the object, or published to a signal it subscribes
+	 * to. It should return as soon as it's done with the event.
+	 * @param evt The event.
+	 */
+	virtual void handle(const Event* evt) =0;
+
+public:
+	/**
+	 * Creates an active object that is not yet running.
+	 */
+	ActiveObject() : sched_(0), prio_(0), running_(false) {}
+	/**
+	 * Destroys the object, removing it from its scheduler.
+	 */
+	virtual ~ActiveObject();
+	/**
+	 * Gets the priority of the object.
+	 * @return The priority of the object, or zero if it's not running.
+	 */
+	int prio() const { return prio_; }
+	/**
+	 * Posts an event to the object.
+	 * This can be called from any thread.
+	 * @param evt The event.
+	 * @return @em true on success, @em false if the object's queue is full
+	 *  	   (or it's not running). In that case, a pooled event that
+	 *  	   isn't referenced elsewhere is recycled.
+	 */
+	bool post(const Event* evt);
+	/**
+	 * Subscribes to all the events that are published with a signal.
+	 * @param sig The signal.
+	 */
+	void subscribe(evt_sig_t sig);
+	/**
+	 * Stops receiving the events that are published with a signal.
+	 * @param sig The signal.
+	 */
+	void unsubscribe(evt_sig_t sig);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Active
+/////////////////////////////////////////////////////////////////////////////
+
+/// An active object that hands its events to a @ref HierStateMachine.
+/// The derived class is written just like any other hierarchical state
+/// machine, with the handlers taking events of type <tt>const Event*</tt>.
+/// Entry and exit are actions rather than pseudo-events, so the handlers
+/// only ever see real events. The machine enters its initial state when
+/// the object is started. As with any @ref HierStateMachine, the state
+/// tables are normally a static member of the derived class.
+///
+/// @param T The derived class.
+/// @param N The number of states.
+
+template <typename T, int N>
+class Active : public ActiveObject, public HierStateMachine<T,N>
+{
+	typedef HierStateMachine<T,N> Hsm;
+
+	int initial_;	///< The initial state
+
+protected:
+	/**
+	 * Creates the active object.
+	 * @param tbl The state tables, shared with the other objects of the
+	 *  		  same class.
+	 * @param initial The state entered when the object is started.
+	 */
+	Active(const typename Hsm::Table& tbl, int initial)
+				: Hsm(tbl), initial_(initial) {}
+	/**
+	 * Enters the initial state.
+	 * A derived class that overrides this should call it.
+	 */
+	virtual void init() { Hsm::init(initial_); }
+	/**
+	 * Dispatches an event to the state machine.
+	 */
+	virtual void handle(const Event* evt) { Hsm::dispatch(evt); }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								ActiveScheduler
+/////////////////////////////////////////////////////////////////////////////
+
+/// A run-to-completion scheduler for active objects.
+/// A small set of threads runs any number (up to @ref MAX_ACTIVE) of
+/// active objects. Each thread repeatedly takes the highest-priority
+/// object that has events waiting and isn't already being run by another
+/// thread, and gives it its next event. So an object is never run by more
+/// than one thread at a time, but different objects run in parallel.
+///
+/// The scheduler also keeps the publish/subscribe lists. An event that is
+/// published is posted to every object that subscribes to its signal.
+
+class ActiveScheduler
+{
+	friend class ActiveObject;
+
+	typedef Guard<ConditionVar> MyGuard;
+
+public:
+	/// The maximum number of active objects (and the highest priority).
+	static const int MAX_ACTIVE = 64;
+
+private:
+	/// A scheduler thread.
+	class Runner : public Thread
+	{
+		ActiveScheduler& sched_;
+		virtual int run();
+	public:
+		Runner(ActiveScheduler& sched, int prio, const char* name)
+				: Thread(prio, 0, name), sched_(sched) {}
+		virtual void quit();
+	};
+
+	ConditionVar	cond_;					///< Protects everything here
+	ActiveObject*	active_[MAX_ACTIVE+1];	///< The objects, by priority
+	uint64_t		ready_;					///< Objects with events waiting
+	uint64_t*		subs_;					///< Subscribers, by signal
+	int				maxSig_;				///< The number of signals
+	int				nRunner_;				///< The number of threads
+	Runner**		runners_;				///< The threads
+	volatile bool	quit_;					///< Set on shutdown
+
+	static uint64_t prio_bit(int prio) { return uint64_t(1) << (prio-1); }
+
+	/// Takes the next event to run, blocking until there is one.
+	ActiveObject* next(const Event** evt);
+	/// Posts an event to an object. The caller must hold the lock.
+	bool post_locked(ActiveObject* ao, const Event* evt);
+
+	// Non-copyable
+	ActiveScheduler(const ActiveScheduler&);
+	ActiveScheduler& operator=(const ActiveScheduler&);
+
+public:
+	/**
+	 * Creates the scheduler and starts its threads.
+	 * @param maxSig The number of signals that can be published. Signals
+	 *  			 from zero to @em maxSig-1 can be subscribed to.
+	 * @param nThread The number of threads to run the active objects.
+	 * @param prio The priority of the threads.
+	 */
+	explicit ActiveScheduler(int maxSig, int nThread=1,
+							 int prio=Thread::PRIORITY_NORMAL);
+	/**
+	 * Stops the threads and destroys the scheduler.
+	 * Events still in the queues are discarded.
+	 */
+	~ActiveScheduler();
+	/**
+	 * Starts running an active object.
+	 * This gives the object its queue and calls its init() function.
+	 * @param ao The active object.
+	 * @param prio The priority of the object, from 1 to @ref MAX_ACTIVE.
+	 *  		   This must be unique among the objects in the scheduler.
+	 * @param queSize The maximum number of events that can be waiting in
+	 *  			  the object's queue.
+	 * @return @em 0 on success, @em -1 if the priority is out of range or
+	 *  	   already taken.
+	 */
+	int start(ActiveObject& ao, int prio, size_t queSize);
+	/**
+	 * Stops running an active object.
+	 * Any events still in its queue are released. If a thread is running
+	 * the object, this waits for it to finish with the current event, so
+	 * this can't be called from the object's own handler.
+	 * @param ao The active object.
+	 */
+	void stop(ActiveObject& ao);
+	/**
+	 * Publishes an event to all of the objects that subscribe to its
+	 * signal.
+	 * If nobody subscribes, a pooled event is recycled right away.
+	 * @param evt The event.
+	 * @return The number of objects the event was posted to.
+	 */
+	int publish(const Event* evt);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_ActiveObject_h
+
@@ -0,0 +1,179 @@
+/// @file EventPool.h
+/// Definition of the @ref EventPool class and the @ref Events registry.
+
+#ifndef __CtrlrFx_EventPool_h
+#define __CtrlrFx_EventPool_h
+
+#include "CtrlrFx/Event.h"
+#include "CtrlrFx/Mutex.h"
+#include "CtrlrFx/Guard.h"
+#include <new>
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+//								EventPool
+/////////////////////////////////////////////////////////////////////////////
+
+/// A fixed-size pool of event blocks.
+/// The pool is a set of equal-sized blocks of memory, kept in a free list.
+/// Getting and returning a block are O(1) and never block the caller.
+/// The memory can be provided by the application, or allocated off the
+/// heap when the pool is created.
+///
+/// Applications don't normally use the pools directly, but register them
+/// with @ref Events, and then allocate events through it.
+
+class EventPool
+{
+	typedef Guard<Mutex> MyGuard;
+
+	/// A free block.
+	struct Block { Block* next; };
+
+	Mutex		lock_;		///< Protects the free list
+	byte*		mem_;		///< The memory for the blocks
+	Block*		free_;		///< The list of free blocks
+	size_t		blkSize_,	///< The size of each block
+				n_,			///< The total number of blocks
+				nFree_,		///< The number of free blocks
+				nMin_;		///< The fewest free blocks there have been
+	bool		own_;		///< Whether we own the memory
+
+	void init(size_t blkSize, size_t n);
+
+	// Non-copyable
+	EventPool(const EventPool&);
+	EventPool& operator=(const EventPool&);
+
+public:
+	/**
+	 * Creates a pool, allocating the memory from the heap.
+	 * @param blkSize The size of each block. This is the size of the
+	 *  			  largest event that the pool can hold.
+	 * @param n The number of blocks.
+	 */
+	EventPool(size_t blkSize, size_t n);
+	/**
+	 * Creates a pool in the memory provided.
+	 * @param mem The memory for the blocks. It must be suitably aligned
+	 *  		  for any of the events that will be placed in it.
+	 * @param memSize The size of the memory, in bytes.
+	 * @param blkSize The size of each block.
+	 */
+	EventPool(void* mem, size_t memSize, size_t blkSize);
+	/**
+	 * Destroys the pool, freeing the memory if we own it.
+	 */
+	~EventPool();
+	/**
+	 * Gets the size of each block in the pool.
+	 * @return The size of each block in the pool.
+	 */
+	size_t block_size() const { return blkSize_; }
+	/**
+	 * Gets the total number of blocks in the pool.
+	 * @return The total number of blocks in the pool.
+	 */
+	size_t capacity() const { return n_; }
+	/**
+	 * Gets the number of free blocks in the pool.
+	 * @return The number of free blocks in the pool.
+	 */
+	size_t available() const { return nFree_; }
+	/**
+	 * Gets the smallest number of free blocks the pool has had.
+	 * This is useful for tuning the size of the pool.
+	 * @return The smallest number of free blocks the pool has had.
+	 */
+	size_t min_available() const { return nMin_; }
+	/**
+	 * Gets a block from the pool.
+	 * @return A pointer to the block, or null if the pool is empty.
+	 */
+	void* get();
+	/**
+	 * Returns a block to the pool.
+	 * @param p The block.
+	 */
+	void put(void* p);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Events
+/////////////////////////////////////////////////////////////////////////////
+
+/// The registry of event pools, used to allocate and recycle events.
+/// The application registers its pools at startup, in order of
+/// increasing block size. An event is allocated from the first pool with
+/// blocks large enough to hold it.
+///
+/// Pooled events are reference counted. The active-object framework adds
+/// a reference for each queue that the event is posted into, and releases
+/// it when the event has been handled, so an application only needs to
+/// call @ref release for events that it allocates but never posts.
+///
+/// Events are constructed in the pool, but are never destroyed, so they
+/// shouldn't have members with non-trivial destructors.
+
+class Events
+{
+public:
+	/// The maximum number of pools.
+	static const int MAX_POOLS = 8;
+
+private:
+	static EventPool*	pools_[MAX_POOLS];	///< The registered pools
+	static int			nPool_;				///< The number of pools
+
+	/// Gets a block that can hold an event of the specified size.
+	static void* alloc(size_t sz, uint8_t* poolId);
+
+public:
+	/**
+	 * Registers a pool.
+	 * Pools must be registered in order of increasing block size, before
+	 * any events are allocated.
+	 * @param pool The pool.
+	 * @return The pool id, or @em -1 if there are too many pools.
+	 */
+	static int add_pool(EventPool& pool);
+	/**
+	 * Allocates an event from the pools.
+	 * @param E The event type. This must derive from Event.
+	 * @param sig The event signal.
+	 * @return The new event, or null if there's no free block for it.
+	 */
+	template <typename E>
+	static E* create(evt_sig_t sig) {
+		uint8_t id;
+		void* p = alloc(sizeof(E), &id);
+		if (!p)
+			return 0;
+		E* evt = new (p) E;
+		evt->sig = sig;
+		evt->poolId = id;
+		evt->refCnt = 0;
+		return evt;
+	}
+	/**
+	 * Adds a reference to an event.
+	 * This has no effect on events that aren't from a pool.
+	 * @param evt The event.
+	 */
+	static void add_ref(const Event* evt);
+	/**
+	 * Releases a reference to an event.
+	 * When the last reference is released, the event is returned to its
+	 * pool. This has no effect on events that aren't from a pool.
+	 * @param evt The event.
+	 */
+	static void release(const Event* evt);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_EventPool_h
+
@@ -0,0 +1,403 @@
+/// @file Executor.h
+/// Definition of the work-stealing @ref Executor and its futures.
+
+#ifndef __CtrlrFx_Executor_h
+#define __CtrlrFx_Executor_h
+
+#include "CtrlrFx/Thread.h"
+#include "CtrlrFx/Mutex.h"
+#include "CtrlrFx/Semaphore.h"
+#include "CtrlrFx/ConditionVar.h"
+#include "CtrlrFx/Guard.h"
+#include "CtrlrFx/AtomicOps.h"
+#include "CtrlrFx/WorkStealDeque.h"
+
+#if __cplusplus >= 201103L
+	#include <utility>
+#endif
+
+namespace CtrlrFx {
+
+class Executor;
+
+/////////////////////////////////////////////////////////////////////////////
+//								ExecTask
+/////////////////////////////////////////////////////////////////////////////
+
+/// A unit of work for an @ref Executor.
+/// Tasks are created by the executor's @ref Executor::submit and
+/// @ref Executor::parallel_for functions, and deleted once they've run.
+
+class ExecTask
+{
+	friend class Executor;
+
+	ExecTask* next_;	///< Link for the executor's shared queue
+
+public:
+	ExecTask() : next_(0) {}
+	virtual ~ExecTask() {}
+	/// Runs the task.
+	virtual void execute() =0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Future state
+/////////////////////////////////////////////////////////////////////////////
+
+/// The part of the state shared between a task and its @ref Future that
+/// doesn't depend on the result type.
+/// This is reference counted, and deleted when both the task and all the
+/// futures are done with it.
+
+class FutureStateBase
+{
+	volatile int	refs_;		///< The reference count
+	volatile int	done_;		///< Whether the task has completed
+
+protected:
+	Executor&		exec_;		///< The executor running the task
+
+public:
+	/// Creates the state with a single reference.
+	FutureStateBase(Executor& exec, int refs=1)
+					: refs_(refs), done_(0), exec_(exec) {}
+	virtual ~FutureStateBase() {}
+
+	/// Adds a reference to the state.
+	void add_ref() { atomic_fetch_add(&refs_, 1); }
+	/// Removes a reference to the state, deleting it on the last one.
+	void release() {
+		if (atomic_fetch_add(&refs_, -1) == 1)
+			delete this;
+	}
+	/// Determines if the task has completed.
+	bool is_ready() const { return atomic_load_acquire(&done_) != 0; }
+	/// Marks the task as complete and wakes anyone waiting on it.
+	void set_ready();
+	/// Waits for the task to complete.
+	void wait();
+};
+
+/// The shared state for a task with a result.
+template <typename R>
+class FutureState : public FutureStateBase
+{
+	R	val_;
+
+public:
+	FutureState(Executor& exec) : FutureStateBase(exec, 2), val_() {}
+
+	/// Runs the function and keeps its result.
+	template <typename F>
+	void run(F& fn) { val_ = fn(); }
+	/// Gets the result.
+	const R& value() const { return val_; }
+};
+
+/// The shared state for a task without a result.
+template <>
+class FutureState<void> : public FutureStateBase
+{
+public:
+	FutureState(Executor& exec) : FutureStateBase(exec, 2) {}
+
+	template <typename F>
+	void run(F& fn) { fn(); }
+	void value() const {}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Future
+/////////////////////////////////////////////////////////////////////////////
+
+/// A handle to the result of a task submitted to an @ref Executor.
+/// This is a lightweight, copyable object; it just holds a reference to
+/// the state shared with the task.
+///
+/// Waiting on a future from one of the executor's own worker threads
+/// doesn't block the worker. It runs other tasks until the result is
+/// ready, so tasks can safely wait on the results of sub-tasks.
+
+template <typename R>
+class Future
+{
+	FutureState<R>*	st_;
+
+public:
+	/// Creates an empty future, not attached to any task.
+	Future() : st_(0) {}
+	/// Creates a future attached to the shared state of a task.
+	explicit Future(FutureState<R>* st) : st_(st) {}
+	/// Copy constructor.
+	Future(const Future& f) : st_(f.st_) {
+		if (st_) st_->add_ref();
+	}
+	/// Destructor.
+	~Future() {
+		if (st_) st_->release();
+	}
+	/// Assignment.
+	Future& operator=(const Future& f) {
+		if (f.st_) f.st_->add_ref();
+		if (st_) st_->release();
+		st_ = f.st_;
+		return *this;
+	}
+	/// Determines if the future is attached to a task.
+	bool is_valid() const { return st_ != 0; }
+	/// Determines if the task has completed.
+	bool is_ready() const { return st_ && st_->is_ready(); }
+	/// Waits for the task to complete.
+	void wait() const {
+		if (st_) st_->wait();
+	}
+	/// Waits for the task to complete and gets its result.
+	R get() const {
+		assert(st_);
+		st_->wait();
+		return st_->value();
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Task result
+/////////////////////////////////////////////////////////////////////////////
+
+/// Determines the result type of a callable object.
+/// With a C++11 compiler, this is whatever calling the object returns.
+/// Before that, it's the return type of a function pointer, or the
+/// @em result_type of a function object, as the standard function
+/// adapters declare. A function object without one doesn't compile, rather
+/// than quietly losing its result; one that returns nothing should declare
+/// a @em result_type of @em void.
+
+#if __cplusplus >= 201103L
+	template <typename F>
+	struct task_result { typedef decltype(std::declval<F&>()()) type; };
+#else
+	template <typename F>
+	struct task_result { typedef typename F::result_type type; };
+
+	template <typename R>
+	struct task_result<R (*)()> { typedef R type; };
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+//								Executor
+/////////////////////////////////////////////////////////////////////////////
+
+/// A pool of worker threads that run short tasks, with work stealing.
+/// Each worker has its own @ref WorkStealDeque. Tasks submitted from a
+/// worker go onto its own deque, and tasks submitted from other threads
+/// go onto a shared queue. A worker that runs out of work of its own
+/// takes from the shared queue and then steals from the other workers.
+/// Workers that can't find anything to do park on their own semaphore,
+/// and are woken, one at a time, as work arrives.
+///
+/// This is meant for short, non-blocking pieces of work, where the cost of
+/// handing a message to a dedicated thread would be a large part of the
+/// total. Long-lived, blocking work, such as servicing a connection, is
+/// still better suited to a @ref ThreadPool.
+
+class Executor
+{
+	friend class FutureStateBase;
+
+	/// A worker thread.
+	class Worker : public Thread
+	{
+		friend class Executor;
+
+		Executor&					exec_;
+		int							id_;
+		WorkStealDeque<ExecTask*>	deque_;		///< Our own tasks
+		Semaphore					wake_;		///< Parks the thread when idle
+		Worker*						nextIdle_;	///< Link in the idle list
+		bool						parked_;	///< Whether we're in the idle list
+		uint32_t					rand_;		///< For picking a victim
+
+		virtual int run();
+
+	public:
+		Worker(Executor& exec, int id, int prio, size_t cap, const char* name);
+	};
+
+	/// A task that runs a function and sets its future.
+	template <typename F, typename R>
+	class FnTask : public ExecTask
+	{
+		F				fn_;
+		FutureState<R>*	st_;
+	public:
+		FnTask(F fn, FutureState<R>* st) : fn_(fn), st_(st) {}
+		~FnTask() { st_->release(); }
+		virtual void execute() {
+			st_->run(fn_);
+			st_->set_ready();
+		}
+	};
+
+	/// The completion latch for a parallel_for.
+	class ForLatch : public FutureStateBase
+	{
+		volatile int remaining_;
+	public:
+		ForLatch(Executor& exec, int n) : FutureStateBase(exec), remaining_(n) {}
+		void count_down() {
+			if (atomic_fetch_add(&remaining_, -1) == 1)
+				set_ready();
+		}
+	};
+
+	/// A chunk of a parallel_for.
+	template <typename Body>
+	class ForTask : public ExecTask
+	{
+		Body*		body_;
+		int64_t		begin_, end_;
+		ForLatch*	latch_;
+	public:
+		ForTask(Body* body, int64_t begin, int64_t end, ForLatch* latch)
+				: body_(body), begin_(begin), end_(end), latch_(latch) {}
+		virtual void execute() {
+			for (int64_t i=begin_; i<end_; ++i)
+				(*body_)(i);
+			latch_->count_down();
+		}
+	};
+
+	static const int SPIN_COUNT = 64;	///< Tries for work before parking
+
+	int				nWorker_;		///< The number of workers
+	Worker**		workers_;		///< The workers
+
+	Mutex			qLock_;			///< Protects the shared queue
+	ExecTask		*qHead_,		///< Shared queue head
+					*qTail_;		///< Shared queue tail
+	volatile int	qSize_;			///< Number of tasks in the shared queue
+
+	Mutex			idleLock_;		///< Protects the idle list
+	Worker*			idleHead_;		///< Parked workers
+	volatile int	nIdle_;			///< Number of parked workers
+	volatile int	nSearching_;	///< Number of workers looking for work
+
+	ConditionVar	doneCond_;		///< For threads blocked on futures
+	volatile int	nWaiters_;		///< Number of blocked threads
+
+	volatile bool	quit_;			///< Set on shutdown
+
+	/// The worker running on the current thread, if any.
+	static __thread Worker* currWorker_;
+
+	/// Gets the worker for the current thread, if it's one of ours.
+	Worker* curr_worker() const {
+		return (currWorker_ && &currWorker_->exec_ == this) ? currWorker_ : 0;
+	}
+
+	void enqueue(ExecTask* task);
+	ExecTask* dequeue_shared();
+	ExecTask* find_task(Worker* w);
+	bool has_work() const;
+	void park(Worker* w);
+	void unpark(Worker* w);
+	void wake_one();
+	void wait_for(FutureStateBase& st);
+	void notify_done();
+
+	// Non-copyable
+	Executor(const Executor&);
+	Executor& operator=(const Executor&);
+
+public:
+	/// The default capacity of each worker's deque.
+	static const size_t DFLT_DEQUE_SIZE = 1024;
+	/**
+	 * Creates the executor and starts the worker threads.
+	 * @param nThread The number of worker threads. If zero, one is created
+	 *  			  for each online CPU.
+	 * @param prio The priority of the worker threads.
+	 * @param dequeSize The capacity of each worker's deque. Tasks that
+	 *  			  don't fit go onto the shared queue.
+	 */
+	explicit Executor(int nThread=0, int prio=Thread::PRIORITY_NORMAL,
+					  size_t dequeSize=DFLT_DEQUE_SIZE);
+	/**
+	 * Runs any tasks that are still queued, then stops the workers.
+	 */
+	~Executor();
+	/**
+	 * Gets the number of worker threads.
+	 * @return The number of worker threads.
+	 */
+	int num_threads() const { return nWorker_; }
+	/**
+	 * Gets the number of CPUs that are online.
+	 * @return The number of CPUs that are online.
+	 */
+	static int hardware_concurrency();
+	/**
+	 * Submits a function to be run by one of the workers.
+	 * @param fn A function pointer, or function object, taking no
+	 *  		 arguments. It's copied into the task. Before C++11, a
+	 *  		 function object must declare its @em result_type.
+	 * @return A future for the completion (and result) of the function.
+	 */
+	template <typename F>
+	Future<typename task_result<F>::type> submit(F fn) {
+		typedef typename task_result<F>::type R;
+		FutureState<R>* st = new FutureState<R>(*this);
+		enqueue(new FnTask<F,R>(fn, st));
+		return Future<R>(st);
+	}
+	/**
+	 * Runs a function over a range of indexes, in parallel.
+	 * The range is split into chunks, which are run as tasks. This blocks
+	 * until all the chunks are done. If called from one of the workers,
+	 * the worker runs tasks while it waits.
+	 * @param begin The first index.
+	 * @param end One past the last index.
+	 * @param body The function to call with each index. This is shared by
+	 *  		   all the chunks, not copied, so it must be safe to call
+	 *  		   concurrently.
+	 * @param grain The number of indexes in each chunk. If zero, the range
+	 *  			is split into a few chunks for each worker.
+	 */
+	template <typename Body>
+	void parallel_for(int64_t begin, int64_t end, Body& body, int64_t grain=0);
+};
+
+// --------------------------------------------------------------------------
+
+template <typename Body>
+void Executor::parallel_for(int64_t begin, int64_t end, Body& body, int64_t grain)
+{
+	if (end <= begin)
+		return;
+
+	int64_t n = end - begin;
+
+	if (grain <= 0) {
+		grain = n / (4 * nWorker_);
+		if (grain < 1)
+			grain = 1;
+	}
+
+	int nChunk = int((n + grain - 1) / grain);
+	ForLatch* latch = new ForLatch(*this, nChunk);
+
+	for (int64_t i=begin; i<end; i+=grain) {
+		int64_t e = (end - i > grain) ? i + grain : end;
+		enqueue(new ForTask<Body>(&body, i, e, latch));
+	}
+
+	wait_for(*latch);
+	latch->release();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_Executor_h
+
@@ -12,12 +12,20 @@ namespace CtrlrFx {
 /////////////////////////////////////////////////////////////////////////////
 
 /// A thread with a built-in message queue.
-
-template <typename T>
+/// The queue is a bounded MsgQueue by default. Any type with the same
+/// put/get interface can be used instead, like a @ref Mailbox, which
+/// never blocks the senders:
+/// @code
+/// class Worker : public QueueThread<Cmd, Mailbox<Cmd> > { ... };
+/// @endcode
+/// @param T The message type.
+/// @param Q The queue type.
+
+template <typename T, typename Q=MsgQueue<T> >
 class QueueThread : public Thread
 {
 protected:
-	MsgQueue<T> que_;
+	Q que_;
 
 public:
 	QueueThread(int prio, size_t queCap);
@@ -61,14 +69,14 @@ public:
 
 // --------------------------------------------------------------------------
 
-template <typename T>
-QueueThread<T>::QueueThread(int prio, size_t queCap)
+template <typename T, typename Q>
+QueueThread<T,Q>::QueueThread(int prio, size_t queCap)
 					: Thread(prio), que_(queCap)
 {
 }
 
-template <typename T>
-QueueThread<T>::QueueThread(int prio, unsigned stackSize, size_t queCap)
+template <typename T, typename Q>
+QueueThread<T,Q>::QueueThread(int prio, unsigned stackSize, size_t queCap)
 					: Thread(prio, stackSize), que_(queCap)
 {
 }
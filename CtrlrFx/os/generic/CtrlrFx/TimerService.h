@@ -0,0 +1,330 @@
+/// @file TimerService.h
+/// Definition of the @ref TimerService class and its timers.
+
+#ifndef __CtrlrFx_TimerService_h
+#define __CtrlrFx_TimerService_h
+
+#include "CtrlrFx/Thread.h"
+#include "CtrlrFx/ConditionVar.h"
+#include "CtrlrFx/Mutex.h"
+#include "CtrlrFx/Guard.h"
+#include "CtrlrFx/Time.h"
+#include "CtrlrFx/ITimer.h"
+
+namespace CtrlrFx {
+
+class WheelTimer;
+class TimerService;
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerWheel
+/////////////////////////////////////////////////////////////////////////////
+
+/// A hierarchical timing wheel.
+/// This is the data structure at the heart of the @ref TimerService. It
+/// holds a set of timers, sorted by their expiration tick, in a set of
+/// wheels, each of which has 64 slots. The first wheel has a slot for each
+/// of the next 64 ticks, the second has a slot for each of the next 64
+/// groups of 64 ticks, and so on. Timers in the higher wheels are moved
+/// down ("cascaded") as the time of their slot comes up.
+///
+/// Adding and removing a timer are O(1) operations. Each wheel keeps a
+/// bitmap of its occupied slots, so the time of the next event can be
+/// found in constant time, and idle time is skipped over without visiting
+/// the empty slots.
+///
+/// The wheel doesn't do any locking or have any notion of real time. It
+/// just counts ticks. Timers that are further out than the span of the
+/// wheels are parked in the last wheel and re-sorted as it turns.
+
+class TimerWheel
+{
+public:
+	/// The number of bits for the slot index in each wheel.
+	static const int SLOT_BITS = 6;
+	/// The number of slots in each wheel.
+	static const int N_SLOTS = 1 << SLOT_BITS;
+	/// The number of wheels.
+	static const int N_LEVELS = 4;
+	/// The number of ticks that can be held without re-sorting.
+	static const uint64_t MAX_SPAN = uint64_t(1) << (SLOT_BITS * N_LEVELS);
+	/// The tick value meaning "never".
+	static const uint64_t NEVER = ~uint64_t(0);
+
+private:
+	uint64_t	now_;						///< The current tick
+	WheelTimer*	slots_[N_LEVELS][N_SLOTS];	///< The timer lists
+	uint64_t	occupied_[N_LEVELS];		///< Bitmaps of non-empty slots
+	size_t		n_;							///< The number of timers
+
+	void link(WheelTimer* t);
+	void unlink(WheelTimer* t);
+	void cascade(int level);
+
+	// Non-copyable
+	TimerWheel(const TimerWheel&);
+	TimerWheel& operator=(const TimerWheel&);
+
+public:
+	/**
+	 * Creates an empty wheel, with the current tick at zero.
+	 */
+	TimerWheel();
+	/**
+	 * Gets the current tick.
+	 * @return The current tick.
+	 */
+	uint64_t now() const { return now_; }
+	/**
+	 * Gets the number of timers in the wheel.
+	 * @return The number of timers in the wheel.
+	 */
+	size_t size() const { return n_; }
+	/**
+	 * Determines if the wheel is empty.
+	 * @return @em true if there are no timers in the wheel.
+	 */
+	bool empty() const { return n_ == 0; }
+	/**
+	 * Adds a timer to the wheel.
+	 * The timer must not already be in a wheel. If the expiration is at or
+	 * before the current tick, the timer is due immediately.
+	 * @param t The timer.
+	 * @param expire The tick at which the timer expires.
+	 */
+	void add(WheelTimer* t, uint64_t expire);
+	/**
+	 * Removes a timer from the wheel.
+	 * It's safe to call this for a timer that isn't in the wheel.
+	 * @param t The timer.
+	 */
+	void remove(WheelTimer* t);
+	/**
+	 * Gets the next tick at which the wheel has some work to do.
+	 * This is either the expiration of a timer, or a point at which a
+	 * slot in one of the higher wheels needs to be cascaded down.
+	 * @return The next tick at which there's work to do, or @ref NEVER if
+	 *  	   the wheel is empty.
+	 */
+	uint64_t next_event() const;
+	/**
+	 * Removes and returns a timer that has expired.
+	 * This advances the wheel up to the specified tick, stopping at the
+	 * first one that has a timer. Call it repeatedly to get all the timers
+	 * that are due.
+	 * @param tick The tick to advance to, normally the current time.
+	 * @return A timer that has expired, or null if there are no more timers
+	 *  	   due at or before @em tick.
+	 */
+	WheelTimer* pop_expired(uint64_t tick);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								WheelTimer
+/////////////////////////////////////////////////////////////////////////////
+
+/// A timer that is run by a @ref TimerService.
+/// This is a lightweight timer object. It doesn't have a thread of its
+/// own, but rather is assigned to one of the dispatch threads of the
+/// service when it's created. Starting and stopping the timer are O(1)
+/// operations.
+///
+/// The client callbacks are made from the service's dispatch thread, and
+/// should be short. A long callback delays all of the other timers that
+/// are served by the same thread.
+
+class WheelTimer : public ITimer
+{
+	friend class TimerWheel;
+	friend class TimerService;
+
+	TimerService*	svc_;			///< The service running this timer
+	int				shard_;			///< The dispatch thread serving this timer
+	ITimerClient*	client_;		///< The client to notify
+	Duration		initDelay_,		///< The delay to the first expiration
+					period_,		///< The period (zero for a one-shot)
+					slack_;			///< Allowed lateness, for coalescing
+	uint64_t		due_,			///< The ideal (unrounded) expiration tick
+					expire_;		///< The tick at which it's scheduled
+	bool			active_;		///< Whether the timer is running
+
+	// Wheel linkage
+	WheelTimer*		next_;			///< The next timer in the slot
+	WheelTimer**	pprev_;			///< The link pointing to this timer
+	int				level_,			///< The wheel holding the timer
+					slot_;			///< The slot holding the timer
+
+	void init(TimerService& svc);
+
+	// Non-copyable
+	WheelTimer(const WheelTimer&);
+	WheelTimer& operator=(const WheelTimer&);
+
+public:
+	/**
+	 * Creates a timer, without a client.
+	 * @param svc The service to run the timer.
+	 */
+	explicit WheelTimer(TimerService& svc);
+	/**
+	 * Creates a timer.
+	 * @param svc The service to run the timer.
+	 * @param client The client to receive the timer events.
+	 */
+	WheelTimer(TimerService& svc, ITimerClient& client);
+	/**
+	 * Destructor.
+	 * Stops the timer.
+	 */
+	virtual ~WheelTimer() { stop(); }
+	/**
+	 * Sets the amount that the timer is allowed to be late.
+	 * The expirations are rounded up to a multiple of the slack, so that
+	 * timers with similar expirations fire together, and the dispatch
+	 * thread wakes up less often. This takes effect the next time the
+	 * timer is started. The default is the slack of the service.
+	 * @param slack The amount that the timer is allowed to be late.
+	 */
+	void slack(const Duration& slack) { slack_ = slack; }
+	/**
+	 * Gets the amount that the timer is allowed to be late.
+	 * @return The amount that the timer is allowed to be late.
+	 */
+	Duration slack() const { return slack_; }
+	/**
+	 * Determines if the timer is running.
+	 * @return @em true if the timer is running.
+	 */
+	bool is_active() const { return active_; }
+
+	// ----- ITimer Interface -----
+
+	virtual int register_client(ITimerClient& client);
+
+	virtual void start();
+	virtual void start(const Duration& period);
+	virtual void start(const Duration& initDelay, const Duration& period);
+
+	virtual void one_shot(const Duration& timeout);
+
+	virtual void stop();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerService
+/////////////////////////////////////////////////////////////////////////////
+
+/// A service that runs any number of timers from a few threads.
+/// Each @ref ThreadTimer is a thread of its own, which gets expensive
+/// when an application has hundreds of timers. The timer service instead
+/// runs its timers from one or more dispatch threads, each with its own
+/// @ref TimerWheel. The timers are spread over the threads, round-robin,
+/// as they are created.
+///
+/// Time is kept in ticks of a fixed resolution. Timers are rounded up to
+/// the next tick, so the resolution should be the coarsest that is
+/// acceptable to the application. The ticks count from the monotonic
+/// clock, so setting the system time doesn't move the timers.
+
+class TimerService
+{
+	friend class WheelTimer;
+
+	static const int DFLT_PRIO = Thread::PRIORITY_ABOVE_NORMAL + Thread::PRIORITY_INCREASE;
+
+	typedef Guard<ConditionVar> MyGuard;
+
+	/// A dispatch thread, and the wheel of timers that it serves.
+	class Shard : public Thread
+	{
+		friend class TimerService;
+		friend class WheelTimer;
+
+		TimerService&	svc_;
+		ConditionVar	cond_;			///< Protects the wheel
+		TimerWheel		wheel_;			///< The timers
+		uint64_t		wakeTick_;		///< When the thread plans to wake up
+		WheelTimer*		firing_;		///< Timer whose callback is running
+		thread_t		threadId_;		///< The OS dispatch thread
+
+		virtual int run();
+
+	public:
+		Shard(TimerService& svc, int prio, const char* name);
+		virtual void quit();
+	};
+
+	MonotonicTime	epoch_;		///< The time of tick zero
+	nsec_t			res_;		///< The tick resolution, in nsec
+	Duration		slack_;		///< The default timer slack
+	int				nShard_;	///< The number of dispatch threads
+	Shard**			shards_;	///< The dispatch threads
+	int				nextShard_;	///< The shard for the next timer
+	Mutex			lock_;		///< Protects the shard assignment
+
+	/// Gets the current time as a number of ticks.
+	uint64_t curr_tick() const;
+	/// Converts a duration to a whole number of ticks, rounding up.
+	uint64_t to_ticks(const Duration& d) const;
+	/// Gets the time at which the specified tick occurs.
+	MonotonicTime tick_time(uint64_t tick) const;
+	/// Selects a dispatch thread for a new timer.
+	int assign_shard();
+	/// Puts a timer into its wheel, due after the specified delay.
+	void schedule(WheelTimer* t, const Duration& delay);
+
+	// Non-copyable
+	TimerService(const TimerService&);
+	TimerService& operator=(const TimerService&);
+
+public:
+	/// The default tick resolution.
+	static const msec_t DFLT_RESOLUTION = 1;
+	/**
+	 * Creates the service and starts the dispatch threads.
+	 * @param nThread The number of dispatch threads.
+	 * @param res The tick resolution.
+	 * @param prio The priority of the dispatch threads.
+	 */
+	explicit TimerService(int nThread=1,
+						  const Duration& res=msec(DFLT_RESOLUTION),
+						  int prio=DFLT_PRIO);
+	/**
+	 * Stops the dispatch threads and destroys the service.
+	 * All of the timers should be destroyed before the service.
+	 */
+	~TimerService();
+	/**
+	 * Sets the default slack for new timers.
+	 * @param slack The default amount that timers are allowed to be late.
+	 * @sa WheelTimer::slack
+	 */
+	void slack(const Duration& slack) { slack_ = slack; }
+	/**
+	 * Gets the default slack for new timers.
+	 * @return The default amount that timers are allowed to be late.
+	 */
+	Duration slack() const { return slack_; }
+	/**
+	 * Gets the tick resolution of the service.
+	 * @return The tick resolution of the service.
+	 */
+	Duration resolution() const { return Duration(nsec(res_)); }
+	/**
+	 * Gets the number of dispatch threads.
+	 * @return The number of dispatch threads.
+	 */
+	int num_threads() const { return nShard_; }
+	/**
+	 * Gets the number of timers that are currently running.
+	 * @return The number of timers that are currently running.
+	 */
+	size_t num_active();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_TimerService_h
+
@@ -27,6 +27,15 @@ class ConditionVar
 	int				err_;		///< The last error encountered
 	pthread_cond_t	cond_;		///< The OS condition variable handle
 	Mutex			mutex_;		///< Mutex to guard the condition
+	clockid_t		clock_;		///< The clock for timed waits
+
+	/// Initializes the OS condition variable to use the clock.
+	void init();
+
+	/// Waits until an absolute time on the variable's clock.
+	bool timedwait(const timespec& ts) {
+		return ::pthread_cond_timedwait(&cond_, &mutex_.handle(), &ts) == 0;
+	}
 
 	// Non-copyable
 	ConditionVar(const ConditionVar&);
@@ -34,10 +43,16 @@ class ConditionVar
 
 public:
 	/// Constructs a condition variable that uses its internal mutex.
-	ConditionVar();
+	/// @param clock The POSIX clock for timed waits. A variable that
+	///  			 uses CLOCK_MONOTONIC isn't thrown off when the system
+	///  			 time is set, but must be given a @ref MonotonicTime for
+	///  			 its absolute waits.
+	explicit ConditionVar(clockid_t clock=CLOCK_REALTIME);
 
 	/// Constrcts a condition variable to use the mutex provided.
-	ConditionVar(Mutex& mutex);
+	/// @param mutex The mutex to guard the condition.
+	/// @param clock The POSIX clock for timed waits.
+	ConditionVar(Mutex& mutex, clockid_t clock=CLOCK_REALTIME);
 
 	/// Destroys the condition variable.
 	~ConditionVar() {
@@ -55,6 +70,9 @@ public:
 	/// Gets the last internal error for the condition variable.
 	int error() const { return err_; }
 
+	/// Gets the clock that the condition variable uses for timed waits.
+	clockid_t clock_id() const { return clock_; }
+
 	/// Determines if the condition variable is valid and usable.
 	operator void*() const { return (void*) is_valid(); }
 
@@ -110,7 +128,12 @@ public:
 	/// @li true If the condition variable was signaled.
 	/// @li false If a timeout occured.
 	bool wait(const Duration& d) {
-		return wait_until(Time::from_now(d));
+		timespec ts;
+		::clock_gettime(clock_, &ts);
+		ts.tv_sec  += d.tv_sec;
+		ts.tv_nsec += d.tv_nsec;
+		normalize_timespec(&ts);
+		return timedwait(ts);
 	}
 
 	/// Timed wait for the condition variable to be signaled, using an 
@@ -118,12 +141,14 @@ public:
 	/// This puts the calling thread to sleep until another thread signals
 	/// the condition variable. If the variable isn't signaled by the 
 	/// specified time, a timeout occurs.
+	/// The time must be based on the clock of the condition variable.
 	/// @return 
 	/// @li true If the condition variable was signaled.
 	/// @li false If a timeout occured.
-	bool wait_until(const Time& t) {
-		return ::pthread_cond_timedwait(&cond_, &mutex_.handle(),
-								&(const_cast<Time&>(t))) == 0;
+	template <clockid_t CLOCK>
+	bool wait_until(const TimeTmpl<CLOCK>& t) {
+		assert(CLOCK == clock_);
+		return timedwait(t);
 	}
 
 	/// Signals the conditional variable.
@@ -140,21 +165,37 @@ public:
 
 // --------------------------------------------------------------------------
 
-inline ConditionVar::ConditionVar()
+inline ConditionVar::ConditionVar(clockid_t clock /*=CLOCK_REALTIME*/)
+							: clock_(clock)
 {
-	if ((err_ = mutex_.error()) == 0 &&
-			::pthread_cond_init(&cond_, NULL) < 0)
-		err_ = errno;
+	if ((err_ = mutex_.error()) == 0)
+		init();
 	assert(err_ == 0);
 }
 
-inline ConditionVar::ConditionVar(Mutex& mutex) : err_(0), mutex_(mutex.handle())
+inline ConditionVar::ConditionVar(Mutex& mutex, clockid_t clock /*=CLOCK_REALTIME*/)
+							: err_(0), mutex_(mutex.handle()), clock_(clock)
 {
-	if (::pthread_cond_init(&cond_, NULL) < 0)
-		err_ = errno;
+	init();
 	assert(err_ == 0);
 }
 
+// --------------------------------------------------------------------------
+// The pthread functions return the error code rather than setting errno.
+
+inline void ConditionVar::init()
+{
+	pthread_condattr_t attr;
+
+	if ((err_ = ::pthread_condattr_init(&attr)) != 0)
+		return;
+
+	if ((err_ = ::pthread_condattr_setclock(&attr, clock_)) == 0)
+		err_ = ::pthread_cond_init(&cond_, &attr);
+
+	::pthread_condattr_destroy(&attr);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // end namespace CtrlrFx
 };
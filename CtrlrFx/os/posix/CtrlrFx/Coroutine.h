@@ -0,0 +1,535 @@
+/// @file Coroutine.h
+/// Definition of stackless coroutines: @ref Coroutine, @ref Task and the
+/// @ref CoScheduler that runs them.
+
+#ifndef __CtrlrFx_Coroutine_h
+#define __CtrlrFx_Coroutine_h
+
+#include "CtrlrFx/Thread.h"
+#include "CtrlrFx/ConditionVar.h"
+#include "CtrlrFx/Guard.h"
+#include "CtrlrFx/Time.h"
+#include "CtrlrFx/MsgQueue.h"
+#include "CtrlrFx/PollableMsgQueue.h"
+#include <poll.h>
+
+namespace CtrlrFx {
+
+class Coroutine;
+class CoScheduler;
+
+/////////////////////////////////////////////////////////////////////////////
+//								CoAwait
+/////////////////////////////////////////////////////////////////////////////
+
+/// A description of something that a coroutine can wait on.
+/// These are created with the co_xxx() helper functions, and passed to
+/// @ref CFX_CO_AWAIT.
+
+struct CoAwait
+{
+	/// The kinds of waits
+	enum Kind {
+		YIELD,		///< Give up the thread, but stay ready to run
+		SLEEP,		///< Wait for a time
+		FD,			///< Wait for a file descriptor to be ready
+		RETRY,		///< Retry a non-blocking operation until it succeeds
+		FD_RETRY,	///< Retry an operation each time a descriptor is ready
+		JOIN		///< Wait for another coroutine to finish
+	};
+
+	/// A non-blocking operation, returning @em true when it succeeds.
+	typedef bool (*TryFunc)(void* obj, void* arg);
+
+	Kind		kind;		///< The kind of wait
+	int			fd;			///< The descriptor for FD and FD_RETRY waits
+	short		events;		///< The poll events for FD and FD_RETRY waits
+	Duration	delay;		///< The time for SLEEP waits
+	TryFunc		func;		///< The operation for RETRY and FD_RETRY waits
+	void*		obj;		///< The object for the operation
+	void*		arg;		///< The argument for the operation
+	Coroutine*	co;			///< The coroutine for JOIN waits
+
+	/// Creates a wait of the specified kind.
+	explicit CoAwait(Kind k) : kind(k), fd(-1), events(0), func(0),
+								obj(0), arg(0), co(0) {}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Coroutine
+/////////////////////////////////////////////////////////////////////////////
+
+/// A stackless coroutine.
+///
+/// The body of the coroutine is the @ref run() function of a derived
+/// class, bracketed by @ref CFX_CO_BEGIN and @ref CFX_CO_END. Wherever it
+/// would block, it uses @ref CFX_CO_AWAIT instead. If the operation can't
+/// complete right away, run() returns to the scheduler, which parks the
+/// coroutine until the operation is ready, then calls run() again. The
+/// call picks up right after the await.
+///
+/// Since run() returns to the scheduler while the coroutine waits, its
+/// local variables don't survive an await. Anything that needs to live
+/// across one must be a member of the class. Two awaits can't appear on
+/// the same source line, and awaits can't be used inside a nested switch
+/// statement.
+///
+/// A coroutine takes no thread of its own while it waits, so a few
+/// scheduler threads can run thousands of them.
+///
+/// @code
+/// class Echo : public Coroutine
+/// {
+/// 	TcpSocket sock_;
+/// 	char buf_[512];
+/// 	int n_;
+///
+/// 	virtual bool run() {
+/// 		CFX_CO_BEGIN;
+/// 		for (;;) {
+/// 			CFX_CO_AWAIT(co_readable(sock_));
+/// 			if ((n_ = sock_.read(buf_, sizeof(buf_))) <= 0)
+/// 				break;
+/// 			sock_.write_n(buf_, n_);
+/// 		}
+/// 		CFX_CO_END;
+/// 	}
+/// };
+/// @endcode
+
+class Coroutine
+{
+	friend class CoScheduler;
+
+public:
+	/// The states of a coroutine
+	enum State { IDLE, READY, WAITING, DONE };
+
+private:
+	CoScheduler*	sched_;		///< The scheduler running us
+	volatile int	state_;		///< The current state
+	CoAwait			wait_;		///< What we're waiting on
+	MonotonicTime	due_;		///< The wake time for SLEEP waits
+	Coroutine*		next_;		///< The next in the ready list
+	Coroutine*		joiner_;	///< A coroutine waiting for us to finish
+
+	// Non-copyable
+	Coroutine(const Coroutine&);
+	Coroutine& operator=(const Coroutine&);
+
+protected:
+	int				line_;		///< The resume point, used by the CFX_CO macros
+
+	/**
+	 * Starts waiting on an operation.
+	 * This is called by @ref CFX_CO_AWAIT. If the operation completes
+	 * right away, the coroutine continues without returning to the
+	 * scheduler.
+	 * @param aw The operation.
+	 * @return @em true if the operation is already done, @em false if the
+	 *  	   coroutine needs to wait for it.
+	 */
+	bool await(const CoAwait& aw);
+	/**
+	 * The body of the coroutine.
+	 * This is called by the scheduler each time the coroutine is resumed.
+	 * @return @em true when the coroutine has finished, @em false when it
+	 *  	   is waiting.
+	 */
+	virtual bool run() =0;
+	/**
+	 * Called by the scheduler, from its own thread, when the coroutine
+	 * finishes.
+	 * This is called just before the coroutine is marked done, so anything
+	 * it does happens before a co_join(), wait() or wait_all() on the
+	 * coroutine returns. The scheduler still needs the object afterwards,
+	 * so it must not delete itself here; whoever joins or waits on it can
+	 * do that.
+	 */
+	virtual void on_done() {}
+
+public:
+	/**
+	 * Creates a coroutine that is not yet running.
+	 */
+	Coroutine() : sched_(0), state_(IDLE), wait_(CoAwait::YIELD),
+					next_(0), joiner_(0), line_(0) {}
+	/**
+	 * Virtual destructor.
+	 */
+	virtual ~Coroutine() {}
+	/**
+	 * Gets the state of the coroutine.
+	 * @return The state of the coroutine.
+	 */
+	State state() const { return State(state_); }
+	/**
+	 * Determines if the coroutine has finished.
+	 * @return @em true if the coroutine has finished.
+	 */
+	bool done() const { return state_ == DONE; }
+	/**
+	 * Gets the scheduler that is running the coroutine.
+	 * A coroutine uses this to spawn the tasks that it then joins.
+	 * @return The scheduler, or null if the coroutine was never spawned.
+	 */
+	CoScheduler* scheduler() const { return sched_; }
+	/**
+	 * Blocks the calling thread until the coroutine finishes.
+	 * This is for threads outside the scheduler. A coroutine waits for
+	 * another with co_join().
+	 */
+	void wait();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Task
+/////////////////////////////////////////////////////////////////////////////
+
+/// A coroutine that produces a result.
+/// The body returns the result with @ref CFX_CO_RETURN. Another coroutine
+/// can wait for the task with co_join(), then read the result.
+/// @param R The result type. This must be default-constructible and
+///  		 copyable.
+
+template <typename R>
+class Task : public Coroutine
+{
+protected:
+	R result_;		///< The result, set by CFX_CO_RETURN
+
+public:
+	/**
+	 * Gets the result of the task.
+	 * This is only valid after the task is done.
+	 * @return The result of the task.
+	 */
+	const R& result() const { return result_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// Starts the body of a coroutine, in its run() function.
+#define CFX_CO_BEGIN	switch (line_) { case 0:
+
+/// Ends the body of a coroutine.
+#define CFX_CO_END		} line_ = -1; return true
+
+/// Waits on an operation, described by a @ref CoAwait.
+#define CFX_CO_AWAIT(aw) \
+	do { \
+		line_ = __LINE__; \
+		if (!await(aw)) \
+			return false; \
+		case __LINE__: ; \
+	} while (0)
+
+/// Lets other coroutines run, then continues.
+#define CFX_CO_YIELD()	CFX_CO_AWAIT(co_resched())
+
+/// Finishes a task, setting its result.
+#define CFX_CO_RETURN(v) \
+	do { \
+		this->result_ = (v); \
+		line_ = -1; \
+		return true; \
+	} while (0)
+
+/////////////////////////////////////////////////////////////////////////////
+//								Awaitables
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Lets other coroutines run, then continues.
+ */
+inline CoAwait co_resched()
+{
+	return CoAwait(CoAwait::YIELD);
+}
+
+/**
+ * Waits for a time.
+ * @param d The time to wait.
+ */
+inline CoAwait co_sleep(const Duration& d)
+{
+	CoAwait aw(CoAwait::SLEEP);
+	aw.delay = d;
+	return aw;
+}
+
+/**
+ * Waits for a file descriptor to be ready.
+ * @param fd The file descriptor.
+ * @param events The poll(2) events to wait for.
+ */
+inline CoAwait co_poll(int fd, short events)
+{
+	CoAwait aw(CoAwait::FD);
+	aw.fd = fd;
+	aw.events = events;
+	return aw;
+}
+
+/**
+ * Waits for a file descriptor to be readable.
+ * @param fd The file descriptor.
+ */
+inline CoAwait co_readable(int fd) { return co_poll(fd, POLLIN); }
+
+/**
+ * Waits for a file descriptor to be writable.
+ * @param fd The file descriptor.
+ */
+inline CoAwait co_writable(int fd) { return co_poll(fd, POLLOUT); }
+
+/**
+ * Waits for a socket or device to be readable.
+ * @param h Any object with an OS handle, like a Socket or Device.
+ */
+template <typename H>
+inline CoAwait co_readable(const H& h) { return co_poll(h.handle(), POLLIN); }
+
+/**
+ * Waits for a socket or device to be writable.
+ * @param h Any object with an OS handle, like a Socket or Device.
+ */
+template <typename H>
+inline CoAwait co_writable(const H& h) { return co_poll(h.handle(), POLLOUT); }
+
+/**
+ * Waits for another coroutine to finish.
+ * @param co The coroutine. It must have been spawned on the same
+ *  		 scheduler.
+ */
+inline CoAwait co_join(Coroutine& co)
+{
+	CoAwait aw(CoAwait::JOIN);
+	aw.co = &co;
+	return aw;
+}
+
+// --------------------------------------------------------------------------
+
+/// The non-blocking operations behind the queue waits.
+template <typename T, typename L>
+struct CoQueueOps
+{
+	static bool try_get(void* que, void* p) {
+		return static_cast<MsgQueue<T,L>*>(que)->tryget(static_cast<T*>(p));
+	}
+	static bool try_put(void* que, void* p) {
+		return static_cast<MsgQueue<T,L>*>(que)->tryput(*static_cast<const T*>(p));
+	}
+};
+
+/**
+ * Gets an item from a message queue, waiting while it's empty.
+ * @param que The queue.
+ * @param p Where to put the item. Since it's written when the wait
+ *  		completes, this must be a member of the coroutine.
+ */
+template <typename T, typename L>
+inline CoAwait co_get(MsgQueue<T,L>& que, T* p)
+{
+	CoAwait aw(CoAwait::RETRY);
+	aw.func = &CoQueueOps<T,L>::try_get;
+	aw.obj = &que;
+	aw.arg = p;
+	return aw;
+}
+
+/**
+ * Puts an item into a message queue, waiting while it's full.
+ * @param que The queue.
+ * @param v The item. This is read when the wait completes, so it must be
+ *  		a member of the coroutine.
+ */
+template <typename T, typename L>
+inline CoAwait co_put(MsgQueue<T,L>& que, const T& v)
+{
+	CoAwait aw(CoAwait::RETRY);
+	aw.func = &CoQueueOps<T,L>::try_put;
+	aw.obj = &que;
+	aw.arg = const_cast<T*>(&v);
+	return aw;
+}
+
+// --------------------------------------------------------------------------
+
+/// The non-blocking operations behind the pollable queue waits.
+template <typename T>
+struct CoPollableQueueOps
+{
+	static bool try_get(void* que, void* p) {
+		return static_cast<PollableMsgQueue<T>*>(que)->tryget(static_cast<T*>(p));
+	}
+	static bool try_put(void* que, void* p) {
+		return static_cast<PollableMsgQueue<T>*>(que)->tryput(*static_cast<const T*>(p));
+	}
+};
+
+/**
+ * Gets an item from a pollable message queue, waiting while it's empty.
+ * The coroutine waits on the queue's descriptor, so it's resumed as soon
+ * as an item arrives, without any polling.
+ * @param que The queue.
+ * @param p Where to put the item. Since it's written when the wait
+ *  		completes, this must be a member of the coroutine.
+ */
+template <typename T>
+inline CoAwait co_get(PollableMsgQueue<T>& que, T* p)
+{
+	CoAwait aw(CoAwait::FD_RETRY);
+	aw.fd = que.handle();
+	aw.events = POLLIN;
+	aw.func = &CoPollableQueueOps<T>::try_get;
+	aw.obj = &que;
+	aw.arg = p;
+	return aw;
+}
+
+/**
+ * Puts an item into a pollable message queue, waiting while it's full.
+ * The queue only signals when it has data, so this is retried like a
+ * MsgQueue put.
+ * @param que The queue.
+ * @param v The item. This is read when the wait completes, so it must be
+ *  		a member of the coroutine.
+ */
+template <typename T>
+inline CoAwait co_put(PollableMsgQueue<T>& que, const T& v)
+{
+	CoAwait aw(CoAwait::RETRY);
+	aw.func = &CoPollableQueueOps<T>::try_put;
+	aw.obj = &que;
+	aw.arg = const_cast<T*>(&v);
+	return aw;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								CoScheduler
+/////////////////////////////////////////////////////////////////////////////
+
+/// A scheduler for coroutines.
+///
+/// A few worker threads take ready coroutines from a FIFO list and run
+/// them until they finish or wait. A separate poller thread keeps the
+/// waiting coroutines: it polls the file descriptors they're waiting on,
+/// keeps their sleep times in a heap, and makes them ready again when
+/// their waits are over.
+///
+/// MsgQueue doesn't notify anyone when it changes, so the queue waits are
+/// retried by the poller, at least once every @em retryInterval while any
+/// are pending. A get from a @ref PollableMsgQueue instead waits on the
+/// queue's descriptor, and is retried only when that's readable, so
+/// coroutines that take their input from queues should use those.
+
+class CoScheduler
+{
+	friend class Coroutine;
+
+	typedef Guard<ConditionVar> MyGuard;
+
+	/// A worker thread.
+	class Worker : public Thread
+	{
+		CoScheduler& sched_;
+		virtual int run();
+	public:
+		Worker(CoScheduler& sched, int prio, const char* name)
+				: Thread(prio, 0, name), sched_(sched) {}
+	};
+
+	/// The poller thread.
+	class Poller : public Thread
+	{
+		CoScheduler& sched_;
+		virtual int run();
+	public:
+		Poller(CoScheduler& sched, int prio)
+				: Thread(prio, 0, "copoll"), sched_(sched) {}
+	};
+
+	ConditionVar	cond_;			///< Protects everything here
+	Coroutine		*head_,			///< The head of the ready list
+					*tail_;			///< The tail of the ready list
+	Coroutine**		fdWait_;		///< Coroutines waiting on descriptors
+	size_t			nFdWait_,		///< The number of descriptor waits
+					fdCap_;			///< The size of the descriptor array
+	Coroutine**		retryWait_;		///< Coroutines retrying an operation
+	size_t			nRetryWait_,	///< The number of retry waits
+					retryCap_;		///< The size of the retry array
+	Coroutine**		heap_;			///< Sleeping coroutines, by wake time
+	size_t			nHeap_,			///< The number of sleepers
+					heapCap_;		///< The size of the heap
+	Duration		retryInterval_;	///< How often to retry queue waits
+	int				pipe_[2];		///< Pipe to wake the poller
+	int				nWorker_;		///< The number of worker threads
+	Worker**		workers_;		///< The worker threads
+	Poller*			poller_;		///< The poller thread
+	size_t			nLive_;			///< Coroutines not yet done
+	int				nExtWait_;		///< Outside threads waiting on the condition
+	bool			wakePending_;	///< Whether the poller has been woken
+	volatile bool	quit_;			///< Set on shutdown
+
+	/// Appends a coroutine to the ready list. The caller must hold the lock.
+	void make_ready(Coroutine* co);
+	/// Parks a coroutine that's waiting. The caller must hold the lock.
+	void park(Coroutine* co);
+	/// Handles a coroutine that just finished. The caller must hold the lock.
+	void finish(Coroutine* co);
+	/// Wakes the poller thread.
+	void wake_poller();
+	/// Takes the next ready coroutine, blocking until there is one.
+	Coroutine* next();
+
+	/// Adds a coroutine to the sleep heap.
+	void heap_push(Coroutine* co);
+	/// Removes the earliest coroutine from the sleep heap.
+	Coroutine* heap_pop();
+
+	// Non-copyable
+	CoScheduler(const CoScheduler&);
+	CoScheduler& operator=(const CoScheduler&);
+
+public:
+	/**
+	 * Creates the scheduler and starts its threads.
+	 * @param nThread The number of worker threads.
+	 * @param prio The priority of the threads.
+	 * @param retryInterval How often to retry operations that are waiting
+	 *  					on a message queue.
+	 */
+	explicit CoScheduler(int nThread=1, int prio=Thread::PRIORITY_NORMAL,
+						 const Duration& retryInterval=Duration(msec(1)));
+	/**
+	 * Stops the threads and destroys the scheduler.
+	 * Coroutines that haven't finished are abandoned where they are.
+	 */
+	~CoScheduler();
+	/**
+	 * Starts running a coroutine.
+	 * The coroutine must not already be running. One that is done may be
+	 * spawned again, starting over from the beginning.
+	 * @param co The coroutine.
+	 * @return @em 0 on success, @em -1 if the coroutine is already running.
+	 */
+	int spawn(Coroutine& co);
+	/**
+	 * Gets the number of coroutines that haven't yet finished.
+	 * @return The number of coroutines that haven't yet finished.
+	 */
+	size_t num_live() const;
+	/**
+	 * Blocks the caller until all of the coroutines have finished.
+	 */
+	void wait_all();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_Coroutine_h
+
@@ -0,0 +1,159 @@
+/// @file DevForwarder.h
+/// Definition of the @ref DevForwarder class, which moves data between a
+/// device and a socket in both directions.
+
+#ifndef __CtrlrFx_DevForwarder_h
+#define __CtrlrFx_DevForwarder_h
+
+#include "CtrlrFx/Device.h"
+#include "CtrlrFx/Socket.h"
+#include "CtrlrFx/PollSignal.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// Forwards data between a device and a stream socket, in both directions,
+/// from a single thread.
+///
+/// This is the core of a serial-to-Ethernet gateway. The forwarder waits
+/// on all the descriptors with poll(), so data moves as soon as it arrives,
+/// with no polling delay and no thread per direction.
+///
+/// Under Linux, the data is moved with splice() through a pipe, so it never
+/// passes through user space. Devices that can't be spliced, such as many
+/// serial ports, are detected on the first transfer and switched to copying
+/// through a buffer.
+///
+/// Each direction holds at most one buffer (or pipe) full of data. While
+/// the destination can't take it, the source isn't read, so a slow side
+/// pushes back on the fast one rather than having data pile up in memory.
+///
+/// The forwarder puts the descriptors into non-blocking mode. It doesn't
+/// own them.
+
+class DevForwarder
+{
+public:
+	/// The default amount of data held for each direction.
+	enum { DFLT_BUF_SIZE = 64*1024 };
+
+	/// The directions that data is forwarded.
+	enum Dir {
+		DEV_TO_SOCK,	///< From the device to the socket
+		SOCK_TO_DEV		///< From the socket to the device
+	};
+
+private:
+	/// One direction of forwarding.
+	struct Channel {
+		int			src;		///< The descriptor we read from
+		int			dst;		///< The descriptor we write to
+		int			pipe[2];	///< The splice pipe, or -1's to copy
+		byte*		buf;		///< The copy buffer, if not splicing
+		size_t		pos;		///< The start of the pending data in buf
+		size_t		npend;		///< The bytes read but not yet written
+		uint64_t	nbytes;		///< The bytes forwarded
+		bool		eof;		///< Whether the source is done
+		bool		done;		///< Whether everything was delivered
+	};
+
+	Channel		chan_[2];	///< The two directions
+	size_t		bufSize_;	///< The most data held per direction
+	PollSignal	quit_;		///< Signals the loop to stop
+	bool		sockEnds_;	///< Whether the socket closing ends the session
+	int			err_;		///< The last error
+
+	/// Sets up a direction of forwarding.
+	void init(Channel& ch, int src, int dst);
+
+	/// Switches a direction to copying through a buffer.
+	int to_copy(Channel& ch);
+
+	/// Reads what's available from the source of a direction.
+	int fill(Channel& ch);
+
+	/// Writes what the destination will take of the pending data.
+	int drain(Channel& ch);
+
+	// Non-copyable
+	DevForwarder(const DevForwarder&);
+	DevForwarder& operator=(const DevForwarder&);
+
+public:
+	/**
+	 * Creates a forwarder between an input and output device and a socket.
+	 * To forward with a single read/write device, pass it as both.
+	 * @param idev The device to read from.
+	 * @param odev The device to write to.
+	 * @param sock The connected socket.
+	 * @param bufSize The most data to hold for each direction.
+	 */
+	DevForwarder(InDevice& idev, OutDevice& odev, StreamSocket& sock,
+				 size_t bufSize=DFLT_BUF_SIZE);
+	/**
+	 * Creates a forwarder between descriptors.
+	 * @param idev The device descriptor to read from.
+	 * @param odev The device descriptor to write to.
+	 * @param sock The socket descriptor.
+	 * @param bufSize The most data to hold for each direction.
+	 */
+	DevForwarder(int idev, int odev, int sock, size_t bufSize=DFLT_BUF_SIZE);
+	/**
+	 * Releases the pipes and buffers.
+	 */
+	~DevForwarder();
+	/**
+	 * Sets whether the session ends when the client closes the socket.
+	 * By default, a client that closes its side of the socket is taken to
+	 * have half-closed it, and the device is still forwarded to the socket.
+	 * That never ends for a device that doesn't reach the end of its data,
+	 * like a serial port, so a server for such a device should turn this
+	 * on. Then run() returns as soon as the data read from the socket has
+	 * been delivered to the device.
+	 * @param on Whether the socket closing ends the session.
+	 */
+	void end_on_sock_close(bool on=true) { sockEnds_ = on; }
+	/**
+	 * Forwards data until both sides close, an error occurs, or the
+	 * forwarder is stopped.
+	 * When the source of one direction closes, the data already read is
+	 * delivered, and then the write side of its destination is shut down
+	 * (if it's a socket) so the peer sees the end of the stream. The other
+	 * direction keeps running, so a client that half-closes the socket
+	 * after sending a command still gets the device's reply, unless
+	 * end_on_sock_close() was set. A connection that is reset or hung up
+	 * ends the session even while the device is idle.
+	 * @return 0 on a close or stop, -1 on an error.
+	 */
+	int run();
+	/**
+	 * Stops the forwarding.
+	 * This can be called from any thread.
+	 */
+	void stop() { quit_.set(); }
+	/**
+	 * Gets the number of bytes forwarded in one direction.
+	 * @param d The direction.
+	 * @return The number of bytes written to the destination.
+	 */
+	uint64_t bytes(Dir d) const { return chan_[d].nbytes; }
+	/**
+	 * Determines if a direction is using splice().
+	 * @param d The direction.
+	 * @return @em true if splicing, @em false if copying.
+	 */
+	bool splicing(Dir d) const { return chan_[d].pipe[0] >= 0; }
+	/**
+	 * Gets the last error.
+	 * @return The last error.
+	 */
+	int error() const { return err_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_DevForwarder_h
+
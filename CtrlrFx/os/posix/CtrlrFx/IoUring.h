@@ -0,0 +1,405 @@
+/// @file IoUring.h
+/// Definition of the @ref IoUring asynchronous I/O ring, and its
+/// @ref IoOp operations.
+/// These are Linux-specific.
+
+#ifndef __CtrlrFx_IoUring_h
+#define __CtrlrFx_IoUring_h
+
+#if defined(__linux__)
+
+#include "CtrlrFx/Buffer.h"
+#include "CtrlrFx/BufPool.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace CtrlrFx {
+
+class IoOp;
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// The interface for objects that are notified when an asynchronous
+/// operation completes.
+
+class IIoCompletion
+{
+public:
+	/**
+	 * Called when an operation completes.
+	 * This is called from the thread that reaps the ring's completions.
+	 * @param op The operation. Its result and buffer are up to date.
+	 */
+	virtual void on_complete(IoOp& op) =0;
+	/**
+	 * Virtual destructor.
+	 */
+	virtual ~IIoCompletion() {}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// An asynchronous read or write, submitted to an @ref IoUring.
+///
+/// The operation object, and its buffer, must stay alive and untouched
+/// until it completes. When it does, the result is stored, the buffer's
+/// position is advanced by the number of bytes transferred (just like the
+/// synchronous read(ByteBuffer&) and write(ByteBuffer&)), and the client,
+/// if any, is called back.
+
+class IoOp
+{
+	friend class IoUring;
+
+public:
+	/// The kinds of operations.
+	enum Type {
+		NONE,		///< Not yet submitted
+		READ,		///< A read from a file or device
+		WRITE,		///< A write to a file or device
+		RECV,		///< A receive from a socket
+		SEND		///< A send to a socket
+	};
+
+private:
+	Type			type_;		///< The kind of operation
+	int				fd_;		///< The descriptor
+	ByteBuffer*		buf_;		///< The buffer
+	IIoCompletion*	client_;	///< Who to notify
+	void*			arg_;		///< User data
+	int				res_;		///< The result
+	volatile bool	done_;		///< Whether the operation completed
+
+	// Non-copyable
+	IoOp(const IoOp&);
+	IoOp& operator=(const IoOp&);
+
+public:
+	/**
+	 * Creates an operation that isn't in use.
+	 * @param arg Application data to keep with the operation.
+	 */
+	explicit IoOp(void* arg=0) : type_(NONE), fd_(-1), buf_(0), client_(0),
+									arg_(arg), res_(0), done_(true) {}
+	/**
+	 * Gets the kind of operation.
+	 * @return The kind of operation.
+	 */
+	Type type() const { return type_; }
+	/**
+	 * Gets the descriptor the operation was submitted for.
+	 * @return The descriptor.
+	 */
+	int handle() const { return fd_; }
+	/**
+	 * Gets the buffer.
+	 * @return The buffer.
+	 */
+	ByteBuffer* buffer() const { return buf_; }
+	/**
+	 * Gets the application data.
+	 * @return The application data.
+	 */
+	void* arg() const { return arg_; }
+	/**
+	 * Sets the application data.
+	 * @param arg The application data.
+	 */
+	void arg(void* arg) { arg_ = arg; }
+	/**
+	 * Determines whether the operation completed.
+	 * @return @em true if the operation completed (or was never
+	 *  	   submitted).
+	 */
+	bool done() const { return done_; }
+	/**
+	 * Gets the result of the operation.
+	 * @return The number of bytes transferred, or a negative errno value
+	 *  	   on an error.
+	 */
+	int result() const { return res_; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// An asynchronous I/O ring on the Linux io_uring interface.
+///
+/// Operations are queued into the ring without any system calls, then
+/// handed to the kernel in a batch by @ref submit(), or by one of the
+/// calls that wait for completions. Completions are reaped from shared
+/// memory, again without a system call unless the caller needs to wait.
+/// A thread moving a lot of small reads and writes - on serial ports or
+/// sockets - can then pay for a single system call per batch, rather than
+/// one or more per operation.
+///
+/// Descriptors and buffers can be registered with the kernel ahead of
+/// time. After that, any operation on a registered descriptor is made
+/// against the "fixed file", and a read or write into a registered
+/// buffer uses the fixed-buffer form, which saves the kernel from taking
+/// and releasing references on each operation. This happens
+/// automatically; the caller submits the same way in either case.
+///
+/// Each completion is delivered to the operation's @ref IIoCompletion
+/// client, if it has one. The operation can also be polled with
+/// IoOp::done(), or waited for with @ref wait(IoOp&). The ring has a
+/// descriptor, from @ref handle(), that becomes readable when completions
+/// arrive, so the ring can be run from a Reactor, or awaited by a
+/// coroutine with co_readable(), alongside other I/O; the waiter then
+/// calls @ref dispatch().
+///
+/// The ring is not thread-safe. It's meant to be owned by a single I/O
+/// thread, which submits the operations and reaps the completions.
+
+class IoUring
+{
+	int			fd_;		///< The ring descriptor
+	int			evtFd_;		///< The eventfd signalled on completions
+	int			err_;		///< The last error
+
+	void*		sqMem_;		///< The submission ring mapping
+	size_t		sqMemSz_;	///< ...and its size
+	void*		cqMem_;		///< The completion ring mapping (may be sqMem_)
+	size_t		cqMemSz_;	///< ...and its size
+	io_uring_sqe* sqes_;	///< The submission entries
+	size_t		sqesSz_;	///< ...and their size
+
+	volatile unsigned* sqHead_;		///< The kernel's submission head
+	volatile unsigned* sqTail_;		///< Our submission tail
+	unsigned	sqMask_;			///< The submission ring mask
+	unsigned*	sqArray_;			///< The submission index array
+	unsigned	sqLocal_;			///< Entries queued but not yet published
+
+	volatile unsigned* cqHead_;		///< Our completion head
+	volatile unsigned* cqTail_;		///< The kernel's completion tail
+	unsigned	cqMask_;			///< The completion ring mask
+	io_uring_cqe* cqes_;			///< The completion entries
+
+	unsigned	nPending_;	///< Operations submitted but not completed
+
+	int*		fileIdx_;	///< Maps descriptors to fixed-file indexes
+	int			nFileIdx_;	///< The size of the map
+
+	ByteBuffer** regBufs_;	///< The registered buffers
+	unsigned	nRegBufs_;	///< The number of registered buffers
+
+	/// Gets a free submission entry, flushing the ring if it's full.
+	io_uring_sqe* get_sqe();
+	/// Queues an operation.
+	int queue(IoOp& op, IoOp::Type type, int fd, ByteBuffer& buf,
+			  IIoCompletion* client);
+	/// Calls io_uring_enter.
+	int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+	/// Publishes the queued entries to the kernel.
+	unsigned flush_sq();
+	/// Finds a registered buffer containing the region.
+	int buf_index(const ByteBuffer& buf) const;
+	/// Releases the rings.
+	void close();
+
+	// Non-copyable
+	IoUring(const IoUring&);
+	IoUring& operator=(const IoUring&);
+
+public:
+	/// The default number of submission entries.
+	enum { DFLT_ENTRIES = 256 };
+	/**
+	 * Creates a ring.
+	 * @param entries The number of submission entries. This is the most
+	 *  			  operations that can be queued between submissions.
+	 */
+	explicit IoUring(unsigned entries=DFLT_ENTRIES);
+	/**
+	 * Destroys the ring.
+	 * Any operations that are still in flight are abandoned; their
+	 * buffers may still be written by the kernel until the ring is torn
+	 * down, so the owner should wait for them first.
+	 */
+	~IoUring();
+	/**
+	 * Determines if the ring was created successfully.
+	 * This fails on kernels without io_uring, or where it's disabled.
+	 * @return @em true if the ring is usable.
+	 */
+	bool is_valid() const { return fd_ >= 0; }
+	/**
+	 * Gets the last error.
+	 * @return The last error.
+	 */
+	int error() const { return err_; }
+	/**
+	 * Gets a descriptor that becomes readable when operations complete.
+	 * @return The descriptor.
+	 */
+	int handle() const { return evtFd_; }
+	/**
+	 * Gets the number of operations that were submitted but haven't yet
+	 * completed.
+	 * @return The number of operations in flight.
+	 */
+	unsigned pending() const { return nPending_; }
+	/**
+	 * Registers a set of descriptors with the kernel.
+	 * Later operations on these descriptors use the fixed-file form.
+	 * This replaces any previous registration, and should only be done
+	 * while no operations are in flight.
+	 * @param fds The descriptors.
+	 * @param n The number of descriptors.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int register_files(const int fds[], unsigned n);
+	/**
+	 * Unregisters the descriptors.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int unregister_files();
+	/**
+	 * Registers a set of buffers with the kernel.
+	 * Later reads and writes within these buffers use the fixed-buffer
+	 * form. The buffers must not be resized while registered. This
+	 * replaces any previous registration, and should only be done while no
+	 * operations are in flight.
+	 * @param bufs The buffers.
+	 * @param n The number of buffers.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int register_buffers(ByteBuffer* const bufs[], unsigned n);
+	/**
+	 * Registers all the buffers in a pool with the kernel.
+	 * The pool must be full (all of its buffers returned) when this is
+	 * called.
+	 * @param pool The buffer pool.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	template <typename LockType>
+	int register_buffers(BufPool<byte, LockType>& pool);
+	/**
+	 * Unregisters the buffers.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int unregister_buffers();
+	/**
+	 * Queues a read into the available space of a buffer.
+	 * @param fd The descriptor.
+	 * @param buf The buffer.
+	 * @param op The operation. It must not already be in flight.
+	 * @param client Who to notify on completion, if anyone.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int read(int fd, ByteBuffer& buf, IoOp& op, IIoCompletion* client=0) {
+		return queue(op, IoOp::READ, fd, buf, client);
+	}
+	/**
+	 * Queues a write of the available data in a buffer.
+	 * @param fd The descriptor.
+	 * @param buf The buffer.
+	 * @param op The operation. It must not already be in flight.
+	 * @param client Who to notify on completion, if anyone.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int write(int fd, ByteBuffer& buf, IoOp& op, IIoCompletion* client=0) {
+		return queue(op, IoOp::WRITE, fd, buf, client);
+	}
+	/**
+	 * Queues a receive on a socket into the available space of a buffer.
+	 * @param fd The socket.
+	 * @param buf The buffer.
+	 * @param op The operation. It must not already be in flight.
+	 * @param client Who to notify on completion, if anyone.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int recv(int fd, ByteBuffer& buf, IoOp& op, IIoCompletion* client=0) {
+		return queue(op, IoOp::RECV, fd, buf, client);
+	}
+	/**
+	 * Queues a send on a socket of the available data in a buffer.
+	 * @param fd The socket.
+	 * @param buf The buffer.
+	 * @param op The operation. It must not already be in flight.
+	 * @param client Who to notify on completion, if anyone.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int send(int fd, ByteBuffer& buf, IoOp& op, IIoCompletion* client=0) {
+		return queue(op, IoOp::SEND, fd, buf, client);
+	}
+	/**
+	 * Queues a read from a device or socket.
+	 * @param dev Any object with a handle(), like an InDevice, Device, or
+	 *  		  TcpSocket.
+	 */
+	template <typename D>
+	int read(D& dev, ByteBuffer& buf, IoOp& op, IIoCompletion* client=0) {
+		return read(int(dev.handle()), buf, op, client);
+	}
+	/**
+	 * Queues a write to a device or socket.
+	 * @param dev Any object with a handle(), like an OutDevice, Device, or
+	 *  		  TcpSocket.
+	 */
+	template <typename D>
+	int write(D& dev, ByteBuffer& buf, IoOp& op, IIoCompletion* client=0) {
+		return write(int(dev.handle()), buf, op, client);
+	}
+	/**
+	 * Hands all the queued operations to the kernel.
+	 * @return The number of operations submitted, or @em -1 on error.
+	 */
+	int submit();
+	/**
+	 * Reaps the operations that have completed, without waiting.
+	 * Each operation is updated and its client is notified. This only
+	 * touches the shared memory; it doesn't make a system call.
+	 * @return The number of operations completed.
+	 */
+	int complete();
+	/**
+	 * Clears the completion descriptor, then reaps the completions.
+	 * This is what to call when @ref handle() becomes readable.
+	 * @return The number of operations completed.
+	 */
+	int dispatch();
+	/**
+	 * Submits the queued operations and waits for some to complete.
+	 * @param minComplete The number of completions to wait for.
+	 * @return The number of operations completed, or @em -1 on error.
+	 */
+	int wait_complete(unsigned minComplete=1);
+	/**
+	 * Submits the queued operations and waits for a particular one to
+	 * complete. Other operations that complete in the meantime are
+	 * handled as usual.
+	 * @param op The operation.
+	 * @return The result of the operation, or a negative errno value if
+	 *  	   the wait failed.
+	 */
+	int wait(IoOp& op);
+};
+
+// --------------------------------------------------------------------------
+
+template <typename LockType>
+int IoUring::register_buffers(BufPool<byte, LockType>& pool)
+{
+	unsigned n = unsigned(pool.capacity());
+	ByteBuffer** bufs = new ByteBuffer*[n];
+
+	for (unsigned i=0; i<n; ++i)
+		bufs[i] = pool.get();
+
+	int ret = register_buffers(bufs, n);
+
+	for (unsigned i=0; i<n; ++i)
+		pool.put(bufs[i]);
+
+	delete[] bufs;
+	return ret;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __linux__
+#endif		// __CtrlrFx_IoUring_h
+
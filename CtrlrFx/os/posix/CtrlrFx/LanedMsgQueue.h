@@ -0,0 +1,524 @@
+/// @file LanedMsgQueue.h
+/// Definition of the @ref LanedMsgQueue class.
+
+#ifndef __CtrlrFx_LanedMsgQueue_h
+#define __CtrlrFx_LanedMsgQueue_h
+
+#include "CtrlrFx/AtomicOps.h"
+#include "CtrlrFx/Parker.h"
+#include "CtrlrFx/Time.h"
+#include <assert.h>
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A many-to-one message queue with a separate lane for each producer.
+///
+/// Each producer thread gets a lane of its own, which is a lock-free,
+/// single-producer/single-consumer ring buffer. So the producers never
+/// share a lock or a cache line with each other; each one only shares its
+/// own lane with the consumer. The consumer drains the lanes, either
+/// round-robin, which is fair to the producers, or by priority, where
+/// lane zero is always drained first.
+///
+/// All the lanes share a single wakeup: the consumer parks once when every
+/// lane is empty, and a producer only makes a system call to wake it if it
+/// is parked. A producer that finds its lane full likewise parks until the
+/// consumer takes something from that lane.
+///
+/// A producer claims a lane with @ref open_lane() and then passes the
+/// lane number to put(). Or it can just call put(v), which claims a lane
+/// for the calling thread the first time and then reuses it. Lanes are
+/// never given back, so the queue must be created with a lane for every
+/// thread that will ever put into it.
+///
+/// The consumer side has the same get() interface as MsgQueue. There must
+/// only be one consumer.
+///
+/// Each put and get has one full memory barrier, between publishing its
+/// change to the lane and checking whether the other side is parked. That
+/// is what keeps a wakeup from being lost.
+///
+/// @param T The message type. It must be default-constructible and
+///  		 assignable.
+
+template <typename T>
+class LanedMsgQueue
+{
+public:
+	/// How the consumer picks the next lane
+	enum Policy {
+		ROUND_ROBIN,	///< Take from each busy lane in turn
+		PRIORITY		///< Always take from the lowest-numbered busy lane
+	};
+
+	/// The most queues a thread can use at once with the automatic put(v).
+	/// The slot of a queue that has been destroyed is reclaimed, so this
+	/// limits the live queues a thread puts into, not all of them over
+	/// its lifetime.
+	static const int MAX_THREAD_QUEUES = 16;
+
+private:
+	/// A single-producer, single-consumer ring.
+	struct Lane
+	{
+		volatile size_t	tail;		///< Next slot to fill (producer)
+		size_t			headCache;	///< The producer's copy of the head
+		Parker			parker;		///< Where the producer waits when full
+		char			pad1[64];
+		volatile size_t	head;		///< Next slot to take (consumer)
+		size_t			tailCache;	///< The consumer's copy of the tail
+		char			pad2[64];
+		T*				buf;		///< The ring buffer
+	};
+
+	Lane*			lanes_;		///< The lanes
+	int				id_;		///< Tells this queue from earlier ones at its address
+	int				nLane_;		///< The number of lanes
+	volatile int	nOpen_;		///< The number of lanes claimed
+	size_t			mask_;		///< Lane capacity - 1
+	Policy			policy_;	///< How to pick the next lane
+	int				next_;		///< The next lane to look at (round-robin)
+	Parker			parker_;	///< Where the consumer waits
+	LanedMsgQueue*	prevLive_;	///< The previous queue in the live list
+	LanedMsgQueue*	nextLive_;	///< The next queue in the live list
+
+	static volatile int		nextId_;	///< The id for the next queue
+	static LanedMsgQueue*	live_;		///< The queues that exist
+	static volatile int		liveLock_;	///< Spin lock for the live list
+
+	/// Locks the list of live queues.
+	static void lock_live() {
+		while (!atomic_cas(&liveLock_, 0, 1))
+			cpu_relax();
+	}
+
+	/// Unlocks the list of live queues.
+	static void unlock_live() { atomic_store_release(&liveLock_, 0); }
+
+	/// Determines if a queue still exists. Call with the live list locked.
+	static bool is_live(const LanedMsgQueue* que, int id) {
+		for (LanedMsgQueue* q=live_; q; q=q->nextLive_) {
+			if (q == que)
+				return q->id_ == id;
+		}
+		return false;
+	}
+
+	/// Determines if a lane is full, from the producer side.
+	bool lane_full(Lane& ln) {
+		size_t t = atomic_load_relaxed(&ln.tail);
+		if (t - ln.headCache <= mask_)
+			return false;
+		ln.headCache = atomic_load_acquire(&ln.head);
+		return t - ln.headCache > mask_;
+	}
+
+	/// Takes an item from a lane, if it has one.
+	bool lane_get(Lane& ln, T* p) {
+		size_t h = ln.head;
+		if (h == ln.tailCache) {
+			ln.tailCache = atomic_load_acquire(&ln.tail);
+			if (h == ln.tailCache)
+				return false;
+		}
+		*p = ln.buf[h & mask_];
+		atomic_store_release(&ln.head, h+1);
+		atomic_fence();
+		ln.parker.unpark();
+		return true;
+	}
+
+	/// Determines if any lane has an item, from the consumer side.
+	bool any_ready() const {
+		int n = atomic_load_acquire(&nOpen_);
+		if (n > nLane_)
+			n = nLane_;
+		for (int i=0; i<n; ++i) {
+			if (atomic_load_acquire(&lanes_[i].tail) != lanes_[i].head)
+				return true;
+		}
+		return false;
+	}
+
+	/// Gets the lane that the calling thread has claimed in this queue,
+	/// claiming one if needed.
+	int thread_lane();
+
+	// Non-copyable
+	LanedMsgQueue(const LanedMsgQueue&);
+	LanedMsgQueue& operator=(const LanedMsgQueue&);
+
+public:
+	/**
+	 * Creates a queue.
+	 * @param nLane The number of lanes. This is the most producer threads
+	 *  			that can use the queue.
+	 * @param laneCap The capacity of each lane. This is rounded up to a
+	 *  			  power of two.
+	 * @param policy How the consumer picks the next lane.
+	 */
+	LanedMsgQueue(int nLane, size_t laneCap, Policy policy=ROUND_ROBIN);
+	/**
+	 * Destroys the queue, discarding any messages.
+	 */
+	~LanedMsgQueue();
+	/**
+	 * Gets the number of lanes.
+	 * @return The number of lanes.
+	 */
+	int num_lanes() const { return nLane_; }
+	/**
+	 * Gets the capacity of each lane.
+	 * @return The capacity of each lane.
+	 */
+	size_t lane_capacity() const { return mask_ + 1; }
+	/**
+	 * Claims a lane for a producer.
+	 * @return The lane number, or @em -1 if all the lanes are taken.
+	 */
+	int open_lane();
+	/**
+	 * Gets the number of messages waiting, across all the lanes.
+	 * Producers are always adding, so this is only a snapshot.
+	 * @return The number of messages waiting.
+	 */
+	size_t size() const;
+	/**
+	 * Determines if the queue is empty.
+	 * @return @em true if there's nothing in any of the lanes.
+	 */
+	bool empty() const { return !any_ready(); }
+
+	/**
+	 * Places an item into a lane, waiting while the lane is full.
+	 * Only the producer that claimed the lane may put into it.
+	 * @param lane The producer's lane.
+	 * @param v The item.
+	 */
+	void put(int lane, const T& v);
+	/**
+	 * Places an item into a lane, waiting a bounded time while the lane
+	 * is full.
+	 * @param lane The producer's lane.
+	 * @param v The item.
+	 * @param d The longest time to wait.
+	 * @return @em true if the item was placed, @em false on a timeout.
+	 */
+	bool put(int lane, const T& v, const Duration& d);
+	/**
+	 * Places an item into a lane, if it isn't full.
+	 * @param lane The producer's lane.
+	 * @param v The item.
+	 * @return @em true if the item was placed, @em false if the lane was
+	 *  	   full.
+	 */
+	bool tryput(int lane, const T& v);
+	/**
+	 * Places an item into the calling thread's lane, waiting while it's
+	 * full. The first call from a thread claims a lane for it.
+	 * @param v The item.
+	 * @return @em true if the item was placed, @em false if there was no
+	 *  	   lane for the thread.
+	 */
+	bool put(const T& v) {
+		int lane = thread_lane();
+		if (lane < 0)
+			return false;
+		put(lane, v);
+		return true;
+	}
+	/**
+	 * Places an item into the calling thread's lane, if it isn't full.
+	 * @param v The item.
+	 * @return @em true if the item was placed.
+	 */
+	bool tryput(const T& v) {
+		int lane = thread_lane();
+		return lane >= 0 && tryput(lane, v);
+	}
+
+	/**
+	 * Takes the next item, waiting while all the lanes are empty.
+	 * @param p Gets the item.
+	 */
+	void get(T* p);
+	/**
+	 * Takes the next item, waiting a bounded time while all the lanes are
+	 * empty.
+	 * @param p Gets the item.
+	 * @param d The longest time to wait.
+	 * @return @em true if an item was taken, @em false on a timeout.
+	 */
+	bool get(T* p, const Duration& d);
+	/**
+	 * Takes the next item, if there is one.
+	 * @param p Gets the item.
+	 * @return @em true if an item was taken, @em false if all the lanes
+	 *  	   were empty.
+	 */
+	bool tryget(T* p);
+};
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+LanedMsgQueue<T>::LanedMsgQueue(int nLane, size_t laneCap, Policy policy)
+					: id_(atomic_fetch_add(&nextId_, 1) + 1), nLane_(nLane),
+						nOpen_(0), policy_(policy), next_(0)
+{
+	size_t cap = 2;
+	while (cap < laneCap)
+		cap <<= 1;
+	mask_ = cap - 1;
+
+	lanes_ = new Lane[nLane_];
+	for (int i=0; i<nLane_; ++i) {
+		Lane& ln = lanes_[i];
+		ln.tail = ln.headCache = ln.head = ln.tailCache = 0;
+		ln.buf = new T[cap];
+	}
+
+	lock_live();
+	prevLive_ = 0;
+	nextLive_ = live_;
+	if (live_)
+		live_->prevLive_ = this;
+	live_ = this;
+	unlock_live();
+}
+
+template <typename T>
+LanedMsgQueue<T>::~LanedMsgQueue()
+{
+	lock_live();
+	if (prevLive_)
+		prevLive_->nextLive_ = nextLive_;
+	else
+		live_ = nextLive_;
+	if (nextLive_)
+		nextLive_->prevLive_ = prevLive_;
+	id_ = 0;
+	unlock_live();
+
+	for (int i=0; i<nLane_; ++i)
+		delete[] lanes_[i].buf;
+	delete[] lanes_;
+}
+
+// The live list and its lock are constant-initialized, so they're ready for
+// queues that are created during static initialization.
+
+template <typename T>
+volatile int LanedMsgQueue<T>::nextId_ = 0;
+
+template <typename T>
+LanedMsgQueue<T>* LanedMsgQueue<T>::live_ = 0;
+
+template <typename T>
+volatile int LanedMsgQueue<T>::liveLock_ = 0;
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+int LanedMsgQueue<T>::open_lane()
+{
+	int lane = atomic_fetch_add(&nOpen_, 1);
+	if (lane < nLane_)
+		return lane;
+
+	atomic_fetch_add(&nOpen_, -1);
+	return -1;
+}
+
+// --------------------------------------------------------------------------
+// Each thread keeps a small table of the queues it has put into, and the
+// lane it claimed in each. A queue can be created at the address of one
+// that was destroyed, so an entry only belongs to this queue if the id
+// matches as well. One left over from an earlier queue at this address is
+// stale, and its slot is reused.
+// Entries for queues destroyed at other addresses are only found when the
+// table fills up. Then it's swept against the list of live queues, which
+// takes the lock, but only once every MAX_THREAD_QUEUES new queues.
+
+template <typename T>
+int LanedMsgQueue<T>::thread_lane()
+{
+	struct Entry { const LanedMsgQueue* que; int id; int lane; };
+	static __thread Entry tbl[MAX_THREAD_QUEUES];
+
+	for (int swept=0; swept<2; ++swept) {
+		for (int i=0; i<MAX_THREAD_QUEUES; ++i) {
+			if (tbl[i].que == this && tbl[i].id == id_)
+				return tbl[i].lane;
+			if (tbl[i].que == 0 || tbl[i].que == this) {
+				int lane = open_lane();
+				if (lane >= 0) {
+					tbl[i].que = this;
+					tbl[i].id = id_;
+					tbl[i].lane = lane;
+				}
+				return lane;
+			}
+		}
+
+		if (swept)
+			break;
+
+		int n = 0;
+		lock_live();
+		for (int i=0; i<MAX_THREAD_QUEUES; ++i) {
+			if (is_live(tbl[i].que, tbl[i].id))
+				tbl[n++] = tbl[i];
+		}
+		unlock_live();
+
+		for (int i=n; i<MAX_THREAD_QUEUES; ++i)
+			tbl[i].que = 0;
+	}
+	return -1;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+size_t LanedMsgQueue<T>::size() const
+{
+	size_t n = 0;
+	int nOpen = atomic_load_acquire(&nOpen_);
+	if (nOpen > nLane_)
+		nOpen = nLane_;
+
+	for (int i=0; i<nOpen; ++i)
+		n += atomic_load_acquire(&lanes_[i].tail) - atomic_load_acquire(&lanes_[i].head);
+	return n;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool LanedMsgQueue<T>::tryput(int lane, const T& v)
+{
+	assert(lane >= 0 && lane < nLane_);
+	Lane& ln = lanes_[lane];
+
+	if (lane_full(ln))
+		return false;
+
+	size_t t = ln.tail;
+	ln.buf[t & mask_] = v;
+	atomic_store_release(&ln.tail, t+1);
+	atomic_fence();
+	parker_.unpark();
+	return true;
+}
+
+template <typename T>
+void LanedMsgQueue<T>::put(int lane, const T& v)
+{
+	Lane& ln = lanes_[lane];
+
+	while (!tryput(lane, v)) {
+		ln.parker.prepare();
+		if (!lane_full(ln))
+			ln.parker.cancel();
+		else
+			ln.parker.park();
+	}
+}
+
+template <typename T>
+bool LanedMsgQueue<T>::put(int lane, const T& v, const Duration& d)
+{
+	if (tryput(lane, v))
+		return true;
+
+	Lane& ln = lanes_[lane];
+	MonotonicTime until = MonotonicTime::now() + d;
+
+	for (;;) {
+		ln.parker.prepare();
+		if (!lane_full(ln))
+			ln.parker.cancel();
+		else {
+			Duration rem = until - MonotonicTime::now();
+			if (rem.to_nsec() <= 0 || !ln.parker.park(rem)) {
+				ln.parker.cancel();
+				return tryput(lane, v);
+			}
+		}
+		if (tryput(lane, v))
+			return true;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool LanedMsgQueue<T>::tryget(T* p)
+{
+	int n = atomic_load_acquire(&nOpen_);
+	if (n > nLane_)
+		n = nLane_;
+
+	if (policy_ == PRIORITY) {
+		for (int i=0; i<n; ++i) {
+			if (lane_get(lanes_[i], p))
+				return true;
+		}
+		return false;
+	}
+
+	for (int k=0; k<n; ++k) {
+		int i = next_;
+		if (++next_ >= n)
+			next_ = 0;
+		if (lane_get(lanes_[i], p))
+			return true;
+	}
+	return false;
+}
+
+template <typename T>
+void LanedMsgQueue<T>::get(T* p)
+{
+	while (!tryget(p)) {
+		parker_.prepare();
+		if (any_ready())
+			parker_.cancel();
+		else
+			parker_.park();
+	}
+}
+
+template <typename T>
+bool LanedMsgQueue<T>::get(T* p, const Duration& d)
+{
+	if (tryget(p))
+		return true;
+
+	MonotonicTime until = MonotonicTime::now() + d;
+
+	for (;;) {
+		parker_.prepare();
+		if (any_ready())
+			parker_.cancel();
+		else {
+			Duration rem = until - MonotonicTime::now();
+			if (rem.to_nsec() <= 0 || !parker_.park(rem)) {
+				parker_.cancel();
+				return tryget(p);
+			}
+		}
+		if (tryget(p))
+			return true;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_LanedMsgQueue_h
+
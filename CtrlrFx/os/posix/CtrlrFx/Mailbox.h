@@ -0,0 +1,282 @@
+/// @file Mailbox.h
+/// Definition of the @ref Mailbox class.
+
+#ifndef __CtrlrFx_Mailbox_h
+#define __CtrlrFx_Mailbox_h
+
+#include "CtrlrFx/MpscQueue.h"
+#include "CtrlrFx/Parker.h"
+#include "CtrlrFx/Time.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A many-to-one message queue that never blocks the senders.
+///
+/// Messages are copied into nodes that are linked into an @ref MpscQueue,
+/// so a put never takes a lock and never waits on another producer or on
+/// the receiver. The nodes come from a pool that's allocated when the
+/// mailbox is created. The pool's free list is a lock-free stack, with a
+/// tag on its head to guard against ABA. If the pool runs dry, nodes are
+/// allocated from the heap, so the mailbox is unbounded. The pool should
+/// be sized for the normal backlog so that the heap is only hit in
+/// bursts; @ref num_overflow() tells how often that has happened.
+///
+/// There must only be one receiver. It spins through the queue while
+/// there are messages, and only parks (on a futex, under Linux) when the
+/// mailbox is empty. Senders only make a system call to wake it when it
+/// is actually parked.
+///
+/// This has the same put/get interface as MsgQueue, so it can be used as
+/// the queue for a @ref QueueThread:
+/// @code
+/// class Worker : public QueueThread<Cmd, Mailbox<Cmd> > { ... };
+/// @endcode
+///
+/// @param T The message type. It must be default-constructible and
+///  		 assignable.
+
+template <typename T>
+class Mailbox
+{
+	/// A node carrying a message.
+	struct Node : public MpscNode
+	{
+		T					val;		///< The message
+		volatile uint32_t	nextFree;	///< Next in the free list (index+1)
+	};
+
+	MpscQueue			que_;		///< The messages
+	Parker				parker_;	///< Where the receiver sleeps
+	Node*				pool_;		///< The node pool
+	size_t				poolSize_;	///< The number of nodes in the pool
+	volatile uint64_t	free_;		///< Free list head: tag<<32 | (index+1)
+	volatile size_t		nOverflow_;	///< Nodes taken from the heap
+
+	/// Gets a node, from the pool if possible.
+	Node* alloc();
+	/// Returns a node to the pool (or the heap).
+	void free(Node* node);
+
+	// Non-copyable
+	Mailbox(const Mailbox&);
+	Mailbox& operator=(const Mailbox&);
+
+public:
+	/**
+	 * Creates an empty mailbox.
+	 * @param poolSize The number of nodes to allocate up front. This is
+	 *  			   the number of messages that can be waiting before
+	 *  			   the mailbox has to go to the heap.
+	 */
+	explicit Mailbox(size_t poolSize);
+	/**
+	 * Destroys the mailbox, discarding any waiting messages.
+	 */
+	~Mailbox();
+	/**
+	 * Gets the number of nodes in the pool.
+	 * @return The number of nodes in the pool.
+	 */
+	size_t capacity() const { return poolSize_; }
+	/**
+	 * Gets the number of times that the pool ran out and a node was
+	 * allocated from the heap.
+	 * @return The number of heap allocations.
+	 */
+	size_t num_overflow() const { return nOverflow_; }
+	/**
+	 * Determines if the mailbox is empty.
+	 * This is only meaningful to the receiver.
+	 * @return @em true if the mailbox is empty.
+	 */
+	bool empty() const { return que_.empty(); }
+	/**
+	 * Sends a message.
+	 * This never blocks, and can be called from any thread.
+	 * @param v The message.
+	 * @return @em true. (The return is for compatibility with MsgQueue.)
+	 */
+	bool put(const T& v);
+	/**
+	 * Sends a message.
+	 * This is the same as put(v). The mailbox is never full, so it never
+	 * needs to wait.
+	 */
+	bool put(const T& v, const Duration&) { return put(v); }
+	/**
+	 * Sends a message.
+	 * This is the same as put(v).
+	 */
+	bool tryput(const T& v) { return put(v); }
+	/**
+	 * Receives a message, waiting for one if the mailbox is empty.
+	 * This must only be called from the receiving thread.
+	 * @param p Gets the message.
+	 */
+	void get(T* p);
+	/**
+	 * Receives a message, waiting a bounded time for one if the mailbox
+	 * is empty.
+	 * This must only be called from the receiving thread.
+	 * @param p Gets the message.
+	 * @param d The longest time to wait.
+	 * @return @em true if a message was received, @em false on a timeout.
+	 */
+	bool get(T* p, const Duration& d);
+	/**
+	 * Receives a message if there is one, without waiting.
+	 * This must only be called from the receiving thread.
+	 * @param p Gets the message.
+	 * @return @em true if a message was received, @em false if the
+	 *  	   mailbox was empty.
+	 */
+	bool tryget(T* p);
+};
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+Mailbox<T>::Mailbox(size_t poolSize)
+				: pool_(0), poolSize_(poolSize), free_(0), nOverflow_(0)
+{
+	if (poolSize_ > 0) {
+		pool_ = new Node[poolSize_];
+		for (size_t i=0; i<poolSize_; ++i)
+			pool_[i].nextFree = uint32_t(i+2);
+		pool_[poolSize_-1].nextFree = 0;
+		free_ = 1;
+	}
+}
+
+template <typename T>
+Mailbox<T>::~Mailbox()
+{
+	T v;
+	while (tryget(&v))
+		;
+	delete[] pool_;
+}
+
+// --------------------------------------------------------------------------
+// Reading the next link of a node that another thread has just taken is
+// harmless: the tag will have changed, so the CAS fails and we retry.
+
+template <typename T>
+typename Mailbox<T>::Node* Mailbox<T>::alloc()
+{
+	uint64_t top = atomic_load_acquire(&free_);
+
+	for (;;) {
+		uint32_t idx = uint32_t(top);
+		if (idx == 0) {
+			atomic_fetch_add(&nOverflow_, size_t(1));
+			return new Node;
+		}
+
+		Node* node = &pool_[idx-1];
+		uint64_t next = ((top >> 32) + 1) << 32
+							| atomic_load_relaxed(&node->nextFree);
+
+		if (atomic_cas(&free_, top, next))
+			return node;
+
+		top = atomic_load_acquire(&free_);
+	}
+}
+
+template <typename T>
+void Mailbox<T>::free(Node* node)
+{
+	if (node < pool_ || node >= pool_ + poolSize_) {
+		delete node;
+		return;
+	}
+
+	uint64_t idx = uint64_t(node - pool_) + 1,
+			 top = atomic_load_acquire(&free_);
+
+	for (;;) {
+		atomic_store_relaxed(&node->nextFree, uint32_t(top));
+		uint64_t next = ((top >> 32) + 1) << 32 | idx;
+
+		if (atomic_cas(&free_, top, next))
+			break;
+
+		top = atomic_load_acquire(&free_);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool Mailbox<T>::put(const T& v)
+{
+	Node* node = alloc();
+	node->val = v;
+	que_.push(node);
+	parker_.unpark();
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool Mailbox<T>::tryget(T* p)
+{
+	Node* node = static_cast<Node*>(que_.pop());
+	if (!node)
+		return false;
+
+	*p = node->val;
+	free(node);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+void Mailbox<T>::get(T* p)
+{
+	while (!tryget(p)) {
+		parker_.prepare();
+		if (!que_.empty())
+			parker_.cancel();
+		else
+			parker_.park();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool Mailbox<T>::get(T* p, const Duration& d)
+{
+	if (tryget(p))
+		return true;
+
+	MonotonicTime until = MonotonicTime::now() + d;
+
+	for (;;) {
+		parker_.prepare();
+		if (!que_.empty())
+			parker_.cancel();
+		else {
+			Duration rem = until - MonotonicTime::now();
+			if (rem.to_nsec() <= 0 || !parker_.park(rem)) {
+				parker_.cancel();
+				return tryget(p);
+			}
+		}
+		if (tryget(p))
+			return true;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_Mailbox_h
+
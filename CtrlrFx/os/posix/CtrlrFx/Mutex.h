@@ -13,6 +13,7 @@
 #define __CtrlrFx_Mutex_h
 
 #include <pthread.h>
+#include <unistd.h>
 #include <errno.h>
 #include <assert.h>
 
@@ -23,18 +24,47 @@ namespace CtrlrFx {
 /**
  * A mutually exclusive thread synchronization object.
  * This wraps an underlying OS mutex object.
+ *
+ * The locking policy can be chosen when the mutex is created, by passing a
+ * combination of the policy flags to the constructor. Containers that take
+ * the lock as a template parameter can use one of the @ref MutexTmpl
+ * typedefs, like @ref AdaptiveMutex or @ref PrioInheritMutex, to select a
+ * policy at compile time.
  */
 class Mutex
 {
 	pthread_mutex_t mutex_;		///< Handle to the OS Mutex
 	bool			own_;		///< Whether we own the OS handle
 	int				err_;		///< The last error encountered
+	int				spin_;		///< # tries before blocking (adaptive)
+
+	/// Creates the OS mutex with the requested policy.
+	void create(int flags);
+
+	/// Spins on the mutex, trying to acquire it without blocking.
+	bool spin_lock();
 
 public:
+	/// Locking policy flags.
+	enum {
+		DEFAULT			= 0x00,	///< The OS default mutex
+		ADAPTIVE		= 0x01,	///< Spin briefly before blocking on contention
+		PRIO_INHERIT	= 0x02	///< Owner inherits the priority of waiters
+	};
+
+	/// The number of times an adaptive mutex tries the lock before blocking,
+	/// when the OS doesn't provide an adaptive mutex type.
+	static const int DFLT_SPIN_COUNT = 100;
+
 	/// Construct a mutex.
 	/// This creates a new mutex in the OS.
 	Mutex();
 
+	/// Construct a mutex with the specified locking policy.
+	/// @param flags A bitwise combination of the policy flags, like
+	///              @em ADAPTIVE and @em PRIO_INHERIT.
+	explicit Mutex(int flags);
+
 	/// Constructs a mutex wrapper around the specified OS mutex handle.
 	/// If we're given ownership of the handle, the OS mutex will be destroyed
 	/// when this wrapper is destroyed.
@@ -71,7 +101,10 @@ public:
 	/// Locks the mutex.
 	/// If another thread hold the mutex, this will block the calling thread
 	/// until it gets possesion of the mutex.
-	void lock() { ::pthread_mutex_lock(&mutex_); }
+	void lock() {
+		if (spin_ == 0 || !spin_lock())
+			::pthread_mutex_lock(&mutex_);
+	}
 
 	/// Attempts to lock the mutex without blocking.
 	/// If another thread holds the mutex this call will fail.
@@ -101,25 +134,76 @@ public:
 
 // --------------------------------------------------------------------------
 
-inline Mutex::Mutex() : own_(true), err_(0)
+inline Mutex::Mutex() : own_(true), err_(0), spin_(0)
 {
 	if (::pthread_mutex_init(&mutex_, NULL) < 0)
 		err_ = errno;
 	assert(err_ == 0);
 }
 
+inline Mutex::Mutex(int flags) : own_(true), err_(0), spin_(0)
+{
+	create(flags);
+	assert(err_ == 0);
+}
+
 // --------------------------------------------------------------------------
 
 inline Mutex::Mutex(const pthread_mutex_t& h, bool own /*=false*/) 
-			: mutex_(h), own_(own), err_(0)
+			: mutex_(h), own_(own), err_(0), spin_(0)
 {
 }
 
 // --------------------------------------------------------------------------
 
 inline Mutex::Mutex(Mutex& m)
-			: mutex_(m.handle()), own_(false), err_(m.error())
+			: mutex_(m.handle()), own_(false), err_(m.error()), spin_(m.spin_)
+{
+}
+
+// --------------------------------------------------------------------------
+// Creates the OS mutex with the attributes for the requested policy. If the
+// OS has an adaptive mutex type we use it, otherwise we fall back to 
+// spinning on trylock() for a while before blocking.
+
+inline void Mutex::create(int flags)
 {
+	pthread_mutexattr_t attr;
+
+	if ((err_ = ::pthread_mutexattr_init(&attr)) != 0)
+		return;
+
+	if (flags & ADAPTIVE) {
+		#if defined(PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP)
+			err_ = ::pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+		#else
+			spin_ = DFLT_SPIN_COUNT;
+		#endif
+	}
+
+	if (err_ == 0 && (flags & PRIO_INHERIT)) {
+		#if defined(_POSIX_THREAD_PRIO_INHERIT) && _POSIX_THREAD_PRIO_INHERIT > 0
+			err_ = ::pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+		#else
+			err_ = ENOTSUP;
+		#endif
+	}
+
+	if (err_ == 0)
+		err_ = ::pthread_mutex_init(&mutex_, &attr);
+
+	::pthread_mutexattr_destroy(&attr);
+}
+
+// --------------------------------------------------------------------------
+
+inline bool Mutex::spin_lock()
+{
+	for (int i=0; i<spin_; ++i) {
+		if (::pthread_mutex_trylock(&mutex_) == 0)
+			return true;
+	}
+	return false;
 }
 
 // --------------------------------------------------------------------------
@@ -132,6 +216,32 @@ inline Mutex::~Mutex()
 
 /////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A mutex with a locking policy that is fixed at compile time.
+ * This allows the policy to be selected by containers and other classes
+ * that take their lock type as a template parameter, and default-construct
+ * it, such as @ref MsgQueue<T, LockType>.
+ * @param FLAGS A bitwise combination of the @ref Mutex policy flags.
+ */
+template <int FLAGS>
+class MutexTmpl : public Mutex
+{
+public:
+	/// Creates the mutex with the template's locking policy.
+	MutexTmpl() : Mutex(FLAGS) {}
+};
+
+/// A mutex that spins briefly on contention before putting the caller to
+/// sleep. Good for locks that are only held for very short periods.
+typedef MutexTmpl<Mutex::ADAPTIVE> AdaptiveMutex;
+
+/// A mutex that uses priority inheritance to prevent priority inversion
+/// when it is shared between high and low priority threads.
+typedef MutexTmpl<Mutex::PRIO_INHERIT> PrioInheritMutex;
+
+/// An adaptive mutex that also uses priority inheritance.
+typedef MutexTmpl<Mutex::ADAPTIVE | Mutex::PRIO_INHERIT> AdaptivePrioInheritMutex;
+
 typedef Mutex FastMutex;
 
 /////////////////////////////////////////////////////////////////////////////
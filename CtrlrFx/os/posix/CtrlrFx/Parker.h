@@ -0,0 +1,96 @@
+/// @file Parker.h
+/// Definition of the @ref Parker class.
+
+#ifndef __CtrlrFx_Parker_h
+#define __CtrlrFx_Parker_h
+
+#include "CtrlrFx/AtomicOps.h"
+#include "CtrlrFx/Time.h"
+
+#if !defined(__linux__)
+	#include "CtrlrFx/Semaphore.h"
+#endif
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A way for a single consumer thread to sleep until a producer has work
+/// for it, without either side taking a lock.
+///
+/// The consumer calls @ref prepare() to announce that it's about to
+/// sleep, then checks once more for work. If there is some, it calls
+/// @ref cancel(), otherwise it calls @ref park(). A producer makes its
+/// work visible first, then calls @ref unpark(). The full barrier in
+/// prepare() means that either the consumer sees the work, or the
+/// producer sees that the consumer is going to sleep, so no wakeup is
+/// lost.
+///
+/// While the consumer is running, unpark() is a single load, so producers
+/// don't pay for the wakeup unless the consumer actually sleeps.
+///
+/// On Linux, the consumer sleeps on a futex. Elsewhere, it uses a
+/// semaphore.
+
+class Parker
+{
+	volatile int	state_;		///< Non-zero while the consumer is parking
+	#if !defined(__linux__)
+		Semaphore	sem_;		///< What the consumer sleeps on
+	#endif
+
+	/// Wakes the consumer.
+	void wake();
+
+	// Non-copyable
+	Parker(const Parker&);
+	Parker& operator=(const Parker&);
+
+public:
+	/**
+	 * Creates a parker with the consumer running.
+	 */
+	Parker() : state_(0) {}
+	/**
+	 * Announces that the consumer is about to park.
+	 * This is called by the consumer before it checks for work one last
+	 * time.
+	 */
+	void prepare() {
+		atomic_store_relaxed(&state_, 1);
+		atomic_fence();
+	}
+	/**
+	 * Cancels a park, when the consumer found work after calling
+	 * @ref prepare().
+	 */
+	void cancel() { atomic_store_relaxed(&state_, 0); }
+	/**
+	 * Puts the consumer to sleep until a producer calls @ref unpark().
+	 * This must follow a call to @ref prepare(). It might return early,
+	 * so the consumer must check for work again.
+	 */
+	void park();
+	/**
+	 * Puts the consumer to sleep until a producer calls @ref unpark(), or
+	 * a timeout expires.
+	 * @param d The longest time to sleep.
+	 * @return @em false if the time expired, @em true otherwise.
+	 */
+	bool park(const Duration& d);
+	/**
+	 * Wakes the consumer, if it's parked or about to park.
+	 * This can be called from any thread.
+	 */
+	void unpark() {
+		if (atomic_load_acquire(&state_) != 0 && atomic_exchange(&state_, 0) != 0)
+			wake();
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_Parker_h
+
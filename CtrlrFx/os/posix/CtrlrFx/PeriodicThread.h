@@ -0,0 +1,186 @@
+/// @file PeriodicThread.h
+/// Definition of the @ref PeriodicThread class.
+
+#ifndef __CtrlrFx_PeriodicThread_h
+#define __CtrlrFx_PeriodicThread_h
+
+#include "CtrlrFx/Thread.h"
+#include "CtrlrFx/Mutex.h"
+#include "CtrlrFx/Guard.h"
+#include "CtrlrFx/Time.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+//								CycleStats
+/////////////////////////////////////////////////////////////////////////////
+
+/// Running statistics for a per-cycle timing measurement.
+/// This keeps the min, max, and average of a set of samples, in
+/// nanoseconds, along with a histogram of the samples. The histogram bins
+/// are logarithmic: bin @em n holds the samples in the range
+/// [2^n, 2^(n+1)) nsec, with bin zero also holding samples of zero (or
+/// less), and the last bin holding everything that is too large for the
+/// others.
+
+struct CycleStats
+{
+	/// The number of bins in the histogram.
+	static const int N_BINS = 32;
+
+	uint64_t	count;			///< The number of samples
+	nsec_t		min,			///< The smallest sample
+				max,			///< The largest sample
+				total;			///< The sum of all the samples
+	uint32_t	hist[N_BINS];	///< The histogram of the samples
+
+	CycleStats() { clear(); }
+
+	/// Resets the statistics.
+	void clear();
+	/// Adds a sample, in nanoseconds.
+	void add(nsec_t ns);
+	/// Gets the average of the samples, in nanoseconds.
+	nsec_t avg() const { return count ? nsec_t(total / nsec_t(count)) : 0; }
+	/// Gets the histogram bin into which a value would be placed.
+	static int bin(nsec_t ns);
+	/// Gets the smallest value that would be placed into the specified bin.
+	static nsec_t bin_floor(int n) { return (n == 0) ? 0 : (nsec_t(1) << n); }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								PeriodicThread
+/////////////////////////////////////////////////////////////////////////////
+
+/// A thread that runs a function at a fixed period.
+/// The derived class implements the @ref cycle() function, which is called
+/// once per period. The release times are computed as absolute times on
+/// the monotonic clock, so they don't drift with the time it takes for
+/// each cycle to run, and aren't affected by changes to the wall clock.
+///
+/// For each cycle the thread measures the wakeup latency (the time from
+/// the scheduled release until the thread actually starts running), and
+/// the execution time of @ref cycle(). These are kept as @ref CycleStats,
+/// which can be read from another thread at any time.
+///
+/// A cycle that runs past the next release time is an overrun. Overruns
+/// are counted, and are then handled according to the @ref OverrunPolicy.
+///
+/// On Linux the thread can optionally be run under the SCHED_DEADLINE
+/// scheduling class, which gives it a CPU reservation of a certain runtime
+/// in each period, rather than a fixed priority.
+
+class PeriodicThread : public Thread
+{
+public:
+	/// What to do when a cycle runs past one or more release times.
+	enum OverrunPolicy {
+		SKIP,		///< Drop the missed cycles and stay on the original time grid
+		CATCH_UP,	///< Run the missed cycles back-to-back, as soon as possible
+		CALLBACK	///< Let @ref on_overrun() decide, per overrun
+	};
+
+	/// A snapshot of the timing statistics.
+	struct Stats
+	{
+		uint64_t	cycles;		///< The number of cycles run
+		uint64_t	overruns;	///< The number of overruns
+		uint64_t	missed;		///< The number of release times missed
+		CycleStats	latency;	///< Wakeup latency
+		CycleStats	exec;		///< Execution time of cycle()
+
+		Stats() : cycles(0), overruns(0), missed(0) {}
+	};
+
+private:
+	typedef Guard<PrioInheritMutex> MyGuard;
+
+	Duration			period_;		///< The cycle period
+	OverrunPolicy		policy_;		///< How overruns are handled
+	Duration			dlRuntime_,		///< SCHED_DEADLINE runtime (zero if not used)
+						dlDeadline_;	///< SCHED_DEADLINE relative deadline
+	Stats				stats_;			///< The timing statistics
+	mutable PrioInheritMutex lock_;		///< Protects the statistics
+
+	/// Puts the calling thread under the SCHED_DEADLINE policy.
+	bool set_deadline_sched();
+
+	/// The thread function. This runs the periodic loop.
+	virtual int run();
+
+protected:
+	/**
+	 * The periodic function.
+	 * Derived classes implement this to do the periodic work of the
+	 * thread. It is called once per period, from the thread's context.
+	 */
+	virtual void cycle() =0;
+	/**
+	 * Called when a cycle overruns and the policy is @em CALLBACK.
+	 * The default implementation skips the missed cycles.
+	 * @param nMissed The number of release times that were missed.
+	 * @return @em true to run the missed cycles back-to-back to catch up,
+	 *  	   @em false to skip them.
+	 */
+	virtual bool on_overrun(unsigned nMissed) { return false; }
+
+public:
+	/**
+	 * Creates a periodic thread.
+	 * The thread is not started until @ref activate() is called.
+	 * @param period The cycle period.
+	 * @param prio The thread's priority.
+	 * @param stackSize The size of the thread's stack, in bytes, or zero
+	 *  			  for the OS default.
+	 * @param name The name of the thread.
+	 */
+	PeriodicThread(const Duration& period, int prio,
+				   unsigned stackSize=0, const char *name=0);
+	/**
+	 * Gets the cycle period.
+	 * @return The cycle period.
+	 */
+	Duration period() const { return period_; }
+	/**
+	 * Sets the policy for handling overruns.
+	 * @param policy The policy for handling overruns.
+	 */
+	void overrun_policy(OverrunPolicy policy) { policy_ = policy; }
+	/**
+	 * Gets the policy for handling overruns.
+	 * @return The policy for handling overruns.
+	 */
+	OverrunPolicy overrun_policy() const { return policy_; }
+	/**
+	 * Requests that the thread be run under the SCHED_DEADLINE policy.
+	 * This must be called before the thread is activated. The thread is
+	 * given @em runtime of CPU time in every period, which must be
+	 * completed within @em deadline of the release time. If the policy
+	 * can't be set (it's not supported by the OS, or the caller doesn't
+	 * have the privileges, or the kernel's admission control rejects it),
+	 * the thread quietly runs at its fixed priority instead.
+	 * @param runtime The worst-case execution time of a cycle.
+	 * @param deadline The relative deadline. If zero, the period is used.
+	 */
+	void deadline_sched(const Duration& runtime,
+						const Duration& deadline=Duration()) {
+		dlRuntime_ = runtime;
+		dlDeadline_ = deadline;
+	}
+	/**
+	 * Gets a snapshot of the timing statistics.
+	 * @return The timing statistics.
+	 */
+	Stats stats() const;
+	/**
+	 * Clears the timing statistics.
+	 */
+	void reset_stats();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_PeriodicThread_h
+
@@ -0,0 +1,84 @@
+/// @file PollSignal.h
+/// Definition of the @ref PollSignal class.
+
+#ifndef __CtrlrFx_PollSignal_h
+#define __CtrlrFx_PollSignal_h
+
+#include "CtrlrFx/Time.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A signal that can be waited on with poll(), select() or epoll.
+///
+/// The signal is a file descriptor that is readable while the signal is
+/// set. Under Linux it's an eventfd; elsewhere it's the read end of a
+/// pipe. Setting a signal that is already set does nothing, so a burst of
+/// sets causes only one wakeup.
+///
+/// The object doesn't keep track of whether it's set; the owner does that
+/// under its own lock, and only calls @ref set() and @ref clear() on the
+/// transitions.
+
+class PollSignal
+{
+	int		fd_[2];		///< The descriptors (both the same for an eventfd)
+	int		err_;		///< The last error
+
+	// Non-copyable
+	PollSignal(const PollSignal&);
+	PollSignal& operator=(const PollSignal&);
+
+public:
+	/**
+	 * Creates a signal that is cleared.
+	 */
+	PollSignal();
+	/**
+	 * Closes the signal.
+	 */
+	~PollSignal();
+	/**
+	 * Determines if the signal was created successfully.
+	 * @return @em true if the signal is usable.
+	 */
+	bool is_valid() const { return fd_[0] >= 0; }
+	/**
+	 * Gets the last error.
+	 * @return The last error.
+	 */
+	int error() const { return err_; }
+	/**
+	 * Gets the descriptor to poll for the signal.
+	 * @return The descriptor, which is readable while the signal is set.
+	 */
+	int handle() const { return fd_[0]; }
+	/**
+	 * Sets the signal, making the descriptor readable.
+	 */
+	void set();
+	/**
+	 * Clears the signal.
+	 */
+	void clear();
+	/**
+	 * Waits for the signal to be set.
+	 * @return @em true if the signal is set, @em false on an error.
+	 */
+	bool wait();
+	/**
+	 * Waits a bounded time for the signal to be set.
+	 * @param d The longest time to wait.
+	 * @return @em true if the signal is set, @em false on a timeout or an
+	 *  	   error.
+	 */
+	bool wait(const Duration& d);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_PollSignal_h
+
@@ -0,0 +1,222 @@
+/// @file PollableMsgQueue.h
+/// Definition of the @ref PollableMsgQueue class.
+
+#ifndef __CtrlrFx_PollableMsgQueue_h
+#define __CtrlrFx_PollableMsgQueue_h
+
+#include "CtrlrFx/ConditionVar.h"
+#include "CtrlrFx/Guard.h"
+#include "CtrlrFx/CircQueue.h"
+#include "CtrlrFx/PollSignal.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/// A message queue that can be polled alongside sockets and devices.
+///
+/// This has the same put/get interface as MsgQueue, but the signal that
+/// data is available is a file descriptor (an eventfd under Linux), from
+/// @ref handle(). It's readable whenever the queue has data, so it can be
+/// added to a poll(), select() or epoll set next to TcpSocket and Device
+/// handles. A single I/O thread can then wait on its network traffic and
+/// on commands from the rest of the application at the same time.
+///
+/// The descriptor is only written when the queue goes from empty to
+/// non-empty, and only read when it goes back to empty, so a burst of puts
+/// costs one system call and causes a single wakeup.
+///
+/// A consumer that polls the handle should drain the queue with
+/// @ref tryget() when it becomes readable. Waking to find the queue empty
+/// is possible (another consumer got there first) and harmless.
+///
+/// Producers that find the queue full block on a condition variable, as
+/// with MsgQueue.
+
+template <typename T>
+class PollableMsgQueue
+{
+	typedef Guard<ConditionVar> MyGuard;
+
+	ConditionVar	cond_;		///< Protects the queue; signals free slots
+	CircQueue<T>	que_;		///< The items
+	PollSignal		sig_;		///< Readable while there are items
+	bool			set_;		///< Whether the signal is set
+	unsigned		nwait_;		///< The number of producers waiting
+
+	/// Puts an item. The caller must hold the lock, and the queue must
+	/// have room.
+	void do_put(const T& v) {
+		que_.put(v);
+		if (!set_) {
+			set_ = true;
+			sig_.set();
+		}
+	}
+
+	/// Gets an item. The caller must hold the lock.
+	/// Each item taken frees a slot for one waiting producer, so any that
+	/// are waiting get signalled, not just on the first get from a full
+	/// queue.
+	bool do_get(T* p) {
+		if (!que_.get(p))
+			return false;
+		if (que_.empty() && set_) {
+			set_ = false;
+			sig_.clear();
+		}
+		if (nwait_ > 0)
+			cond_.signal();
+		return true;
+	}
+
+	// Non-copyable
+	PollableMsgQueue(const PollableMsgQueue&);
+	PollableMsgQueue& operator=(const PollableMsgQueue&);
+
+public:
+	/**
+	 * Creates a queue.
+	 * @param cap The maximum number of items that the queue can hold.
+	 */
+	explicit PollableMsgQueue(size_t cap)
+				: que_(cap+1), set_(false), nwait_(0) {}
+	/**
+	 * Determines if the queue was created successfully.
+	 * @return @em true if the signal descriptor was created.
+	 */
+	bool is_valid() const { return sig_.is_valid(); }
+	/**
+	 * Gets the descriptor that is readable while the queue has data.
+	 * @return The descriptor.
+	 */
+	int handle() const { return sig_.handle(); }
+	/**
+	 * Gets the maximum number of items the queue can hold.
+	 * @return The maximum number of items the queue can hold.
+	 */
+	size_t capacity() const { return que_.capacity() - 1; }
+	/**
+	 * Gets the number of items in the queue.
+	 * @return The number of items in the queue.
+	 */
+	size_t size() const {
+		MyGuard g(const_cast<ConditionVar&>(cond_));
+		return que_.size();
+	}
+	/**
+	 * Determines if the queue is empty.
+	 * @return @em true if the queue is empty.
+	 */
+	bool empty() const { return size() == 0; }
+	/**
+	 * Places an item into the queue, waiting while the queue is full.
+	 * @param v The item.
+	 */
+	void put(const T& v) {
+		MyGuard g(cond_);
+		while (que_.full()) {
+			++nwait_;
+			cond_.wait();
+			--nwait_;
+		}
+		do_put(v);
+	}
+	/**
+	 * Places an item into the queue, waiting a bounded time while the
+	 * queue is full.
+	 * @param v The item.
+	 * @param d The longest time to wait.
+	 * @return @em true if the item was placed, @em false on a timeout.
+	 */
+	bool put(const T& v, const Duration& d);
+	/**
+	 * Places an item into the queue if it isn't full.
+	 * @param v The item.
+	 * @return @em true if the item was placed, @em false if the queue was
+	 *  	   full.
+	 */
+	bool tryput(const T& v) {
+		MyGuard g(cond_);
+		if (que_.full())
+			return false;
+		do_put(v);
+		return true;
+	}
+	/**
+	 * Takes an item from the queue, waiting while it's empty.
+	 * @param p Gets the item.
+	 */
+	void get(T* p) {
+		while (!tryget(p))
+			sig_.wait();
+	}
+	/**
+	 * Takes an item from the queue, waiting a bounded time while it's
+	 * empty.
+	 * @param p Gets the item.
+	 * @param d The longest time to wait.
+	 * @return @em true if an item was taken, @em false on a timeout.
+	 */
+	bool get(T* p, const Duration& d);
+	/**
+	 * Takes an item from the queue if there is one.
+	 * @param p Gets the item.
+	 * @return @em true if an item was taken, @em false if the queue was
+	 *  	   empty.
+	 */
+	bool tryget(T* p) {
+		MyGuard g(cond_);
+		return do_get(p);
+	}
+};
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool PollableMsgQueue<T>::put(const T& v, const Duration& d)
+{
+	MyGuard g(cond_);
+
+	if (que_.full()) {
+		MonotonicTime until = MonotonicTime::now() + d;
+		do {
+			Duration rem = until - MonotonicTime::now();
+			if (rem.to_nsec() <= 0)
+				return false;
+			++nwait_;
+			cond_.wait(rem);
+			--nwait_;
+		}
+		while (que_.full());
+	}
+
+	do_put(v);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+template <typename T>
+bool PollableMsgQueue<T>::get(T* p, const Duration& d)
+{
+	if (tryget(p))
+		return true;
+
+	MonotonicTime until = MonotonicTime::now() + d;
+
+	for (;;) {
+		Duration rem = until - MonotonicTime::now();
+		if (rem.to_nsec() <= 0 || !sig_.wait(rem))
+			return tryget(p);
+		if (tryget(p))
+			return true;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __CtrlrFx_PollableMsgQueue_h
+
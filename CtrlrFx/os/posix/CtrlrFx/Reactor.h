@@ -0,0 +1,539 @@
+/// @file Reactor.h
+/// Definition of the epoll-based @ref Reactor, its event handlers, and the
+/// @ref ReactorPool for running one reactor per core, with a
+/// @ref ShardedAcceptor to take connections on all of them.
+/// These are Linux-specific.
+
+#ifndef __CtrlrFx_Reactor_h
+#define __CtrlrFx_Reactor_h
+
+#if defined(__linux__)
+
+#include "CtrlrFx/Thread.h"
+#include "CtrlrFx/Mutex.h"
+#include "CtrlrFx/Guard.h"
+#include "CtrlrFx/PollSignal.h"
+#include "CtrlrFx/TcpAcceptor.h"
+#include "CtrlrFx/TimerFdTimer.h"
+#include <sys/epoll.h>
+#include <signal.h>
+
+struct signalfd_siginfo;
+
+namespace CtrlrFx {
+
+class Reactor;
+
+/////////////////////////////////////////////////////////////////////////////
+//								EventHandler
+/////////////////////////////////////////////////////////////////////////////
+
+/// The base for objects that handle the events on a descriptor.
+/// A handler is registered with a @ref Reactor, which calls it back from
+/// the reactor's thread when its descriptor is ready.
+
+class EventHandler
+{
+	friend class Reactor;
+
+	Reactor*		reactor_;	///< The reactor we're registered with
+	int				fd_;		///< The descriptor we were registered with
+	EventHandler	*prev_,		///< The previous handler in the reactor's list
+					*next_;		///< The next handler in the reactor's list
+
+	// Non-copyable
+	EventHandler(const EventHandler&);
+	EventHandler& operator=(const EventHandler&);
+
+public:
+	/// The events that a handler can wait for.
+	enum {
+		READ = EPOLLIN,		///< The descriptor is readable
+		WRITE = EPOLLOUT	///< The descriptor is writable
+	};
+
+	/**
+	 * Creates a handler that isn't registered with a reactor.
+	 */
+	EventHandler() : reactor_(0), fd_(-1), prev_(0), next_(0) {}
+	/**
+	 * Destroys the handler, removing it from its reactor.
+	 */
+	virtual ~EventHandler();
+	/**
+	 * Gets the reactor that the handler is registered with.
+	 * @return The reactor, or null if the handler isn't registered.
+	 */
+	Reactor* reactor() const { return reactor_; }
+	/**
+	 * Gets the descriptor that the handler waits on.
+	 * @return The descriptor.
+	 */
+	virtual int handle() const =0;
+	/**
+	 * Called when the descriptor is readable.
+	 * In edge-triggered mode, this should read until the operation would
+	 * block, since it won't be called again until more data arrives.
+	 */
+	virtual void on_readable() {}
+	/**
+	 * Called when the descriptor is writable.
+	 */
+	virtual void on_writable() {}
+	/**
+	 * Called when there's an error or a hangup on the descriptor.
+	 * The default removes the handler from the reactor, since level-
+	 * triggered mode would otherwise keep reporting the same condition.
+	 * @param events The epoll events that were reported.
+	 */
+	virtual void on_error(uint32_t events);
+};
+
+// --------------------------------------------------------------------------
+
+/// A handler for any object with an OS handle, like a TcpSocket, a
+/// UdpSocket, an InDevice or OutDevice, or a PollableMsgQueue.
+/// The object isn't owned by the handler.
+/// @param H The object type. It must have a handle() method.
+
+template <typename H>
+class IoHandler : public EventHandler
+{
+protected:
+	H&	io_;	///< The object
+
+public:
+	/**
+	 * Creates a handler for an object.
+	 * @param io The object.
+	 */
+	explicit IoHandler(H& io) : io_(io) {}
+	/**
+	 * Gets the object.
+	 * @return The object.
+	 */
+	H& io() { return io_; }
+	/**
+	 * Gets the descriptor of the object.
+	 * @return The descriptor of the object.
+	 */
+	virtual int handle() const { return io_.handle(); }
+};
+
+// --------------------------------------------------------------------------
+
+/// A handler that accepts incoming TCP connections.
+/// The acceptor is made non-blocking, and each time it's readable, all
+/// the waiting connections are accepted and passed to @ref on_accept().
+/// The new sockets are non-blocking as well.
+///
+/// A connection that was aborted before it could be accepted is skipped.
+/// When the process runs out of descriptors or memory, the rest of the
+/// backlog is left for the next call, so the handler should be registered
+/// level-triggered to be called again for it.
+
+class AcceptHandler : public IoHandler<TcpAcceptor>
+{
+public:
+	/**
+	 * Creates a handler for an acceptor.
+	 * @param acc The acceptor. It must already be open.
+	 */
+	explicit AcceptHandler(TcpAcceptor& acc);
+	/**
+	 * Accepts the waiting connections.
+	 */
+	virtual void on_readable();
+	/**
+	 * Called for each new connection.
+	 * @param sock The new socket. The handler takes ownership by copying
+	 *  		   (transferring) it.
+	 */
+	virtual void on_accept(TcpSocket& sock) =0;
+};
+
+// --------------------------------------------------------------------------
+
+/// A handler that runs a @ref TimerFdTimer from a reactor.
+/// The timer's client is called back from the reactor's thread.
+
+class TimerFdHandler : public EventHandler
+{
+	TimerFdTimer&	tmr_;	///< The timer
+
+public:
+	/**
+	 * Creates a handler for a timer.
+	 * @param tmr The timer.
+	 */
+	explicit TimerFdHandler(TimerFdTimer& tmr) : tmr_(tmr) {}
+	/**
+	 * Gets the timer's descriptor.
+	 * @return The timer's descriptor.
+	 */
+	virtual int handle() const { return tmr_.handle(); }
+	/**
+	 * Dispatches the expirations to the timer's client.
+	 */
+	virtual void on_readable() { tmr_.dispatch(false); }
+};
+
+// --------------------------------------------------------------------------
+
+/// A handler that receives Unix signals through a signalfd.
+/// The signals are blocked for normal delivery when the handler is
+/// created. Signal masks are per-thread and inherited, so the handler
+/// should be created in the main thread before any other threads are
+/// started.
+
+class SignalHandler : public EventHandler
+{
+	int		fd_;	///< The signalfd
+
+public:
+	/**
+	 * Creates a handler for a set of signals.
+	 * @param sigs The signals to handle.
+	 */
+	explicit SignalHandler(const sigset_t& sigs);
+	/**
+	 * Creates a handler for a single signal.
+	 * @param signo The signal to handle.
+	 */
+	explicit SignalHandler(int signo);
+	/**
+	 * Closes the signalfd.
+	 */
+	virtual ~SignalHandler();
+	/**
+	 * Determines if the signalfd was created.
+	 * @return @em true if the handler is usable.
+	 */
+	bool is_valid() const { return fd_ >= 0; }
+	/**
+	 * Gets the signalfd.
+	 * @return The signalfd.
+	 */
+	virtual int handle() const { return fd_; }
+	/**
+	 * Reads the pending signals and passes each to @ref on_signal().
+	 */
+	virtual void on_readable();
+	/**
+	 * Called for each signal received.
+	 * @param signo The signal number.
+	 * @param info The details of the signal.
+	 */
+	virtual void on_signal(int signo, const signalfd_siginfo& info) =0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Reactor
+/////////////////////////////////////////////////////////////////////////////
+
+/// An event loop on epoll.
+///
+/// Handlers are registered for the events on their descriptors, in either
+/// level-triggered or edge-triggered mode, and the reactor calls them back
+/// from the thread that calls @ref run() or @ref run_once().
+///
+/// In level-triggered mode, a handler is called for as long as its
+/// descriptor is ready, so it can read a little at a time. In edge-
+/// triggered mode, it's only called when the descriptor becomes ready, so
+/// it must read (or write) until the operation would block; in exchange,
+/// the kernel does less work for each wait, which matters with thousands
+/// of mostly-idle connections.
+///
+/// Handlers may be added from any thread. They should only be modified or
+/// removed from the reactor's own thread (typically from a callback), or
+/// while the reactor isn't running. A handler removed during a dispatch
+/// won't be called for the rest of it, so a handler may delete itself, or
+/// another handler, from a callback.
+
+class Reactor
+{
+public:
+	/// How a handler is triggered.
+	enum Mode {
+		LEVEL,		///< Level-triggered: called while the descriptor is ready
+		EDGE		///< Edge-triggered: called when it becomes ready
+	};
+
+private:
+	int				epfd_;		///< The epoll descriptor
+	int				err_;		///< The last error
+	PollSignal		wake_;		///< Wakes the loop for stop()
+	epoll_event*	evts_;		///< The events from the last wait
+	int				maxEvts_;	///< The size of the event array
+	int				nEvts_;		///< The number of events being dispatched
+	volatile bool	quit_;		///< Set to stop the loop
+	EventHandler*	handlers_;	///< The registered handlers
+	Mutex			lock_;		///< Protects the handler list
+
+	/// Adds a handler to the list of registered handlers.
+	void link(EventHandler& h);
+	/// Takes a handler off the list of registered handlers.
+	void unlink(EventHandler& h);
+
+	/// Converts the handler events and mode to epoll flags.
+	static uint32_t epoll_flags(uint32_t events, Mode mode) {
+		return events | ((mode == EDGE) ? uint32_t(EPOLLET) : 0) | EPOLLRDHUP;
+	}
+
+	// Non-copyable
+	Reactor(const Reactor&);
+	Reactor& operator=(const Reactor&);
+
+public:
+	/**
+	 * Creates a reactor.
+	 * @param maxEvents The most events to take from the kernel in one
+	 *  				wait.
+	 */
+	explicit Reactor(int maxEvents=256);
+	/**
+	 * Destroys the reactor.
+	 * The handlers are not destroyed, but any that are still registered
+	 * are detached, so that they can be destroyed or registered elsewhere
+	 * later.
+	 */
+	~Reactor();
+	/**
+	 * Determines if the reactor was created successfully.
+	 * @return @em true if the reactor is usable.
+	 */
+	bool is_valid() const { return epfd_ >= 0; }
+	/**
+	 * Gets the last error.
+	 * @return The last error.
+	 */
+	int error() const { return err_; }
+	/**
+	 * Registers a handler.
+	 * @param h The handler. It must not be registered with any reactor.
+	 * @param events The events to wait for (EventHandler::READ and/or
+	 *  			 EventHandler::WRITE).
+	 * @param mode How the handler is triggered.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int add(EventHandler& h, uint32_t events, Mode mode=LEVEL);
+	/**
+	 * Changes the events that a handler waits for.
+	 * @param h The handler.
+	 * @param events The events to wait for.
+	 * @param mode How the handler is triggered.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int modify(EventHandler& h, uint32_t events, Mode mode=LEVEL);
+	/**
+	 * Removes a handler.
+	 * @param h The handler.
+	 * @return @em 0 on success, @em -1 on error.
+	 */
+	int remove(EventHandler& h);
+	/**
+	 * Waits for events and dispatches them.
+	 * @param timeoutMs The longest time to wait, in milliseconds, or
+	 *  				@em -1 to wait indefinitely.
+	 * @return The number of events dispatched, or @em -1 on error.
+	 */
+	int run_once(int timeoutMs=-1);
+	/**
+	 * Runs the event loop until @ref stop() is called.
+	 * @return @em 0 on a normal stop, @em -1 on error.
+	 */
+	int run();
+	/**
+	 * Stops the event loop.
+	 * This can be called from any thread.
+	 */
+	void stop();
+	/**
+	 * Re-arms the reactor after a stop, so that run() can be called again.
+	 */
+	void reset();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								ReactorPool
+/////////////////////////////////////////////////////////////////////////////
+
+/// A set of reactors, each running in its own thread.
+/// This is the multi-reactor model: typically one reactor per core, with
+/// each thread optionally pinned to its core. A listener hands each new
+/// connection to the next reactor, and that connection is then only ever
+/// handled by that reactor's thread, so the connections need no locking.
+
+class ReactorPool
+{
+	/// A thread running a reactor.
+	class Runner : public Thread
+	{
+		Reactor& reactor_;
+		virtual int run() { return reactor_.run(); }
+	public:
+		Runner(Reactor& r, int prio, const char* name)
+				: Thread(prio, 0, name), reactor_(r) {}
+		virtual void quit() {
+			quit_ = true;
+			reactor_.stop();
+		}
+	};
+
+	int				n_;			///< The number of reactors
+	Reactor**		reactors_;	///< The reactors
+	Runner**		runners_;	///< Their threads
+	volatile int	next_;		///< The next reactor to hand out
+	int				err_;		///< The error creating a reactor, if any
+
+	// Non-copyable
+	ReactorPool(const ReactorPool&);
+	ReactorPool& operator=(const ReactorPool&);
+
+public:
+	/**
+	 * Creates the reactors and starts their threads.
+	 * @param n The number of reactors. If zero or less, one is created for
+	 *  		each online CPU.
+	 * @param pin Whether to pin reactor @em i to CPU @em i.
+	 * @param prio The priority of the threads.
+	 */
+	explicit ReactorPool(int n=0, bool pin=false,
+						 int prio=Thread::PRIORITY_NORMAL);
+	/**
+	 * Stops the threads and destroys the reactors.
+	 */
+	~ReactorPool();
+	/**
+	 * Determines if all the reactors were created successfully.
+	 * @return @em true if all the reactors are usable.
+	 */
+	bool is_valid() const { return err_ == 0; }
+	/**
+	 * Gets the error from creating the reactors.
+	 * @return The error from the first reactor that couldn't be created,
+	 *  	   or zero.
+	 */
+	int error() const { return err_; }
+	/**
+	 * Gets the number of reactors.
+	 * @return The number of reactors.
+	 */
+	int size() const { return n_; }
+	/**
+	 * Gets one of the reactors.
+	 * @param i The index of the reactor.
+	 * @return The reactor.
+	 */
+	Reactor& operator[](int i) { return *reactors_[i]; }
+	/**
+	 * Gets the next reactor, round-robin.
+	 * This is used to spread new connections across the reactors.
+	 * @return The next reactor.
+	 */
+	Reactor& next();
+	/**
+	 * Stops all the reactors and waits for their threads to finish.
+	 */
+	void stop();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								ShardedAcceptor
+/////////////////////////////////////////////////////////////////////////////
+
+/// Accepts TCP connections on every reactor in a pool.
+/// Each reactor gets its own listener on the same address, opened with
+/// SO_REUSEPORT, and the kernel balances the incoming connections across
+/// them. A connection is accepted on the thread of the reactor that will
+/// service it, so there's no single accept thread to stall, and no hand-off
+/// between threads.
+
+class ShardedAcceptor
+{
+	/// The handler for one reactor's listener.
+	class Shard : public AcceptHandler
+	{
+		ShardedAcceptor& owner_;
+	public:
+		Shard(TcpAcceptor& acc, ShardedAcceptor& owner)
+				: AcceptHandler(acc), owner_(owner) {}
+		virtual void on_accept(TcpSocket& sock) {
+			owner_.on_accept(sock, *reactor());
+		}
+	};
+
+	ReactorPool&	pool_;		///< The reactors
+	TcpAcceptor**	accs_;		///< One listener per reactor
+	Shard**			shards_;	///< One handler per listener
+
+	/// Removes and closes all the listeners.
+	void release();
+
+	// Non-copyable
+	ShardedAcceptor(const ShardedAcceptor&);
+	ShardedAcceptor& operator=(const ShardedAcceptor&);
+
+public:
+	/**
+	 * Creates an acceptor for the reactors in a pool.
+	 * @param pool The reactor pool.
+	 */
+	explicit ShardedAcceptor(ReactorPool& pool)
+				: pool_(pool), accs_(0), shards_(0) {}
+	/**
+	 * Closes the listeners.
+	 * The pool must be stopped first.
+	 */
+	virtual ~ShardedAcceptor();
+	/**
+	 * Opens a listener on each reactor and starts accepting.
+	 * The listeners are registered level-triggered, so a backlog left by a
+	 * shortage of descriptors is picked up again, and the accepted sockets
+	 * are non-blocking. This fails if the pool isn't valid, or if any
+	 * listener can't be opened or registered, in which case none are left
+	 * open.
+	 * @param addr The address to listen on. If the port is zero, the
+	 *  		   system picks one, and all the listeners share it.
+	 * @param queSize The listen queue size for each listener.
+	 * @param opts Additional @ref TcpAcceptor options, such as
+	 *  		   DEFER_ACCEPT. REUSE_PORT and NON_BLOCK are always used.
+	 * @return 0 on success, -1 on error.
+	 */
+	int open(const SockAddr& addr, int queSize=TcpAcceptor::MAX_QUE_SIZE,
+			 int opts=0);
+	/**
+	 * Determines if the listeners are open.
+	 * @return @em true if the listeners are open.
+	 */
+	bool is_open() const { return accs_ != 0; }
+	/**
+	 * Gets the address that the listeners are bound to.
+	 * @return The address, or an empty one if not open.
+	 */
+	SockAddr addr() const {
+		return accs_ ? accs_[0]->local_addr() : SockAddr();
+	}
+	/**
+	 * Removes the listeners from the reactors and closes them.
+	 * The pool must be stopped first.
+	 */
+	void close();
+	/**
+	 * Called for each new connection, from the thread of the reactor that
+	 * accepted it. This is called concurrently from all the reactors.
+	 * @param sock The new socket. The handler takes ownership by copying
+	 *  		   (transferring) it.
+	 * @param r The reactor that accepted the connection. This is normally
+	 *  		the one to register the connection with.
+	 */
+	virtual void on_accept(TcpSocket& sock, Reactor& r) =0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __linux__
+#endif		// __CtrlrFx_Reactor_h
+
@@ -52,23 +52,43 @@ public:
 
 	static const int 	DFLT_POLICY = SCHED_RR;
 
+	/// The amount of the stack that is left untouched when it is prefaulted,
+	/// to cover the frames already in use when the thread starts.
+	static const size_t	PREFAULT_MARGIN			= 4096;
+
 private:
 	pthread_t			thread_;		///< Handle to the OS thread
 	mutable int			prio_;			///< The thread's priority
+	size_t				stackSize_;		///< Requested stack size (0 for OS default)
+	char				name_[CTRLR_FX_THREAD_NAME_LEN];	///< The thread's name
 	ManualResetEvent	evtDone_;		///< Gets signaled when the thread completes
 	volatile bool		active_;		///< true if the thread was activated
 
+	#if defined(CPU_SETSIZE)
+		cpu_set_t		cpus_;			///< CPU affinity to apply on activation
+		bool			hasCpus_;		///< Whether an affinity was requested
+	#endif
+
+	/// Touches the requested stack area so that it is mapped in before the
+	/// thread starts its real work.
+	void prefault_stack();
+
 protected:
 	volatile bool quit_;	///< Flag gets set when someone wants the thread to exit
 
 	/**
      * Creates a thread at the specified priority.
-     * The thread is created with the default (os-dependent) stack size.
      * @param prio The thread's priority. This can be a os-independent
      *             constant like @em Thread::PRIORITY_NORMAL, or @em
      *             Thread::PRIORITY_ABOVE_NORMAL
-     * @param stackSize (ignored in POSIX port)
-     * @param name (ignored in POSIX implementation)
+     * @param stackSize The size of the thread's stack, in bytes. If zero,
+     *             the OS default is used. Sizes below the OS minimum are
+     *             rounded up to the minimum. When a size is given, the
+     *             stack is prefaulted as the thread starts so that it
+     *             won't take page faults later while running.
+     * @param name The name of the thread. This is handed to the OS (if
+     *             supported) so that it shows up in debuggers and
+     *             profilers. The OS may truncate long names.
 	 */
 	explicit Thread(int prio, unsigned stackSize=0, const char *name=0);
 	/**
@@ -140,9 +160,33 @@ public:
      * @return The priority of the current thread.
 	 */
 	static int curr_priority();
+	/**
+     * Locks all of the process's current and future memory pages into RAM.
+     * This prevents page faults caused by paging out memory, which is a
+     * source of large, unpredictable delays in real-time threads. The
+     * process normally needs elevated privileges for this to succeed.
+     * @return bool @em true on success, @em false on failure.
+	 */
+	static bool lock_memory();
+
+	#if defined(CPU_SETSIZE)
+	/**
+     * Sets the CPU affinity of the current thread.
+     * @param cpus The set of CPUs on which the thread is allowed to run.
+     * @return bool @em true on success, @em false on failure.
+	 */
+	static bool curr_affinity(const cpu_set_t& cpus);
+	#endif
 
 	// ----- Public Interface -----
 
+	/**
+     * Gets the name of the thread.
+     * @return The name of the thread. This is an empty string if no name
+     *         was given on construction.
+	 */
+	const char* name() const { return name_; }
+
     /**
      * Activates the thread by placing it into the scheduler's queue.
      * When created, the thread object is unknown to the operating system.
@@ -186,6 +230,31 @@ public:
      * @return The priority of the current thread.
 	 */
 	int priority() const;
+
+	#if defined(CPU_SETSIZE)
+	/**
+     * Sets the CPU affinity of the thread.
+     * If the thread is already running, this is applied immediately,
+     * otherwise it is applied when the thread is activated. Pinning
+     * real-time threads to isolated cores is one of the most effective
+     * ways to reduce their jitter.
+     * @param cpus The set of CPUs on which the thread is allowed to run.
+     * @return bool @em true on success, @em false on failure.
+	 */
+	bool affinity(const cpu_set_t& cpus);
+	/**
+     * Pins the thread to a single CPU.
+     * @param cpu The CPU number (zero-based) on which the thread should run.
+     * @return bool @em true on success, @em false on failure.
+	 */
+	bool affinity(int cpu);
+	/**
+     * Gets the CPU affinity of the thread.
+     * @param cpus Gets the set of CPUs on which the thread is allowed to run.
+     * @return bool @em true on success, @em false on failure.
+	 */
+	bool affinity(cpu_set_t* cpus) const;
+	#endif
 	/**
      * Sends a request to the thread to terminate itself gracefully.
      * This does not wait for the thread to complete. To do that, call the
@@ -521,7 +521,7 @@ inline Duration operator-(const TimeTmpl<CLOCK>& t1, const TimeTmpl<CLOCK>& t2)
 
 typedef TimeTmpl<CLOCK_REALTIME>  Time;
 
-#if defined(PLATFORM_LINUX)
+#if defined(PLATFORM_LINUX) || defined(CLOCK_MONOTONIC)
 	typedef TimeTmpl<CLOCK_MONOTONIC> MonotonicTime;
 #endif
 
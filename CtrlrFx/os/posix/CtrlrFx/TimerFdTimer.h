@@ -0,0 +1,157 @@
+/// @file TimerFdTimer.h
+/// Definition of the @ref TimerFdTimer and @ref TimerFdThread classes.
+/// These are Linux-specific.
+
+#ifndef __CtrlrFx_TimerFdTimer_h
+#define __CtrlrFx_TimerFdTimer_h
+
+#if defined(__linux__)
+
+#include "CtrlrFx/Thread.h"
+#include "CtrlrFx/Time.h"
+#include "CtrlrFx/ITimer.h"
+
+namespace CtrlrFx {
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerFdTimer
+/////////////////////////////////////////////////////////////////////////////
+
+/// A timer based on a Linux timerfd.
+/// The kernel keeps the expirations on the monotonic clock, so a periodic
+/// timer doesn't drift, and it counts the expirations between reads, so
+/// the client learns when it has fallen behind. The count is passed to
+/// ITimerClient::on_timer(ITimer&, uint64_t).
+///
+/// The timer doesn't have a thread of its own. The file descriptor, from
+/// @ref handle(), becomes readable when the timer expires, so it can be
+/// polled by an event loop, which then calls @ref dispatch() to make the
+/// client callback. Alternately, a @ref TimerFdThread can be used to run
+/// the timer from a dedicated thread.
+
+class TimerFdTimer : public ITimer
+{
+	int				fd_;			///< The timerfd
+	int				err_;			///< The last error
+	ITimerClient*	client_;		///< The client to notify
+	Duration		initDelay_,		///< The delay to the first expiration
+					period_;		///< The period (zero for a one-shot)
+
+	/// Arms or disarms the timerfd.
+	void set(const Duration& initDelay, const Duration& period);
+
+	// Non-copyable
+	TimerFdTimer(const TimerFdTimer&);
+	TimerFdTimer& operator=(const TimerFdTimer&);
+
+public:
+	/**
+	 * Creates a timer without a client.
+	 */
+	TimerFdTimer();
+	/**
+	 * Creates a timer.
+	 * @param client The client to receive the timer events.
+	 */
+	explicit TimerFdTimer(ITimerClient& client);
+	/**
+	 * Closes the timer.
+	 */
+	virtual ~TimerFdTimer();
+	/**
+	 * Determines if the timer is valid and usable.
+	 * @return @em true if the timerfd was created successfully.
+	 */
+	bool is_valid() const { return fd_ >= 0; }
+	/**
+	 * Gets the last error from the timer.
+	 * @return The last error from the timer.
+	 */
+	int error() const { return err_; }
+	/**
+	 * Determines if the timer is valid and usable.
+	 */
+	operator void*() const { return (void*) is_valid(); }
+	/**
+	 * Determines if the timer is invalid (unusable).
+	 */
+	bool operator!() const { return !is_valid(); }
+	/**
+	 * Gets the file descriptor for the timer.
+	 * This becomes readable when the timer expires. It's non-blocking.
+	 * @return The file descriptor for the timer.
+	 */
+	int handle() const { return fd_; }
+	/**
+	 * Reads the expirations from the timer and notifies the client.
+	 * This is normally called from an event loop when the handle becomes
+	 * readable.
+	 * @param block Whether to wait for the timer to expire if it hasn't
+	 *  			already.
+	 * @return The number of expirations since the last call, zero if
+	 *  	   there weren't any, or -1 on error.
+	 */
+	int64_t dispatch(bool block=false);
+	/**
+	 * Gets the time remaining until the next expiration.
+	 * @return The time until the next expiration. This is zero if the
+	 *  	   timer is stopped.
+	 */
+	Duration remaining() const;
+
+	// ----- ITimer Interface -----
+
+	virtual int register_client(ITimerClient& client);
+
+	virtual void start();
+	virtual void start(const Duration& period);
+	virtual void start(const Duration& initDelay, const Duration& period);
+
+	virtual void one_shot(const Duration& timeout);
+
+	virtual void stop();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerFdThread
+/////////////////////////////////////////////////////////////////////////////
+
+/// A thread that runs a @ref TimerFdTimer.
+/// This is a drop-in replacement for a @ref ThreadTimer, but with the
+/// timing kept by the kernel, rather than by waits on a condition
+/// variable.
+
+class TimerFdThread : public TimerFdTimer, public Thread
+{
+	int		pipe_[2];		///< Used to knock the thread out of its wait
+
+	virtual int run();
+
+public:
+	/**
+	 * Creates the timer and starts its thread.
+	 * @param prio The priority of the timer thread.
+	 * @param client The client to receive the timer events.
+	 */
+	TimerFdThread(int prio, ITimerClient& client);
+	/**
+	 * Stops the thread and destroys the timer.
+	 */
+	~TimerFdThread() { destroy(); }
+	/**
+	 * Stops the thread and waits for it to exit.
+	 */
+	void destroy();
+	/**
+	 * Asks the thread to exit.
+	 */
+	virtual void quit();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace CtrlrFx
+};
+
+#endif		// __linux__
+#endif		// __CtrlrFx_TimerFdTimer_h
+
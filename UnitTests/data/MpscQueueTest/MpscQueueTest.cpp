@@ -0,0 +1,160 @@
+// MpscQueueTest.cpp
+//
+// CppUnit test for the CtrlrFx "MpscQueue" class
+//
+
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/MpscQueue.h"
+#include "CtrlrFx/Thread.h"
+
+using namespace CppUnit;
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+// An item that remembers who pushed it, and in what order.
+
+struct Item : public MpscNode
+{
+	int src, seq;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Pushes a run of items into the queue.
+
+class Producer : public Thread
+{
+	MpscQueue&	que_;
+	Item*		items_;
+	int			n_;
+
+public:
+	Producer(MpscQueue& que, Item* items, int n)
+		: Thread(0), que_(que), items_(items), n_(n) {}
+
+	virtual int run() {
+		for (int i=0; i<n_; ++i)
+			que_.push(&items_[i]);
+		return 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+class MpscQueueTest : public TestFixture
+{
+	CPPUNIT_TEST_SUITE( MpscQueueTest );
+	CPPUNIT_TEST( test_empty );
+	CPPUNIT_TEST( test_order );
+	CPPUNIT_TEST( test_one_at_a_time );
+	CPPUNIT_TEST( test_producers );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {
+	}
+
+	void tearDown() {
+	}
+
+	void test_empty() {
+		MpscQueue que;
+
+		CPPUNIT_ASSERT(que.empty());
+		CPPUNIT_ASSERT(que.pop() == 0);
+		CPPUNIT_ASSERT(que.empty());
+	}
+
+	void test_order() {
+		const int N = 100;
+		MpscQueue que;
+		Item item[N];
+
+		for (int i=0; i<N; ++i) {
+			item[i].seq = i;
+			que.push(&item[i]);
+		}
+		CPPUNIT_ASSERT(!que.empty());
+
+		for (int i=0; i<N; ++i) {
+			Item* p = static_cast<Item*>(que.pop());
+			CPPUNIT_ASSERT(p != 0);
+			CPPUNIT_ASSERT_EQUAL(i, p->seq);
+		}
+		CPPUNIT_ASSERT(que.pop() == 0);
+		CPPUNIT_ASSERT(que.empty());
+	}
+
+	// Draining the queue to a single item, and then to nothing, moves the
+	// stub around the list. Items are reused once they're popped.
+	void test_one_at_a_time() {
+		MpscQueue que;
+		Item a, b;
+
+		a.seq = 1;
+		b.seq = 2;
+
+		for (int i=0; i<1000; ++i) {
+			que.push(&a);
+			CPPUNIT_ASSERT(que.pop() == &a);
+			CPPUNIT_ASSERT(que.pop() == 0);
+
+			que.push(&a);
+			que.push(&b);
+			CPPUNIT_ASSERT(que.pop() == &a);
+			que.push(&a);
+			CPPUNIT_ASSERT(que.pop() == &b);
+			CPPUNIT_ASSERT(que.pop() == &a);
+			CPPUNIT_ASSERT(que.empty());
+		}
+	}
+
+	// Items from each producer come out in the order it pushed them.
+	void test_producers() {
+		const int N_PROD = 4, N = 50000;
+		MpscQueue que;
+		Item* items = new Item[N_PROD * N];
+		Producer* prod[N_PROD];
+		int next[N_PROD] = { 0 };
+
+		for (int i=0; i<N_PROD; ++i) {
+			for (int j=0; j<N; ++j) {
+				items[i*N + j].src = i;
+				items[i*N + j].seq = j;
+			}
+			prod[i] = new Producer(que, items + i*N, N);
+			prod[i]->activate();
+		}
+
+		for (int n=0; n<N_PROD*N; ) {
+			Item* p = static_cast<Item*>(que.pop());
+			if (!p)
+				continue;
+			CPPUNIT_ASSERT(p->src >= 0 && p->src < N_PROD);
+			CPPUNIT_ASSERT_EQUAL(next[p->src], p->seq);
+			++next[p->src];
+			++n;
+		}
+		CPPUNIT_ASSERT(que.pop() == 0);
+
+		for (int i=0; i<N_PROD; ++i) {
+			prod[i]->wait();
+			delete prod[i];
+		}
+		delete[] items;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	CPPUNIT_TEST_SUITE_REGISTRATION( MpscQueueTest );
+
+	TextUi::TestRunner runner;
+	TestFactoryRegistry &registry = TestFactoryRegistry::getRegistry();
+
+	runner.addTest(registry.makeTest());
+	return (runner.run()) ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+// WorkStealDequeTest.cpp
+//
+// CppUnit test for the CtrlrFx "WorkStealDeque" class
+//
+
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/WorkStealDeque.h"
+#include "CtrlrFx/Thread.h"
+#include <string.h>
+
+using namespace CppUnit;
+using namespace CtrlrFx;
+
+typedef WorkStealDeque<intptr_t> IntDeque;
+
+/////////////////////////////////////////////////////////////////////////////
+// Steals items until told to stop, counting each one it gets.
+
+class Thief : public Thread
+{
+	IntDeque&		deq_;
+	volatile int*	seen_;
+	volatile bool&	stop_;
+
+public:
+	int nstolen;
+
+	Thief(IntDeque& deq, volatile int* seen, volatile bool& stop)
+		: Thread(0), deq_(deq), seen_(seen), stop_(stop), nstolen(0) {}
+
+	virtual int run() {
+		intptr_t v;
+		while (!stop_ || !deq_.empty()) {
+			if (deq_.steal(&v) == IntDeque::SUCCESS) {
+				atomic_fetch_add(&seen_[v], 1);
+				++nstolen;
+			}
+		}
+		return 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+class WorkStealDequeTest : public TestFixture
+{
+	CPPUNIT_TEST_SUITE( WorkStealDequeTest );
+	CPPUNIT_TEST( test_capacity );
+	CPPUNIT_TEST( test_ends );
+	CPPUNIT_TEST( test_wrap );
+	CPPUNIT_TEST( test_thieves );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {
+	}
+
+	void tearDown() {
+	}
+
+	void test_capacity() {
+		IntDeque deq(5);
+		intptr_t v;
+
+		CPPUNIT_ASSERT_EQUAL(size_t(8), deq.capacity());
+		CPPUNIT_ASSERT(deq.empty());
+		CPPUNIT_ASSERT(!deq.pop(&v));
+		CPPUNIT_ASSERT_EQUAL(int(IntDeque::EMPTY), deq.steal(&v));
+
+		for (int i=0; i<8; ++i)
+			CPPUNIT_ASSERT(deq.push(i));
+		CPPUNIT_ASSERT(!deq.push(8));
+		CPPUNIT_ASSERT_EQUAL(size_t(8), deq.size());
+	}
+
+	// The owner works LIFO from the bottom; thieves take FIFO from the top.
+	void test_ends() {
+		IntDeque deq(8);
+		intptr_t v;
+
+		for (int i=1; i<=5; ++i)
+			deq.push(i);
+
+		CPPUNIT_ASSERT_EQUAL(int(IntDeque::SUCCESS), deq.steal(&v));
+		CPPUNIT_ASSERT_EQUAL(intptr_t(1), v);
+		CPPUNIT_ASSERT(deq.pop(&v));
+		CPPUNIT_ASSERT_EQUAL(intptr_t(5), v);
+		CPPUNIT_ASSERT_EQUAL(int(IntDeque::SUCCESS), deq.steal(&v));
+		CPPUNIT_ASSERT_EQUAL(intptr_t(2), v);
+		CPPUNIT_ASSERT(deq.pop(&v));
+		CPPUNIT_ASSERT_EQUAL(intptr_t(4), v);
+		CPPUNIT_ASSERT(deq.pop(&v));
+		CPPUNIT_ASSERT_EQUAL(intptr_t(3), v);
+
+		CPPUNIT_ASSERT(!deq.pop(&v));
+		CPPUNIT_ASSERT_EQUAL(int(IntDeque::EMPTY), deq.steal(&v));
+		CPPUNIT_ASSERT(deq.empty());
+	}
+
+	// Steals move the top along, so the items wrap around the buffer.
+	void test_wrap() {
+		IntDeque deq(4);
+		intptr_t v;
+
+		for (int n=0; n<100; ++n) {
+			for (int i=0; i<4; ++i)
+				CPPUNIT_ASSERT(deq.push(4*n + i));
+			CPPUNIT_ASSERT(!deq.push(-1));
+
+			CPPUNIT_ASSERT_EQUAL(int(IntDeque::SUCCESS), deq.steal(&v));
+			CPPUNIT_ASSERT_EQUAL(intptr_t(4*n), v);
+			CPPUNIT_ASSERT_EQUAL(int(IntDeque::SUCCESS), deq.steal(&v));
+			CPPUNIT_ASSERT_EQUAL(intptr_t(4*n + 1), v);
+
+			CPPUNIT_ASSERT(deq.pop(&v));
+			CPPUNIT_ASSERT_EQUAL(intptr_t(4*n + 3), v);
+			CPPUNIT_ASSERT(deq.pop(&v));
+			CPPUNIT_ASSERT_EQUAL(intptr_t(4*n + 2), v);
+			CPPUNIT_ASSERT(deq.empty());
+		}
+	}
+
+	// With the owner pushing and popping while thieves steal, every item
+	// is taken exactly once.
+	void test_thieves() {
+		const int N_THIEF = 3, N = 200000;
+		IntDeque deq(64);
+		volatile int* seen = new int[N];
+		volatile bool stop = false;
+		Thief* thief[N_THIEF];
+		int npopped = 0;
+		intptr_t v;
+
+		::memset((void*) seen, 0, N * sizeof(int));
+
+		for (int i=0; i<N_THIEF; ++i) {
+			thief[i] = new Thief(deq, seen, stop);
+			thief[i]->activate();
+		}
+
+		for (int i=0; i<N; ++i) {
+			while (!deq.push(i)) {
+				if (deq.pop(&v)) {
+					atomic_fetch_add(&seen[v], 1);
+					++npopped;
+				}
+			}
+			if (i % 3 == 0 && deq.pop(&v)) {
+				atomic_fetch_add(&seen[v], 1);
+				++npopped;
+			}
+		}
+		while (deq.pop(&v)) {
+			atomic_fetch_add(&seen[v], 1);
+			++npopped;
+		}
+
+		stop = true;
+		int nstolen = 0;
+		for (int i=0; i<N_THIEF; ++i) {
+			thief[i]->wait();
+			nstolen += thief[i]->nstolen;
+			delete thief[i];
+		}
+
+		CPPUNIT_ASSERT_EQUAL(N, npopped + nstolen);
+		for (int i=0; i<N; ++i)
+			CPPUNIT_ASSERT_EQUAL(1, int(seen[i]));
+
+		delete[] seen;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	CPPUNIT_TEST_SUITE_REGISTRATION( WorkStealDequeTest );
+
+	TextUi::TestRunner runner;
+	TestFactoryRegistry &registry = TestFactoryRegistry::getRegistry();
+
+	runner.addTest(registry.makeTest());
+	return (runner.run()) ? 0 : 1;
+}
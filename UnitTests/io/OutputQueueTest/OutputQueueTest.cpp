@@ -0,0 +1,301 @@
+// OutputQueueTest.cpp
+// 
+// CppUnit test for the CtrlrFx "OutputQueue" class
+//
+
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/OutputQueue.h"
+#include "CtrlrFx/Thread.h"
+#include <string.h>
+#include <errno.h>
+
+using namespace CppUnit;
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+// A device that takes only as many bytes as it's allowed, and keeps them.
+
+class TestDevice : public IOutDevice
+{
+	size_t	allow_;
+	byte	out_[4096];
+	size_t	nout_;
+	size_t	ntotal_;
+
+public:
+	TestDevice() : allow_(0), nout_(0), ntotal_(0) {}
+
+	void allow(size_t n) { allow_ = n; }
+	size_t total() const { return ntotal_; }
+	const byte* data() const { return out_; }
+	size_t size() const { return nout_; }
+
+	virtual int writev(ByteBuffer* const bufs[], size_t n) {
+		if (allow_ == 0) {
+			errno = EAGAIN;
+			return -1;
+		}
+		size_t cnt = 0;
+		for (size_t i=0; i<n && allow_ > 0; ++i) {
+			size_t m = bufs[i]->available();
+			if (m > allow_)
+				m = allow_;
+			for (size_t j=0; j<m; ++j) {
+				if (nout_ < sizeof(out_))
+					out_[nout_++] = bufs[i]->position_ptr()[j];
+			}
+			bufs[i]->incr_position(m);
+			allow_ -= m;
+			cnt += m;
+		}
+		ntotal_ += cnt;
+		return int(cnt);
+	}
+
+	virtual int write(const void*, size_t)		{ return -1; }
+	virtual int write_n(const void*, size_t)	{ return -1; }
+	virtual int write(ByteBuffer&)				{ return -1; }
+	virtual int write_n(ByteBuffer&)			{ return -1; }
+	virtual int writev_n(ByteBuffer* const[], size_t) { return -1; }
+	virtual bool write_timeout(const Duration&)	{ return false; }
+};
+
+// --------------------------------------------------------------------------
+
+class TestClient : public IOutputQueueClient
+{
+public:
+	int nrelease, nhigh, nlow, noverflow;
+
+	TestClient() : nrelease(0), nhigh(0), nlow(0), noverflow(0) {}
+
+	virtual void on_release(ByteBuffer*)	{ ++nrelease; }
+	virtual void on_high_water(OutputQueue&) { ++nhigh; }
+	virtual void on_low_water(OutputQueue&)	{ ++nlow; }
+	virtual void on_overflow(OutputQueue&)	{ ++noverflow; }
+};
+
+// --------------------------------------------------------------------------
+
+class Producer : public Thread
+{
+	OutputQueue&	que_;
+	ByteBuffer*		buf_;
+
+public:
+	volatile int	ret;
+	volatile bool	done;
+
+	Producer(OutputQueue& que, ByteBuffer* buf)
+		: Thread(0), que_(que), buf_(buf), ret(-2), done(false) {}
+
+	virtual int run() {
+		ret = que_.write(buf_);
+		done = true;
+		return 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+class OutputQueueTest : public TestFixture
+{
+public:
+	CPPUNIT_TEST_SUITE( OutputQueueTest );
+	CPPUNIT_TEST( test_direct );
+	CPPUNIT_TEST( test_order );
+	CPPUNIT_TEST( test_many_bufs );
+	CPPUNIT_TEST( test_drop );
+	CPPUNIT_TEST( test_disconnect );
+	CPPUNIT_TEST( test_block );
+	CPPUNIT_TEST_SUITE_END();
+
+private:
+	static void fill(ByteBuffer& buf, byte c) {
+		memset(buf.position_ptr(), c, buf.available());
+	}
+
+public:
+	void setUp() {
+	}
+
+	void tearDown() {
+	}
+
+	// A write to an empty queue on a ready device goes right out.
+	void test_direct() {
+		TestDevice dev;
+		TestClient client;
+		OutputQueue que(dev, 100, 40, OutputQueue::BLOCK, &client);
+		ByteBuffer buf(10);
+		buf.size(10);
+
+		dev.allow(1000);
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&buf));
+		CPPUNIT_ASSERT(!que.pending());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), que.size());
+		CPPUNIT_ASSERT_EQUAL(1, client.nrelease);
+		CPPUNIT_ASSERT_EQUAL(size_t(10), dev.total());
+	}
+
+	// Buffers go out in order across partial writes.
+	void test_order() {
+		TestDevice dev;
+		TestClient client;
+		OutputQueue que(dev, 1000, 400, OutputQueue::BLOCK, &client, 4);
+		ByteBuffer a(10), b(10), c(10);
+		a.size(10); fill(a, 'a');
+		b.size(10); fill(b, 'b');
+		c.size(10); fill(c, 'c');
+
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&a));
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&b));
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&c));
+		CPPUNIT_ASSERT_EQUAL(size_t(30), que.size());
+
+		dev.allow(15);
+		CPPUNIT_ASSERT_EQUAL(1, que.flush());
+		CPPUNIT_ASSERT_EQUAL(size_t(15), que.size());
+		CPPUNIT_ASSERT_EQUAL(1, client.nrelease);
+
+		dev.allow(1000);
+		CPPUNIT_ASSERT_EQUAL(0, que.flush());
+		CPPUNIT_ASSERT_EQUAL(3, client.nrelease);
+		CPPUNIT_ASSERT_EQUAL(size_t(30), dev.size());
+
+		for (size_t i=0; i<30; ++i)
+			CPPUNIT_ASSERT_EQUAL(byte('a' + i/10), dev.data()[i]);
+
+		// The ring wraps around
+		a.rewind(); b.rewind();
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&a));
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&b));
+		CPPUNIT_ASSERT_EQUAL(5, client.nrelease);
+	}
+
+	// More finished buffers than a single gather write can take.
+	void test_many_bufs() {
+		const int NSMALL = 70, NEMPTY = 130;
+		TestDevice dev;
+		TestClient client;
+		OutputQueue que(dev, 2*1024*1024, 1024*1024, OutputQueue::BLOCK,
+						&client, 256);
+
+		ByteBuffer big(1024*1024);
+		big.size(1024*1024);
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&big));
+
+		ByteBuffer small[NSMALL], empty[NEMPTY];
+		for (int i=0; i<NSMALL; ++i) {
+			small[i].resize(8);
+			small[i].size(8);
+			CPPUNIT_ASSERT_EQUAL(0, que.write(&small[i]));
+		}
+		for (int i=0; i<NEMPTY; ++i)
+			CPPUNIT_ASSERT_EQUAL(0, que.write(&empty[i]));
+
+		dev.allow(size_t(-1));
+		CPPUNIT_ASSERT_EQUAL(0, que.flush());
+		CPPUNIT_ASSERT(!que.pending());
+		CPPUNIT_ASSERT_EQUAL(1 + NSMALL + NEMPTY, client.nrelease);
+		CPPUNIT_ASSERT_EQUAL(size_t(1024*1024 + 8*NSMALL), dev.total());
+	}
+
+	// The watermarks are reported, and DROP rejects past the high one.
+	void test_drop() {
+		TestDevice dev;
+		TestClient client;
+		OutputQueue que(dev, 100, 40, OutputQueue::DROP, &client);
+		ByteBuffer a(60), b(60);
+		a.size(60);
+		b.size(60);
+
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&a));
+		CPPUNIT_ASSERT_EQUAL(0, client.nhigh);
+
+		CPPUNIT_ASSERT_EQUAL(1, que.write(&b));
+		CPPUNIT_ASSERT_EQUAL(1, client.nhigh);
+		CPPUNIT_ASSERT_EQUAL(1, client.nrelease);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1), que.dropped());
+		CPPUNIT_ASSERT_EQUAL(size_t(60), que.size());
+
+		dev.allow(10);
+		que.flush();
+		CPPUNIT_ASSERT_EQUAL(0, client.nlow);
+
+		dev.allow(10);
+		que.flush();
+		CPPUNIT_ASSERT_EQUAL(size_t(40), que.size());
+		CPPUNIT_ASSERT_EQUAL(1, client.nlow);
+
+		b.rewind();
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&b));
+		CPPUNIT_ASSERT_EQUAL(2, client.nhigh);
+	}
+
+	// DISCONNECT closes the queue and releases everything in it.
+	void test_disconnect() {
+		TestDevice dev;
+		TestClient client;
+		OutputQueue que(dev, 100, 40, OutputQueue::DISCONNECT, &client);
+		ByteBuffer a(60), b(60), c(10);
+		a.size(60);
+		b.size(60);
+		c.size(10);
+
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&a));
+		CPPUNIT_ASSERT_EQUAL(-1, que.write(&b));
+		CPPUNIT_ASSERT_EQUAL(EPIPE, errno);
+		CPPUNIT_ASSERT(que.is_closed());
+		CPPUNIT_ASSERT_EQUAL(1, client.noverflow);
+		CPPUNIT_ASSERT_EQUAL(2, client.nrelease);
+		CPPUNIT_ASSERT_EQUAL(size_t(0), que.size());
+
+		CPPUNIT_ASSERT_EQUAL(-1, que.write(&c));
+		CPPUNIT_ASSERT_EQUAL(3, client.nrelease);
+	}
+
+	// A blocked producer wakes once the queue drains to the low watermark,
+	// even though the buffer at the front is only partly written.
+	void test_block() {
+		TestDevice dev;
+		TestClient client;
+		OutputQueue que(dev, 100, 40, OutputQueue::BLOCK, &client);
+		ByteBuffer big(1000), a(10);
+		big.size(1000);
+		a.size(10);
+
+		CPPUNIT_ASSERT_EQUAL(0, que.write(&big));
+
+		Producer prod(que, &a);
+		prod.activate();
+		Thread::sleep(Duration(msec(50)));
+		CPPUNIT_ASSERT(!prod.done);
+
+		dev.allow(970);
+		que.flush();
+		CPPUNIT_ASSERT_EQUAL(size_t(30), que.size());
+
+		CPPUNIT_ASSERT(prod.wait(Duration(sec(2))));
+		CPPUNIT_ASSERT_EQUAL(0, prod.ret);
+		CPPUNIT_ASSERT_EQUAL(size_t(40), que.size());
+		CPPUNIT_ASSERT_EQUAL(0, client.nrelease);
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	CPPUNIT_TEST_SUITE_REGISTRATION( OutputQueueTest );
+
+	TextUi::TestRunner runner;
+	TestFactoryRegistry &registry = TestFactoryRegistry::getRegistry();
+
+	runner.addTest(registry.makeTest());
+	return (runner.run()) ? 0 : 1;
+}
+
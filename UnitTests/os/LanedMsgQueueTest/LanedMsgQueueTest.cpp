@@ -0,0 +1,215 @@
+// LanedMsgQueueTest.cpp
+// 
+// CppUnit test for the CtrlrFx "LanedMsgQueue" class
+//
+
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/LanedMsgQueue.h"
+#include "CtrlrFx/Thread.h"
+#include <new>
+
+using namespace CppUnit;
+using namespace CtrlrFx;
+
+typedef LanedMsgQueue<int> IntQueue;
+
+/////////////////////////////////////////////////////////////////////////////
+// Puts a run of numbers into the queue from its own lane.
+
+class Producer : public Thread
+{
+	IntQueue&	que_;
+	int			first_, n_;
+
+public:
+	volatile bool ok;
+
+	Producer(IntQueue& que, int first, int n)
+		: Thread(0), que_(que), first_(first), n_(n), ok(true) {}
+
+	virtual int run() {
+		for (int i=0; i<n_; ++i) {
+			if (!que_.put(first_ + i))
+				ok = false;
+		}
+		return 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+class LanedMsgQueueTest : public TestFixture
+{
+public:
+	CPPUNIT_TEST_SUITE( LanedMsgQueueTest );
+	CPPUNIT_TEST( test_constructor );
+	CPPUNIT_TEST( test_wrap );
+	CPPUNIT_TEST( test_lanes );
+	CPPUNIT_TEST( test_priority );
+	CPPUNIT_TEST( test_reused_address );
+	CPPUNIT_TEST( test_short_lived );
+	CPPUNIT_TEST( test_producers );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {
+	}
+
+	void tearDown() {
+	}
+
+	void test_constructor() {
+		IntQueue que(3, 5);
+
+		CPPUNIT_ASSERT_EQUAL(3, que.num_lanes());
+		CPPUNIT_ASSERT_EQUAL(size_t(8), que.lane_capacity());
+		CPPUNIT_ASSERT(que.empty());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), que.size());
+	}
+
+	// A lane fills to its capacity and keeps its order as it wraps.
+	void test_wrap() {
+		IntQueue que(1, 4);
+		int lane = que.open_lane(), v;
+
+		CPPUNIT_ASSERT_EQUAL(0, lane);
+		CPPUNIT_ASSERT_EQUAL(-1, que.open_lane());
+
+		for (int n=0; n<10; ++n) {
+			for (int i=0; i<4; ++i)
+				CPPUNIT_ASSERT(que.tryput(lane, 4*n + i));
+			CPPUNIT_ASSERT(!que.tryput(lane, -1));
+			CPPUNIT_ASSERT_EQUAL(size_t(4), que.size());
+
+			for (int i=0; i<4; ++i) {
+				CPPUNIT_ASSERT(que.tryget(&v));
+				CPPUNIT_ASSERT_EQUAL(4*n + i, v);
+			}
+			CPPUNIT_ASSERT(!que.tryget(&v));
+		}
+		CPPUNIT_ASSERT(!que.get(&v, Duration(msec(10))));
+	}
+
+	// Round-robin takes from each busy lane in turn.
+	void test_lanes() {
+		IntQueue que(2, 4);
+		int a = que.open_lane(), b = que.open_lane(), v;
+
+		que.put(a, 1);
+		que.put(a, 2);
+		que.put(b, 10);
+		que.put(b, 20);
+
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(1, v);
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(10, v);
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(2, v);
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(20, v);
+	}
+
+	// Lane zero is always drained first.
+	void test_priority() {
+		IntQueue que(2, 4, IntQueue::PRIORITY);
+		int a = que.open_lane(), b = que.open_lane(), v;
+
+		que.put(b, 10);
+		que.put(a, 1);
+		que.put(b, 20);
+		que.put(a, 2);
+
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(1, v);
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(2, v);
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(10, v);
+		que.get(&v); CPPUNIT_ASSERT_EQUAL(20, v);
+	}
+
+	// A queue made at the address of a destroyed one doesn't inherit the
+	// thread's lane from it.
+	void test_reused_address() {
+		double mem[sizeof(IntQueue)/sizeof(double) + 1];
+		int v;
+
+		IntQueue* que = new (mem) IntQueue(4, 4);
+		que->open_lane();
+		que->open_lane();
+		CPPUNIT_ASSERT(que->put(1));
+		que->get(&v);
+		que->~IntQueue();
+
+		que = new (mem) IntQueue(1, 4);
+		CPPUNIT_ASSERT(que->put(2));
+		CPPUNIT_ASSERT(que->get(&v, Duration(msec(10))));
+		CPPUNIT_ASSERT_EQUAL(2, v);
+		que->~IntQueue();
+	}
+
+	// A thread can put into any number of queues over time, as long as
+	// no more than MAX_THREAD_QUEUES of them are alive at once.
+	void test_short_lived() {
+		const int MAXQ = IntQueue::MAX_THREAD_QUEUES;
+		IntQueue* que[MAXQ+1];
+		int v;
+
+		for (int n=0; n<10; ++n) {
+			for (int i=0; i<MAXQ; ++i) {
+				que[i] = new IntQueue(1, 4);
+				CPPUNIT_ASSERT(que[i]->put(i));
+			}
+
+			que[MAXQ] = new IntQueue(1, 4);
+			CPPUNIT_ASSERT(!que[MAXQ]->put(MAXQ));
+			delete que[MAXQ];
+
+			for (int i=0; i<MAXQ; ++i) {
+				CPPUNIT_ASSERT(que[i]->tryget(&v));
+				CPPUNIT_ASSERT_EQUAL(i, v);
+				delete que[i];
+			}
+		}
+	}
+
+	// Each producer's items arrive in order, and none are lost.
+	void test_producers() {
+		const int NPROD = 4, N = 20000;
+		IntQueue que(NPROD, 16);
+		Producer* prod[NPROD];
+
+		for (int i=0; i<NPROD; ++i) {
+			prod[i] = new Producer(que, i*N, N);
+			prod[i]->activate();
+		}
+
+		int next[NPROD] = { 0 };
+
+		for (int i=0; i<NPROD*N; ++i) {
+			int v;
+			CPPUNIT_ASSERT(que.get(&v, Duration(sec(2))));
+			int p = v / N;
+			CPPUNIT_ASSERT_EQUAL(next[p], v % N);
+			++next[p];
+		}
+
+		for (int i=0; i<NPROD; ++i) {
+			CPPUNIT_ASSERT(prod[i]->wait(Duration(sec(2))));
+			CPPUNIT_ASSERT(prod[i]->ok);
+			delete prod[i];
+		}
+		CPPUNIT_ASSERT(que.empty());
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	CPPUNIT_TEST_SUITE_REGISTRATION( LanedMsgQueueTest );
+
+	TextUi::TestRunner runner;
+	TestFactoryRegistry &registry = TestFactoryRegistry::getRegistry();
+
+	runner.addTest(registry.makeTest());
+	return (runner.run()) ? 0 : 1;
+}
+
@@ -0,0 +1,167 @@
+// MailboxTest.cpp
+//
+// CppUnit test for the CtrlrFx "Mailbox" class
+//
+
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/Mailbox.h"
+#include "CtrlrFx/Thread.h"
+
+using namespace CppUnit;
+using namespace CtrlrFx;
+
+typedef Mailbox<int> IntMailbox;
+
+/////////////////////////////////////////////////////////////////////////////
+// Sends a run of numbers, tagged with the producer's id in the top bits,
+// optionally after a delay.
+
+class Producer : public Thread
+{
+	IntMailbox&	mbox_;
+	int			id_, n_;
+	Duration	delay_;
+
+public:
+	enum { SHIFT = 24 };
+
+	Producer(IntMailbox& mbox, int id, int n, const Duration& delay=Duration(0))
+		: Thread(0), mbox_(mbox), id_(id), n_(n), delay_(delay) {}
+
+	virtual int run() {
+		if (delay_ > Duration(0))
+			Thread::sleep(delay_);
+		for (int i=0; i<n_; ++i)
+			mbox_.put((id_ << SHIFT) | i);
+		return 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+class MailboxTest : public TestFixture
+{
+	CPPUNIT_TEST_SUITE( MailboxTest );
+	CPPUNIT_TEST( test_order );
+	CPPUNIT_TEST( test_overflow );
+	CPPUNIT_TEST( test_timeout );
+	CPPUNIT_TEST( test_wakeup );
+	CPPUNIT_TEST( test_producers );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {
+	}
+
+	void tearDown() {
+	}
+
+	// Messages come out in order, and the pool nodes are reused over many
+	// trips around it.
+	void test_order() {
+		IntMailbox mbox(8);
+		int v;
+
+		CPPUNIT_ASSERT_EQUAL(size_t(8), mbox.capacity());
+		CPPUNIT_ASSERT(mbox.empty());
+		CPPUNIT_ASSERT(!mbox.tryget(&v));
+
+		for (int n=0; n<100; ++n) {
+			for (int i=0; i<8; ++i)
+				CPPUNIT_ASSERT(mbox.put(8*n + i));
+			for (int i=0; i<8; ++i) {
+				CPPUNIT_ASSERT(mbox.tryget(&v));
+				CPPUNIT_ASSERT_EQUAL(8*n + i, v);
+			}
+			CPPUNIT_ASSERT(mbox.empty());
+		}
+		CPPUNIT_ASSERT_EQUAL(size_t(0), mbox.num_overflow());
+	}
+
+	// Running out of pool nodes goes to the heap without losing anything.
+	void test_overflow() {
+		IntMailbox mbox(4);
+		int v;
+
+		for (int i=0; i<100; ++i)
+			mbox.put(i);
+		CPPUNIT_ASSERT_EQUAL(size_t(96), mbox.num_overflow());
+
+		for (int i=0; i<100; ++i) {
+			CPPUNIT_ASSERT(mbox.tryget(&v));
+			CPPUNIT_ASSERT_EQUAL(i, v);
+		}
+		CPPUNIT_ASSERT(!mbox.tryget(&v));
+
+		for (int i=0; i<4; ++i)
+			mbox.put(i);
+		CPPUNIT_ASSERT_EQUAL(size_t(96), mbox.num_overflow());
+	}
+
+	void test_timeout() {
+		IntMailbox mbox(4);
+		int v;
+
+		MonotonicTime start = MonotonicTime::now();
+		CPPUNIT_ASSERT(!mbox.get(&v, Duration(msec(20))));
+		CPPUNIT_ASSERT(MonotonicTime::now() - start >= Duration(msec(20)));
+	}
+
+	// A receiver parked on an empty mailbox is woken by a put.
+	void test_wakeup() {
+		IntMailbox mbox(4);
+		Producer prod(mbox, 0, 1, Duration(msec(20)));
+		int v = -1;
+
+		prod.activate();
+		mbox.get(&v);
+		CPPUNIT_ASSERT_EQUAL(0, v);
+
+		prod.wait();
+		CPPUNIT_ASSERT(!mbox.get(&v, Duration(msec(10))));
+	}
+
+	// Messages from each producer come out in the order it sent them.
+	void test_producers() {
+		const int N_PROD = 4, N = 50000;
+		IntMailbox mbox(256);
+		Producer* prod[N_PROD];
+		int next[N_PROD] = { 0 };
+
+		for (int i=0; i<N_PROD; ++i) {
+			prod[i] = new Producer(mbox, i, N);
+			prod[i]->activate();
+		}
+
+		for (int n=0; n<N_PROD*N; ++n) {
+			int v;
+			CPPUNIT_ASSERT(mbox.get(&v, Duration(sec(5))));
+			int id = v >> Producer::SHIFT,
+				seq = v & ((1 << Producer::SHIFT) - 1);
+			CPPUNIT_ASSERT(id >= 0 && id < N_PROD);
+			CPPUNIT_ASSERT_EQUAL(next[id], seq);
+			++next[id];
+		}
+		CPPUNIT_ASSERT(mbox.empty());
+
+		for (int i=0; i<N_PROD; ++i) {
+			prod[i]->wait();
+			delete prod[i];
+		}
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	CPPUNIT_TEST_SUITE_REGISTRATION( MailboxTest );
+
+	TextUi::TestRunner runner;
+	TestFactoryRegistry &registry = TestFactoryRegistry::getRegistry();
+
+	runner.addTest(registry.makeTest());
+	return (runner.run()) ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// PollableMsgQueueTest.cpp
+// 
+// CppUnit test for the CtrlrFx "PollableMsgQueue" class
+//
+
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/PollableMsgQueue.h"
+#include "CtrlrFx/Thread.h"
+#include <poll.h>
+
+using namespace CppUnit;
+using namespace CtrlrFx;
+
+typedef PollableMsgQueue<int> IntQueue;
+
+/////////////////////////////////////////////////////////////////////////////
+
+class Producer : public Thread
+{
+	IntQueue&	que_;
+	int			first_, n_;
+
+public:
+	Producer(IntQueue& que, int first, int n)
+		: Thread(0), que_(que), first_(first), n_(n) {}
+
+	virtual int run() {
+		for (int i=0; i<n_; ++i)
+			que_.put(first_ + i);
+		return 0;
+	}
+};
+
+// --------------------------------------------------------------------------
+
+static bool readable(const IntQueue& que)
+{
+	pollfd pfd;
+	pfd.fd = que.handle();
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return ::poll(&pfd, 1, 0) == 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+class PollableMsgQueueTest : public TestFixture
+{
+public:
+	CPPUNIT_TEST_SUITE( PollableMsgQueueTest );
+	CPPUNIT_TEST( test_putget );
+	CPPUNIT_TEST( test_signal );
+	CPPUNIT_TEST( test_timeouts );
+	CPPUNIT_TEST( test_blocked_producers );
+	CPPUNIT_TEST( test_drain_wakes_all );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {
+	}
+
+	void tearDown() {
+	}
+
+	void test_putget() {
+		IntQueue que(3);
+
+		CPPUNIT_ASSERT(que.is_valid());
+		CPPUNIT_ASSERT_EQUAL(size_t(3), que.capacity());
+		CPPUNIT_ASSERT(que.empty());
+
+		for (int n=0; n<10; ++n) {
+			CPPUNIT_ASSERT(que.tryput(3*n));
+			CPPUNIT_ASSERT(que.tryput(3*n+1));
+			CPPUNIT_ASSERT(que.tryput(3*n+2));
+			CPPUNIT_ASSERT(!que.tryput(-1));
+
+			int v;
+			for (int i=0; i<3; ++i) {
+				CPPUNIT_ASSERT(que.tryget(&v));
+				CPPUNIT_ASSERT_EQUAL(3*n+i, v);
+			}
+			CPPUNIT_ASSERT(!que.tryget(&v));
+		}
+	}
+
+	// The handle is readable exactly while there's data.
+	void test_signal() {
+		IntQueue que(4);
+		int v;
+
+		CPPUNIT_ASSERT(!readable(que));
+		que.put(1);
+		que.put(2);
+		CPPUNIT_ASSERT(readable(que));
+		que.get(&v);
+		CPPUNIT_ASSERT(readable(que));
+		que.get(&v);
+		CPPUNIT_ASSERT(!readable(que));
+	}
+
+	void test_timeouts() {
+		IntQueue que(1);
+		int v;
+
+		CPPUNIT_ASSERT(!que.get(&v, Duration(msec(10))));
+		CPPUNIT_ASSERT(que.put(5, Duration(msec(10))));
+		CPPUNIT_ASSERT(!que.put(6, Duration(msec(10))));
+		CPPUNIT_ASSERT(que.get(&v, Duration(msec(10))));
+		CPPUNIT_ASSERT_EQUAL(5, v);
+	}
+
+	// Several producers blocked on a full queue all get through as it's
+	// drained, and each one's items stay in order.
+	void test_blocked_producers() {
+		const int NPROD = 4, N = 1000;
+		IntQueue que(2);
+		Producer* prod[NPROD];
+
+		for (int i=0; i<NPROD; ++i) {
+			prod[i] = new Producer(que, i*N, N);
+			prod[i]->activate();
+		}
+
+		int next[NPROD] = { 0 };
+
+		for (int i=0; i<NPROD*N; ++i) {
+			int v;
+			CPPUNIT_ASSERT(que.get(&v, Duration(sec(2))));
+			int p = v / N;
+			CPPUNIT_ASSERT_EQUAL(next[p], v % N);
+			++next[p];
+		}
+
+		for (int i=0; i<NPROD; ++i) {
+			CPPUNIT_ASSERT(prod[i]->wait(Duration(sec(2))));
+			delete prod[i];
+		}
+		CPPUNIT_ASSERT(que.empty());
+	}
+
+	// Draining a full queue quickly must wake every blocked producer, not
+	// just the one that saw it go from full to not-full.
+	void test_drain_wakes_all() {
+		const int NPROD = 3;
+		IntQueue que(2);
+		Producer* prod[NPROD];
+
+		que.put(-1);
+		que.put(-1);
+
+		for (int i=0; i<NPROD; ++i) {
+			prod[i] = new Producer(que, i, 1);
+			prod[i]->activate();
+		}
+		Thread::sleep(Duration(msec(50)));
+
+		int v, n = 0;
+		while (que.tryget(&v))
+			++n;
+
+		while (n < 2+NPROD && que.get(&v, Duration(sec(1))))
+			++n;
+
+		CPPUNIT_ASSERT_EQUAL(2+NPROD, n);
+
+		for (int i=0; i<NPROD; ++i) {
+			CPPUNIT_ASSERT(prod[i]->wait(Duration(sec(2))));
+			delete prod[i];
+		}
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	CPPUNIT_TEST_SUITE_REGISTRATION( PollableMsgQueueTest );
+
+	TextUi::TestRunner runner;
+	TestFactoryRegistry &registry = TestFactoryRegistry::getRegistry();
+
+	runner.addTest(registry.makeTest());
+	return (runner.run()) ? 0 : 1;
+}
+
@@ -0,0 +1,240 @@
+// TimerServiceTest.cpp
+//
+// CppUnit test for the CtrlrFx "TimerService" and "TimerWheel" classes
+//
+
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/TimerService.h"
+#include "CtrlrFx/Semaphore.h"
+
+using namespace CppUnit;
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+// Counts timer events by posting a semaphore for each one.
+
+class Counter : public ITimerClient
+{
+public:
+	Semaphore sem;
+
+	virtual void on_timer(ITimer&) { sem.post(); }
+
+	// Takes all the events that have come in so far.
+	int take() {
+		int n = 0;
+		while (sem.trywait())
+			++n;
+		return n;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+class TimerServiceTest : public TestFixture
+{
+	enum { N_TMR = 8 };
+
+	TimerService*	svc_;
+	WheelTimer*		tmr_[N_TMR];
+
+	// Pops the next expired timer, making sure it comes out at its tick.
+	void expect(TimerWheel& w, int i, uint64_t tick) {
+		if (tick > 0)
+			CPPUNIT_ASSERT(w.pop_expired(tick-1) == 0);
+		CPPUNIT_ASSERT(w.next_event() <= tick);
+		CPPUNIT_ASSERT(w.pop_expired(tick) == tmr_[i]);
+		CPPUNIT_ASSERT_EQUAL(tick, w.now());
+	}
+
+	CPPUNIT_TEST_SUITE( TimerServiceTest );
+	CPPUNIT_TEST( test_wheel_order );
+	CPPUNIT_TEST( test_wheel_cascade );
+	CPPUNIT_TEST( test_wheel_cancel );
+	CPPUNIT_TEST( test_wheel_past );
+	CPPUNIT_TEST( test_one_shot );
+	CPPUNIT_TEST( test_periodic );
+	CPPUNIT_TEST( test_stop );
+	CPPUNIT_TEST( test_many );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	// The wheel tests only use the timers as wheel entries. They're never
+	// started, so the service doesn't touch them.
+	void setUp() {
+		svc_ = new TimerService(2);
+		for (int i=0; i<N_TMR; ++i)
+			tmr_[i] = new WheelTimer(*svc_);
+	}
+
+	void tearDown() {
+		for (int i=0; i<N_TMR; ++i)
+			delete tmr_[i];
+		delete svc_;
+	}
+
+	// Timers come out in expiration order, each at its own tick.
+	void test_wheel_order() {
+		TimerWheel w;
+
+		CPPUNIT_ASSERT(w.empty());
+		CPPUNIT_ASSERT(w.next_event() == TimerWheel::NEVER);
+
+		w.add(tmr_[0], 5);
+		w.add(tmr_[1], 1);
+		w.add(tmr_[2], 63);
+		w.add(tmr_[3], 3);
+		CPPUNIT_ASSERT_EQUAL(size_t(4), w.size());
+
+		expect(w, 1, 1);
+		expect(w, 3, 3);
+		expect(w, 0, 5);
+		expect(w, 2, 63);
+
+		CPPUNIT_ASSERT(w.pop_expired(1000) == 0);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1000), w.now());
+		CPPUNIT_ASSERT(w.empty());
+	}
+
+	// Timers in the higher wheels, and past the span of all of them, are
+	// cascaded down and fire on time.
+	void test_wheel_cascade() {
+		TimerWheel w;
+		const uint64_t FAR = TimerWheel::MAX_SPAN + 10;
+
+		w.add(tmr_[0], 64);
+		w.add(tmr_[1], 65);
+		w.add(tmr_[2], 4096 + 7);
+		w.add(tmr_[3], 300000);
+		w.add(tmr_[4], FAR);
+		w.add(tmr_[5], 2*FAR);
+
+		expect(w, 0, 64);
+		expect(w, 1, 65);
+		expect(w, 2, 4096 + 7);
+		expect(w, 3, 300000);
+		expect(w, 4, FAR);
+		expect(w, 5, 2*FAR);
+		CPPUNIT_ASSERT(w.empty());
+	}
+
+	// Removed timers never fire, whichever wheel they're in.
+	void test_wheel_cancel() {
+		TimerWheel w;
+
+		for (int i=0; i<N_TMR; ++i)
+			w.add(tmr_[i], uint64_t(1) << (3*i));
+
+		// Move far enough that some timers have cascaded
+		expect(w, 0, 1);
+		expect(w, 1, 8);
+		CPPUNIT_ASSERT(w.pop_expired(60) == 0);
+
+		w.remove(tmr_[3]);		// 512
+		w.remove(tmr_[4]);		// 4096
+		w.remove(tmr_[7]);		// 2M
+		w.remove(tmr_[7]);		// Not in the wheel
+		CPPUNIT_ASSERT_EQUAL(size_t(3), w.size());
+
+		expect(w, 2, 64);
+		expect(w, 5, 32768);
+		expect(w, 6, 262144);
+		CPPUNIT_ASSERT(w.empty());
+		CPPUNIT_ASSERT(w.next_event() == TimerWheel::NEVER);
+		CPPUNIT_ASSERT(w.pop_expired(TimerWheel::MAX_SPAN) == 0);
+	}
+
+	// A timer added at or before the current tick is due right away.
+	void test_wheel_past() {
+		TimerWheel w;
+
+		CPPUNIT_ASSERT(w.pop_expired(500) == 0);
+		w.add(tmr_[0], 100);
+		w.add(tmr_[1], 500);
+		CPPUNIT_ASSERT(w.pop_expired(500) != 0);
+		CPPUNIT_ASSERT(w.pop_expired(500) != 0);
+		CPPUNIT_ASSERT(w.pop_expired(500) == 0);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(500), w.now());
+	}
+
+	void test_one_shot() {
+		Counter cnt;
+		WheelTimer tmr(*svc_, cnt);
+
+		MonotonicTime start = MonotonicTime::now();
+		tmr.one_shot(Duration(msec(20)));
+		CPPUNIT_ASSERT(tmr.is_active());
+
+		CPPUNIT_ASSERT(cnt.sem.wait(Duration(sec(2))));
+		CPPUNIT_ASSERT(MonotonicTime::now() - start >= Duration(msec(20)));
+		CPPUNIT_ASSERT(!tmr.is_active());
+
+		Thread::sleep(Duration(msec(50)));
+		CPPUNIT_ASSERT_EQUAL(0, cnt.take());
+	}
+
+	void test_periodic() {
+		Counter cnt;
+		WheelTimer tmr(*svc_, cnt);
+
+		tmr.start(Duration(msec(5)));
+		for (int i=0; i<5; ++i)
+			CPPUNIT_ASSERT(cnt.sem.wait(Duration(sec(2))));
+		tmr.stop();
+
+		CPPUNIT_ASSERT(!tmr.is_active());
+		cnt.take();
+		Thread::sleep(Duration(msec(30)));
+		CPPUNIT_ASSERT_EQUAL(0, cnt.take());
+	}
+
+	void test_stop() {
+		Counter cnt;
+		WheelTimer tmr(*svc_, cnt);
+
+		tmr.one_shot(Duration(msec(30)));
+		CPPUNIT_ASSERT_EQUAL(size_t(1), svc_->num_active());
+		tmr.stop();
+		CPPUNIT_ASSERT_EQUAL(size_t(0), svc_->num_active());
+
+		Thread::sleep(Duration(msec(80)));
+		CPPUNIT_ASSERT_EQUAL(0, cnt.take());
+	}
+
+	// Lots of timers, spread over the dispatch threads, each fire once.
+	void test_many() {
+		const int N = 200;
+		Counter cnt;
+		WheelTimer* tmr[N];
+
+		for (int i=0; i<N; ++i) {
+			tmr[i] = new WheelTimer(*svc_, cnt);
+			tmr[i]->one_shot(Duration(msec((i * 7) % 100)));
+		}
+
+		for (int i=0; i<N; ++i)
+			CPPUNIT_ASSERT(cnt.sem.wait(Duration(sec(2))));
+
+		Thread::sleep(Duration(msec(20)));
+		CPPUNIT_ASSERT_EQUAL(0, cnt.take());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), svc_->num_active());
+
+		for (int i=0; i<N; ++i)
+			delete tmr[i];
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	CPPUNIT_TEST_SUITE_REGISTRATION( TimerServiceTest );
+
+	TextUi::TestRunner runner;
+	TestFactoryRegistry &registry = TestFactoryRegistry::getRegistry();
+
+	runner.addTest(registry.makeTest());
+	return (runner.run()) ? 0 : 1;
+}
@@ -5,14 +5,14 @@
 // It is a utility program to forward packets from a TCP connection to a
 // device communications port, such as a serial port. It demonstrates the
 // use of a number of low-level CtrlrFx communications classes.
-// It uses a separate thread to monitor communications in each direction.
-// On a specific OS this might be done more efficiently with a select()
-// but this demonstrates simple multitasking.
+// The data is moved in both directions by a DevForwarder, which waits on
+// the device and the socket together, so it needs no extra threads and
+// forwards data as soon as it arrives.
 // 
 // DEMONSTRATES:
 // 		- Low-level TCP socket (server) classes: TcpAcceptor, Socket
-// 		- Low-level Device Communications: InDevice, OutDevice
-// 		- Simple Mulit-Threaded programming: Thread
+// 		- Low-level Device Communications: Device
+// 		- Event-driven forwarding: DevForwarder
 // 
 // AUTHOR:
 //		Frank Pagliughi
@@ -24,10 +24,9 @@
 #include <errno.h>
 #include "CtrlrFx/CtrlrFx.h"
 #include "CtrlrFx/os.h"
-#include "CtrlrFx/Buffer.h"
 #include "CtrlrFx/TcpAcceptor.h"
-#include "CtrlrFx/Thread.h"
 #include "CtrlrFx/Device.h"
+#include "CtrlrFx/DevForwarder.h"
 
 // TODO: Replace this with framework TRACING when it's fixed.
 #define TRACE printf
@@ -37,83 +36,18 @@ using namespace CtrlrFx;
 
 const uint16_t		PORT = 2233;
 const char * const 	DEVICE = "/dev/ttyS0";
-const int			BUF_SIZE = 4096;
-
-/////////////////////////////////////////////////////////////////////////////
-// The device monitor thread. It reads packets from the device and sends
-// them to the TCP port.
-
-class DevMonThread : public Thread
-{
-	TcpSocket& 		sock_;
-	const char 		*devname_;
-	
-protected:
-	virtual int run();
-
-public:
-	DevMonThread(TcpSocket& sock, const char *devname)
-		: Thread(PRIORITY_ABOVE_NORMAL), sock_(sock), devname_(devname) {}
-
-	virtual void quit() {
-		quit_ = true;
-		wait();
-	}
-};
-
-// --------------------------------------------------------------------------
-// This is the active thread function to monitor incoming data on the device.
-// The thread is only run while the TCP socket is open. 
-//
-// We open a handle to the device and wait for incoming data. To allow for
-// a clean termination of the thread, we open the device in non-blocking
-// mode and essentially poll it.
-//
-// Data read from the device is just sent out the socket.
-
-int DevMonThread::run()
-{
-	TRACE("DevMonThread: Started\n");
-
-	InDevice idev(devname_, O_NONBLOCK);
-	
-	if (!idev.is_open()) {
-		TRACE("DevMonThread: Error opening the input device\n");
-		return -1;
-	}
-
-	byte		bufmem[BUF_SIZE];
-	ByteBuffer	buf(bufmem, BUF_SIZE);
-	
-	while (!quit_) {
-		if (idev.read(buf.clear()) < 0) {
-			if (errno != EWOULDBLOCK)
-				TRACE("DevMonThread: Error reading from the device: %d\n", errno);
-			sleep(250);
-		}
-		else
-			sock_.write(buf.flip());
-	}
-	
-	TRACE("DevMonThread: Done\n");
-	return 0;
-}
 
 ////////////////////////////////////////////////////////////////////////////
 // The main thread waits for incoming TCP connections. When one arrives, 
-// a socket is opened, a thread is started to monitor the incoming device
-// data, and we monitor incoming data on the socket.
-// When the socket is closed by the client, we close the device thread,
-// and the device itself, and await another incoming TCP connection.
+// the device is opened, and the data is forwarded between the device and
+// the socket until the client closes the connection. Then the device is
+// closed, and we await another incoming TCP connection.
 // 
-// This is essentially single-threaded in regards to the incoming TCP 
-// connection and can only service one connection at a time.
+// This can only service one connection at a time.
 
 int App::main(int, char **)
 {
-	//int			n;
-	byte		bufmem[BUF_SIZE];
-	ByteBuffer	buf(bufmem, BUF_SIZE);
+	Socket::initialize();
 
 	// ----- Create a TCP acceptor -----
 
@@ -139,32 +73,30 @@ int App::main(int, char **)
 
 		// ----- We've got a connection. -----
 
-		DevMonThread dev_thread(sock, DEVICE);
-		dev_thread.activate();
-		
-		OutDevice odev(DEVICE);
-		if (!odev.is_open()) {
-			TRACE("Main: Error opening output device");
+		Device dev;
+		if (dev.open(DEVICE, O_NOCTTY) < 0) {
+			TRACE("Main: Error opening the device\n");
 			return -1;
 		}
 
-		StdOutDevice stddev;
-		
-		// ----- Read incoming data on the TCP socket & send to dev -----
+		sock.no_delay();
 
-		while (sock.read(buf.clear()) > 0) {
-			stddev.write(buf.flip());
-			odev.write(buf.rewind());
-		}
+		DevForwarder fwd(dev, dev, sock);
+		fwd.end_on_sock_close();
+
+		if (fwd.run() < 0)
+			TRACE("Main: Forwarding error: %d\n", fwd.error());
 
-		// ----- Connection closed by client -----
+		// ----- Connection closed -----
 
-		TRACE("Main: Connection closed. Cleaning up...\n");
-		dev_thread.quit();
+		TRACE("Main: Connection closed after %lu bytes in, %lu bytes out.\n",
+			  (unsigned long) fwd.bytes(DevForwarder::SOCK_TO_DEV),
+			  (unsigned long) fwd.bytes(DevForwarder::DEV_TO_SOCK));
 		sock.close();
-		odev.close();
+		dev.close();
 		TRACE("Ok\n");
 	}
 	
 	return 0;	
 }
+
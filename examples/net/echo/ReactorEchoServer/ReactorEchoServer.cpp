@@ -0,0 +1,151 @@
+// ReactorEchoServer.cpp
+// Event-driven TCP echo server built with CtrlrFx.
+//
+// CtrlrFx Example Application.
+//
+// This application demonstrates the Reactor and ReactorPool classes. The
+// main thread runs a reactor that accepts incoming connections, and hands
+// each one to the next reactor in a pool, with one reactor thread per CPU.
+// Each connection is then serviced entirely by its reactor's thread, in
+// edge-triggered mode, so a handful of threads can service thousands of
+// connections. The main reactor also handles SIGINT through a signalfd,
+// and prints statistics from a timerfd, to shut down cleanly.
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/os.h"
+#include "CtrlrFx/Reactor.h"
+#include "CtrlrFx/AtomicOps.h"
+#include "CtrlrFx/debug.h"
+#include <sys/signalfd.h>
+#include <errno.h>
+
+using namespace std;
+using namespace CtrlrFx;
+
+const int		BUF_SIZE	= 4096;		// The read buffer size
+const uint16_t	TCP_PORT	= 12345;	// The TCP server's port
+const int		QUE_SIZE	= 128;		// The listen queue size
+
+volatile int	nConn = 0;				// The number of open connections
+
+/////////////////////////////////////////////////////////////////////////////
+// Handles a single connection. It's created when the connection arrives,
+// and deletes itself when the client closes it.
+// Since the socket is non-blocking and edge-triggered, each readable
+// event reads until the socket is drained. For brevity, a short write
+// drops the rest of the data rather than waiting for the socket to become
+// writable.
+
+class EchoConnHandler : public IoHandler<TcpSocket>
+{
+	TcpSocket	sock_;
+
+	void close() {
+		reactor()->remove(*this);
+		atomic_fetch_add(&nConn, -1);
+		delete this;
+	}
+
+public:
+	EchoConnHandler(TcpSocket& sock) : IoHandler<TcpSocket>(sock_), sock_(sock) {
+		atomic_fetch_add(&nConn, 1);
+	}
+
+	virtual void on_readable() {
+		byte buf[BUF_SIZE];
+		ssize_t n;
+
+		while ((n = sock_.read(buf, BUF_SIZE)) > 0)
+			sock_.write(buf, n);
+
+		if (n == 0 || errno != EAGAIN)
+			close();
+	}
+
+	virtual void on_error(uint32_t) { close(); }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Accepts connections and spreads them across the reactor pool.
+
+class EchoAcceptor : public AcceptHandler
+{
+	ReactorPool& pool_;
+
+public:
+	EchoAcceptor(TcpAcceptor& acc, ReactorPool& pool)
+					: AcceptHandler(acc), pool_(pool) {}
+
+	virtual void on_accept(TcpSocket& sock) {
+		EchoConnHandler* h = new EchoConnHandler(sock);
+		pool_.next().add(*h, EventHandler::READ, Reactor::EDGE);
+	}
+};
+
+// --------------------------------------------------------------------------
+// Stops the main reactor on a Ctrl-C.
+
+class QuitHandler : public SignalHandler
+{
+public:
+	QuitHandler() : SignalHandler(SIGINT) {}
+
+	virtual void on_signal(int, const signalfd_siginfo&) {
+		DPRINTF("Shutting down.\n");
+		reactor()->stop();
+	}
+};
+
+// --------------------------------------------------------------------------
+// Reports the number of open connections.
+
+class StatsReporter : public ITimerClient
+{
+public:
+	virtual void on_timer(ITimer&) {
+		DPRINTF("%d connection(s)\n", int(nConn));
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+int App::main(int, char**)
+{
+	// Not required on all platforms, but harmless either way.
+	Socket::initialize();
+
+	// The reactor must outlive the handlers registered with it, and the
+	// signal must be blocked before the pool threads are created.
+	Reactor		reactor;
+	QuitHandler	quit;
+
+	TcpAcceptor	acceptor(TCP_PORT, QUE_SIZE);
+
+	if (!acceptor) {
+		DPRINTF("Error opening incoming TCP port.\n");
+		return -1;
+	}
+
+	ReactorPool		pool(0, true);
+
+	EchoAcceptor	accHandler(acceptor, pool);
+	StatsReporter	stats;
+	TimerFdTimer	tmr(stats);
+	TimerFdHandler	tmrHandler(tmr);
+
+	reactor.add(accHandler, EventHandler::READ, Reactor::EDGE);
+	reactor.add(tmrHandler, EventHandler::READ);
+	reactor.add(quit, EventHandler::READ);
+
+	tmr.start(Duration(sec(5)));
+
+	DPRINTF("Echo server on port %u with %d reactor(s)...\n",
+			unsigned(TCP_PORT), pool.size());
+
+	reactor.run();
+
+	tmr.stop();
+	pool.stop();
+	return 0;
+}
+
@@ -2,70 +2,73 @@
 //
 // This is a Controller Framework example program demonstrating how to create
 // threads that run periodically.
-// 
-// This example only works on platforms that have a wait_until(absolute time)
-// method in their semaphores. Note that the threads are scheduled to run 
-// periodically, but may jitter due to scheduling issues. Better timing is
-// achieved by using Timer objects that execute in interrupt or other high
-// priority context.
+//
+// The threads derive from the library's PeriodicThread class, which calls
+// the cycle() function at absolute release times on the monotonic clock,
+// and measures the wakeup latency and execution time of each cycle. The
+// threads are scheduled to run periodically, but may jitter due to
+// scheduling issues. The statistics printed at the end show how much.
 //
 
 #include "CtrlrFx/CtrlrFx.h"
 #include "CtrlrFx/os.h"
+#include "CtrlrFx/PeriodicThread.h"
 #include "CtrlrFx/debug.h"
 
 using namespace CtrlrFx;
 
 /////////////////////////////////////////////////////////////////////////////
-// This is the periodic thread. It derives from the CtrlrFx thread class
-// and overrides the run method to implement the periodic behavior.
+// This is the periodic thread. It derives from the CtrlrFx periodic thread
+// class and overrides the cycle method to implement the periodic behavior.
 
-class PeriodicThread : public Thread
+class ClickThread : public PeriodicThread
 {
-	Duration	period_;
-	Semaphore	quitSem_;
+	unsigned n_;
 
-	virtual int run();
+	virtual void cycle() {
+		DPRINTF("%s: clicked [%u]\n", name(), ++n_);
+	}
 
 public:
 	// We construct the thread and start it running by calling activate()
-	PeriodicThread(const Duration& per, int prio, const char *name)
-			: Thread(prio, DFLT_STACK_SIZE, name), period_(per) {
+	ClickThread(const Duration& per, int prio, const char *name)
+			: PeriodicThread(per, prio, DFLT_STACK_SIZE, name), n_(0) {
 		activate();
 	}
 
-	// When the user want to quit we post the "quit semaphore" 
-	// to signal  the run() method to exit.
-	virtual void quit() { quitSem_.post(); }
+	// Prints the timing statistics for the thread.
+	void print_stats() const;
 };
 
 // --------------------------------------------------------------------------
-// The thread function. This loops until another thread sets the "quit
-// semaphore" indicating the funtion, and thus thread, should exit.
-// The thread sleeps on a wait of the semaphore. The wait normally fails,
-// which, in this case, is the expected behavior. The wait times out when
-// the thread should be scheduled to run. 
-// The thread then runs its periodic task (in this case prints a message
-// to the debug output). It then updates the time for the next sleep by 
-// adding the desired time period to the previous timeout time. Thus the
-// trigger time will not be dependent on the time for the task as long as
-// the task completes within the time period.
-
-int PeriodicThread::run()
+// Prints the min/avg/max of the wakeup latency and execution time, in
+// microseconds, followed by the non-empty bins of the latency histogram.
+
+void ClickThread::print_stats() const
 {
-	unsigned	n = 0;
-	Time		t = Time::from_now(period_);
+	Stats st = stats();
+
+	printf("%s: %u cycles, %u overruns\n", name(),
+		   unsigned(st.cycles), unsigned(st.overruns));
 
-	while (!quitSem_.wait_until(t)) {
-		DPRINTF("%s: clicked [%u]\n", name(), ++n);
-		t += period_;
+	printf("  latency: min %ldus, avg %ldus, max %ldus\n",
+		   long(st.latency.min/1000), long(st.latency.avg()/1000),
+		   long(st.latency.max/1000));
+
+	printf("  exec:    min %ldus, avg %ldus, max %ldus\n",
+		   long(st.exec.min/1000), long(st.exec.avg()/1000),
+		   long(st.exec.max/1000));
+
+	for (int i=0; i<CycleStats::N_BINS; ++i) {
+		if (st.latency.hist[i] != 0)
+			printf("  >= %10ldns: %u\n", long(CycleStats::bin_floor(i)),
+				   unsigned(st.latency.hist[i]));
 	}
-	return 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // The main routine (thread) creates two periodic threads: one that runs at
-// one second intervals and one that runs at five second intervals. Main 
+// one second intervals and one that runs at five second intervals. Main
 // then just sleeps and lets the two threads run.
 // On a desk-top target, the user can just hit <ENTER> to stop the threads
 // and end the program.
@@ -74,11 +77,11 @@ int App::main(int, char**)
 {
 	// ----- Create and start the threads -----
 
-	PeriodicThread	oneSecThread(sec(1.0), 
-								 Thread::PRIORITY_ABOVE_NORMAL + Thread::PRIORITY_INCREASE,
-								 "OneSec Thread"),
-					fiveSecThread(sec(5.0), Thread::PRIORITY_ABOVE_NORMAL,
-								  "FiveSec Thread");
+	ClickThread	oneSecThread(sec(1.0),
+							 Thread::PRIORITY_ABOVE_NORMAL + Thread::PRIORITY_INCREASE,
+							 "OneSec Thread"),
+				fiveSecThread(sec(5.0), Thread::PRIORITY_ABOVE_NORMAL,
+							  "FiveSec Thread");
 
 	// ----- This thread (main) just waits for user abort -----
 
@@ -97,6 +100,9 @@ int App::main(int, char**)
 	oneSecThread.wait();
 	fiveSecThread.wait();
 
+	oneSecThread.print_stats();
+	fiveSecThread.print_stats();
+
 	return 0;
 }
 
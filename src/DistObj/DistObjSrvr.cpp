@@ -4,6 +4,7 @@
 #include "CtrlrFx/CtrlrFx.h"
 #include "CtrlrFx/DistObjSrvr.h"
 #include "CtrlrFx/BinDistObj.h"
+#include "CtrlrFx/ConnectionPool.h"
 #include "CtrlrFx/FixedBuffer.h"
 #include "CtrlrFx/debug.h"
 #include "CtrlrFx/error.h"
@@ -86,44 +87,77 @@ int DistObjSrvr::register_obj(key_t key, IDistObj* obj)
 }
 
 // --------------------------------------------------------------------------
-// Send a packet to the remote server.
+// Send a packet to the remote server and wait for the response.
+// The header and payload go out with a single gather write, and the two
+// response headers come back with a single scatter read.
 
-int DistObjSrvr::send(byte msg_type, ByteBuffer& packet, ByteBuffer& rsp)
+int DistObjSrvr::transact(IDevice& port, byte msg_type, ByteBuffer& packet,
+						  ByteBuffer& rsp)
 {
 	// TODO: Set real byte order
 	BinPktHdr	pkt_hdr = { { 'C', 'X' }, 0, msg_type, (uint32_t) packet.available() },
 				rsp_pkt_hdr;
 	BinRspHdr	rsp_hdr;
 
-	MyGuard g(lock_);
+	ByteBuffer	pkt_hdr_buf(reinterpret_cast<byte*>(&pkt_hdr), sizeof(pkt_hdr)),
+				rsp_pkt_hdr_buf(reinterpret_cast<byte*>(&rsp_pkt_hdr), sizeof(rsp_pkt_hdr)),
+				rsp_hdr_buf(reinterpret_cast<byte*>(&rsp_hdr), sizeof(rsp_hdr));
+
+	ByteBuffer* out_bufs[] = { &pkt_hdr_buf, &packet };
+	ByteBuffer* in_bufs[] = { &rsp_pkt_hdr_buf, &rsp_hdr_buf };
 
 	// Send the packet
 	
-	if (port_->write_n(&pkt_hdr, sizeof(pkt_hdr)) < 0)
-		return -CFXE_PACKET_WRITE;
-
-	if (port_->write_n(packet) < 0)
+	if (port.writev_n(out_bufs, 2) < 0)
 		return -CFXE_PACKET_WRITE;
 
 	// Wait for a response
 
-	if (port_->read_n(&rsp_pkt_hdr, sizeof(rsp_pkt_hdr)) != sizeof(rsp_pkt_hdr))
-		return -CFXE_PACKET_READ;
-
-	if (port_->read_n(&rsp_hdr, sizeof(rsp_hdr)) != sizeof(rsp_pkt_hdr))
+	if (port.readv_n(in_bufs, 2) != int(sizeof(rsp_pkt_hdr) + sizeof(rsp_hdr)))
 		return -CFXE_PACKET_READ;
 
 	uint32_t n = rsp_pkt_hdr.msg_size - sizeof(rsp_hdr);
 
 	if (n != 0) {
 		rsp.size(n);
-		port_->read_n(rsp);
+		if (port.read_n(rsp) != int(n))
+			return -CFXE_PACKET_READ;
 		rsp.flip();
 	}
 
 	return (int) rsp_hdr.reply;
 }
 
+// --------------------------------------------------------------------------
+// Send a packet to the remote server over our port.
+
+int DistObjSrvr::send(byte msg_type, ByteBuffer& packet, ByteBuffer& rsp)
+{
+	MyGuard g(lock_);
+	return transact(*port_, msg_type, packet, rsp);
+}
+
+// --------------------------------------------------------------------------
+// Send a packet to the remote server over a pooled connection.
+// A connection that failed part way through an exchange is out of step
+// with the server, so it's closed rather than put back.
+
+int DistObjSrvr::send(ConnectionPool& pool, const SockAddr& addr,
+					  byte msg_type, ByteBuffer& packet, ByteBuffer& rsp)
+{
+	PooledConnection conn(pool, addr);
+
+	if (!conn.is_open())
+		return -CFXE_PACKET_WRITE;
+
+	int ret = transact(conn.socket(), msg_type, packet, rsp);
+
+	if (ret == -CFXE_PACKET_WRITE || ret == -CFXE_PACKET_READ)
+		conn.discard();
+
+	return ret;
+}
+
 // --------------------------------------------------------------------------
 // Signal the run routine to quit.
 
@@ -148,6 +182,14 @@ int DistObjSrvr::run()
 	BinNativeDecoder cmd_decoder(cmd_buf_);
 	BinNativeEncoder rsp_encoder(rsp_buf_);
 
+	// The response goes out as a single gather write of the two headers
+	// and the body.
+
+	ByteBuffer	pkt_hdr_buf(reinterpret_cast<byte*>(&pkt_hdr), sizeof(pkt_hdr)),
+				rsp_hdr_buf(reinterpret_cast<byte*>(&rsp_hdr), sizeof(rsp_hdr));
+
+	ByteBuffer* rsp_bufs[] = { &pkt_hdr_buf, &rsp_hdr_buf, &rsp_buf_ };
+
 	while (!quit_) {
 
 		int n = get_pkt_hdr(&pkt_hdr);
@@ -222,12 +264,11 @@ int DistObjSrvr::run()
 
 		DPRINTF3("DistObjSrvr: Returning %u byte response\n", (unsigned) rsp_buf_.available());
 
-		g.acquire();
-		port_->write_n(&pkt_hdr, sizeof(pkt_hdr));
-		port_->write_n(&rsp_hdr, sizeof(rsp_hdr));
+		pkt_hdr_buf.rewind();
+		rsp_hdr_buf.rewind();
 
-		if (pkt_hdr.msg_size > 0)
-			port_->write_n(rsp_buf_);
+		g.acquire();
+		port_->writev_n(rsp_bufs, 3);
 	}
 
 	return 0;
@@ -0,0 +1,376 @@
+// DistObjTcpServer.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+
+#if defined(__linux__)
+
+#include "CtrlrFx/DistObjTcpServer.h"
+#include "CtrlrFx/BinDistObj.h"
+#include "CtrlrFx/debug.h"
+#include <sys/socket.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+//								Connection
+/////////////////////////////////////////////////////////////////////////////
+
+/// One client connection.
+/// This only ever runs on the thread of the reactor it's registered with,
+/// and it deletes itself when the client goes away.
+
+class DistObjTcpServer::Connection : public EventHandler
+{
+	enum { PKT_HDR_SIZE = sizeof(BinPktHdr) };
+	enum { RSP_HDR_SIZE = sizeof(BinPktHdr) + sizeof(BinRspHdr) };
+
+	DistObjTcpServer&	srvr_;		///< The server
+	TcpSocket			sock_;		///< The client's socket
+	byte*				ibuf_;		///< Received data not yet processed
+	size_t				ilen_;		///< The amount of data in ibuf_
+	size_t				icap_;		///< The size of ibuf_
+	byte*				obuf_;		///< Responses not yet sent
+	size_t				opos_;		///< The start of the unsent data
+	size_t				olen_;		///< The end of the unsent data
+	size_t				ocap_;		///< The size of obuf_
+	bool				blocked_;	///< Whether we're out of output space
+
+	/// Handles a single command packet.
+	void dispatch(const BinPktHdr& hdr, byte* cmd);
+
+	/// Processes all the complete packets in the input buffer.
+	int process();
+
+	/// Sends as much of the output as the socket will take.
+	int flush();
+
+	/// Reads, processes, and responds, until the socket would block.
+	void service();
+
+	/// Makes room in the output buffer for a full response.
+	bool make_room();
+
+public:
+	Connection(DistObjTcpServer& srvr, TcpSocket& sock);
+	virtual ~Connection();
+
+	Connection	*prev,	///< The previous connection in the server's list
+				*next;	///< The next connection in the server's list
+
+	virtual int handle() const { return sock_.handle(); }
+	virtual void on_readable() { service(); }
+	virtual void on_writable() { service(); }
+	virtual void on_error(uint32_t events);
+};
+
+// --------------------------------------------------------------------------
+
+DistObjTcpServer::Connection::Connection(DistObjTcpServer& srvr, TcpSocket& sock)
+				: srvr_(srvr), sock_(sock), ilen_(0), opos_(0), olen_(0),
+					blocked_(false), prev(0), next(0)
+{
+	icap_ = PKT_HDR_SIZE + srvr_.maxPkt_;
+	ocap_ = srvr_.outSize_;
+	ibuf_ = new byte[icap_];
+	obuf_ = new byte[ocap_];
+}
+
+DistObjTcpServer::Connection::~Connection()
+{
+	delete[] ibuf_;
+	delete[] obuf_;
+}
+
+// --------------------------------------------------------------------------
+
+void DistObjTcpServer::Connection::on_error(uint32_t /*events*/)
+{
+	DPRINTF3("DistObjTcpServer: Client disconnected\n");
+	srvr_.remove(this);
+	delete this;
+}
+
+// --------------------------------------------------------------------------
+// The response is built right in the output buffer, behind room left for
+// its headers, which are filled in once its size is known.
+
+void DistObjTcpServer::Connection::dispatch(const BinPktHdr& hdr, byte* cmd)
+{
+	ByteBuffer			cmd_buf(cmd, hdr.msg_size),
+						rsp_buf(obuf_ + olen_ + RSP_HDR_SIZE, srvr_.maxPkt_);
+	BinNativeDecoder	cmd_decoder(cmd_buf);
+	BinNativeEncoder	rsp_encoder(rsp_buf);
+	BinCmdHdr			cmd_hdr;
+
+	cmd_decoder.get_uint32(&cmd_hdr.msg_id);
+	cmd_decoder.get_uint32(&cmd_hdr.tgt_obj);
+	cmd_decoder.get_uint32(&cmd_hdr.operation);
+
+	DPRINTF3("DistObjTcpServer: Got command request, Obj: 0x%08x, Op: %u\n",
+				(unsigned) cmd_hdr.tgt_obj, (unsigned) cmd_hdr.operation);
+
+	int ret = srvr_.dispatch(cmd_hdr.tgt_obj, cmd_hdr.operation,
+							 cmd_decoder, rsp_encoder);
+
+	if (ret < 0) {
+		DPRINTF("DistObjTcpServer: Command failed with code: %d\n", ret);
+	}
+
+	rsp_buf.flip();
+
+	BinPktHdr	pkt_hdr = hdr;
+	BinRspHdr	rsp_hdr;
+
+	pkt_hdr.msg_type = BIN_MSG_TYPE_RSP;
+	pkt_hdr.msg_size = uint32_t(sizeof(rsp_hdr) + rsp_buf.available());
+
+	rsp_hdr.msg_id = cmd_hdr.msg_id;
+	rsp_hdr.reply = ret;
+
+	memcpy(obuf_ + olen_, &pkt_hdr, sizeof(pkt_hdr));
+	memcpy(obuf_ + olen_ + sizeof(pkt_hdr), &rsp_hdr, sizeof(rsp_hdr));
+
+	olen_ += sizeof(pkt_hdr) + pkt_hdr.msg_size;
+}
+
+// --------------------------------------------------------------------------
+
+bool DistObjTcpServer::Connection::make_room()
+{
+	size_t need = RSP_HDR_SIZE + srvr_.maxPkt_;
+
+	if (ocap_ - olen_ >= need)
+		return true;
+
+	if (opos_ > 0) {
+		memmove(obuf_, obuf_ + opos_, olen_ - opos_);
+		olen_ -= opos_;
+		opos_ = 0;
+	}
+	return ocap_ - olen_ >= need;
+}
+
+// --------------------------------------------------------------------------
+// Like DistObjSrvr::get_pkt_hdr(), anything ahead of the "CX" that starts
+// a packet is thrown away. A packet that can't fit in the input buffer is
+// a protocol error, since the stream can't be resynchronized past it.
+// Processing stops, leaving the rest of the input, when there's no room
+// for another response.
+
+int DistObjTcpServer::Connection::process()
+{
+	size_t pos = 0;
+	int ret = 0;
+
+	blocked_ = false;
+
+	while (true) {
+		while (pos < ilen_ && (ibuf_[pos] != 'C' ||
+				(pos+1 < ilen_ && ibuf_[pos+1] != 'X')))
+			++pos;
+
+		if (ilen_ - pos < size_t(PKT_HDR_SIZE))
+			break;
+
+		BinPktHdr hdr;
+		memcpy(&hdr, ibuf_ + pos, sizeof(hdr));
+
+		if (hdr.msg_size > srvr_.maxPkt_) {
+			DPRINTF("DistObjTcpServer: %u byte packet is too big\n",
+					(unsigned) hdr.msg_size);
+			ret = -1;
+			break;
+		}
+
+		if (ilen_ - pos < PKT_HDR_SIZE + hdr.msg_size)
+			break;
+
+		if (hdr.msg_type != BIN_MSG_TYPE_CMD) {
+			DPRINTF("Received something other than command: %u\n",
+					(unsigned) hdr.msg_type);
+		}
+		else if (!make_room()) {
+			blocked_ = true;
+			break;
+		}
+		else
+			dispatch(hdr, ibuf_ + pos + PKT_HDR_SIZE);
+
+		pos += PKT_HDR_SIZE + hdr.msg_size;
+	}
+
+	if (pos > 0) {
+		memmove(ibuf_, ibuf_ + pos, ilen_ - pos);
+		ilen_ -= pos;
+	}
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+
+int DistObjTcpServer::Connection::flush()
+{
+	while (opos_ < olen_) {
+		ssize_t n = ::send(sock_.handle(), obuf_ + opos_, olen_ - opos_,
+						   MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+		opos_ += size_t(n);
+	}
+
+	if (opos_ == olen_)
+		opos_ = olen_ = 0;
+
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// The connection is edge-triggered, so each call keeps going until the
+// socket would block, or until the client stops taking responses. In the
+// latter case, the rest of its commands stay in the kernel until the
+// socket turns writable again.
+// All the responses to a batch of commands go out together.
+
+void DistObjTcpServer::Connection::service()
+{
+	while (true) {
+		if (process() < 0 || flush() < 0)
+			break;
+
+		if (blocked_) {
+			if (opos_ < olen_)
+				return;
+			continue;
+		}
+
+		ssize_t n = ::recv(sock_.handle(), ibuf_ + ilen_, icap_ - ilen_, 0);
+
+		if (n > 0) {
+			ilen_ += size_t(n);
+			continue;
+		}
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+		}
+		break;
+	}
+
+	on_error(0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								DistObjTcpServer
+/////////////////////////////////////////////////////////////////////////////
+
+DistObjTcpServer::DistObjTcpServer(ReactorPool& pool,
+								   size_t maxPktSize /*=DFLT_MAX_PKT_SIZE*/,
+								   size_t outBufSize /*=DFLT_OUT_BUF_SIZE*/)
+					: acc_(pool, *this), maxPkt_(maxPktSize),
+						outSize_(outBufSize), conns_(0), nconn_(0)
+{
+	size_t minOut = sizeof(BinPktHdr) + sizeof(BinRspHdr) + maxPkt_;
+	if (outSize_ < minOut)
+		outSize_ = minOut;
+}
+
+DistObjTcpServer::~DistObjTcpServer()
+{
+	close();
+}
+
+// --------------------------------------------------------------------------
+
+int DistObjTcpServer::register_obj(key_t key, IDistObj* obj)
+{
+	MyGuard g(lock_);
+	return obj_reg_.register_obj(key, obj);
+}
+
+// --------------------------------------------------------------------------
+
+int DistObjTcpServer::dispatch(key_t obj, IDistObj::op_t op,
+							   BufDecoder& param, BufEncoder& rsp)
+{
+	MyGuard g(lock_);
+	return obj_reg_.dispatch(obj, op, param, rsp);
+}
+
+// --------------------------------------------------------------------------
+// This is called from the thread of the reactor that accepted the
+// connection, so anything the client already sent is picked up as soon as
+// the connection is registered.
+
+void DistObjTcpServer::on_accept(TcpSocket& sock, Reactor& r)
+{
+	Connection* conn = new Connection(*this, sock);
+
+	MyGuard g(connLock_);
+	conn->next = conns_;
+	if (conns_)
+		conns_->prev = conn;
+	conns_ = conn;
+	++nconn_;
+	g.release();
+
+	DPRINTF3("DistObjTcpServer: Client connected\n");
+
+	if (r.add(*conn, EventHandler::READ | EventHandler::WRITE, Reactor::EDGE) < 0) {
+		remove(conn);
+		delete conn;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void DistObjTcpServer::remove(Connection* conn)
+{
+	MyGuard g(connLock_);
+
+	if (conn->prev)
+		conn->prev->next = conn->next;
+	else
+		conns_ = conn->next;
+
+	if (conn->next)
+		conn->next->prev = conn->prev;
+
+	conn->prev = conn->next = 0;
+	--nconn_;
+}
+
+// --------------------------------------------------------------------------
+
+void DistObjTcpServer::close()
+{
+	acc_.close();
+
+	MyGuard g(connLock_);
+	while (conns_) {
+		Connection* conn = conns_;
+		conns_ = conn->next;
+		delete conn;
+	}
+	nconn_ = 0;
+}
+
+// --------------------------------------------------------------------------
+
+size_t DistObjTcpServer::num_connections() const
+{
+	MyGuard g(connLock_);
+	return nconn_;
+}
+
+#endif		// __linux__
+
@@ -0,0 +1,333 @@
+// SocketBinStream.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/SocketBinStream.h"
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std;
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+//							SocketBinStreamBuf
+/////////////////////////////////////////////////////////////////////////////
+
+SocketBinStreamBuf::SocketBinStreamBuf(Socket& sock,
+									   size_t inSize /*=DFLT_BUF_SIZE*/,
+									   size_t outSize /*=DFLT_BUF_SIZE*/)
+						: sock_(sock), dgram_(false), isize_(inSize),
+							osize_(outSize), rec_(0), err_(0)
+{
+	assert(inSize > 0 && outSize >= size_t(HDR_SIZE));
+
+	int type = 0;
+	dgram_ = (sock_.get_option(SOL_SOCKET, SO_TYPE, &type) == 0 &&
+				type == SOCK_DGRAM);
+
+	ibuf_ = new byte[BACK_BUF_SIZE + isize_];
+	obuf_ = new byte[osize_];
+
+	byte *p = ibuf_ + BACK_BUF_SIZE;
+	setg(p, p, p);
+	setp(obuf_, obuf_ + osize_);
+}
+
+SocketBinStreamBuf::~SocketBinStreamBuf()
+{
+	sync();
+	delete[] ibuf_;
+	delete[] obuf_;
+}
+
+// --------------------------------------------------------------------------
+// Data is read into the free space at the end of the input buffer. The
+// unread data is only moved down to the front when the free space is too
+// small, bringing the last few bytes read along for putback.
+// A datagram is never added onto data already in the buffer, since that
+// would join two messages.
+
+int SocketBinStreamBuf::fill(size_t n)
+{
+	size_t nbuf = size_t(egptr() - gptr());
+
+	if (nbuf >= n)
+		return 0;
+
+	if (n > isize_ || (dgram_ && nbuf > 0)) {
+		err_ = EMSGSIZE;
+		return -1;
+	}
+
+	byte	*base = ibuf_ + BACK_BUF_SIZE,
+			*end = base + isize_;
+
+	if (size_t(end - gptr()) < n || nbuf == 0) {
+		size_t nback = min(size_t(gptr() - eback()), size_t(BACK_BUF_SIZE));
+		memmove(base - nback, gptr() - nback, nback + nbuf);
+		setg(base - nback, base, base + nbuf);
+	}
+
+	while (size_t(egptr() - gptr()) < n) {
+		ssize_t ret = ::recv(sock_.handle(), egptr(), size_t(end - egptr()), 0);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err_ = errno;
+			return -1;
+		}
+
+		if (ret == 0 && !dgram_) {
+			err_ = 0;
+			return -1;
+		}
+
+		setg(eback(), gptr(), egptr() + ret);
+
+		if (dgram_ && ret > 0 && size_t(ret) < n) {
+			setg(base, base, base);
+			err_ = EMSGSIZE;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int SocketBinStreamBuf::underflow()
+{
+	if (gptr() == egptr() && fill(1) < 0)
+		return -1;
+
+	return *gptr();
+}
+
+// --------------------------------------------------------------------------
+// Once the buffered data is used up, a large read from a stream socket goes
+// right into the caller's memory rather than through the input buffer.
+
+SocketBinStreamBuf::streamsize SocketBinStreamBuf::xsgetn(void* buf, streamsize n)
+{
+	byte		*p = (byte*) buf;
+	streamsize	cnt = n;
+
+	while (cnt > 0) {
+		streamsize nbuf = streamsize(egptr() - gptr());
+
+		if (nbuf > 0) {
+			streamsize ncpy = min(cnt, nbuf);
+			memcpy(p, gptr(), ncpy);
+			gbump(int(ncpy));
+			p += ncpy;
+			cnt -= ncpy;
+		}
+		else if (!dgram_ && size_t(cnt) >= isize_) {
+			ssize_t ret = ::recv(sock_.handle(), p, size_t(cnt), 0);
+
+			if (ret < 0 && errno == EINTR)
+				continue;
+
+			if (ret <= 0) {
+				err_ = (ret < 0) ? errno : 0;
+				break;
+			}
+
+			byte *base = ibuf_ + BACK_BUF_SIZE;
+			setg(base, base, base);
+			p += ret;
+			cnt -= ret;
+		}
+		else if (fill(1) < 0)
+			break;
+	}
+	return n - cnt;
+}
+
+// --------------------------------------------------------------------------
+// Writes the buffered output, along with n bytes from buf, in a single
+// gather write. The data of an open record is held back, and moved down to
+// the front of the buffer, since its header hasn't been filled in yet.
+//
+// RETURNS:
+//		0	on success
+//		-1	on failure
+
+int SocketBinStreamBuf::flush(const void* buf, size_t n)
+{
+	byte *end = rec_ ? rec_ : pptr();
+
+	iovec iov[2];
+	iov[0].iov_base = pbase();
+	iov[0].iov_len = size_t(end - pbase());
+	iov[1].iov_base = const_cast<void*>(buf);
+	iov[1].iov_len = n;
+
+	iovec	*piov = iov;
+	int		niov = (n > 0) ? 2 : 1;
+
+	if (iov[0].iov_len == 0) {
+		++piov;
+		--niov;
+	}
+
+	while (niov > 0) {
+		ssize_t ret = ::writev(sock_.handle(), piov, niov);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err_ = errno;
+			return -1;
+		}
+
+		size_t m = size_t(ret);
+		while (niov > 0 && m >= piov->iov_len) {
+			m -= piov->iov_len;
+			++piov;
+			--niov;
+		}
+
+		if (niov > 0) {
+			piov->iov_base = (byte*) piov->iov_base + m;
+			piov->iov_len -= m;
+		}
+	}
+
+	size_t nrec = size_t(pptr() - end);
+
+	if (nrec > 0)
+		memmove(obuf_, end, nrec);
+
+	if (rec_)
+		rec_ = obuf_;
+
+	setp(obuf_, obuf_ + nrec, obuf_ + osize_);
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int SocketBinStreamBuf::sync()
+{
+	return flush(0, 0);
+}
+
+// --------------------------------------------------------------------------
+// An open record that already fills the whole buffer can't be flushed, so
+// there's nowhere to put the byte.
+
+int SocketBinStreamBuf::overflow(int c)
+{
+	if (pptr() == epptr()) {
+		if (rec_ == pbase()) {
+			err_ = EMSGSIZE;
+			return -1;
+		}
+		if (flush(0, 0) < 0)
+			return -1;
+	}
+
+	if (c < 0)
+		return 0;
+
+	return sputc(byte(c));
+}
+
+// --------------------------------------------------------------------------
+// Data that won't fit in the free space is written right from the caller's
+// memory, along with what's already buffered, unless it's part of an open
+// record.
+
+SocketBinStreamBuf::streamsize SocketBinStreamBuf::xsputn(const void* buf, streamsize n)
+{
+	if (!rec_ && n > streamsize(epptr() - pptr()))
+		return (flush(buf, size_t(n)) < 0) ? 0 : n;
+
+	return BinStreamBuf::xsputn(buf, n);
+}
+
+// --------------------------------------------------------------------------
+
+int SocketBinStreamBuf::begin_record()
+{
+	if (rec_) {
+		err_ = EINVAL;
+		return -1;
+	}
+
+	if (epptr() - pptr() < HDR_SIZE && flush(0, 0) < 0)
+		return -1;
+
+	rec_ = pptr();
+	pbump(HDR_SIZE);
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int SocketBinStreamBuf::end_record()
+{
+	if (!rec_) {
+		err_ = EINVAL;
+		return -1;
+	}
+
+	uint32_t n = uint32_t(pptr() - rec_ - HDR_SIZE),
+			 hdr = htonl(n);
+
+	memcpy(rec_, &hdr, HDR_SIZE);
+	rec_ = 0;
+	return int(n);
+}
+
+// --------------------------------------------------------------------------
+
+int SocketBinStreamBuf::write_record(const void* buf, size_t n)
+{
+	if (rec_) {
+		err_ = EINVAL;
+		return -1;
+	}
+
+	if (epptr() - pptr() < HDR_SIZE && flush(0, 0) < 0)
+		return -1;
+
+	uint32_t hdr = htonl(uint32_t(n));
+	memcpy(pptr(), &hdr, HDR_SIZE);
+	pbump(HDR_SIZE);
+
+	if (n > size_t(epptr() - pptr()))
+		return flush(buf, n);
+
+	memcpy(pptr(), buf, n);
+	pbump(int(n));
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int SocketBinStreamBuf::read_record(const byte** data)
+{
+	if (fill(HDR_SIZE) < 0)
+		return -1;
+
+	uint32_t hdr;
+	memcpy(&hdr, gptr(), HDR_SIZE);
+	size_t n = ntohl(hdr);
+
+	if (n > isize_ - HDR_SIZE) {
+		err_ = EMSGSIZE;
+		return -1;
+	}
+
+	if (fill(HDR_SIZE + n) < 0)
+		return -1;
+
+	*data = gptr() + HDR_SIZE;
+	gbump(int(HDR_SIZE + n));
+	return int(n);
+}
+
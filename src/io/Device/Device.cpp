@@ -2,6 +2,7 @@
 
 #include "CtrlrFx/CtrlrFx.h"
 #include "CtrlrFx/Device.h"
+#include <sys/uio.h>
 
 namespace CtrlrFx {
 
@@ -100,6 +101,99 @@ int write_n(fd_t fd, ByteBuffer& buf)
 	return n;
 }
 
+// --------------------------------------------------------------------------
+// Scatter/gather I/O. At most MAX_IOV buffers are handled by a single call,
+// so a longer sequence is just a partial transfer, which the "_n" versions
+// pick up and continue.
+
+static const size_t MAX_IOV = 64;
+
+// An iovec array loaded with the available region of each buffer.
+
+struct IoVecArray
+{
+	iovec	iov[MAX_IOV];
+	int		n;
+
+	IoVecArray(ByteBuffer* const bufs[], size_t nbuf) {
+		n = int((nbuf > MAX_IOV) ? MAX_IOV : nbuf);
+		for (int i=0; i<n; ++i) {
+			iov[i].iov_base = bufs[i]->position_ptr();
+			iov[i].iov_len = bufs[i]->available();
+		}
+	}
+};
+
+// --------------------------------------------------------------------------
+
+int readv(fd_t fd, ByteBuffer* const bufs[], size_t n)
+{
+	IoVecArray v(bufs, n);
+	int nx = int(::readv(fd, v.iov, v.n));
+
+	if (nx > 0)
+		advance_buffers(bufs, n, nx);
+
+	return nx;
+}
+
+// --------------------------------------------------------------------------
+// Best effort attempt at filling all of the buffers. Buffers that are
+// already full are skipped, so that an empty read isn't mistaken for the
+// end of the file.
+
+int readv_n(fd_t fd, ByteBuffer* const bufs[], size_t n)
+{
+	size_t	nr = 0, i = 0;
+	int		nx = 0;
+
+	for (;;) {
+		while (i < n && bufs[i]->full())
+			++i;
+
+		if (i == n || (nx = readv(fd, bufs+i, n-i)) <= 0)
+			break;
+
+		nr += nx;
+	}
+
+	return (nr == 0) ? nx : int(nr);
+}
+
+// --------------------------------------------------------------------------
+
+int writev(fd_t fd, ByteBuffer* const bufs[], size_t n)
+{
+	IoVecArray v(bufs, n);
+	int nx = int(::writev(fd, v.iov, v.n));
+
+	if (nx > 0)
+		advance_buffers(bufs, n, nx);
+
+	return nx;
+}
+
+// --------------------------------------------------------------------------
+// Best effort attempt to write all of the available data in the buffers.
+
+int writev_n(fd_t fd, ByteBuffer* const bufs[], size_t n)
+{
+	size_t	nw = 0, i = 0;
+	int		nx = 0;
+
+	for (;;) {
+		while (i < n && bufs[i]->empty())
+			++i;
+
+		if (i == n || (nx = writev(fd, bufs+i, n-i)) <= 0)
+			break;
+
+		nw += nx;
+	}
+
+	return (nw == 0) ? nx : int(nw);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //							DeviceBase
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,247 @@
+// OutputQueue.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/OutputQueue.h"
+#include <errno.h>
+
+using namespace CtrlrFx;
+
+// --------------------------------------------------------------------------
+
+OutputQueue::OutputQueue(IOutDevice& dev, size_t hiWater, size_t loWater,
+						 Policy policy /*=BLOCK*/,
+						 IOutputQueueClient* client /*=0*/,
+						 size_t maxBufs /*=256*/)
+				: dev_(dev), client_(client), hiWater_(hiWater),
+					loWater_((loWater < hiWater) ? loWater : hiWater),
+					policy_(policy), cap_(maxBufs), head_(0), n_(0),
+					nbytes_(0), high_(false), closed_(false), ndropped_(0)
+{
+	assert(maxBufs > 0);
+	bufs_ = new ByteBuffer*[cap_];
+}
+
+OutputQueue::~OutputQueue()
+{
+	close();
+	delete[] bufs_;
+}
+
+// --------------------------------------------------------------------------
+
+void OutputQueue::release(ByteBuffer* const bufs[], size_t n)
+{
+	if (client_) {
+		for (size_t i=0; i<n; ++i)
+			client_->on_release(bufs[i]);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+size_t OutputQueue::clear_locked(ByteBuffer* bufs[])
+{
+	size_t n = n_;
+
+	for (size_t i=0; i<n; ++i)
+		bufs[i] = bufs_[(head_ + i) % cap_];
+
+	head_ = n_ = nbytes_ = 0;
+	high_ = false;
+	return n;
+}
+
+// --------------------------------------------------------------------------
+// Does a single gather write of the buffers at the front of the queue.
+// Only the buffers that were offered to the device can be finished, which
+// also keeps the count within the caller's array of MAX_WRITE_BUFS.
+// Producers are woken whenever a buffer completes or the queue falls to
+// the low watermark, since a blocked one may be waiting on either.
+// Returns -1 on an error, 0 if the queue is empty, 1 if the device can't
+// take any more right now, or 2 if it took everything it was offered and
+// there's more to write.
+
+int OutputQueue::flush_locked(ByteBuffer* done[], size_t* ndone)
+{
+	*ndone = 0;
+
+	if (n_ == 0)
+		return 0;
+
+	ByteBuffer* iov[MAX_WRITE_BUFS];
+	size_t k = (n_ < size_t(MAX_WRITE_BUFS)) ? n_ : size_t(MAX_WRITE_BUFS),
+		   len = 0;
+
+	for (size_t i=0; i<k; ++i) {
+		iov[i] = bufs_[(head_ + i) % cap_];
+		len += iov[i]->available();
+	}
+
+	int ret = dev_.writev(iov, k);
+
+	if (ret < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 1 : -1;
+
+	nbytes_ -= size_t(ret);
+
+	while (*ndone < k && bufs_[head_]->available() == 0) {
+		done[(*ndone)++] = bufs_[head_];
+		head_ = (head_ + 1) % cap_;
+		--n_;
+	}
+
+	if (*ndone > 0 || nbytes_ <= loWater_)
+		cond_.broadcast();
+
+	if (n_ == 0)
+		return 0;
+
+	return (size_t(ret) < len) ? 1 : 2;
+}
+
+// --------------------------------------------------------------------------
+// A buffer that's bigger than the high watermark is still let into an
+// empty queue; otherwise it could never be written.
+// Hitting the limit counts as reaching the high watermark, since partial
+// writes mean the queue rarely lands on it exactly. The client hears about
+// it before the policy is applied, so that a blocked producer has already
+// been told.
+
+int OutputQueue::write(ByteBuffer* buf)
+{
+	ByteBuffer*	done[MAX_WRITE_BUFS];
+	ByteBuffer**	dropped = 0;
+	size_t		ndone = 0, ndropped = 0;
+	bool		high = false, low = false, overflow = false, rejected = false;
+	int			ret = 0;
+
+	cond_.lock();
+
+	size_t len = buf->available();
+
+	if (!closed_ && (n_ == cap_ || (n_ > 0 && nbytes_ + len > hiWater_))) {
+		if (!high_) {
+			high_ = true;
+			if (client_) {
+				cond_.unlock();
+				client_->on_high_water(*this);
+				cond_.lock();
+			}
+		}
+
+		switch (policy_) {
+			case BLOCK:
+				while (!closed_ && (nbytes_ > loWater_ || n_ == cap_))
+					cond_.wait();
+				break;
+
+			case DROP:
+				++ndropped_;
+				ret = 1;
+				break;
+
+			case DISCONNECT:
+				dropped = new ByteBuffer*[cap_];
+				ndropped = clear_locked(dropped);
+				closed_ = overflow = true;
+				cond_.broadcast();
+				break;
+		}
+	}
+
+	if (closed_) {
+		errno = EPIPE;
+		ret = -1;
+		rejected = true;
+	}
+	else if (ret == 1)
+		rejected = true;
+	else {
+		bufs_[(head_ + n_) % cap_] = buf;
+		++n_;
+		nbytes_ += len;
+
+		if (n_ == 1 && flush_locked(done, &ndone) < 0)
+			ret = -1;
+
+		if (!high_ && nbytes_ >= hiWater_)
+			high_ = high = true;
+		else if (high_ && nbytes_ <= loWater_) {
+			high_ = false;
+			low = true;
+		}
+	}
+
+	cond_.unlock();
+
+	if (rejected)
+		release(&buf, 1);
+
+	release(done, ndone);
+
+	if (dropped) {
+		release(dropped, ndropped);
+		delete[] dropped;
+	}
+
+	if (client_) {
+		if (high)
+			client_->on_high_water(*this);
+		if (low)
+			client_->on_low_water(*this);
+		if (overflow)
+			client_->on_overflow(*this);
+	}
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+
+int OutputQueue::flush()
+{
+	int ret;
+
+	do {
+		ByteBuffer*	done[MAX_WRITE_BUFS];
+		size_t		ndone = 0;
+		bool		low = false;
+
+		cond_.lock();
+		ret = flush_locked(done, &ndone);
+
+		if (high_ && nbytes_ <= loWater_) {
+			high_ = false;
+			low = true;
+		}
+		cond_.unlock();
+
+		release(done, ndone);
+
+		if (low && client_)
+			client_->on_low_water(*this);
+	}
+	while (ret == 2);
+
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+
+void OutputQueue::close()
+{
+	cond_.lock();
+
+	size_t n = n_;
+	ByteBuffer** bufs = (n > 0) ? new ByteBuffer*[n] : 0;
+
+	clear_locked(bufs);
+	closed_ = true;
+	cond_.broadcast();
+	cond_.unlock();
+
+	if (bufs) {
+		release(bufs, n);
+		delete[] bufs;
+	}
+}
+
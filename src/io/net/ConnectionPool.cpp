@@ -0,0 +1,163 @@
+// ConnectionPool.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/ConnectionPool.h"
+#include "CtrlrFx/Guard.h"
+#include <unistd.h>
+#include <poll.h>
+
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+
+ConnectionPool::ConnectionPool(size_t maxIdle /*=DFLT_MAX_IDLE*/,
+							   const Duration& idleTimeout /*=sec(60)*/,
+							   const Duration& connTimeout /*=sec(5)*/)
+					: cap_(maxIdle), n_(0), idleTimeout_(idleTimeout),
+						connTimeout_(connTimeout), nreused_(0), nnew_(0)
+{
+	idle_ = (cap_ > 0) ? new Entry[cap_] : 0;
+}
+
+ConnectionPool::~ConnectionPool()
+{
+	clear();
+	delete[] idle_;
+}
+
+// --------------------------------------------------------------------------
+
+void ConnectionPool::close(socket_t sock)
+{
+	::close(sock);
+}
+
+// --------------------------------------------------------------------------
+// An idle request/response connection should have nothing to read. If it's
+// readable, the server closed it, it has an error, or it's out of step with
+// the server, and none of those can be reused.
+
+bool ConnectionPool::is_healthy(socket_t sock)
+{
+	pollfd pfd;
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	return ::poll(&pfd, 1, 0) == 0;
+}
+
+// --------------------------------------------------------------------------
+
+socket_t ConnectionPool::remove_locked(size_t i)
+{
+	socket_t sock = idle_[i].sock;
+
+	for (--n_; i<n_; ++i)
+		idle_[i] = idle_[i+1];
+
+	return sock;
+}
+
+// --------------------------------------------------------------------------
+// The connections are kept in the order they were put back, so the expired
+// ones are all at the front.
+
+void ConnectionPool::expire_locked(const MonotonicTime& now)
+{
+	while (n_ > 0 && now - idle_[0].last > idleTimeout_)
+		close(remove_locked(0));
+}
+
+// --------------------------------------------------------------------------
+// The most recently used connection is the one most likely to still be
+// alive, so the search goes from the back.
+
+int ConnectionPool::get(const SockAddr& addr, TcpSocket& sock)
+{
+	Guard<Mutex> g(lock_);
+
+	expire_locked(MonotonicTime::now());
+
+	for (size_t i=n_; i>0; --i) {
+		if (!(idle_[i-1].addr == addr))
+			continue;
+
+		socket_t s = remove_locked(i-1);
+
+		if (is_healthy(s)) {
+			++nreused_;
+			g.release();
+			sock.reset(s);
+			return 0;
+		}
+		close(s);
+	}
+
+	g.release();
+
+	TcpConnector conn;
+	if (conn.connect(addr, connTimeout_) < 0) {
+		sock.close();
+		return -1;
+	}
+
+	g.acquire();
+	++nnew_;
+	g.release();
+
+	sock.reset(conn.release());
+	return 1;
+}
+
+// --------------------------------------------------------------------------
+
+void ConnectionPool::put(const SockAddr& addr, TcpSocket& sock)
+{
+	if (!sock.is_open())
+		return;
+
+	if (cap_ == 0) {
+		sock.close();
+		return;
+	}
+
+	MonotonicTime now = MonotonicTime::now();
+	Guard<Mutex> g(lock_);
+
+	expire_locked(now);
+
+	if (n_ == cap_)
+		close(remove_locked(0));
+
+	Entry& e = idle_[n_++];
+	e.addr = addr;
+	e.sock = sock.release();
+	e.last = now;
+}
+
+// --------------------------------------------------------------------------
+
+void ConnectionPool::expire()
+{
+	Guard<Mutex> g(lock_);
+	expire_locked(MonotonicTime::now());
+}
+
+// --------------------------------------------------------------------------
+
+void ConnectionPool::clear()
+{
+	Guard<Mutex> g(lock_);
+	while (n_ > 0)
+		close(remove_locked(n_-1));
+}
+
+// --------------------------------------------------------------------------
+
+size_t ConnectionPool::size() const
+{
+	Guard<Mutex> g(lock_);
+	return n_;
+}
+
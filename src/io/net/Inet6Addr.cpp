@@ -0,0 +1,69 @@
+// Inet6Addr.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/Inet6Addr.h"
+#include <cstring>
+
+#if !defined(WIN32)
+	#include <netdb.h>
+#endif
+
+using namespace std;
+using namespace CtrlrFx;
+
+// --------------------------------------------------------------------------
+
+bool Inet6Addr::is_set() const
+{
+	const byte* b = reinterpret_cast<const byte*>(this);
+
+	for (size_t i=0; i<sizeof(Inet6Addr); ++i) {
+		if (b[i] != 0)
+			return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+// Numeric addresses are parsed directly. Names go to the resolver, which
+// is asked for IPv4-mapped addresses when the host has no IPv6 address.
+
+bool Inet6Addr::resolve_name(const char* saddr, in6_addr* addr)
+{
+	if (::inet_pton(AF_INET6, saddr, addr) == 1)
+		return true;
+
+	addrinfo hints, *res = 0;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET6;
+	hints.ai_flags = AI_V4MAPPED;
+
+	if (::getaddrinfo(saddr, 0, &hints, &res) != 0 || !res)
+		return false;
+
+	*addr = reinterpret_cast<sockaddr_in6*>(res->ai_addr)->sin6_addr;
+	::freeaddrinfo(res);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void Inet6Addr::create(const in6_addr& addr, uint16_t port)
+{
+	zero();
+	sin6_family = AF_INET6;
+	sin6_addr = addr;
+	sin6_port = htons(port);
+}
+
+// --------------------------------------------------------------------------
+
+void Inet6Addr::create(const char* saddr, uint16_t port)
+{
+	zero();
+	sin6_family = AF_INET6;
+	if (!resolve_name(saddr, &sin6_addr))
+		sin6_addr = in6addr_any;
+	sin6_port = htons(port);
+}
+
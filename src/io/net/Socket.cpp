@@ -5,11 +5,20 @@
 #include "CtrlrFx/Socket.h"
 
 #if !defined(WIN32)
+	#include "CtrlrFx/Device.h"
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
 	#include <unistd.h>
 	#include <sys/fcntl.h>
 	// TODO: Are these POSIX-only?
 	#include <signal.h>
 	#include <errno.h>
+	#include <string.h>
+#endif
+
+#if defined(__linux__)
+	#include <linux/errqueue.h>
+	#include <linux/net_tstamp.h>
 #endif
 
 using namespace CtrlrFx;
@@ -49,6 +58,261 @@ int Socket::last_error() const
 	#endif	
 }
 
+// --------------------------------------------------------------------------
+
+SockAddr Socket::local_addr() const
+{
+	SockAddr	addr;
+	socklen_t	len = SockAddr::capacity();
+
+	if (::getsockname(sock_, addr.sockaddr_ptr(), &len) == 0)
+		addr.set_size(len);
+
+	return addr;
+}
+
+SockAddr Socket::peer_addr() const
+{
+	SockAddr	addr;
+	socklen_t	len = SockAddr::capacity();
+
+	if (::getpeername(sock_, addr.sockaddr_ptr(), &len) == 0)
+		addr.set_size(len);
+
+	return addr;
+}
+
+// --------------------------------------------------------------------------
+
+int Socket::set_non_blocking(bool on /*=true*/)
+{
+	#if defined(WIN32)
+		u_long mode = on ? 1 : 0;
+		return ::ioctlsocket(sock_, FIONBIO, &mode) == 0 ? 0 : -1;
+	#else
+		int flags = ::fcntl(sock_, F_GETFL, 0);
+		if (flags < 0)
+			return -1;
+		flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+		return ::fcntl(sock_, F_SETFL, flags);
+	#endif
+}
+
+// --------------------------------------------------------------------------
+
+int Socket::set_option(int level, int name, const void* val, socklen_t len)
+{
+	return ::setsockopt(sock_, level, name, (const char*) val, len);
+}
+
+int Socket::get_option(int level, int name, void* val, socklen_t* len) const
+{
+	return ::getsockopt(sock_, level, name, (char*) val, len);
+}
+
+int Socket::get_option(int level, int name, int* val) const
+{
+	socklen_t len = sizeof(int);
+	return get_option(level, name, val, &len);
+}
+
+// --------------------------------------------------------------------------
+
+int Socket::send_buffer_size() const
+{
+	int sz;
+	return (get_option(SOL_SOCKET, SO_SNDBUF, &sz) < 0) ? -1 : sz;
+}
+
+int Socket::recv_buffer_size() const
+{
+	int sz;
+	return (get_option(SOL_SOCKET, SO_RCVBUF, &sz) < 0) ? -1 : sz;
+}
+
+int Socket::busy_poll(int usec)
+{
+	#if defined(SO_BUSY_POLL)
+		return set_option(SOL_SOCKET, SO_BUSY_POLL, usec);
+	#else
+		(void) usec;
+		errno = ENOPROTOOPT;
+		return -1;
+	#endif
+}
+
+#if !defined(WIN32)
+
+// --------------------------------------------------------------------------
+
+int Socket::rx_timestamps(bool on /*=true*/)
+{
+	#if defined(SO_TIMESTAMPNS)
+		return set_option(SOL_SOCKET, SO_TIMESTAMPNS, on ? 1 : 0);
+	#else
+		return set_option(SOL_SOCKET, SO_TIMESTAMP, on ? 1 : 0);
+	#endif
+}
+
+// --------------------------------------------------------------------------
+// Transmit stamps are tagged with an id (OPT_ID) and come back without a
+// copy of the data (OPT_TSONLY).
+
+int Socket::timestamping(int flags)
+{
+	#if defined(__linux__) && defined(SO_TIMESTAMPING)
+		int val = 0;
+
+		if (flags & TS_RX_SOFTWARE)
+			val |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+		if (flags & TS_RX_HARDWARE)
+			val |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+		if (flags & TS_TX_SOFTWARE)
+			val |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+		if (flags & TS_TX_HARDWARE)
+			val |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+		if (flags & (TS_TX_SOFTWARE | TS_TX_HARDWARE))
+			val |= SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+		return set_option(SOL_SOCKET, SO_TIMESTAMPING, val);
+	#else
+		(void) flags;
+		errno = ENOPROTOOPT;
+		return -1;
+	#endif
+}
+
+// --------------------------------------------------------------------------
+// Pulls the timestamp, if any, out of a message's control data.
+// SO_TIMESTAMPING reports a software stamp in the first slot and a raw
+// hardware one in the third; the hardware one is preferred.
+
+static bool get_timestamp(msghdr& msg, Time& stamp)
+{
+	stamp = Time();
+
+	for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET)
+			continue;
+
+		#if defined(SO_TIMESTAMPING)
+			if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+				timespec ts[3];
+				memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+				stamp = (ts[2].tv_sec || ts[2].tv_nsec) ? ts[2] : ts[0];
+				return true;
+			}
+		#endif
+		#if defined(SO_TIMESTAMPNS)
+			if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+				timespec ts;
+				memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+				stamp = ts;
+				return true;
+			}
+		#endif
+		if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+			timeval tv;
+			memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+			stamp = Time(tv.tv_sec, tv.tv_usec*1000L);
+			return true;
+		}
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+int Socket::recv(void* buf, size_t n, Time& stamp, SockAddr* addr /*=0*/)
+{
+	// Room for any of the timestamp messages
+	union {
+		cmsghdr	hdr;
+		char	buf[CMSG_SPACE(3*sizeof(timespec))];
+	} ctrl;
+
+	iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = n;
+
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl);
+
+	if (addr) {
+		msg.msg_name = addr->sockaddr_ptr();
+		msg.msg_namelen = addr->capacity();
+	}
+
+	ssize_t ret = ::recvmsg(handle(), &msg, 0);
+
+	if (ret >= 0) {
+		get_timestamp(msg, stamp);
+		if (addr)
+			addr->set_size(msg.msg_namelen);
+	}
+	return int(ret);
+}
+
+int Socket::recv(ByteBuffer& buf, Time& stamp, SockAddr* addr /*=0*/)
+{
+	int n = recv(buf.position_ptr(), buf.available(), stamp, addr);
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
+// --------------------------------------------------------------------------
+// A transmit stamp comes back on the error queue as a pair of messages: the
+// stamp itself, and an extended error that carries the id of the send.
+
+int Socket::tx_timestamp(uint32_t* id, Time& stamp)
+{
+	#if defined(__linux__) && defined(SO_TIMESTAMPING)
+		char	ctrl[CMSG_SPACE(3*sizeof(timespec)) +
+					 CMSG_SPACE(sizeof(sock_extended_err)) + 64];
+		msghdr	msg;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = ctrl;
+		msg.msg_controllen = sizeof(ctrl);
+
+		if (::recvmsg(handle(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+		bool found = false;
+
+		for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+					(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+				const sock_extended_err* ee = (const sock_extended_err*) CMSG_DATA(cm);
+				if (ee->ee_errno == ENOMSG && ee->ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+					*id = ee->ee_data;
+					found = true;
+				}
+			}
+		}
+
+		if (found && get_timestamp(msg, stamp))
+			return 1;
+
+		errno = EPROTO;
+		return -1;
+	#else
+		(void) id;
+		(void) stamp;
+		errno = ENOPROTOOPT;
+		return -1;
+	#endif
+}
+
+#endif	// !WIN32
+
 // --------------------------------------------------------------------------
 // "Releases" ownership of the socket by simply assigning the handle to the
 // invalid socket constant. It returns the previous value.
@@ -110,6 +374,11 @@ UdpSocket::UdpSocket(const InetAddr& addr) : Socket(create())
 	bind(addr);
 }
 
+UdpSocket::UdpSocket(const SockAddr& addr) : Socket(create(addr.family()))
+{
+	bind(addr);
+}
+
 // Opens a UDP socket. If it was already open, it just succeeds without
 // doing anything.
 
@@ -133,6 +402,16 @@ int UdpSocket::sendto(ByteBuffer& buf, const InetAddr& addr)
 	return n;
 }
 
+int UdpSocket::sendto(ByteBuffer& buf, const SockAddr& addr)
+{
+	int n = sendto(buf.position_ptr(), buf.available(), addr);
+
+	if (n > 0)
+		 buf.incr_position(n);
+		 
+	return n;
+}
+
 int UdpSocket::send(ByteBuffer& buf)
 {
 	int n = send(buf.position_ptr(), buf.available());
@@ -166,6 +445,28 @@ int UdpSocket::recvfrom(ByteBuffer& buf, InetAddr& addr)
 	return n;
 }
 
+int UdpSocket::recvfrom(void* buf, size_t n, SockAddr& addr)
+{
+	socklen_t alen = SockAddr::capacity();
+
+	int ret = ::recvfrom(handle(), buf, n, 0, addr.sockaddr_ptr(), &alen);
+
+	if (ret >= 0)
+		addr.set_size(alen);
+
+	return ret;
+}
+
+int UdpSocket::recvfrom(ByteBuffer& buf, SockAddr& addr)
+{
+	int n = recvfrom(buf.position_ptr(), buf.available(), addr);
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
 int UdpSocket::recv(ByteBuffer& buf)
 {
 	int n = recv(buf.position_ptr(), buf.available());
@@ -176,6 +477,157 @@ int UdpSocket::recv(ByteBuffer& buf)
 	return n;
 }
 
+
+// --------------------------------------------------------------------------
+// Under Linux this is a single recvmmsg(). Elsewhere it's a recvmsg() for
+// each datagram, with all but the first made non-blocking.
+
+int UdpSocket::recv_batch(ByteBuffer* const bufs[], size_t n, UdpMsgInfo info[] /*=0*/)
+{
+	// Room for a timestamp in the control data of each message.
+	union Ctrl {
+		cmsghdr	hdr;
+		char	buf[CMSG_SPACE(3*sizeof(timespec))];
+	};
+
+	if (n > MAX_BATCH)
+		n = MAX_BATCH;
+
+	iovec				iov[MAX_BATCH];
+	sockaddr_storage	ss[MAX_BATCH];
+	Ctrl				ctrl[MAX_BATCH];
+	msghdr				msg[MAX_BATCH];
+
+	memset(msg, 0, n*sizeof(msghdr));
+
+	for (size_t i=0; i<n; ++i) {
+		iov[i].iov_base = bufs[i]->position_ptr();
+		iov[i].iov_len = bufs[i]->available();
+
+		msg[i].msg_iov = &iov[i];
+		msg[i].msg_iovlen = 1;
+
+		if (info) {
+			msg[i].msg_name = &ss[i];
+			msg[i].msg_namelen = sizeof(sockaddr_storage);
+			msg[i].msg_control = ctrl[i].buf;
+			msg[i].msg_controllen = sizeof(Ctrl);
+		}
+	}
+
+	size_t	len[MAX_BATCH];
+	int		ret;
+
+	#if defined(__linux__)
+		mmsghdr mmsg[MAX_BATCH];
+		for (size_t i=0; i<n; ++i) {
+			mmsg[i].msg_hdr = msg[i];
+			mmsg[i].msg_len = 0;
+		}
+
+		if ((ret = ::recvmmsg(handle(), mmsg, unsigned(n), MSG_WAITFORONE, 0)) <= 0)
+			return ret;
+
+		for (int i=0; i<ret; ++i) {
+			msg[i] = mmsg[i].msg_hdr;
+			len[i] = mmsg[i].msg_len;
+		}
+	#else
+		for (ret=0; ret<int(n); ++ret) {
+			ssize_t nx = ::recvmsg(handle(), &msg[ret], (ret == 0) ? 0 : MSG_DONTWAIT);
+			if (nx < 0) {
+				if (ret == 0)
+					return -1;
+				break;
+			}
+			len[ret] = size_t(nx);
+		}
+	#endif
+
+	for (int i=0; i<ret; ++i) {
+		bufs[i]->incr_position(int(len[i]));
+
+		if (info) {
+			info[i].addr = SockAddr((const sockaddr*) &ss[i], msg[i].msg_namelen);
+			info[i].len = len[i];
+			info[i].truncated = (msg[i].msg_flags & MSG_TRUNC) != 0;
+			get_timestamp(msg[i], info[i].stamp);
+		}
+	}
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+// Under Linux this is a single sendmmsg(). Elsewhere it's a sendmsg() for
+// each datagram, stopping at the first failure.
+
+int UdpSocket::send_batch(ByteBuffer* const bufs[], size_t n,
+						  const SockAddr addrs[] /*=0*/)
+{
+	if (n > MAX_BATCH)
+		n = MAX_BATCH;
+
+	iovec	iov[MAX_BATCH];
+	msghdr	msg[MAX_BATCH];
+
+	memset(msg, 0, n*sizeof(msghdr));
+
+	for (size_t i=0; i<n; ++i) {
+		iov[i].iov_base = bufs[i]->position_ptr();
+		iov[i].iov_len = bufs[i]->available();
+
+		msg[i].msg_iov = &iov[i];
+		msg[i].msg_iovlen = 1;
+
+		if (addrs) {
+			msg[i].msg_name = const_cast<sockaddr*>(addrs[i].sockaddr_ptr());
+			msg[i].msg_namelen = addrs[i].size();
+		}
+	}
+
+	int ret;
+
+	#if defined(__linux__)
+		mmsghdr mmsg[MAX_BATCH];
+		for (size_t i=0; i<n; ++i) {
+			mmsg[i].msg_hdr = msg[i];
+			mmsg[i].msg_len = 0;
+		}
+
+		if ((ret = ::sendmmsg(handle(), mmsg, unsigned(n), 0)) <= 0)
+			return ret;
+
+		for (int i=0; i<ret; ++i)
+			bufs[i]->incr_position(int(mmsg[i].msg_len));
+	#else
+		for (ret=0; ret<int(n); ++ret) {
+			ssize_t nx = ::sendmsg(handle(), &msg[ret], 0);
+			if (nx < 0) {
+				if (ret == 0)
+					return -1;
+				break;
+			}
+			bufs[ret]->incr_position(int(nx));
+		}
+	#endif
+
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+
+int UdpSocket::send_batch(ByteBuffer* const bufs[], size_t n, const SockAddr& addr)
+{
+	if (n > MAX_BATCH)
+		n = MAX_BATCH;
+
+	SockAddr addrs[MAX_BATCH];
+	for (size_t i=0; i<n; ++i)
+		addrs[i] = addr;
+
+	return send_batch(bufs, n, addrs);
+}
+
 #endif
 
 /////////////////////////////////////////////////////////////////////////////
@@ -205,8 +657,116 @@ TcpSocket& TcpSocket::operator=(socket_t s)
 }
 */
 // --------------------------------------------------------------------------
+// The options that a platform doesn't have fail with ENOPROTOOPT.
+
+int TcpSocket::no_delay(bool on /*=true*/)
+{
+	return set_option(IPPROTO_TCP, TCP_NODELAY, on ? 1 : 0);
+}
+
+int TcpSocket::cork(bool on /*=true*/)
+{
+	#if defined(TCP_CORK)
+		return set_option(IPPROTO_TCP, TCP_CORK, on ? 1 : 0);
+	#else
+		(void) on;
+		errno = ENOPROTOOPT;
+		return -1;
+	#endif
+}
+
+int TcpSocket::quick_ack(bool on /*=true*/)
+{
+	#if defined(TCP_QUICKACK)
+		return set_option(IPPROTO_TCP, TCP_QUICKACK, on ? 1 : 0);
+	#else
+		(void) on;
+		errno = ENOPROTOOPT;
+		return -1;
+	#endif
+}
+
+// --------------------------------------------------------------------------
+// Without MSG_MORE this is just a normal write.
+
+int TcpSocket::write_more(const void* buf, size_t n)
+{
+	#if defined(MSG_MORE)
+		return ::send(handle(), (const char*) buf, n, MSG_MORE);
+	#else
+		return ::send(handle(), (const char*) buf, n, 0);
+	#endif
+}
+
+int TcpSocket::write_more(ByteBuffer& buf)
+{
+	int n = write_more(buf.position_ptr(), buf.available());
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
+// --------------------------------------------------------------------------
+
+#if defined(__linux__)
+
+int TcpSocket::zero_copy(bool on /*=true*/)
+{
+	return set_option(SOL_SOCKET, SO_ZEROCOPY, on ? 1 : 0);
+}
+
+int TcpSocket::send_zerocopy(ByteBuffer& buf)
+{
+	int n = ::send(handle(), buf.position_ptr(), buf.available(), MSG_ZEROCOPY);
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
+// --------------------------------------------------------------------------
+// The notifications come through the socket's error queue as an extended
+// error from the "zerocopy" origin, with the range of sends in the info
+// and data fields.
+
+int TcpSocket::zerocopy_completion(uint32_t* lo, uint32_t* hi, bool* copied)
+{
+	char	ctrl[CMSG_SPACE(sizeof(sock_extended_err)) + 256];
+	msghdr	msg;
+
+	for (;;) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = ctrl;
+		msg.msg_controllen = sizeof(ctrl);
+
+		if (::recvmsg(handle(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+		for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+					(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+				const sock_extended_err* ee = (const sock_extended_err*) CMSG_DATA(cm);
+				if (ee->ee_errno == 0 && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+					*lo = ee->ee_info;
+					*hi = ee->ee_data;
+					*copied = (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+					return 1;
+				}
+			}
+		}
+	}
+}
+
+#endif	// __linux__
 
-int TcpSocket::read(void *buf, size_t n)
+/////////////////////////////////////////////////////////////////////////////
+//								StreamSocket
+/////////////////////////////////////////////////////////////////////////////
+
+int StreamSocket::read(void *buf, size_t n)
 {
 	return ::recv(handle(), (char*) buf, n, 0);
 }
@@ -216,7 +776,7 @@ int TcpSocket::read(void *buf, size_t n)
 // read() until it has the data or an error occurs.
 // 
 
-int TcpSocket::read_n(void *buf, size_t n)
+int StreamSocket::read_n(void *buf, size_t n)
 {
 	size_t	nr = 0;
 	int		nx = 0;
@@ -236,7 +796,7 @@ int TcpSocket::read_n(void *buf, size_t n)
 // --------------------------------------------------------------------------
 // Reads data into the buffer.
 
-int TcpSocket::read(ByteBuffer& buf)
+int StreamSocket::read(ByteBuffer& buf)
 {
 	int n = read(buf.position_ptr(), buf.available());
 
@@ -249,7 +809,7 @@ int TcpSocket::read(ByteBuffer& buf)
 // --------------------------------------------------------------------------
 // Best effort attempt at reading the whole buffer
 
-int TcpSocket::read_n(ByteBuffer& buf)
+int StreamSocket::read_n(ByteBuffer& buf)
 {
 	size_t	nr = 0;
 	int		nx = 0;
@@ -265,9 +825,54 @@ int TcpSocket::read_n(ByteBuffer& buf)
 	return (nr == 0 && nx < 0) ? nx : int(nr);
 }
 
+// --------------------------------------------------------------------------
+// On POSIX systems a socket is a file descriptor, so the device routines
+// handle the scatter/gather calls. Elsewhere, the buffers are read one at a
+// time.
+
+int StreamSocket::readv(ByteBuffer* const bufs[], size_t n)
+{
+	#if !defined(WIN32)
+		return CtrlrFx::readv(handle(), bufs, n);
+	#else
+		size_t	nr = 0;
+		int		nx = 0;
+
+		for (size_t i=0; i<n; ++i) {
+			if (bufs[i]->full())
+				continue;
+			if ((nx = read(*bufs[i])) <= 0)
+				break;
+			nr += nx;
+			if (!bufs[i]->full())
+				break;
+		}
+		return (nr == 0) ? nx : int(nr);
+	#endif
+}
+
 // --------------------------------------------------------------------------
 
-bool TcpSocket::read_timeout(const Duration& d)
+int StreamSocket::readv_n(ByteBuffer* const bufs[], size_t n)
+{
+	#if !defined(WIN32)
+		return CtrlrFx::readv_n(handle(), bufs, n);
+	#else
+		size_t	nr = 0;
+		int		nx = 0;
+
+		for (size_t i=0; i<n; ++i) {
+			if ((nx = read_n(*bufs[i])) < 0)
+				break;
+			nr += nx;
+		}
+		return (nr == 0 && nx < 0) ? nx : int(nr);
+	#endif
+}
+
+// --------------------------------------------------------------------------
+
+bool StreamSocket::read_timeout(const Duration& d)
 {
 	#if defined(CFX_POSIX)
 		timeval tv = d.to_timeval();
@@ -280,7 +885,7 @@ bool TcpSocket::read_timeout(const Duration& d)
 
 // --------------------------------------------------------------------------
 
-int TcpSocket::write(const void *buf, size_t n)
+int StreamSocket::write(const void *buf, size_t n)
 {
 	return ::send(handle(), (const char*) buf, n , 0);
 }
@@ -289,7 +894,7 @@ int TcpSocket::write(const void *buf, size_t n)
 // Attempts to write the entire buffer by repeatedly calling write() until
 // either all of the data is sent or an error occurs.
 
-int TcpSocket::write_n(const void *buf, size_t n)
+int StreamSocket::write_n(const void *buf, size_t n)
 {
 	size_t	nw = 0;
 	int		nx = 0;
@@ -309,7 +914,7 @@ int TcpSocket::write_n(const void *buf, size_t n)
 // --------------------------------------------------------------------------
 // Attempts to write the buffer to the socket.
 
-int TcpSocket::write(ByteBuffer& buf)
+int StreamSocket::write(ByteBuffer& buf)
 {
 	int n = write(buf.position_ptr(), buf.available());
 
@@ -322,7 +927,7 @@ int TcpSocket::write(ByteBuffer& buf)
 // --------------------------------------------------------------------------
 // Attempts to write all of the available data in the buffer to the socket.
 
-int TcpSocket::write_n(ByteBuffer& buf)
+int StreamSocket::write_n(ByteBuffer& buf)
 {
 	size_t	nw = 0;
 	int		nx = 0;
@@ -340,7 +945,49 @@ int TcpSocket::write_n(ByteBuffer& buf)
 
 // --------------------------------------------------------------------------
 
-bool TcpSocket::write_timeout(const Duration& d)
+int StreamSocket::writev(ByteBuffer* const bufs[], size_t n)
+{
+	#if !defined(WIN32)
+		return CtrlrFx::writev(handle(), bufs, n);
+	#else
+		size_t	nw = 0;
+		int		nx = 0;
+
+		for (size_t i=0; i<n; ++i) {
+			if (bufs[i]->empty())
+				continue;
+			if ((nx = write(*bufs[i])) <= 0)
+				break;
+			nw += nx;
+			if (!bufs[i]->empty())
+				break;
+		}
+		return (nw == 0) ? nx : int(nw);
+	#endif
+}
+
+// --------------------------------------------------------------------------
+
+int StreamSocket::writev_n(ByteBuffer* const bufs[], size_t n)
+{
+	#if !defined(WIN32)
+		return CtrlrFx::writev_n(handle(), bufs, n);
+	#else
+		size_t	nw = 0;
+		int		nx = 0;
+
+		for (size_t i=0; i<n; ++i) {
+			if ((nx = write_n(*bufs[i])) < 0)
+				break;
+			nw += nx;
+		}
+		return (nw == 0 && nx < 0) ? nx : int(nw);
+	#endif
+}
+
+// --------------------------------------------------------------------------
+
+bool StreamSocket::write_timeout(const Duration& d)
 {
 	#if defined(CFX_POSIX)
 		timeval tv = d.to_timeval();
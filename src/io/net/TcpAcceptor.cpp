@@ -3,6 +3,12 @@
 #include <cstring>
 #include "CtrlrFx/TcpAcceptor.h"
 
+#if !defined(WIN32)
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <errno.h>
+#endif
+
 using namespace std;
 using namespace CtrlrFx;
 
@@ -13,7 +19,8 @@ using namespace CtrlrFx;
 // If the acceptor appears to already be opened, this will quietly succeed
 // without doing anything. 
 
-int TcpAcceptor::open(const InetAddr& addr, int queSize /*=DFLT_QUE_SIZE*/)
+int TcpAcceptor::open(const SockAddr& addr, int queSize /*=DFLT_QUE_SIZE*/,
+					  int opts /*=0*/)
 {
 	if (is_open())
 		return 0;
@@ -23,7 +30,7 @@ int TcpAcceptor::open(const InetAddr& addr, int queSize /*=DFLT_QUE_SIZE*/)
 
 	// TODO: Check queue size?
 
-	reset(TcpSocket::create());
+	reset(TcpSocket::create(addr.family()));
 
 	if (!is_valid())
 		return handle();
@@ -33,33 +40,93 @@ int TcpAcceptor::open(const InetAddr& addr, int queSize /*=DFLT_QUE_SIZE*/)
 	#if defined(CFX_POSIX)
 		int reuse = 1;
 		if ((ret = ::setsockopt(handle(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(int))) < 0) {
-			release();
+			close();
 			return ret;
 		}
 	#endif	
 	
-	if ((ret = bind(addr)) < 0) {
-		release();
+	if ((ret = set_bind_options(opts)) < 0 || (ret = bind(addr)) < 0
+			|| (ret = listen(queSize)) < 0
+			|| (ret = set_listen_options(opts, queSize)) < 0) {
+		close();
 		return ret;
 	}
 
-	if ((ret = listen(queSize)) < 0) {
-		release();
-		return ret;
+	addr_ = addr;
+	opts_ = opts;
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// Options that the OS doesn't have fail with ENOPROTOOPT, rather than being
+// quietly ignored, since the caller is depending on them for load sharing.
+
+int TcpAcceptor::set_bind_options(int opts)
+{
+	if (opts & REUSE_PORT) {
+		#if defined(SO_REUSEPORT)
+			int on = 1;
+			if (::setsockopt(handle(), SOL_SOCKET, SO_REUSEPORT, &on, sizeof(int)) < 0)
+				return -1;
+		#else
+			errno = ENOPROTOOPT;
+			return -1;
+		#endif
 	}
 
-	addr_ = addr;
 	return 0;
 }
 
 // --------------------------------------------------------------------------
+// TCP_DEFER_ACCEPT holds a connection for up to a second waiting for the
+// client's first data. TCP_FASTOPEN's value is the number of pending
+// fast-open requests, which follows the listen queue size.
 
-TcpSocket TcpAcceptor::accept()
+int TcpAcceptor::set_listen_options(int opts, int queSize)
 {
-	InetAddr	clientAddr;
-	socklen_t	len = sizeof(InetAddr);
+	if (opts & DEFER_ACCEPT) {
+		#if defined(TCP_DEFER_ACCEPT)
+			int secs = 1;
+			if (::setsockopt(handle(), IPPROTO_TCP, TCP_DEFER_ACCEPT, &secs, sizeof(int)) < 0)
+				return -1;
+		#else
+			errno = ENOPROTOOPT;
+			return -1;
+		#endif
+	}
+
+	if (opts & FAST_OPEN) {
+		#if defined(TCP_FASTOPEN)
+			if (::setsockopt(handle(), IPPROTO_TCP, TCP_FASTOPEN, &queSize, sizeof(int)) < 0)
+				return -1;
+		#else
+			errno = ENOPROTOOPT;
+			return -1;
+		#endif
+	}
+
+	return 0;
+}
+
+// --------------------------------------------------------------------------
 
-	socket_t s = ::accept(handle(), clientAddr.sockaddr_ptr(), &len);
-	return TcpSocket(s);
+TcpSocket TcpAcceptor::accept()
+{
+	SockAddr	clientAddr;
+	socklen_t	len = SockAddr::capacity();
+
+	#if defined(__linux__)
+		int flags = SOCK_CLOEXEC;
+		if (opts_ & NON_BLOCK)
+			flags |= SOCK_NONBLOCK;
+
+		TcpSocket sock(::accept4(handle(), clientAddr.sockaddr_ptr(), &len, flags));
+	#else
+		TcpSocket sock(::accept(handle(), clientAddr.sockaddr_ptr(), &len));
+
+		if (sock.is_open() && (opts_ & NON_BLOCK))
+			sock.set_non_blocking();
+	#endif
+	return sock;
 }
 
@@ -2,27 +2,83 @@
 
 #include "CtrlrFx/CtrlrFx.h"
 #include "CtrlrFx/TcpConnector.h"
+#include <poll.h>
+#include <errno.h>
 
 using namespace CtrlrFx;
 
 // --------------------------------------------------------------------------
 
-TcpConnector::TcpConnector(const InetAddr& addr) : TcpSocket(TcpSocket::create())
+TcpConnector::TcpConnector(const SockAddr& addr)
+					: TcpSocket(TcpSocket::create(addr.family()))
 {
 	if (::connect(handle(), addr.sockaddr_ptr(), addr.size()) < 0)
-		release();
+		close();
 }
 
 // --------------------------------------------------------------------------
 
-int TcpConnector::connect(const InetAddr& addr)
+int TcpConnector::connect(const SockAddr& addr)
 {
 	int ret;
 
-	reset(create());
+	reset(create(addr.family()));
 	if ((ret = ::connect(handle(), addr.sockaddr_ptr(), addr.size())) < 0)
-		release();
+		close();
 
 	return ret;
 }
 
+// --------------------------------------------------------------------------
+
+TcpConnector::TcpConnector(const SockAddr& addr, const Duration& timeout)
+{
+	connect(addr, timeout);
+}
+
+// --------------------------------------------------------------------------
+// The result of a connect that's in progress is picked up from SO_ERROR
+// once the socket becomes writable.
+
+int TcpConnector::connect(const SockAddr& addr, const Duration& timeout)
+{
+	reset(create(addr.family()));
+	if (!is_open())
+		return -1;
+
+	int ret = set_non_blocking(true);
+
+	if (ret == 0 && (ret = ::connect(handle(), addr.sockaddr_ptr(), addr.size())) < 0
+			&& errno == EINPROGRESS) {
+		pollfd pfd;
+		pfd.fd = handle();
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+
+		while ((ret = ::poll(&pfd, 1, int(timeout.to_msec()))) < 0 && errno == EINTR)
+			;
+
+		if (ret == 0) {
+			errno = ETIMEDOUT;
+			ret = -1;
+		}
+		else if (ret > 0) {
+			int err = 0;
+			if ((ret = get_option(SOL_SOCKET, SO_ERROR, &err)) == 0 && err != 0) {
+				errno = err;
+				ret = -1;
+			}
+		}
+	}
+
+	if (ret == 0)
+		ret = set_non_blocking(false);
+
+	if (ret < 0) {
+		int err = errno;
+		close();
+		errno = err;
+	}
+	return ret;
+}
+
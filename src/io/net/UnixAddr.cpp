@@ -0,0 +1,37 @@
+// UnixAddr.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/UnixAddr.h"
+
+#if !defined(WIN32)
+
+using namespace std;
+using namespace CtrlrFx;
+
+// --------------------------------------------------------------------------
+// Under Linux, a leading '@' names the socket in the abstract namespace,
+// where the first byte of the path is a NUL rather than the '@'. A path
+// that doesn't fit is left empty, rather than silently truncated, so that
+// it can't bind to the wrong place.
+
+void UnixAddr::create(const char* path)
+{
+	zero();
+
+	size_t n = strlen(path);
+	if (n == 0 || n > MAX_PATH_LEN)
+		return;
+
+	#if defined(__linux__)
+		if (path[0] == '@') {
+			if (n > 1)
+				memcpy(sun_path+1, path+1, n-1);
+			return;
+		}
+	#endif
+
+	memcpy(sun_path, path, n);
+}
+
+#endif	// !WIN32
+
@@ -0,0 +1,195 @@
+// UnixSocket.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/UnixSocket.h"
+
+#if !defined(WIN32)
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+
+using namespace CtrlrFx;
+
+// --------------------------------------------------------------------------
+// Removes a stale socket file from a path, so it can be bound again. Only
+// a socket that nobody accepts connections on is removed.
+
+static void unlink_stale(const UnixAddr& addr)
+{
+	struct stat st;
+
+	if (::lstat(addr.path(), &st) < 0 || !S_ISSOCK(st.st_mode))
+		return;
+
+	int sock = ::socket(PF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0)
+		return;
+
+	if (::connect(sock, addr.sockaddr_ptr(), addr.size()) < 0
+			&& errno == ECONNREFUSED)
+		::unlink(addr.path());
+
+	::close(sock);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//							UnixStreamSocket
+/////////////////////////////////////////////////////////////////////////////
+
+UnixStreamSocket::UnixStreamSocket(const UnixAddr& addr) : StreamSocket(create())
+{
+	if (::connect(handle(), addr.sockaddr_ptr(), addr.size()) < 0)
+		close();
+}
+
+// --------------------------------------------------------------------------
+
+int UnixStreamSocket::connect(const UnixAddr& addr)
+{
+	int ret;
+
+	reset(create());
+	if ((ret = ::connect(handle(), addr.sockaddr_ptr(), addr.size())) < 0)
+		close();
+
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+
+int UnixStreamSocket::pair(UnixStreamSocket& sock1, UnixStreamSocket& sock2)
+{
+	int sv[2];
+
+	if (::socketpair(PF_UNIX, SOCK_STREAM, 0, sv) < 0)
+		return -1;
+
+	sock1.reset(sv[0]);
+	sock2.reset(sv[1]);
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//							UnixAcceptor
+/////////////////////////////////////////////////////////////////////////////
+
+UnixAcceptor::~UnixAcceptor()
+{
+	if (is_open()) {
+		close();
+		if (!addr_.is_abstract())
+			::unlink(addr_.path());
+	}
+}
+
+// --------------------------------------------------------------------------
+// As with the TcpAcceptor, on any error this leaves the socket unopened,
+// and if the acceptor is already open, it quietly succeeds.
+
+int UnixAcceptor::open(const UnixAddr& addr, int queSize /*=DFLT_QUE_SIZE*/)
+{
+	if (is_open())
+		return 0;
+
+	if (!addr.is_set())
+		return -1;
+
+	reset(UnixStreamSocket::create());
+
+	if (!is_valid())
+		return -1;
+
+	if (!addr.is_abstract())
+		unlink_stale(addr);
+
+	if (::bind(handle(), addr.sockaddr_ptr(), addr.size()) < 0
+			|| ::listen(handle(), queSize) < 0) {
+		close();
+		return -1;
+	}
+
+	addr_ = addr;
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//							UnixDgramSocket
+/////////////////////////////////////////////////////////////////////////////
+
+UnixDgramSocket::UnixDgramSocket(const UnixAddr& addr) : Socket(create())
+{
+	bind(addr);
+}
+
+// --------------------------------------------------------------------------
+
+int UnixDgramSocket::pair(UnixDgramSocket& sock1, UnixDgramSocket& sock2)
+{
+	int sv[2];
+
+	if (::socketpair(PF_UNIX, SOCK_DGRAM, 0, sv) < 0)
+		return -1;
+
+	sock1.reset(sv[0]);
+	sock2.reset(sv[1]);
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int UnixDgramSocket::sendto(ByteBuffer& buf, const UnixAddr& addr)
+{
+	int n = sendto(buf.position_ptr(), buf.available(), addr);
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
+int UnixDgramSocket::send(ByteBuffer& buf)
+{
+	int n = send(buf.position_ptr(), buf.available());
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
+int UnixDgramSocket::recvfrom(void* buf, size_t n, UnixAddr& addr)
+{
+	UnixAddr	sau;
+	socklen_t	alen = sizeof(sockaddr_un);
+
+	int ret = ::recvfrom(handle(), buf, n, 0, sau.sockaddr_ptr(), &alen);
+
+	if (ret >= 0)
+		addr = sau;
+
+	return ret;
+}
+
+int UnixDgramSocket::recvfrom(ByteBuffer& buf, UnixAddr& addr)
+{
+	int n = recvfrom(buf.position_ptr(), buf.available(), addr);
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
+int UnixDgramSocket::recv(ByteBuffer& buf)
+{
+	int n = recv(buf.position_ptr(), buf.available());
+
+	if (n > 0)
+		buf.incr_position(n);
+
+	return n;
+}
+
+#endif	// !WIN32
+
@@ -0,0 +1,269 @@
+// ActiveObject.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/ActiveObject.h"
+#include <string.h>
+#include <stdio.h>
+
+using namespace CtrlrFx;
+
+// Gets the position (one-based) of the highest bit set in a non-zero value.
+
+static inline int highest_bit(uint64_t x)
+{
+	#if defined(__GNUC__)
+		return 64 - __builtin_clzll(x);
+	#else
+		int n = 0;
+		while (x) {
+			x >>= 1;
+			++n;
+		}
+		return n;
+	#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								ActiveObject
+/////////////////////////////////////////////////////////////////////////////
+
+ActiveObject::~ActiveObject()
+{
+	if (sched_)
+		sched_->stop(*this);
+}
+
+// --------------------------------------------------------------------------
+
+// The reference taken around the post means that an event that nobody
+// else holds gets recycled if the post fails.
+
+bool ActiveObject::post(const Event* evt)
+{
+	bool ok = false;
+
+	Events::add_ref(evt);
+	if (sched_) {
+		ActiveScheduler::MyGuard g(sched_->cond_);
+		ok = sched_->post_locked(this, evt);
+	}
+	Events::release(evt);
+	return ok;
+}
+
+// --------------------------------------------------------------------------
+
+void ActiveObject::subscribe(evt_sig_t sig)
+{
+	assert(sched_ && sig >= 0 && sig < sched_->maxSig_);
+
+	ActiveScheduler::MyGuard g(sched_->cond_);
+	sched_->subs_[sig] |= ActiveScheduler::prio_bit(prio_);
+}
+
+// --------------------------------------------------------------------------
+
+void ActiveObject::unsubscribe(evt_sig_t sig)
+{
+	assert(sched_ && sig >= 0 && sig < sched_->maxSig_);
+
+	ActiveScheduler::MyGuard g(sched_->cond_);
+	sched_->subs_[sig] &= ~ActiveScheduler::prio_bit(prio_);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//							ActiveScheduler::Runner
+/////////////////////////////////////////////////////////////////////////////
+
+// Runs one event at a time, outside the lock, releasing each when the
+// object is done with it.
+
+int ActiveScheduler::Runner::run()
+{
+	ActiveObject* ao;
+	const Event* evt;
+
+	while ((ao = sched_.next(&evt)) != 0) {
+		ao->handle(evt);
+		Events::release(evt);
+
+		MyGuard g(sched_.cond_);
+		ao->running_ = false;
+		if (!ao->que_.empty())
+			sched_.ready_ |= prio_bit(ao->prio_);
+		sched_.cond_.broadcast();
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+void ActiveScheduler::Runner::quit()
+{
+	MyGuard g(sched_.cond_);
+	quit_ = true;
+	sched_.quit_ = true;
+	sched_.cond_.broadcast();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								ActiveScheduler
+/////////////////////////////////////////////////////////////////////////////
+
+ActiveScheduler::ActiveScheduler(int maxSig, int nThread, int prio)
+					: ready_(0), maxSig_(maxSig), quit_(false)
+{
+	::memset(active_, 0, sizeof(active_));
+
+	subs_ = new uint64_t[maxSig_];
+	::memset(subs_, 0, maxSig_ * sizeof(uint64_t));
+
+	nRunner_ = (nThread > 0) ? nThread : 1;
+	runners_ = new Runner*[nRunner_];
+
+	for (int i=0; i<nRunner_; ++i) {
+		char name[CTRLR_FX_THREAD_NAME_LEN];
+		::snprintf(name, sizeof(name), "active%d", i);
+		runners_[i] = new Runner(*this, prio, name);
+		runners_[i]->activate();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+ActiveScheduler::~ActiveScheduler()
+{
+	for (int i=0; i<nRunner_; ++i)
+		runners_[i]->quit();
+
+	for (int i=0; i<nRunner_; ++i) {
+		runners_[i]->wait();
+		delete runners_[i];
+	}
+	delete[] runners_;
+
+	for (int prio=1; prio<=MAX_ACTIVE; ++prio) {
+		if (active_[prio])
+			stop(*active_[prio]);
+	}
+	delete[] subs_;
+}
+
+// --------------------------------------------------------------------------
+// Takes the highest priority object that's ready, marks it as running, and
+// pulls its next event. Returns null on shutdown.
+
+ActiveObject* ActiveScheduler::next(const Event** evt)
+{
+	MyGuard g(cond_);
+
+	while (ready_ == 0 && !quit_)
+		cond_.wait();
+
+	if (quit_)
+		return 0;
+
+	int prio = highest_bit(ready_);
+	ready_ &= ~prio_bit(prio);
+
+	ActiveObject* ao = active_[prio];
+	ao->running_ = true;
+	ao->que_.get(evt);
+	return ao;
+}
+
+// --------------------------------------------------------------------------
+// If the object isn't running, it's marked ready. Otherwise, the thread
+// that's running it will mark it ready when it's done with the current
+// event.
+
+bool ActiveScheduler::post_locked(ActiveObject* ao, const Event* evt)
+{
+	if (ao->que_.full())
+		return false;
+
+	Events::add_ref(evt);
+	ao->que_.put(evt);
+
+	if (!ao->running_) {
+		ready_ |= prio_bit(ao->prio_);
+		cond_.signal();
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+int ActiveScheduler::start(ActiveObject& ao, int prio, size_t queSize)
+{
+	{
+		MyGuard g(cond_);
+
+		if (prio < 1 || prio > MAX_ACTIVE || active_[prio] || ao.sched_)
+			return -1;
+
+		// The circular queue keeps one slot open.
+		ao.que_.resize(queSize+1);
+		ao.prio_ = prio;
+		ao.running_ = false;
+		ao.sched_ = this;
+		active_[prio] = &ao;
+	}
+
+	ao.init();
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+void ActiveScheduler::stop(ActiveObject& ao)
+{
+	MyGuard g(cond_);
+
+	if (ao.sched_ != this)
+		return;
+
+	while (ao.running_ && !quit_)
+		cond_.wait();
+
+	uint64_t bit = prio_bit(ao.prio_);
+
+	ready_ &= ~bit;
+	for (int i=0; i<maxSig_; ++i)
+		subs_[i] &= ~bit;
+
+	const Event* evt;
+	while (ao.que_.get(&evt))
+		Events::release(evt);
+
+	active_[ao.prio_] = 0;
+	ao.sched_ = 0;
+	ao.prio_ = 0;
+}
+
+// --------------------------------------------------------------------------
+// The extra reference held while the event is being published keeps it from
+// being recycled by a subscriber that handles it before we've posted it to
+// everyone else.
+
+int ActiveScheduler::publish(const Event* evt)
+{
+	assert(evt->sig >= 0 && evt->sig < maxSig_);
+
+	int n = 0;
+	Events::add_ref(evt);
+	{
+		MyGuard g(cond_);
+		uint64_t subs = subs_[evt->sig];
+
+		while (subs) {
+			int prio = highest_bit(subs);
+			subs &= ~prio_bit(prio);
+			if (post_locked(active_[prio], evt))
+				++n;
+		}
+	}
+	Events::release(evt);
+	return n;
+}
+
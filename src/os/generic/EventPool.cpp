@@ -0,0 +1,145 @@
+// EventPool.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/EventPool.h"
+#include "CtrlrFx/AtomicOps.h"
+
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+//								EventPool
+/////////////////////////////////////////////////////////////////////////////
+
+EventPool::EventPool(size_t blkSize, size_t n) : own_(true)
+{
+	// Round the block size up to keep every block pointer-aligned.
+	blkSize = (blkSize + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	if (blkSize < sizeof(Block))
+		blkSize = sizeof(Block);
+
+	mem_ = new byte[blkSize * n];
+	init(blkSize, n);
+}
+
+EventPool::EventPool(void* mem, size_t memSize, size_t blkSize)
+					: mem_(static_cast<byte*>(mem)), own_(false)
+{
+	blkSize = (blkSize + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	if (blkSize < sizeof(Block))
+		blkSize = sizeof(Block);
+
+	init(blkSize, memSize / blkSize);
+}
+
+// --------------------------------------------------------------------------
+
+void EventPool::init(size_t blkSize, size_t n)
+{
+	blkSize_ = blkSize;
+	n_ = nFree_ = nMin_ = n;
+	free_ = 0;
+
+	for (size_t i=n; i>0; --i) {
+		Block* blk = reinterpret_cast<Block*>(mem_ + (i-1)*blkSize);
+		blk->next = free_;
+		free_ = blk;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+EventPool::~EventPool()
+{
+	if (own_)
+		delete[] mem_;
+}
+
+// --------------------------------------------------------------------------
+
+void* EventPool::get()
+{
+	MyGuard g(lock_);
+
+	Block* blk = free_;
+	if (blk) {
+		free_ = blk->next;
+		if (--nFree_ < nMin_)
+			nMin_ = nFree_;
+	}
+	return blk;
+}
+
+// --------------------------------------------------------------------------
+
+void EventPool::put(void* p)
+{
+	assert(static_cast<byte*>(p) >= mem_ &&
+		   static_cast<byte*>(p) < mem_ + n_*blkSize_);
+
+	MyGuard g(lock_);
+
+	Block* blk = static_cast<Block*>(p);
+	blk->next = free_;
+	free_ = blk;
+	++nFree_;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								Events
+/////////////////////////////////////////////////////////////////////////////
+
+EventPool*	Events::pools_[Events::MAX_POOLS];
+int			Events::nPool_ = 0;
+
+// --------------------------------------------------------------------------
+
+int Events::add_pool(EventPool& pool)
+{
+	if (nPool_ >= MAX_POOLS)
+		return -1;
+
+	assert(nPool_ == 0 || pools_[nPool_-1]->block_size() <= pool.block_size());
+
+	pools_[nPool_++] = &pool;
+	return nPool_;
+}
+
+// --------------------------------------------------------------------------
+// Pool ids are one-based, so that zero can mean "not pooled".
+
+void* Events::alloc(size_t sz, uint8_t* poolId)
+{
+	for (int i=0; i<nPool_; ++i) {
+		if (pools_[i]->block_size() >= sz) {
+			*poolId = uint8_t(i+1);
+			return pools_[i]->get();
+		}
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+void Events::add_ref(const Event* evt)
+{
+	if (evt->poolId != 0)
+		atomic_fetch_add(&const_cast<Event*>(evt)->refCnt, uint8_t(1));
+}
+
+// --------------------------------------------------------------------------
+// An event that was never referenced (refCnt of zero) is recycled as well,
+// which lets the application discard an event that it allocated but
+// didn't post.
+
+void Events::release(const Event* evt)
+{
+	if (evt->poolId == 0)
+		return;
+
+	Event* e = const_cast<Event*>(evt);
+	if (atomic_fetch_add(&e->refCnt, uint8_t(-1)) <= 1) {
+		assert(e->poolId <= nPool_);
+		pools_[e->poolId-1]->put(e);
+	}
+}
+
@@ -0,0 +1,341 @@
+// Executor.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/Executor.h"
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+
+using namespace CtrlrFx;
+
+__thread Executor::Worker* Executor::currWorker_ = 0;
+
+/////////////////////////////////////////////////////////////////////////////
+//								FutureStateBase
+/////////////////////////////////////////////////////////////////////////////
+
+// Once 'done' is set, a waiter may delete the state, so we can't touch
+// any members after that.
+
+void FutureStateBase::set_ready()
+{
+	Executor& exec = exec_;
+	atomic_store_release(&done_, 1);
+	exec.notify_done();
+}
+
+// --------------------------------------------------------------------------
+
+void FutureStateBase::wait()
+{
+	if (!is_ready())
+		exec_.wait_for(*this);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								Executor::Worker
+/////////////////////////////////////////////////////////////////////////////
+
+Executor::Worker::Worker(Executor& exec, int id, int prio, size_t cap,
+						 const char* name)
+			: Thread(prio, 0, name), exec_(exec), id_(id), deque_(cap),
+				wake_(0), nextIdle_(0), parked_(false), rand_(uint32_t(id) * 2654435761U + 1)
+{
+}
+
+// --------------------------------------------------------------------------
+// The worker loop. We keep running tasks as long as we can find them, spin
+// a little when we run dry, and then park until more work arrives. On
+// shutdown we keep going until all the queued work is done.
+
+int Executor::Worker::run()
+{
+	currWorker_ = this;
+
+	while (true) {
+		ExecTask* task = exec_.find_task(this);
+
+		// Search for a while before giving up. While anyone is searching,
+		// producers don't bother waking parked workers, so when a searcher
+		// finds something, it passes the baton on if there's more to do.
+
+		if (!task) {
+			atomic_fetch_add(&exec_.nSearching_, 1);
+
+			for (int i=0; i<SPIN_COUNT && !task; ++i) {
+				if ((task = exec_.find_task(this)) == 0)
+					cpu_relax();
+			}
+
+			if (atomic_fetch_add(&exec_.nSearching_, -1) == 1 &&
+					task && exec_.has_work())
+				exec_.wake_one();
+		}
+
+		if (task) {
+			task->execute();
+			delete task;
+			continue;
+		}
+
+		if (exec_.quit_)
+			break;
+
+		exec_.park(this);
+	}
+
+	currWorker_ = 0;
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								Executor
+/////////////////////////////////////////////////////////////////////////////
+
+Executor::Executor(int nThread, int prio, size_t dequeSize)
+			: qHead_(0), qTail_(0), qSize_(0), idleHead_(0), nIdle_(0),
+				nSearching_(0), nWaiters_(0), quit_(false)
+{
+	nWorker_ = (nThread > 0) ? nThread : hardware_concurrency();
+	workers_ = new Worker*[nWorker_];
+
+	for (int i=0; i<nWorker_; ++i) {
+		char name[CTRLR_FX_THREAD_NAME_LEN];
+		::snprintf(name, sizeof(name), "exec%d", i);
+		workers_[i] = new Worker(*this, i, prio, dequeSize, name);
+	}
+
+	for (int i=0; i<nWorker_; ++i)
+		workers_[i]->activate();
+}
+
+// --------------------------------------------------------------------------
+
+Executor::~Executor()
+{
+	quit_ = true;
+	atomic_fence();
+
+	for (int i=0; i<nWorker_; ++i)
+		workers_[i]->wake_.post();
+
+	for (int i=0; i<nWorker_; ++i) {
+		workers_[i]->wait();
+		delete workers_[i];
+	}
+	delete[] workers_;
+}
+
+// --------------------------------------------------------------------------
+
+int Executor::hardware_concurrency()
+{
+	long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? int(n) : 1;
+}
+
+// --------------------------------------------------------------------------
+// Workers push onto their own deque; everyone else, and a worker whose
+// deque is full, uses the shared queue. Then we wake a parked worker, if
+// there is one and nobody is already out looking for work. The fence
+// pairs with the one in park() so that either we see the worker in the
+// idle list, or it sees our task.
+
+void Executor::enqueue(ExecTask* task)
+{
+	Worker* w = curr_worker();
+
+	if (!w || !w->deque_.push(task)) {
+		Guard<Mutex> g(qLock_);
+		task->next_ = 0;
+		if (qTail_)
+			qTail_->next_ = task;
+		else
+			qHead_ = task;
+		qTail_ = task;
+		atomic_fetch_add(&qSize_, 1);
+	}
+
+	atomic_fence();
+	if (atomic_load_relaxed(&nIdle_) > 0 && atomic_load_relaxed(&nSearching_) == 0)
+		wake_one();
+}
+
+// --------------------------------------------------------------------------
+
+ExecTask* Executor::dequeue_shared()
+{
+	if (atomic_load_acquire(&qSize_) == 0)
+		return 0;
+
+	Guard<Mutex> g(qLock_);
+	ExecTask* task = qHead_;
+	if (task) {
+		if ((qHead_ = task->next_) == 0)
+			qTail_ = 0;
+		atomic_fetch_add(&qSize_, -1);
+	}
+	return task;
+}
+
+// --------------------------------------------------------------------------
+// Looks for work: first our own deque, then the shared queue, then the
+// other workers' deques, starting from a random one.
+
+ExecTask* Executor::find_task(Worker* w)
+{
+	ExecTask* task;
+
+	if (w->deque_.pop(&task))
+		return task;
+
+	if ((task = dequeue_shared()) != 0)
+		return task;
+
+	if (nWorker_ < 2)
+		return 0;
+
+	// xorshift
+	uint32_t r = w->rand_;
+	r ^= r << 13;
+	r ^= r >> 17;
+	r ^= r << 5;
+	w->rand_ = r;
+
+	int start = int(r % uint32_t(nWorker_));
+
+	for (int i=0; i<nWorker_; ++i) {
+		Worker* victim = workers_[(start + i) % nWorker_];
+		if (victim == w)
+			continue;
+
+		int ret;
+		while ((ret = victim->deque_.steal(&task)) == WorkStealDeque<ExecTask*>::ABORT)
+			cpu_relax();
+
+		if (ret == WorkStealDeque<ExecTask*>::SUCCESS)
+			return task;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+bool Executor::has_work() const
+{
+	if (atomic_load_acquire(&qSize_) != 0)
+		return true;
+
+	for (int i=0; i<nWorker_; ++i) {
+		if (!workers_[i]->deque_.empty())
+			return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+// Puts the worker to sleep. It goes into the idle list first, then checks
+// once more for work that might have arrived before anyone could see it
+// there. If there is some, it takes itself back out, unless a producer
+// already did (and posted the semaphore).
+
+void Executor::park(Worker* w)
+{
+	{
+		Guard<Mutex> g(idleLock_);
+		if (!w->parked_) {
+			w->nextIdle_ = idleHead_;
+			idleHead_ = w;
+			w->parked_ = true;
+			atomic_fetch_add(&nIdle_, 1);
+		}
+	}
+
+	atomic_fence();
+
+	if ((has_work() || quit_)) {
+		Guard<Mutex> g(idleLock_);
+		if (w->parked_) {
+			unpark(w);
+			return;
+		}
+	}
+
+	w->wake_.wait();
+
+	Guard<Mutex> g(idleLock_);
+	if (w->parked_)
+		unpark(w);
+}
+
+// --------------------------------------------------------------------------
+// Removes a worker from the idle list. The caller must hold the idle lock.
+
+void Executor::unpark(Worker* w)
+{
+	Worker** pp = &idleHead_;
+	while (*pp && *pp != w)
+		pp = &(*pp)->nextIdle_;
+
+	if (*pp) {
+		*pp = w->nextIdle_;
+		atomic_fetch_add(&nIdle_, -1);
+	}
+	w->nextIdle_ = 0;
+	w->parked_ = false;
+}
+
+// --------------------------------------------------------------------------
+
+void Executor::wake_one()
+{
+	Guard<Mutex> g(idleLock_);
+	Worker* w = idleHead_;
+	if (w) {
+		unpark(w);
+		w->wake_.post();
+	}
+}
+
+// --------------------------------------------------------------------------
+// A worker that waits on a future runs other tasks in the meantime, so
+// that tasks can wait on sub-tasks without tying up the pool. Any other
+// thread blocks on the condition variable.
+
+void Executor::wait_for(FutureStateBase& st)
+{
+	Worker* w = curr_worker();
+
+	if (w) {
+		while (!st.is_ready()) {
+			ExecTask* task = find_task(w);
+			if (task) {
+				task->execute();
+				delete task;
+			}
+			else
+				::sched_yield();
+		}
+		return;
+	}
+
+	Guard<ConditionVar> g(doneCond_);
+	atomic_fetch_add(&nWaiters_, 1);
+	while (!st.is_ready())
+		doneCond_.wait();
+	atomic_fetch_add(&nWaiters_, -1);
+}
+
+// --------------------------------------------------------------------------
+// Called when a task completes. The lock is only taken if someone outside
+// the pool is blocked waiting on a future.
+
+void Executor::notify_done()
+{
+	atomic_fence();
+	if (atomic_load_relaxed(&nWaiters_) > 0) {
+		Guard<ConditionVar> g(doneCond_);
+		doneCond_.broadcast();
+	}
+}
+
@@ -0,0 +1,470 @@
+// TimerService.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/TimerService.h"
+#include <string.h>
+#include <stdio.h>
+
+using namespace CtrlrFx;
+
+// Rotates a 64-bit value right by the specified number of bits.
+
+static inline uint64_t rotr64(uint64_t x, int n)
+{
+	return (n == 0) ? x : ((x >> n) | (x << (64-n)));
+}
+
+// Gets the index of the lowest bit set in a non-zero value.
+
+static inline int lowest_bit(uint64_t x)
+{
+	#if defined(__GNUC__)
+		return __builtin_ctzll(x);
+	#else
+		int n = 0;
+		while ((x & 1) == 0) {
+			x >>= 1;
+			++n;
+		}
+		return n;
+	#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerWheel
+/////////////////////////////////////////////////////////////////////////////
+
+TimerWheel::TimerWheel() : now_(0), n_(0)
+{
+	::memset(slots_, 0, sizeof(slots_));
+	::memset(occupied_, 0, sizeof(occupied_));
+}
+
+// --------------------------------------------------------------------------
+// Puts the timer into a slot according to how far away its expiration is.
+// Timers that expire within the next 64 ticks go into the slot for their
+// tick in the lowest wheel, those within the next 64^2 ticks go into the
+// slot for their group of 64 in the second wheel, and so on. Timers past
+// the end of the last wheel are placed at the farthest point in it, and
+// get re-sorted when that slot comes up.
+
+void TimerWheel::link(WheelTimer* t)
+{
+	uint64_t expire = t->expire_;
+
+	if (expire < now_)
+		expire = now_;
+	else if (expire - now_ >= MAX_SPAN)
+		expire = now_ + MAX_SPAN - 1;
+
+	uint64_t delta = expire - now_;
+	int level = 0;
+
+	while (level < N_LEVELS-1 && delta >= (uint64_t(1) << (SLOT_BITS * (level+1))))
+		++level;
+
+	int slot = int((expire >> (SLOT_BITS * level)) & (N_SLOTS-1));
+
+	WheelTimer** head = &slots_[level][slot];
+
+	t->level_ = level;
+	t->slot_ = slot;
+	t->next_ = *head;
+	t->pprev_ = head;
+	if (*head)
+		(*head)->pprev_ = &t->next_;
+	*head = t;
+
+	occupied_[level] |= uint64_t(1) << slot;
+}
+
+// --------------------------------------------------------------------------
+
+void TimerWheel::unlink(WheelTimer* t)
+{
+	*t->pprev_ = t->next_;
+	if (t->next_)
+		t->next_->pprev_ = t->pprev_;
+
+	if (!slots_[t->level_][t->slot_])
+		occupied_[t->level_] &= ~(uint64_t(1) << t->slot_);
+
+	t->next_ = 0;
+	t->pprev_ = 0;
+}
+
+// --------------------------------------------------------------------------
+// Moves all the timers in the current slot of a higher wheel down into the
+// lower ones.
+
+void TimerWheel::cascade(int level)
+{
+	int slot = int((now_ >> (SLOT_BITS * level)) & (N_SLOTS-1));
+
+	WheelTimer* t = slots_[level][slot];
+	slots_[level][slot] = 0;
+	occupied_[level] &= ~(uint64_t(1) << slot);
+
+	while (t) {
+		WheelTimer* next = t->next_;
+		link(t);
+		t = next;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void TimerWheel::add(WheelTimer* t, uint64_t expire)
+{
+	assert(t->pprev_ == 0);
+	t->expire_ = (expire < now_) ? now_ : expire;
+	link(t);
+	++n_;
+}
+
+// --------------------------------------------------------------------------
+
+void TimerWheel::remove(WheelTimer* t)
+{
+	if (t->pprev_) {
+		unlink(t);
+		--n_;
+	}
+}
+
+// --------------------------------------------------------------------------
+// For the lowest wheel, the next event is the first occupied slot after
+// the current tick. For the higher wheels, it's the start of the first
+// occupied group after the current one, which is when that slot needs to
+// be cascaded.
+
+uint64_t TimerWheel::next_event() const
+{
+	uint64_t next = NEVER;
+
+	for (int level=0; level<N_LEVELS; ++level) {
+		if (occupied_[level] == 0)
+			continue;
+
+		int shift = SLOT_BITS * level;
+		uint64_t base = (now_ >> shift) + 1;
+		uint64_t bits = rotr64(occupied_[level], int(base & (N_SLOTS-1)));
+		uint64_t tick = (base + lowest_bit(bits)) << shift;
+
+		if (tick < next)
+			next = tick;
+	}
+	return next;
+}
+
+// --------------------------------------------------------------------------
+// Timers in the lowest wheel slot for the current tick are due. When that
+// slot is empty, we jump ahead to the next tick that has work, cascading
+// the higher wheels as their slots come up, until we find a due timer or
+// pass the requested tick.
+
+WheelTimer* TimerWheel::pop_expired(uint64_t tick)
+{
+	for (;;) {
+		WheelTimer* t = slots_[0][now_ & (N_SLOTS-1)];
+
+		if (t) {
+			unlink(t);
+			--n_;
+			if (t->expire_ <= now_)
+				return t;
+
+			// Parked beyond the span of the wheels. Not due yet.
+			link(t);
+			++n_;
+		}
+
+		if (now_ >= tick)
+			return 0;
+
+		uint64_t next = next_event();
+		if (next > tick) {
+			now_ = tick;
+			return 0;
+		}
+
+		now_ = next;
+		for (int level=N_LEVELS-1; level>0; --level) {
+			if ((now_ & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) == 0)
+				cascade(level);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								WheelTimer
+/////////////////////////////////////////////////////////////////////////////
+
+WheelTimer::WheelTimer(TimerService& svc) : client_(0)
+{
+	init(svc);
+}
+
+WheelTimer::WheelTimer(TimerService& svc, ITimerClient& client) : client_(&client)
+{
+	init(svc);
+}
+
+// --------------------------------------------------------------------------
+
+void WheelTimer::init(TimerService& svc)
+{
+	svc_ = &svc;
+	shard_ = svc.assign_shard();
+	slack_ = svc.slack();
+	due_ = expire_ = 0;
+	active_ = false;
+	next_ = 0;
+	pprev_ = 0;
+	level_ = slot_ = 0;
+}
+
+// --------------------------------------------------------------------------
+
+int WheelTimer::register_client(ITimerClient& client)
+{
+	TimerService::MyGuard g(svc_->shards_[shard_]->cond_);
+	client_ = &client;
+	return 1;
+}
+
+// --------------------------------------------------------------------------
+
+void WheelTimer::start()
+{
+	svc_->schedule(this, initDelay_);
+}
+
+// --------------------------------------------------------------------------
+
+void WheelTimer::start(const Duration& period)
+{
+	initDelay_ = period_ = period;
+	svc_->schedule(this, initDelay_);
+}
+
+// --------------------------------------------------------------------------
+
+void WheelTimer::start(const Duration& initDelay, const Duration& period)
+{
+	initDelay_ = initDelay;
+	period_ = period;
+	svc_->schedule(this, initDelay_);
+}
+
+// --------------------------------------------------------------------------
+
+void WheelTimer::one_shot(const Duration& timeout)
+{
+	initDelay_ = timeout;
+	period_ = Duration(0);
+	svc_->schedule(this, initDelay_);
+}
+
+// --------------------------------------------------------------------------
+// Removes the timer from its wheel. If the dispatch thread is in the middle
+// of a callback for this timer, we wait for it to finish, unless we are
+// being called from that callback.
+
+void WheelTimer::stop()
+{
+	TimerService::Shard* shard = svc_->shards_[shard_];
+	TimerService::MyGuard g(shard->cond_);
+
+	active_ = false;
+	shard->wheel_.remove(this);
+
+	if (shard->threadId_ != Thread::curr_thread()) {
+		while (shard->firing_ == this)
+			shard->cond_.wait();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//							TimerService::Shard
+/////////////////////////////////////////////////////////////////////////////
+
+TimerService::Shard::Shard(TimerService& svc, int prio, const char* name)
+				: Thread(prio, 0, name), svc_(svc), cond_(CLOCK_MONOTONIC),
+					wakeTick_(TimerWheel::NEVER), firing_(0), threadId_()
+{
+}
+
+// --------------------------------------------------------------------------
+
+void TimerService::Shard::quit()
+{
+	MyGuard g(cond_);
+	quit_ = true;
+	cond_.broadcast();
+}
+
+// --------------------------------------------------------------------------
+// The dispatch loop. We pop each expired timer and, if it's periodic, put
+// it back into the wheel for its next period before making the callback.
+// The lock is released during the callback so that the client can start
+// and stop timers. Then we sleep until the next tick at which the wheel
+// has something to do, or until someone adds a timer ahead of that.
+
+int TimerService::Shard::run()
+{
+	MyGuard g(cond_);
+	threadId_ = Thread::curr_thread();
+
+	while (!quit_) {
+		WheelTimer* t;
+
+		while ((t = wheel_.pop_expired(svc_.curr_tick())) != 0 && !quit_) {
+			ITimerClient* client = t->client_;
+
+			if (t->period_ == Duration(0))
+				t->active_ = false;
+			else {
+				t->due_ += svc_.to_ticks(t->period_);
+				uint64_t slack = svc_.to_ticks(t->slack_);
+				uint64_t expire = t->due_;
+				if (slack > 1)
+					expire = ((expire + slack - 1) / slack) * slack;
+				wheel_.add(t, expire);
+			}
+
+			if (client) {
+				firing_ = t;
+				cond_.unlock();
+				client->on_timer(*t);
+				cond_.lock();
+				firing_ = 0;
+				cond_.broadcast();
+			}
+		}
+
+		if (quit_)
+			break;
+
+		wakeTick_ = wheel_.next_event();
+
+		if (wakeTick_ == TimerWheel::NEVER)
+			cond_.wait();
+		else
+			cond_.wait_until(svc_.tick_time(wakeTick_));
+
+		wakeTick_ = 0;
+	}
+
+	wakeTick_ = TimerWheel::NEVER;
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerService
+/////////////////////////////////////////////////////////////////////////////
+
+TimerService::TimerService(int nThread, const Duration& res, int prio)
+				: epoch_(MonotonicTime::now()), res_(res.ticks()),
+					nShard_(nThread), nextShard_(0)
+{
+	if (res_ <= 0)
+		res_ = nsec_t(DFLT_RESOLUTION) * 1000000;
+
+	if (nShard_ < 1)
+		nShard_ = 1;
+
+	shards_ = new Shard*[nShard_];
+
+	for (int i=0; i<nShard_; ++i) {
+		char name[CTRLR_FX_THREAD_NAME_LEN];
+		::snprintf(name, sizeof(name), "timer%d", i);
+		shards_[i] = new Shard(*this, prio, name);
+		shards_[i]->activate();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+TimerService::~TimerService()
+{
+	for (int i=0; i<nShard_; ++i) {
+		shards_[i]->quit();
+		shards_[i]->wait();
+		delete shards_[i];
+	}
+	delete[] shards_;
+}
+
+// --------------------------------------------------------------------------
+
+uint64_t TimerService::curr_tick() const
+{
+	nsec_t ns = (MonotonicTime::now() - epoch_).ticks();
+	return (ns <= 0) ? 0 : uint64_t(ns / res_);
+}
+
+// --------------------------------------------------------------------------
+
+uint64_t TimerService::to_ticks(const Duration& d) const
+{
+	nsec_t ns = d.ticks();
+	return (ns <= 0) ? 0 : uint64_t((ns + res_ - 1) / res_);
+}
+
+// --------------------------------------------------------------------------
+
+MonotonicTime TimerService::tick_time(uint64_t tick) const
+{
+	return epoch_ + Duration(nsec(nsec_t(tick) * res_));
+}
+
+// --------------------------------------------------------------------------
+
+int TimerService::assign_shard()
+{
+	Guard<Mutex> g(lock_);
+	int n = nextShard_;
+	nextShard_ = (nextShard_ + 1) % nShard_;
+	return n;
+}
+
+// --------------------------------------------------------------------------
+// (Re)starts a timer. The ideal expiration is kept so that periodic timers
+// don't drift, and the scheduled one is rounded up to a multiple of the
+// slack to line up with other timers. The dispatch thread is only woken if
+// the timer is due before it was planning to wake up anyway.
+
+void TimerService::schedule(WheelTimer* t, const Duration& delay)
+{
+	Shard* shard = shards_[t->shard_];
+	MyGuard g(shard->cond_);
+
+	shard->wheel_.remove(t);
+
+	t->due_ = curr_tick() + to_ticks(delay);
+
+	uint64_t expire = t->due_;
+	uint64_t slack = to_ticks(t->slack_);
+	if (slack > 1)
+		expire = ((expire + slack - 1) / slack) * slack;
+
+	t->active_ = true;
+	shard->wheel_.add(t, expire);
+
+	if (t->expire_ < shard->wakeTick_)
+		shard->cond_.signal();
+}
+
+// --------------------------------------------------------------------------
+
+size_t TimerService::num_active()
+{
+	size_t n = 0;
+	for (int i=0; i<nShard_; ++i) {
+		MyGuard g(shards_[i]->cond_);
+		n += shards_[i]->wheel_.size();
+	}
+	return n;
+}
+
@@ -0,0 +1,460 @@
+// Coroutine.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/Coroutine.h"
+#include "CtrlrFx/debug.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+using namespace CtrlrFx;
+
+// Grows an array of coroutine pointers to hold at least one more item.
+
+static void grow(Coroutine**& arr, size_t n, size_t& cap)
+{
+	if (n < cap)
+		return;
+
+	size_t newCap = cap ? 2*cap : 16;
+	Coroutine** p = new Coroutine*[newCap];
+	if (n)
+		::memcpy(p, arr, n * sizeof(Coroutine*));
+	delete[] arr;
+	arr = p;
+	cap = newCap;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								Coroutine
+/////////////////////////////////////////////////////////////////////////////
+
+bool Coroutine::await(const CoAwait& aw)
+{
+	wait_ = aw;
+
+	switch (aw.kind) {
+		case CoAwait::SLEEP:
+			if (aw.delay.to_nsec() <= 0)
+				return true;
+			due_ = MonotonicTime::now() + aw.delay;
+			return false;
+
+		case CoAwait::RETRY:
+		case CoAwait::FD_RETRY:
+			return (*aw.func)(aw.obj, aw.arg);
+
+		case CoAwait::JOIN:
+			return aw.co->state_ == DONE;
+
+		default:
+			break;
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+void Coroutine::wait()
+{
+	assert(sched_);
+	CoScheduler::MyGuard g(sched_->cond_);
+
+	++sched_->nExtWait_;
+	while (state_ != DONE && state_ != IDLE)
+		sched_->cond_.wait();
+	--sched_->nExtWait_;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								CoScheduler threads
+/////////////////////////////////////////////////////////////////////////////
+
+// The scheduler lock isn't held while a coroutine runs. A coroutine that's
+// waiting is parked only after its run() returns, so that it can't be
+// resumed on another worker while it's still running on this one. Likewise
+// on_done() is called before the coroutine is marked done, since anyone
+// joining or waiting on it may destroy it as soon as it is.
+
+int CoScheduler::Worker::run()
+{
+	Coroutine* co;
+
+	while ((co = sched_.next()) != 0) {
+		bool done = co->run();
+
+		if (done)
+			co->on_done();
+
+		MyGuard g(sched_.cond_);
+		if (done)
+			sched_.finish(co);
+		else
+			sched_.park(co);
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// Polls the descriptors that coroutines are waiting on, with a timeout
+// for the earliest sleeper (or the retry interval). The descriptor array
+// is only compacted here; workers just append to it, so the first n
+// entries still match the poll set when poll() returns. An FD_RETRY wait
+// whose descriptor is ready has its operation tried, and stays in the
+// poll set if another consumer beat it to the item.
+
+int CoScheduler::Poller::run()
+{
+	pollfd* pfd = 0;
+	size_t pfdCap = 0;
+
+	for (;;) {
+		size_t n;
+		int timeout = -1;
+
+		{
+			MyGuard g(sched_.cond_);
+			if (sched_.quit_)
+				break;
+
+			n = sched_.nFdWait_;
+			if (n+1 > pfdCap) {
+				delete[] pfd;
+				pfdCap = 2*(n+1);
+				pfd = new pollfd[pfdCap];
+			}
+
+			pfd[0].fd = sched_.pipe_[0];
+			pfd[0].events = POLLIN;
+
+			for (size_t i=0; i<n; ++i) {
+				const CoAwait& aw = sched_.fdWait_[i]->wait_;
+				pfd[i+1].fd = aw.fd;
+				pfd[i+1].events = aw.events;
+			}
+
+			if (sched_.nHeap_ > 0) {
+				Duration d = sched_.heap_[0]->due_ - MonotonicTime::now();
+				int64_t us = d.to_usec();
+				timeout = (us <= 0) ? 0 : int((us + 999) / 1000);
+			}
+
+			if (sched_.nRetryWait_ > 0) {
+				int ms = int(sched_.retryInterval_.to_msec());
+				if (ms < 1)
+					ms = 1;
+				if (timeout < 0 || ms < timeout)
+					timeout = ms;
+			}
+		}
+
+		for (size_t i=0; i<=n; ++i)
+			pfd[i].revents = 0;
+
+		if (::poll(pfd, n+1, timeout) < 0 && errno != EINTR) {
+			DPRINTF("CoScheduler: poll error %d\n", errno);
+		}
+
+		if (pfd[0].revents) {
+			char buf[64];
+			while (::read(sched_.pipe_[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
+		MyGuard g(sched_.cond_);
+		sched_.wakePending_ = false;
+
+		size_t j = 0;
+		for (size_t i=0; i<sched_.nFdWait_; ++i) {
+			Coroutine* co = sched_.fdWait_[i];
+			const CoAwait& aw = co->wait_;
+			if (i < n && pfd[i+1].revents && (aw.kind != CoAwait::FD_RETRY
+						|| (*aw.func)(aw.obj, aw.arg)))
+				sched_.make_ready(co);
+			else
+				sched_.fdWait_[j++] = co;
+		}
+		sched_.nFdWait_ = j;
+
+		if (sched_.nHeap_ > 0) {
+			MonotonicTime now = MonotonicTime::now();
+			while (sched_.nHeap_ > 0 && sched_.heap_[0]->due_ <= now)
+				sched_.make_ready(sched_.heap_pop());
+		}
+
+		j = 0;
+		for (size_t i=0; i<sched_.nRetryWait_; ++i) {
+			Coroutine* co = sched_.retryWait_[i];
+			const CoAwait& aw = co->wait_;
+			if ((*aw.func)(aw.obj, aw.arg))
+				sched_.make_ready(co);
+			else
+				sched_.retryWait_[j++] = co;
+		}
+		sched_.nRetryWait_ = j;
+	}
+
+	delete[] pfd;
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								CoScheduler
+/////////////////////////////////////////////////////////////////////////////
+
+CoScheduler::CoScheduler(int nThread, int prio, const Duration& retryInterval)
+				: head_(0), tail_(0),
+					fdWait_(0), nFdWait_(0), fdCap_(0),
+					retryWait_(0), nRetryWait_(0), retryCap_(0),
+					heap_(0), nHeap_(0), heapCap_(0),
+					retryInterval_(retryInterval), nLive_(0), nExtWait_(0),
+					wakePending_(false), quit_(false)
+{
+	if (::pipe(pipe_) < 0) {
+		DPRINTF("CoScheduler: Error creating pipe: %d\n", errno);
+		pipe_[0] = pipe_[1] = -1;
+	}
+	else {
+		for (int i=0; i<2; ++i) {
+			::fcntl(pipe_[i], F_SETFD, FD_CLOEXEC);
+			::fcntl(pipe_[i], F_SETFL, ::fcntl(pipe_[i], F_GETFL) | O_NONBLOCK);
+		}
+	}
+
+	nWorker_ = (nThread > 0) ? nThread : 1;
+	workers_ = new Worker*[nWorker_];
+
+	for (int i=0; i<nWorker_; ++i) {
+		char name[CTRLR_FX_THREAD_NAME_LEN];
+		::snprintf(name, sizeof(name), "co%d", i);
+		workers_[i] = new Worker(*this, prio, name);
+		workers_[i]->activate();
+	}
+
+	poller_ = new Poller(*this, prio);
+	poller_->activate();
+}
+
+// --------------------------------------------------------------------------
+
+CoScheduler::~CoScheduler()
+{
+	{
+		MyGuard g(cond_);
+		quit_ = true;
+		cond_.broadcast();
+	}
+	wake_poller();
+
+	for (int i=0; i<nWorker_; ++i) {
+		workers_[i]->wait();
+		delete workers_[i];
+	}
+	delete[] workers_;
+
+	poller_->wait();
+	delete poller_;
+
+	delete[] fdWait_;
+	delete[] retryWait_;
+	delete[] heap_;
+
+	::close(pipe_[0]);
+	::close(pipe_[1]);
+}
+
+// --------------------------------------------------------------------------
+// Outside threads waiting for a coroutine share the condition with the
+// workers, so when there are any, a signal might wake the wrong thread.
+
+void CoScheduler::make_ready(Coroutine* co)
+{
+	co->state_ = Coroutine::READY;
+	co->next_ = 0;
+
+	if (tail_)
+		tail_->next_ = co;
+	else
+		head_ = co;
+	tail_ = co;
+
+	if (nExtWait_)
+		cond_.broadcast();
+	else
+		cond_.signal();
+}
+
+// --------------------------------------------------------------------------
+
+Coroutine* CoScheduler::next()
+{
+	MyGuard g(cond_);
+
+	while (!head_ && !quit_)
+		cond_.wait();
+
+	if (quit_)
+		return 0;
+
+	Coroutine* co = head_;
+	if ((head_ = co->next_) == 0)
+		tail_ = 0;
+	return co;
+}
+
+// --------------------------------------------------------------------------
+
+void CoScheduler::park(Coroutine* co)
+{
+	co->state_ = Coroutine::WAITING;
+
+	switch (co->wait_.kind) {
+		case CoAwait::YIELD:
+			make_ready(co);
+			break;
+
+		case CoAwait::SLEEP:
+			heap_push(co);
+			if (heap_[0] == co)
+				wake_poller();
+			break;
+
+		case CoAwait::FD:
+		case CoAwait::FD_RETRY:
+			grow(fdWait_, nFdWait_, fdCap_);
+			fdWait_[nFdWait_++] = co;
+			wake_poller();
+			break;
+
+		case CoAwait::RETRY:
+			grow(retryWait_, nRetryWait_, retryCap_);
+			retryWait_[nRetryWait_++] = co;
+			if (nRetryWait_ == 1)
+				wake_poller();
+			break;
+
+		case CoAwait::JOIN:
+			{
+				Coroutine* child = co->wait_.co;
+				if (child->state_ == Coroutine::DONE)
+					make_ready(co);
+				else {
+					assert(child->joiner_ == 0);
+					child->joiner_ = co;
+				}
+			}
+			break;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void CoScheduler::finish(Coroutine* co)
+{
+	Coroutine* joiner = co->joiner_;
+
+	co->joiner_ = 0;
+	co->state_ = Coroutine::DONE;
+
+	if (joiner)
+		make_ready(joiner);
+
+	--nLive_;
+	cond_.broadcast();
+}
+
+// --------------------------------------------------------------------------
+// Only one byte needs to be in the pipe to wake the poller, so a wake
+// that's already pending isn't repeated. Called with the lock held, except
+// from the destructor.
+
+void CoScheduler::wake_poller()
+{
+	if (!wakePending_ || quit_) {
+		wakePending_ = true;
+		char c = 0;
+		while (::write(pipe_[1], &c, 1) < 0 && errno == EINTR)
+			;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void CoScheduler::heap_push(Coroutine* co)
+{
+	grow(heap_, nHeap_, heapCap_);
+
+	size_t i = nHeap_++;
+	while (i > 0) {
+		size_t parent = (i-1) / 2;
+		if (!(co->due_ < heap_[parent]->due_))
+			break;
+		heap_[i] = heap_[parent];
+		i = parent;
+	}
+	heap_[i] = co;
+}
+
+// --------------------------------------------------------------------------
+
+Coroutine* CoScheduler::heap_pop()
+{
+	Coroutine* top = heap_[0];
+	Coroutine* last = heap_[--nHeap_];
+
+	size_t i = 0, n = nHeap_;
+	for (;;) {
+		size_t child = 2*i + 1;
+		if (child >= n)
+			break;
+		if (child+1 < n && heap_[child+1]->due_ < heap_[child]->due_)
+			++child;
+		if (!(heap_[child]->due_ < last->due_))
+			break;
+		heap_[i] = heap_[child];
+		i = child;
+	}
+	if (n > 0)
+		heap_[i] = last;
+	return top;
+}
+
+// --------------------------------------------------------------------------
+
+int CoScheduler::spawn(Coroutine& co)
+{
+	MyGuard g(cond_);
+
+	if (co.state_ == Coroutine::READY || co.state_ == Coroutine::WAITING)
+		return -1;
+
+	co.sched_ = this;
+	co.line_ = 0;
+	co.joiner_ = 0;
+	++nLive_;
+	make_ready(&co);
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+size_t CoScheduler::num_live() const
+{
+	MyGuard g(const_cast<ConditionVar&>(cond_));
+	return nLive_;
+}
+
+// --------------------------------------------------------------------------
+
+void CoScheduler::wait_all()
+{
+	MyGuard g(cond_);
+
+	++nExtWait_;
+	while (nLive_ > 0 && !quit_)
+		cond_.wait();
+	--nExtWait_;
+}
+
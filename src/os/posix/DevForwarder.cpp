@@ -0,0 +1,270 @@
+// DevForwarder.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/DevForwarder.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+
+using namespace CtrlrFx;
+
+// --------------------------------------------------------------------------
+
+static void set_non_blocking(int fd)
+{
+	int flags = ::fcntl(fd, F_GETFL, 0);
+	if (flags >= 0 && !(flags & O_NONBLOCK))
+		::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+DevForwarder::DevForwarder(InDevice& idev, OutDevice& odev, StreamSocket& sock,
+						   size_t bufSize /*=DFLT_BUF_SIZE*/)
+					: bufSize_(bufSize), sockEnds_(false), err_(0)
+{
+	init(chan_[DEV_TO_SOCK], idev.handle(), sock.handle());
+	init(chan_[SOCK_TO_DEV], sock.handle(), odev.handle());
+}
+
+DevForwarder::DevForwarder(int idev, int odev, int sock,
+						   size_t bufSize /*=DFLT_BUF_SIZE*/)
+					: bufSize_(bufSize), sockEnds_(false), err_(0)
+{
+	init(chan_[DEV_TO_SOCK], idev, sock);
+	init(chan_[SOCK_TO_DEV], sock, odev);
+}
+
+DevForwarder::~DevForwarder()
+{
+	for (int i=0; i<2; ++i) {
+		if (chan_[i].pipe[0] >= 0) {
+			::close(chan_[i].pipe[0]);
+			::close(chan_[i].pipe[1]);
+		}
+		delete[] chan_[i].buf;
+	}
+}
+
+// --------------------------------------------------------------------------
+// If a splice pipe can't be had, the direction just starts out copying.
+
+void DevForwarder::init(Channel& ch, int src, int dst)
+{
+	ch.src = src;
+	ch.dst = dst;
+	ch.pipe[0] = ch.pipe[1] = -1;
+	ch.buf = 0;
+	ch.pos = ch.npend = 0;
+	ch.nbytes = 0;
+	ch.eof = ch.done = false;
+
+	set_non_blocking(src);
+	set_non_blocking(dst);
+
+	#if defined(__linux__)
+		if (::pipe2(ch.pipe, O_NONBLOCK | O_CLOEXEC) == 0) {
+			#if defined(F_SETPIPE_SZ)
+				::fcntl(ch.pipe[1], F_SETPIPE_SZ, int(bufSize_));
+			#endif
+			return;
+		}
+		ch.pipe[0] = ch.pipe[1] = -1;
+	#endif
+
+	ch.buf = new byte[bufSize_];
+}
+
+// --------------------------------------------------------------------------
+// Anything already spliced into the pipe is moved into the buffer, so that
+// no data is lost when the destination turns out not to support splice.
+
+int DevForwarder::to_copy(Channel& ch)
+{
+	ch.buf = new byte[(ch.npend > bufSize_) ? ch.npend : bufSize_];
+	ch.pos = 0;
+
+	size_t n = 0;
+	while (n < ch.npend) {
+		ssize_t ret = ::read(ch.pipe[0], ch.buf+n, ch.npend-n);
+		if (ret <= 0) {
+			err_ = (ret < 0) ? errno : EIO;
+			return -1;
+		}
+		n += size_t(ret);
+	}
+
+	::close(ch.pipe[0]);
+	::close(ch.pipe[1]);
+	ch.pipe[0] = ch.pipe[1] = -1;
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// Returns the number of bytes read, 0 at the end of the source, or -1 on
+// an error. Having nothing to read right now isn't an error.
+
+int DevForwarder::fill(Channel& ch)
+{
+	ssize_t n;
+
+	#if defined(__linux__)
+		if (ch.pipe[0] >= 0) {
+			n = ::splice(ch.src, 0, ch.pipe[1], 0, bufSize_,
+						 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (n >= 0 || errno != EINVAL) {
+				if (n > 0)
+					ch.npend = size_t(n);
+				else if (n == 0)
+					ch.eof = true;
+				else if (errno == EAGAIN || errno == EINTR)
+					return 1;
+				else
+					err_ = errno;
+				return int(n);
+			}
+			if (to_copy(ch) < 0)
+				return -1;
+		}
+	#endif
+
+	n = ::read(ch.src, ch.buf, bufSize_);
+
+	if (n > 0) {
+		ch.pos = 0;
+		ch.npend = size_t(n);
+	}
+	else if (n == 0)
+		ch.eof = true;
+	else if (errno == EAGAIN || errno == EINTR)
+		return 1;
+	else
+		err_ = errno;
+
+	return int(n);
+}
+
+// --------------------------------------------------------------------------
+// Returns 0 on success, even if the destination only took part of the data,
+// or -1 on an error.
+
+int DevForwarder::drain(Channel& ch)
+{
+	while (ch.npend > 0) {
+		ssize_t n;
+
+		#if defined(__linux__)
+			if (ch.pipe[0] >= 0) {
+				n = ::splice(ch.pipe[0], 0, ch.dst, 0, ch.npend,
+							 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+				if (n < 0 && errno == EINVAL) {
+					if (to_copy(ch) < 0)
+						return -1;
+					continue;
+				}
+			}
+			else
+				n = ::write(ch.dst, ch.buf+ch.pos, ch.npend);
+		#else
+			n = ::write(ch.dst, ch.buf+ch.pos, ch.npend);
+		#endif
+
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return 0;
+			err_ = errno;
+			return -1;
+		}
+
+		ch.pos += size_t(n);
+		ch.npend -= size_t(n);
+		ch.nbytes += uint64_t(n);
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// Each direction waits either to read its source (when it has nothing
+// pending) or to write its destination (when it does), never both. That's
+// the backpressure: a full direction stops reading until it drains.
+// A finished direction passes its end-of-stream on and drops out of the
+// poll (a negative descriptor is ignored), while the other one carries on.
+// Shutting down a device that isn't a socket just fails with ENOTSOCK.
+// While the device-to-socket direction is waiting on the device, the socket
+// is polled with no events as well. poll() always reports a hang-up or an
+// error, so a reset connection is noticed without having to wait for the
+// device to send something.
+
+int DevForwarder::run()
+{
+	if (!quit_.is_valid()) {
+		err_ = quit_.error();
+		return -1;
+	}
+
+	while (true) {
+		pollfd pfd[4];
+
+		for (int i=0; i<2; ++i) {
+			Channel& ch = chan_[i];
+
+			if (ch.eof && ch.npend == 0 && !ch.done) {
+				::shutdown(ch.dst, SHUT_WR);
+				ch.done = true;
+			}
+
+			if (ch.done) {
+				pfd[i].fd = -1;
+				pfd[i].events = pfd[i].revents = 0;
+				continue;
+			}
+
+			pfd[i].fd = (ch.npend > 0) ? ch.dst : ch.src;
+			pfd[i].events = (ch.npend > 0) ? POLLOUT : POLLIN;
+			pfd[i].revents = 0;
+		}
+
+		if (chan_[SOCK_TO_DEV].done
+				&& (sockEnds_ || chan_[DEV_TO_SOCK].done))
+			return 0;
+
+		pfd[2].fd = quit_.handle();
+		pfd[2].events = POLLIN;
+		pfd[2].revents = 0;
+
+		const Channel& out = chan_[DEV_TO_SOCK];
+		pfd[3].fd = (!out.done && out.npend == 0) ? out.dst : -1;
+		pfd[3].events = pfd[3].revents = 0;
+
+		if (::poll(pfd, 4, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err_ = errno;
+			return -1;
+		}
+
+		if (pfd[2].revents) {
+			quit_.clear();
+			return 0;
+		}
+
+		if (pfd[3].revents & (POLLHUP | POLLERR))
+			return 0;
+
+		for (int i=0; i<2; ++i) {
+			if (!pfd[i].revents)
+				continue;
+
+			Channel& ch = chan_[i];
+
+			if (ch.npend == 0 && fill(ch) < 0)
+				return -1;
+
+			if (drain(ch) < 0)
+				return -1;
+		}
+	}
+}
+
@@ -0,0 +1,460 @@
+// IoUring.cpp
+//
+// This talks to the kernel directly through the io_uring system calls and
+// the shared ring memory, so it doesn't need liburing.
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/IoUring.h"
+
+#if defined(__linux__)
+
+#include "CtrlrFx/AtomicOps.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+
+IoUring::IoUring(unsigned entries /*=DFLT_ENTRIES*/)
+			: fd_(-1), evtFd_(-1), err_(0),
+				sqMem_(MAP_FAILED), sqMemSz_(0), cqMem_(MAP_FAILED), cqMemSz_(0),
+				sqes_(0), sqesSz_(0), sqLocal_(0), nPending_(0),
+				fileIdx_(0), nFileIdx_(0), regBufs_(0), nRegBufs_(0)
+{
+	io_uring_params p;
+	::memset(&p, 0, sizeof(p));
+
+	if ((fd_ = int(::syscall(__NR_io_uring_setup, entries, &p))) < 0) {
+		err_ = errno;
+		return;
+	}
+
+	// ----- Map the rings -----
+
+	sqMemSz_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqMemSz_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cqMemSz_ > sqMemSz_)
+			sqMemSz_ = cqMemSz_;
+		cqMemSz_ = 0;
+	}
+
+	sqMem_ = ::mmap(0, sqMemSz_, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+
+	if (sqMem_ == MAP_FAILED) {
+		err_ = errno;
+		close();
+		return;
+	}
+
+	if (cqMemSz_ == 0)
+		cqMem_ = sqMem_;
+	else {
+		cqMem_ = ::mmap(0, cqMemSz_, PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+		if (cqMem_ == MAP_FAILED) {
+			err_ = errno;
+			close();
+			return;
+		}
+	}
+
+	sqesSz_ = p.sq_entries * sizeof(io_uring_sqe);
+	void* sqes = ::mmap(0, sqesSz_, PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+
+	if (sqes == MAP_FAILED) {
+		err_ = errno;
+		close();
+		return;
+	}
+	sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+	byte* sq = static_cast<byte*>(sqMem_);
+	sqHead_  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+	sqTail_  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+	sqMask_  = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+	sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+	sqLocal_ = *sqTail_;
+
+	byte* cq = static_cast<byte*>(cqMem_);
+	cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+	cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+	cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+	cqes_   = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+	// ----- The completion signal -----
+
+	if ((evtFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ||
+			::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_EVENTFD,
+					  &evtFd_, 1) < 0) {
+		err_ = errno;
+		close();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+IoUring::~IoUring()
+{
+	close();
+	delete[] fileIdx_;
+	delete[] regBufs_;
+}
+
+// --------------------------------------------------------------------------
+
+void IoUring::close()
+{
+	if (sqes_)
+		::munmap(sqes_, sqesSz_);
+	if (cqMem_ != MAP_FAILED && cqMem_ != sqMem_)
+		::munmap(cqMem_, cqMemSz_);
+	if (sqMem_ != MAP_FAILED)
+		::munmap(sqMem_, sqMemSz_);
+
+	sqes_ = 0;
+	sqMem_ = cqMem_ = MAP_FAILED;
+
+	if (evtFd_ >= 0)
+		::close(evtFd_);
+	if (fd_ >= 0)
+		::close(fd_);
+
+	evtFd_ = fd_ = -1;
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+	int ret;
+	while ((ret = int(::syscall(__NR_io_uring_enter, fd_, toSubmit,
+								minComplete, flags, 0, 0))) < 0 && errno == EINTR)
+		;
+	if (ret < 0)
+		err_ = errno;
+	return ret;
+}
+
+// --------------------------------------------------------------------------
+// The kernel reads the tail with acquire semantics, so the release store
+// makes the entries visible before the tail moves.
+
+unsigned IoUring::flush_sq()
+{
+	unsigned tail = *sqTail_,
+			 n = sqLocal_ - tail;
+
+	if (n)
+		atomic_store_release(sqTail_, sqLocal_);
+	return n;
+}
+
+// --------------------------------------------------------------------------
+
+io_uring_sqe* IoUring::get_sqe()
+{
+	unsigned head = atomic_load_acquire(sqHead_);
+
+	if (sqLocal_ - head > sqMask_) {
+		// Full. Hand what we have to the kernel, which consumes the
+		// entries during the call.
+		if (submit() < 0)
+			return 0;
+		head = atomic_load_acquire(sqHead_);
+		if (sqLocal_ - head > sqMask_)
+			return 0;
+	}
+
+	unsigned idx = sqLocal_ & sqMask_;
+	sqArray_[idx] = idx;
+	++sqLocal_;
+
+	io_uring_sqe* sqe = &sqes_[idx];
+	::memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+// --------------------------------------------------------------------------
+// The region is [position, limit) of the buffer, as with the synchronous
+// ByteBuffer read and write calls.
+
+int IoUring::queue(IoOp& op, IoOp::Type type, int fd, ByteBuffer& buf,
+				   IIoCompletion* client)
+{
+	assert(op.done_);
+
+	io_uring_sqe* sqe = get_sqe();
+	if (!sqe) {
+		if (!err_) err_ = EBUSY;
+		return -1;
+	}
+
+	op.type_ = type;
+	op.fd_ = fd;
+	op.buf_ = &buf;
+	op.client_ = client;
+	op.res_ = 0;
+	op.done_ = false;
+
+	int bufIdx = -1;
+
+	switch (type) {
+		case IoOp::READ:
+			bufIdx = buf_index(buf);
+			sqe->opcode = (bufIdx < 0) ? IORING_OP_READ : IORING_OP_READ_FIXED;
+			break;
+
+		case IoOp::WRITE:
+			bufIdx = buf_index(buf);
+			sqe->opcode = (bufIdx < 0) ? IORING_OP_WRITE : IORING_OP_WRITE_FIXED;
+			break;
+
+		case IoOp::RECV:
+			sqe->opcode = IORING_OP_RECV;
+			break;
+
+		case IoOp::SEND:
+			sqe->opcode = IORING_OP_SEND;
+			sqe->msg_flags = MSG_NOSIGNAL;
+			break;
+
+		default:
+			assert(false);
+	}
+
+	if (fd >= 0 && fd < nFileIdx_ && fileIdx_[fd] >= 0) {
+		sqe->fd = fileIdx_[fd];
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+	else
+		sqe->fd = fd;
+
+	// Reads and writes at offset -1 use (and update) the file position,
+	// which is what a stream device expects. For a socket, the field means
+	// something else and must be zero.
+	if (type == IoOp::READ || type == IoOp::WRITE)
+		sqe->off = uint64_t(-1);
+
+	sqe->addr = uint64_t(uintptr_t(buf.position_ptr()));
+	sqe->len = unsigned(buf.available());
+	sqe->user_data = uint64_t(uintptr_t(&op));
+
+	if (bufIdx >= 0)
+		sqe->buf_index = uint16_t(bufIdx);
+
+	++nPending_;
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::submit()
+{
+	unsigned n = flush_sq();
+	if (n == 0)
+		return 0;
+	return enter(n, 0, 0);
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::complete()
+{
+	unsigned head = *cqHead_;
+	int n = 0;
+
+	for (;;) {
+		unsigned tail = atomic_load_acquire(cqTail_);
+		if (head == tail)
+			break;
+
+		do {
+			const io_uring_cqe& cqe = cqes_[head & cqMask_];
+			IoOp* op = reinterpret_cast<IoOp*>(uintptr_t(cqe.user_data));
+			int res = cqe.res;
+			++head;
+
+			// Release the slot before the callback, which may submit more.
+			atomic_store_release(cqHead_, head);
+
+			--nPending_;
+			++n;
+
+			if (op) {
+				op->res_ = res;
+				if (res > 0)
+					op->buf_->incr_position(res);
+				op->done_ = true;
+				if (op->client_)
+					op->client_->on_complete(*op);
+			}
+		}
+		while (head != tail);
+	}
+	return n;
+}
+
+// --------------------------------------------------------------------------
+
+// The eventfd is cleared first, so a completion that arrives while we're
+// reaping still leaves it readable.
+
+int IoUring::dispatch()
+{
+	uint64_t v;
+	(void) ::read(evtFd_, &v, sizeof(v));
+	return complete();
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::wait_complete(unsigned minComplete /*=1*/)
+{
+	int n = complete();
+	if (n >= int(minComplete))
+		return n;
+
+	// Don't wait for more than are in flight.
+	unsigned toSubmit = flush_sq(),
+			 want = minComplete - unsigned(n);
+
+	if (want > nPending_)
+		want = nPending_;
+
+	if (toSubmit || want) {
+		if (enter(toSubmit, want, want ? IORING_ENTER_GETEVENTS : 0) < 0)
+			return -1;
+	}
+	return n + complete();
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::wait(IoOp& op)
+{
+	while (!op.done_) {
+		if (wait_complete(1) < 0)
+			return -err_;
+	}
+	return op.res_;
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::register_files(const int fds[], unsigned n)
+{
+	if (nFileIdx_ > 0)
+		unregister_files();
+
+	if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_FILES,
+				  fds, n) < 0) {
+		err_ = errno;
+		return -1;
+	}
+
+	int maxFd = -1;
+	for (unsigned i=0; i<n; ++i) {
+		if (fds[i] > maxFd)
+			maxFd = fds[i];
+	}
+
+	nFileIdx_ = maxFd + 1;
+	fileIdx_ = new int[nFileIdx_];
+
+	for (int i=0; i<nFileIdx_; ++i)
+		fileIdx_[i] = -1;
+
+	for (unsigned i=0; i<n; ++i) {
+		if (fds[i] >= 0)
+			fileIdx_[fds[i]] = int(i);
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::unregister_files()
+{
+	delete[] fileIdx_;
+	fileIdx_ = 0;
+	nFileIdx_ = 0;
+
+	if (::syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_FILES,
+				  0, 0) < 0) {
+		err_ = errno;
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::register_buffers(ByteBuffer* const bufs[], unsigned n)
+{
+	if (nRegBufs_ > 0)
+		unregister_buffers();
+
+	iovec* iov = new iovec[n];
+	for (unsigned i=0; i<n; ++i) {
+		iov[i].iov_base = bufs[i]->c_array();
+		iov[i].iov_len = bufs[i]->byte_capacity();
+	}
+
+	long ret = ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+						 iov, n);
+	delete[] iov;
+
+	if (ret < 0) {
+		err_ = errno;
+		return -1;
+	}
+
+	regBufs_ = new ByteBuffer*[n];
+	for (unsigned i=0; i<n; ++i)
+		regBufs_[i] = bufs[i];
+	nRegBufs_ = n;
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int IoUring::unregister_buffers()
+{
+	delete[] regBufs_;
+	regBufs_ = 0;
+	nRegBufs_ = 0;
+
+	if (::syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_BUFFERS,
+				  0, 0) < 0) {
+		err_ = errno;
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// Buffer pools are typically small, so a linear search is fine.
+
+int IoUring::buf_index(const ByteBuffer& buf) const
+{
+	for (unsigned i=0; i<nRegBufs_; ++i) {
+		if (regBufs_[i] == &buf)
+			return int(i);
+	}
+	return -1;
+}
+
+#endif		// __linux__
+
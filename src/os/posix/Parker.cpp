@@ -0,0 +1,68 @@
+// Parker.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/Parker.h"
+#include <errno.h>
+
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+using namespace CtrlrFx;
+
+#if defined(__linux__)
+
+// The futex only sleeps if the state is still 1, so a wake that comes
+// between prepare() and park() just makes the wait return right away.
+
+static inline int futex(volatile int* addr, int op, int val, const timespec* ts)
+{
+	return int(::syscall(SYS_futex, addr, op, val, ts, 0, 0));
+}
+
+void Parker::wake()
+{
+	futex(&state_, FUTEX_WAKE_PRIVATE, 1, 0);
+}
+
+void Parker::park()
+{
+	futex(&state_, FUTEX_WAIT_PRIVATE, 1, 0);
+	atomic_store_relaxed(&state_, 0);
+}
+
+bool Parker::park(const Duration& d)
+{
+	int ret = futex(&state_, FUTEX_WAIT_PRIVATE, 1, &d);
+	bool timedOut = (ret < 0 && errno == ETIMEDOUT);
+	atomic_store_relaxed(&state_, 0);
+	return !timedOut;
+}
+
+#else
+
+// With a semaphore, a wake for a park that was cancelled leaves a count
+// behind, which just makes the next park return early.
+
+void Parker::wake()
+{
+	sem_.post();
+}
+
+void Parker::park()
+{
+	sem_.wait();
+	atomic_store_relaxed(&state_, 0);
+}
+
+bool Parker::park(const Duration& d)
+{
+	bool ok = sem_.wait(d);
+	atomic_store_relaxed(&state_, 0);
+	return ok;
+}
+
+#endif
+
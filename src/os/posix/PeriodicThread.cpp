@@ -0,0 +1,194 @@
+// PeriodicThread.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/PeriodicThread.h"
+#include "CtrlrFx/debug.h"
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__)
+	#include <unistd.h>
+	#include <sys/syscall.h>
+#endif
+
+using namespace CtrlrFx;
+
+// The SCHED_DEADLINE policy is set with the sched_setattr() system call,
+// which isn't wrapped by older C libraries, so we declare what we need.
+
+#if defined(__linux__) && defined(SYS_sched_setattr)
+	#define CFX_HAVE_SCHED_DEADLINE
+
+	namespace {
+		const int CFX_SCHED_DEADLINE = 6;
+
+		struct cfx_sched_attr {
+			uint32_t size;
+			uint32_t sched_policy;
+			uint64_t sched_flags;
+			int32_t  sched_nice;
+			uint32_t sched_priority;
+			uint64_t sched_runtime;
+			uint64_t sched_deadline;
+			uint64_t sched_period;
+		};
+	}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+//								CycleStats
+/////////////////////////////////////////////////////////////////////////////
+
+void CycleStats::clear()
+{
+	count = 0;
+	min = max = total = 0;
+	::memset(hist, 0, sizeof(hist));
+}
+
+// --------------------------------------------------------------------------
+// The bin is the position of the highest bit set in the value.
+
+int CycleStats::bin(nsec_t ns)
+{
+	int n = 0;
+	while (ns > 1 && n < N_BINS-1) {
+		ns >>= 1;
+		++n;
+	}
+	return n;
+}
+
+// --------------------------------------------------------------------------
+
+void CycleStats::add(nsec_t ns)
+{
+	if (count == 0 || ns < min)
+		min = ns;
+	if (count == 0 || ns > max)
+		max = ns;
+
+	++count;
+	total += ns;
+	++hist[bin(ns)];
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								PeriodicThread
+/////////////////////////////////////////////////////////////////////////////
+
+PeriodicThread::PeriodicThread(const Duration& period, int prio,
+							   unsigned stackSize, const char *name)
+				: Thread(prio, stackSize, name), period_(period), policy_(SKIP)
+{
+	assert(period_.ticks() > 0);
+}
+
+// --------------------------------------------------------------------------
+// Switches the calling thread to SCHED_DEADLINE. The kernel wants all of
+// the parameters in nanoseconds.
+
+bool PeriodicThread::set_deadline_sched()
+{
+	#if defined(CFX_HAVE_SCHED_DEADLINE)
+		cfx_sched_attr attr;
+		::memset(&attr, 0, sizeof(attr));
+
+		attr.size = sizeof(attr);
+		attr.sched_policy = CFX_SCHED_DEADLINE;
+		attr.sched_runtime = uint64_t(dlRuntime_.ticks());
+		attr.sched_period = uint64_t(period_.ticks());
+		attr.sched_deadline = (dlDeadline_.ticks() > 0)
+								? uint64_t(dlDeadline_.ticks()) : attr.sched_period;
+
+		return ::syscall(SYS_sched_setattr, 0, &attr, 0) == 0;
+	#else
+		return false;
+	#endif
+}
+
+// --------------------------------------------------------------------------
+// The periodic loop. Each release time is an absolute time on the
+// monotonic clock, computed by adding the period to the previous release,
+// so that the timing doesn't drift. After each cycle we check whether we
+// ran past the next release and, if so, apply the overrun policy.
+// While catching up, the release times we're behind on were already
+// counted when they were missed, so only the ones past 'owed' (the first
+// release not yet counted) are new overruns.
+
+int PeriodicThread::run()
+{
+	if (dlRuntime_.ticks() > 0 && !set_deadline_sched()) {
+		DPRINTF("%s: Unable to set SCHED_DEADLINE [%d]\n", name(), errno);
+	}
+
+	const nsec_t per = period_.ticks();
+	MonotonicTime next = MonotonicTime::now() + period_,
+				  owed = next;
+
+	while (!quit_) {
+		while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+								 &next, NULL) == EINTR)
+			;
+
+		if (quit_)
+			break;
+
+		MonotonicTime	wake = MonotonicTime::now();
+		cycle();
+		MonotonicTime	done = MonotonicTime::now();
+
+		next += period_;
+
+		unsigned nBehind = 0, nMissed = 0;
+		if (done >= next) {
+			nBehind = unsigned((done - next).ticks() / per) + 1;
+
+			MonotonicTime from = (owed >= next) ? owed : next;
+			if (done >= from) {
+				nMissed = unsigned((done - from).ticks() / per) + 1;
+				owed = from + Duration(nsec(per * nsec_t(nMissed)));
+			}
+		}
+
+		{
+			MyGuard g(lock_);
+			++stats_.cycles;
+			stats_.latency.add((wake - (next - period_)).ticks());
+			stats_.exec.add((done - wake).ticks());
+
+			if (nMissed != 0) {
+				++stats_.overruns;
+				stats_.missed += nMissed;
+			}
+		}
+
+		if (nMissed != 0) {
+			bool catchUp = (policy_ == CATCH_UP) ||
+							(policy_ == CALLBACK && on_overrun(nMissed));
+
+			// To skip, move the release onto the first point of the original
+			// time grid that's still in the future.
+			if (!catchUp)
+				next += Duration(nsec(per * nsec_t(nBehind)));
+		}
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+PeriodicThread::Stats PeriodicThread::stats() const
+{
+	MyGuard g(lock_);
+	return stats_;
+}
+
+// --------------------------------------------------------------------------
+
+void PeriodicThread::reset_stats()
+{
+	MyGuard g(lock_);
+	stats_ = Stats();
+}
+
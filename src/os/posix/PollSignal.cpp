@@ -0,0 +1,122 @@
+// PollSignal.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/PollSignal.h"
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#if defined(__linux__)
+	#include <sys/eventfd.h>
+#endif
+
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+
+PollSignal::PollSignal() : err_(0)
+{
+	#if defined(__linux__)
+		fd_[0] = fd_[1] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (fd_[0] < 0)
+			err_ = errno;
+	#else
+		if (::pipe(fd_) < 0) {
+			err_ = errno;
+			fd_[0] = fd_[1] = -1;
+		}
+		else {
+			for (int i=0; i<2; ++i) {
+				::fcntl(fd_[i], F_SETFD, FD_CLOEXEC);
+				::fcntl(fd_[i], F_SETFL, ::fcntl(fd_[i], F_GETFL) | O_NONBLOCK);
+			}
+		}
+	#endif
+}
+
+// --------------------------------------------------------------------------
+
+PollSignal::~PollSignal()
+{
+	if (fd_[0] >= 0)
+		::close(fd_[0]);
+	if (fd_[1] >= 0 && fd_[1] != fd_[0])
+		::close(fd_[1]);
+}
+
+// --------------------------------------------------------------------------
+
+void PollSignal::set()
+{
+	int ret;
+
+	#if defined(__linux__)
+		uint64_t n = 1;
+		while ((ret = ::write(fd_[1], &n, sizeof(n))) < 0 && errno == EINTR)
+			;
+	#else
+		char c = 0;
+		while ((ret = ::write(fd_[1], &c, 1)) < 0 && errno == EINTR)
+			;
+	#endif
+
+	if (ret < 0 && errno != EAGAIN)
+		err_ = errno;
+}
+
+// --------------------------------------------------------------------------
+// Reading an eventfd resets its count to zero. A pipe is drained.
+
+void PollSignal::clear()
+{
+	#if defined(__linux__)
+		uint64_t n;
+		while (::read(fd_[0], &n, sizeof(n)) < 0 && errno == EINTR)
+			;
+	#else
+		char buf[64];
+		while (::read(fd_[0], buf, sizeof(buf)) > 0)
+			;
+	#endif
+}
+
+// --------------------------------------------------------------------------
+
+bool PollSignal::wait()
+{
+	pollfd pfd;
+	pfd.fd = fd_[0];
+	pfd.events = POLLIN;
+
+	int ret;
+	while ((ret = ::poll(&pfd, 1, -1)) < 0 && errno == EINTR)
+		;
+
+	if (ret < 0) {
+		err_ = errno;
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool PollSignal::wait(const Duration& d)
+{
+	pollfd pfd;
+	pfd.fd = fd_[0];
+	pfd.events = POLLIN;
+
+	int64_t us = d.to_usec(),
+			ms = (us <= 0) ? 0 : (us + 999) / 1000;
+
+	int ret = ::poll(&pfd, 1, int(ms));
+	if (ret < 0) {
+		if (errno != EINTR)
+			err_ = errno;
+		return false;
+	}
+	return ret > 0;
+}
+
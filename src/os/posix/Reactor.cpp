@@ -0,0 +1,500 @@
+// Reactor.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/Reactor.h"
+#include "CtrlrFx/AtomicOps.h"
+
+#if defined(__linux__)
+
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+//								EventHandler
+/////////////////////////////////////////////////////////////////////////////
+
+EventHandler::~EventHandler()
+{
+	if (reactor_)
+		reactor_->remove(*this);
+}
+
+// --------------------------------------------------------------------------
+
+void EventHandler::on_error(uint32_t /*events*/)
+{
+	if (reactor_)
+		reactor_->remove(*this);
+}
+
+// --------------------------------------------------------------------------
+
+AcceptHandler::AcceptHandler(TcpAcceptor& acc) : IoHandler<TcpAcceptor>(acc)
+{
+	acc.set_non_blocking();
+}
+
+// --------------------------------------------------------------------------
+// The acceptor may be registered edge-triggered, so take every waiting
+// connection before returning. A connection that died in the backlog, or
+// a network error on it (which Linux reports from accept), only affects
+// that one connection, so the loop carries on past it.
+
+static bool accept_err_transient(int err)
+{
+	switch (err) {
+		case EINTR:
+		case ECONNABORTED:
+		case EPROTO:
+		case ENETDOWN:
+		case ENOPROTOOPT:
+		case EHOSTDOWN:
+		case ENONET:
+		case EHOSTUNREACH:
+		case EOPNOTSUPP:
+		case ENETUNREACH:
+			return true;
+	}
+	return false;
+}
+
+void AcceptHandler::on_readable()
+{
+	for (;;) {
+		TcpSocket sock = io_.accept();
+		if (!sock.is_open()) {
+			if (accept_err_transient(errno))
+				continue;
+			break;
+		}
+		if (!(io_.options() & TcpAcceptor::NON_BLOCK))
+			sock.set_non_blocking();
+		on_accept(sock);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+SignalHandler::SignalHandler(const sigset_t& sigs)
+{
+	::pthread_sigmask(SIG_BLOCK, &sigs, 0);
+	fd_ = ::signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+}
+
+SignalHandler::SignalHandler(int signo)
+{
+	sigset_t sigs;
+	::sigemptyset(&sigs);
+	::sigaddset(&sigs, signo);
+
+	::pthread_sigmask(SIG_BLOCK, &sigs, 0);
+	fd_ = ::signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+}
+
+// --------------------------------------------------------------------------
+
+SignalHandler::~SignalHandler()
+{
+	// Unregister before the descriptor is closed.
+	if (reactor())
+		reactor()->remove(*this);
+
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+// --------------------------------------------------------------------------
+
+void SignalHandler::on_readable()
+{
+	const int N = 8;
+	signalfd_siginfo info[N];
+	ssize_t n;
+
+	while ((n = ::read(fd_, info, sizeof(info))) > 0) {
+		int nsig = int(n / sizeof(signalfd_siginfo));
+		for (int i=0; i<nsig; ++i)
+			on_signal(int(info[i].ssi_signo), info[i]);
+		if (nsig < N)
+			break;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								Reactor
+/////////////////////////////////////////////////////////////////////////////
+
+Reactor::Reactor(int maxEvents /*=256*/)
+			: err_(0), maxEvts_(maxEvents > 0 ? maxEvents : 1),
+				nEvts_(0), quit_(false), handlers_(0)
+{
+	evts_ = new epoll_event[maxEvts_];
+
+	if ((epfd_ = ::epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		err_ = errno;
+		return;
+	}
+
+	// The wakeup signal is registered with a null handler.
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = 0;
+
+	if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, wake_.handle(), &ev) < 0) {
+		err_ = errno;
+		::close(epfd_);
+		epfd_ = -1;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+// The handlers that are still registered would otherwise try to remove
+// themselves from the dead reactor when they're destroyed.
+
+Reactor::~Reactor()
+{
+	Guard<Mutex> g(lock_);
+	while (handlers_) {
+		EventHandler* h = handlers_;
+		handlers_ = h->next_;
+		h->reactor_ = 0;
+		h->prev_ = h->next_ = 0;
+	}
+	g.release();
+
+	if (epfd_ >= 0)
+		::close(epfd_);
+	delete[] evts_;
+}
+
+// --------------------------------------------------------------------------
+
+void Reactor::link(EventHandler& h)
+{
+	Guard<Mutex> g(lock_);
+	h.prev_ = 0;
+	h.next_ = handlers_;
+	if (handlers_)
+		handlers_->prev_ = &h;
+	handlers_ = &h;
+}
+
+void Reactor::unlink(EventHandler& h)
+{
+	Guard<Mutex> g(lock_);
+	if (h.prev_)
+		h.prev_->next_ = h.next_;
+	else
+		handlers_ = h.next_;
+	if (h.next_)
+		h.next_->prev_ = h.prev_;
+	h.prev_ = h.next_ = 0;
+}
+
+// --------------------------------------------------------------------------
+
+int Reactor::add(EventHandler& h, uint32_t events, Mode mode /*=LEVEL*/)
+{
+	assert(h.reactor_ == 0);
+
+	epoll_event ev;
+	ev.events = epoll_flags(events, mode);
+	ev.data.ptr = &h;
+
+	// Set the reactor first, since the handler could be called from the
+	// reactor's thread as soon as it's in the set.
+	h.reactor_ = this;
+	h.fd_ = h.handle();
+	link(h);
+
+	if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, h.fd_, &ev) < 0) {
+		err_ = errno;
+		unlink(h);
+		h.reactor_ = 0;
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int Reactor::modify(EventHandler& h, uint32_t events, Mode mode /*=LEVEL*/)
+{
+	assert(h.reactor_ == this);
+
+	epoll_event ev;
+	ev.events = epoll_flags(events, mode);
+	ev.data.ptr = &h;
+
+	if (::epoll_ctl(epfd_, EPOLL_CTL_MOD, h.fd_, &ev) < 0) {
+		err_ = errno;
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// Any events for the handler that are still waiting to be dispatched in the
+// current batch are cancelled, so that it's safe to delete the handler
+// after removing it. This uses the descriptor saved by add(), since it can
+// be called from the handler's destructor, after handle() is gone.
+
+int Reactor::remove(EventHandler& h)
+{
+	if (h.reactor_ != this)
+		return -1;
+
+	h.reactor_ = 0;
+	unlink(h);
+
+	for (int i=0; i<nEvts_; ++i) {
+		if (evts_[i].data.ptr == &h)
+			evts_[i].events = 0;
+	}
+
+	// The event is ignored, but kernels before 2.6.9 want it non-null.
+	epoll_event ev;
+	ev.events = 0;
+	ev.data.ptr = 0;
+
+	if (::epoll_ctl(epfd_, EPOLL_CTL_DEL, h.fd_, &ev) < 0) {
+		err_ = errno;
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+int Reactor::run_once(int timeoutMs /*=-1*/)
+{
+	int n = ::epoll_wait(epfd_, evts_, maxEvts_, timeoutMs);
+
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		err_ = errno;
+		return -1;
+	}
+
+	nEvts_ = n;
+
+	for (int i=0; i<nEvts_; ++i) {
+		EventHandler* h = static_cast<EventHandler*>(evts_[i].data.ptr);
+		uint32_t events = evts_[i].events;
+
+		if (!h) {
+			wake_.clear();
+			continue;
+		}
+
+		// Readable data is delivered before a hangup, so that a peer that
+		// writes then closes isn't cut short.
+		if (events & EPOLLIN) {
+			h->on_readable();
+			if (evts_[i].events == 0)
+				continue;
+		}
+		if (events & EPOLLOUT) {
+			h->on_writable();
+			if (evts_[i].events == 0)
+				continue;
+		}
+		if (events & (EPOLLERR | EPOLLHUP))
+			h->on_error(events);
+		else if ((events & EPOLLRDHUP) && !(events & EPOLLIN))
+			h->on_error(events);
+	}
+
+	nEvts_ = 0;
+	return n;
+}
+
+// --------------------------------------------------------------------------
+
+int Reactor::run()
+{
+	while (!quit_) {
+		if (run_once(-1) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+
+void Reactor::stop()
+{
+	quit_ = true;
+	wake_.set();
+}
+
+// --------------------------------------------------------------------------
+
+void Reactor::reset()
+{
+	quit_ = false;
+	wake_.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								ReactorPool
+/////////////////////////////////////////////////////////////////////////////
+
+ReactorPool::ReactorPool(int n /*=0*/, bool pin /*=false*/,
+						 int prio /*=Thread::PRIORITY_NORMAL*/)
+					: next_(0), err_(0)
+{
+	if (n <= 0) {
+		long ncpu = ::sysconf(_SC_NPROCESSORS_ONLN);
+		n = (ncpu > 0) ? int(ncpu) : 1;
+	}
+
+	n_ = n;
+	reactors_ = new Reactor*[n_];
+	runners_ = new Runner*[n_];
+
+	for (int i=0; i<n_; ++i) {
+		char name[CTRLR_FX_THREAD_NAME_LEN];
+		::snprintf(name, sizeof(name), "reactor%d", i);
+
+		reactors_[i] = new Reactor;
+		runners_[i] = new Runner(*reactors_[i], prio, name);
+
+		if (!reactors_[i]->is_valid() && err_ == 0)
+			err_ = reactors_[i]->error();
+
+		#if defined(CPU_SETSIZE)
+			if (pin)
+				runners_[i]->affinity(i);
+		#else
+			(void) pin;
+		#endif
+
+		runners_[i]->activate();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+ReactorPool::~ReactorPool()
+{
+	stop();
+
+	for (int i=0; i<n_; ++i) {
+		delete runners_[i];
+		delete reactors_[i];
+	}
+	delete[] runners_;
+	delete[] reactors_;
+}
+
+// --------------------------------------------------------------------------
+
+Reactor& ReactorPool::next()
+{
+	int i = int(unsigned(atomic_fetch_add(&next_, 1)) % unsigned(n_));
+	return *reactors_[i];
+}
+
+// --------------------------------------------------------------------------
+
+void ReactorPool::stop()
+{
+	for (int i=0; i<n_; ++i)
+		runners_[i]->quit();
+
+	for (int i=0; i<n_; ++i)
+		runners_[i]->wait();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								ShardedAcceptor
+/////////////////////////////////////////////////////////////////////////////
+
+ShardedAcceptor::~ShardedAcceptor()
+{
+	close();
+}
+
+// --------------------------------------------------------------------------
+// All the listeners are opened before any is registered, so a failure to
+// open one doesn't leave some reactors accepting. After the first, the
+// listeners bind to its actual address, in case the port was zero.
+// If a registration fails, the ones that succeeded are taken back out.
+
+int ShardedAcceptor::open(const SockAddr& addr, int queSize /*=MAX_QUE_SIZE*/,
+						  int opts /*=0*/)
+{
+	if (is_open())
+		return 0;
+
+	if (!pool_.is_valid()) {
+		errno = pool_.error();
+		return -1;
+	}
+
+	int n = pool_.size();
+	opts |= TcpAcceptor::REUSE_PORT | TcpAcceptor::NON_BLOCK;
+
+	accs_ = new TcpAcceptor*[n];
+	shards_ = new Shard*[n];
+
+	for (int i=0; i<n; ++i) {
+		accs_[i] = new TcpAcceptor;
+		shards_[i] = 0;
+	}
+
+	for (int i=0; i<n; ++i) {
+		SockAddr bindAddr = (i == 0) ? addr : accs_[0]->local_addr();
+		if (accs_[i]->open(bindAddr, queSize, opts) < 0) {
+			release();
+			return -1;
+		}
+	}
+
+	for (int i=0; i<n; ++i) {
+		shards_[i] = new Shard(*accs_[i], *this);
+		if (pool_[i].add(*shards_[i], EventHandler::READ, Reactor::LEVEL) < 0) {
+			release();
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------
+// Deleting a shard removes it from its reactor. The error that got us here,
+// if any, is kept for the caller.
+
+void ShardedAcceptor::release()
+{
+	int err = errno;
+
+	for (int i=0; i<pool_.size(); ++i) {
+		delete shards_[i];
+		delete accs_[i];
+	}
+	delete[] shards_;
+	delete[] accs_;
+	shards_ = 0;
+	accs_ = 0;
+
+	errno = err;
+}
+
+// --------------------------------------------------------------------------
+
+void ShardedAcceptor::close()
+{
+	if (is_open())
+		release();
+}
+
+#endif		// __linux__
+
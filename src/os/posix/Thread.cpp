@@ -11,6 +11,9 @@
 #include <sys/msg.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
+#include <alloca.h>
+#include <sys/mman.h>
 
 #if !defined(_POSIX_THREAD_PRIORITY_SCHEDULING)
 	#error "No POSIX thread priority scheduling"
@@ -22,9 +25,66 @@ using namespace CtrlrFx;
 //								Thread
 /////////////////////////////////////////////////////////////////////////////
 
-Thread::Thread(int prio, unsigned, const char*)
-				: prio_(prio), active_(false), quit_(false)
+Thread::Thread(int prio, unsigned stackSize, const char* name)
+				: prio_(prio), stackSize_(stackSize), active_(false), quit_(false)
 {
+	#if defined(PTHREAD_STACK_MIN)
+		if (stackSize_ != 0 && stackSize_ < size_t(PTHREAD_STACK_MIN))
+			stackSize_ = PTHREAD_STACK_MIN;
+	#endif
+
+	name_[0] = '\0';
+	if (name) {
+		::strncpy(name_, name, CTRLR_FX_THREAD_NAME_LEN-1);
+		name_[CTRLR_FX_THREAD_NAME_LEN-1] = '\0';
+	}
+
+	#if defined(CPU_SETSIZE)
+		CPU_ZERO(&cpus_);
+		hasCpus_ = false;
+	#endif
+}
+
+// --------------------------------------------------------------------------
+// Touches the stack, from the current frame down toward the bottom, so that
+// all the pages are mapped in before the thread does any real work. Where
+// the OS can tell us the actual bounds of the stack we use them, since the
+// thread library may carve its own data out of the requested size.
+// Otherwise we conservatively touch half of the requested size. In either
+// case a margin is left at the bottom for the frames of the calls that we
+// make from here.
+
+void Thread::prefault_stack()
+{
+	char here;
+	size_t n = stackSize_ / 2;
+
+	#if defined(__linux__) && defined(_GNU_SOURCE)
+		pthread_attr_t attr;
+		void* addr;
+		size_t sz;
+
+		if (::pthread_getattr_np(::pthread_self(), &attr) == 0) {
+			if (::pthread_attr_getstack(&attr, &addr, &sz) == 0) {
+				size_t used = size_t(&here - static_cast<char*>(addr));
+				n = (used > 2*PREFAULT_MARGIN) ? used - 2*PREFAULT_MARGIN : 0;
+			}
+			::pthread_attr_destroy(&attr);
+		}
+	#endif
+
+	if (n == 0)
+		return;
+
+	volatile char* p = static_cast<volatile char*>(::alloca(n));
+
+	long pgsz = ::sysconf(_SC_PAGESIZE);
+	if (pgsz <= 0)
+		pgsz = 4096;
+
+	for (size_t i=0; i<n; i+=size_t(pgsz))
+		p[i] = 0;
+	p[n-1] = 0;
 }
 
 // --------------------------------------------------------------------------
@@ -35,6 +95,19 @@ void* Thread::startup(void* p)
 {
 	Thread* thread = static_cast<Thread*>(p);
 
+	#if defined(__linux__) && defined(_GNU_SOURCE)
+		if (thread->name_[0] != '\0') {
+			// Linux limits the name to 16 chars, including the NUL
+			char nm[16];
+			::strncpy(nm, thread->name_, sizeof(nm)-1);
+			nm[sizeof(nm)-1] = '\0';
+			::pthread_setname_np(::pthread_self(), nm);
+		}
+	#endif
+
+	if (thread->stackSize_ != 0)
+		thread->prefault_stack();
+
 	int n = thread->run();
 	thread->evtDone_.signal();
 	thread->close();
@@ -77,6 +150,24 @@ int Thread::curr_priority()
 	return param.sched_priority;
 }
 
+// --------------------------------------------------------------------------
+// Locks the process memory to prevent page faults.
+
+bool Thread::lock_memory()
+{
+	return ::mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+}
+
+// --------------------------------------------------------------------------
+// Sets the CPU affinity of the current thread.
+
+#if defined(CPU_SETSIZE)
+bool Thread::curr_affinity(const cpu_set_t& cpus)
+{
+	return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set_t), &cpus) == 0;
+}
+#endif
+
 // --------------------------------------------------------------------------
 //							Public Interface
 // --------------------------------------------------------------------------
@@ -101,6 +192,16 @@ bool Thread::activate()
 	::pthread_attr_setschedpolicy(&attr, DFLT_POLICY);
 	::pthread_attr_setschedparam(&attr, &param);
 	::pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+
+	// ----- Set the stack size and CPU affinity -----
+
+	if (stackSize_ != 0)
+		::pthread_attr_setstacksize(&attr, stackSize_);
+
+	#if defined(CPU_SETSIZE)
+		if (hasCpus_)
+			::pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus_);
+	#endif
 	
 	// ----- Start the thread -----
 
@@ -108,7 +209,20 @@ bool Thread::activate()
 	::pthread_attr_destroy(&attr);
 	
 	if (!active_) {
-		active_ = ::pthread_create(&thread_, 0, startup, this) == 0;
+		// Fall back to a non-realtime thread, but keep the stack size and 
+		// affinity, if possible.
+		::pthread_attr_init(&attr);
+
+		if (stackSize_ != 0)
+			::pthread_attr_setstacksize(&attr, stackSize_);
+
+		#if defined(CPU_SETSIZE)
+			if (hasCpus_)
+				::pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus_);
+		#endif
+
+		active_ = ::pthread_create(&thread_, &attr, startup, this) == 0;
+		::pthread_attr_destroy(&attr);
 		//TODO: Trace out non-realtime?
 	}
 
@@ -142,6 +256,49 @@ int Thread::priority() const
 	return prio_ = param.sched_priority;
 }
 
+// --------------------------------------------------------------------------
+// Sets the CPU affinity of the thread. If the thread isn't running yet, the
+// set is saved and applied when it's activated.
+
+#if defined(CPU_SETSIZE)
+bool Thread::affinity(const cpu_set_t& cpus)
+{
+	cpus_ = cpus;
+	hasCpus_ = true;
+
+	if (!active_)
+		return true;
+
+	return ::pthread_setaffinity_np(thread_, sizeof(cpu_set_t), &cpus_) == 0;
+}
+
+// --------------------------------------------------------------------------
+
+bool Thread::affinity(int cpu)
+{
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return false;
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	return affinity(cpus);
+}
+
+// --------------------------------------------------------------------------
+
+bool Thread::affinity(cpu_set_t* cpus) const
+{
+	if (!active_) {
+		if (!hasCpus_)
+			return false;
+		*cpus = cpus_;
+		return true;
+	}
+	return ::pthread_getaffinity_np(thread_, sizeof(cpu_set_t), cpus) == 0;
+}
+#endif
+
 // --------------------------------------------------------------------------
 // Waits for the thread to complete
 
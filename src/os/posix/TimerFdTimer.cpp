@@ -0,0 +1,244 @@
+// TimerFdTimer.cpp
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/TimerFdTimer.h"
+
+#if defined(__linux__)
+
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+using namespace CtrlrFx;
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerFdTimer
+/////////////////////////////////////////////////////////////////////////////
+
+TimerFdTimer::TimerFdTimer() : err_(0), client_(0)
+{
+	if ((fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		err_ = errno;
+}
+
+TimerFdTimer::TimerFdTimer(ITimerClient& client) : err_(0), client_(&client)
+{
+	if ((fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		err_ = errno;
+}
+
+// --------------------------------------------------------------------------
+
+TimerFdTimer::~TimerFdTimer()
+{
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+// --------------------------------------------------------------------------
+// A zero initial delay disarms a timerfd, so an immediate start is
+// requested as the smallest possible delay.
+
+void TimerFdTimer::set(const Duration& initDelay, const Duration& period)
+{
+	itimerspec its;
+
+	its.it_interval = period;
+	its.it_value = initDelay;
+
+	if (initDelay == Duration(0)) {
+		its.it_value.tv_sec = 0;
+		its.it_value.tv_nsec = 1;
+	}
+
+	if (::timerfd_settime(fd_, 0, &its, NULL) < 0)
+		err_ = errno;
+}
+
+// --------------------------------------------------------------------------
+// The timerfd read returns the number of expirations since the last read.
+
+int64_t TimerFdTimer::dispatch(bool block)
+{
+	uint64_t n = 0;
+
+	for (;;) {
+		ssize_t ret = ::read(fd_, &n, sizeof(n));
+
+		if (ret == ssize_t(sizeof(n)))
+			break;
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0 && errno == EAGAIN) {
+			if (!block)
+				return 0;
+
+			pollfd pfd;
+			pfd.fd = fd_;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			if (::poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+				err_ = errno;
+				return -1;
+			}
+			continue;
+		}
+
+		err_ = (ret < 0) ? errno : EIO;
+		return -1;
+	}
+
+	if (client_ && n != 0)
+		client_->on_timer(*this, n);
+
+	return int64_t(n);
+}
+
+// --------------------------------------------------------------------------
+
+Duration TimerFdTimer::remaining() const
+{
+	itimerspec its;
+	if (::timerfd_gettime(fd_, &its) < 0)
+		return Duration(0);
+	return Duration(its.it_value);
+}
+
+// --------------------------------------------------------------------------
+
+int TimerFdTimer::register_client(ITimerClient& client)
+{
+	client_ = &client;
+	return 1;
+}
+
+// --------------------------------------------------------------------------
+
+void TimerFdTimer::start()
+{
+	set(initDelay_, period_);
+}
+
+// --------------------------------------------------------------------------
+
+void TimerFdTimer::start(const Duration& period)
+{
+	initDelay_ = period_ = period;
+	set(initDelay_, period_);
+}
+
+// --------------------------------------------------------------------------
+
+void TimerFdTimer::start(const Duration& initDelay, const Duration& period)
+{
+	initDelay_ = initDelay;
+	period_ = period;
+	set(initDelay_, period_);
+}
+
+// --------------------------------------------------------------------------
+
+void TimerFdTimer::one_shot(const Duration& timeout)
+{
+	initDelay_ = timeout;
+	period_ = Duration(0);
+	set(initDelay_, period_);
+}
+
+// --------------------------------------------------------------------------
+// Disarms the timer, and clears out any expirations that haven't been read
+// yet, so that the client doesn't get an event after the stop.
+
+void TimerFdTimer::stop()
+{
+	itimerspec its;
+	its.it_interval = Duration(0);
+	its.it_value = Duration(0);
+
+	if (::timerfd_settime(fd_, 0, &its, NULL) < 0)
+		err_ = errno;
+
+	uint64_t n;
+	while (::read(fd_, &n, sizeof(n)) < 0 && errno == EINTR)
+		;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//								TimerFdThread
+/////////////////////////////////////////////////////////////////////////////
+
+TimerFdThread::TimerFdThread(int prio, ITimerClient& client)
+				: TimerFdTimer(client), Thread(prio)
+{
+	if (::pipe(pipe_) < 0) {
+		pipe_[0] = pipe_[1] = -1;
+		return;
+	}
+	::fcntl(pipe_[0], F_SETFD, FD_CLOEXEC);
+	::fcntl(pipe_[1], F_SETFD, FD_CLOEXEC);
+	activate();
+}
+
+// --------------------------------------------------------------------------
+
+void TimerFdThread::quit()
+{
+	quit_ = true;
+	if (pipe_[1] >= 0) {
+		char c = 0;
+		while (::write(pipe_[1], &c, 1) < 0 && errno == EINTR)
+			;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void TimerFdThread::destroy()
+{
+	if (pipe_[0] < 0)
+		return;
+
+	quit();
+	wait();
+
+	::close(pipe_[0]);
+	::close(pipe_[1]);
+	pipe_[0] = pipe_[1] = -1;
+}
+
+// --------------------------------------------------------------------------
+// Waits on the timer and the quit pipe, dispatching each expiration.
+
+int TimerFdThread::run()
+{
+	pollfd pfd[2];
+
+	pfd[0].fd = handle();
+	pfd[0].events = POLLIN;
+	pfd[1].fd = pipe_[0];
+	pfd[1].events = POLLIN;
+
+	while (!quit_) {
+		pfd[0].revents = pfd[1].revents = 0;
+
+		if (::poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (quit_)
+			break;
+
+		if (pfd[0].revents & POLLIN)
+			dispatch();
+	}
+	return 0;
+}
+
+#endif		// __linux__
+
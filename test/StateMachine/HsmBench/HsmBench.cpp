@@ -0,0 +1,294 @@
+// HsmBench.cpp
+//
+// CtrlrFx Test Application.
+//
+// This is a dispatch throughput benchmark comparing the flat StateMachine
+// with the HierStateMachine.
+//
+// Both machines implement the same motor controller. It is Idle or Running
+// while it's operational, and goes to Fault on a fault event, from which it
+// is reset back to Idle. A status request is answered in every state. The
+// flat machine has to handle the status and fault events in each of its
+// handlers; the hierarchical machine handles them once, in the Operational
+// parent state.
+//
+// The same event stream, which is mostly status requests with regular
+// start/stop transitions and an occasional fault, is run through each
+// machine, and the time per event is reported.
+
+#include "CtrlrFx/CtrlrFx.h"
+#include "CtrlrFx/os.h"
+#include "CtrlrFx/StateMachine.h"
+#include "CtrlrFx/HierStateMachine.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace CtrlrFx;
+
+enum { SIG_STATUS, SIG_START, SIG_STOP, SIG_FAULT, SIG_RESET, N_SIG };
+
+const int N_EVT = 10000000;
+
+// The statistics kept by both machines, to check that they agree.
+struct MotorStats
+{
+	int nStatus, nStart, nFault, nEnter;
+	MotorStats() : nStatus(0), nStart(0), nFault(0), nEnter(0) {}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//								Flat machine
+/////////////////////////////////////////////////////////////////////////////
+
+class FlatMotor : public StateMachine<FlatMotor>
+{
+	static bool is_pseudo(const Event* evt) {
+		return evt == (const Event*) SIG_ENTER || evt == (const Event*) SIG_EXIT;
+	}
+
+public:
+	MotorStats stats;
+
+	FlatMotor() { initialize(&FlatMotor::idle); }
+
+	ReturnState idle(const Event* evt);
+	ReturnState running(const Event* evt);
+	ReturnState fault(const Event* evt);
+};
+
+FlatMotor::ReturnState FlatMotor::idle(const Event* evt)
+{
+	if (evt == (const Event*) SIG_ENTER) {
+		++stats.nEnter;
+		return 0;
+	}
+	if (is_pseudo(evt))
+		return 0;
+
+	switch (evt->sig) {
+		case SIG_STATUS:
+			++stats.nStatus;
+			break;
+		case SIG_START:
+			++stats.nStart;
+			transition(&FlatMotor::running);
+			break;
+		case SIG_FAULT:
+			++stats.nFault;
+			transition(&FlatMotor::fault);
+			break;
+	}
+	return 0;
+}
+
+FlatMotor::ReturnState FlatMotor::running(const Event* evt)
+{
+	if (evt == (const Event*) SIG_ENTER) {
+		++stats.nEnter;
+		return 0;
+	}
+	if (is_pseudo(evt))
+		return 0;
+
+	switch (evt->sig) {
+		case SIG_STATUS:
+			++stats.nStatus;
+			break;
+		case SIG_STOP:
+			transition(&FlatMotor::idle);
+			break;
+		case SIG_FAULT:
+			++stats.nFault;
+			transition(&FlatMotor::fault);
+			break;
+	}
+	return 0;
+}
+
+FlatMotor::ReturnState FlatMotor::fault(const Event* evt)
+{
+	if (evt == (const Event*) SIG_ENTER) {
+		++stats.nEnter;
+		return 0;
+	}
+	if (is_pseudo(evt))
+		return 0;
+
+	switch (evt->sig) {
+		case SIG_STATUS:
+			++stats.nStatus;
+			break;
+		case SIG_RESET:
+			transition(&FlatMotor::idle);
+			break;
+	}
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//							Hierarchical machine
+/////////////////////////////////////////////////////////////////////////////
+
+enum { ST_OPERATIONAL, ST_IDLE, ST_RUNNING, ST_FAULT, N_STATE };
+
+class HierMotor : public HierStateMachine<HierMotor, N_STATE>
+{
+	static const StateDef STATES[N_STATE];
+	static const Table TABLE;
+
+public:
+	MotorStats stats;
+
+	HierMotor() : HierStateMachine<HierMotor, N_STATE>(TABLE) {
+		init(ST_OPERATIONAL);
+	}
+
+	void count_enter() { ++stats.nEnter; }
+
+	bool operational(const Event* evt);
+	bool idle(const Event* evt);
+	bool running(const Event* evt);
+	bool fault(const Event* evt);
+};
+
+const HierMotor::StateDef HierMotor::STATES[N_STATE] = {
+	{ TOP,				ST_IDLE,	&HierMotor::operational,	0,	0 },
+	{ ST_OPERATIONAL,	TOP,		&HierMotor::idle,	&HierMotor::count_enter,	0 },
+	{ ST_OPERATIONAL,	TOP,		&HierMotor::running,	&HierMotor::count_enter,	0 },
+	{ TOP,				TOP,		&HierMotor::fault,	&HierMotor::count_enter,	0 }
+};
+
+const HierMotor::Table HierMotor::TABLE(HierMotor::STATES);
+
+bool HierMotor::operational(const Event* evt)
+{
+	switch (evt->sig) {
+		case SIG_STATUS:
+			++stats.nStatus;
+			return true;
+		case SIG_FAULT:
+			++stats.nFault;
+			tran(ST_FAULT);
+			return true;
+	}
+	return false;
+}
+
+bool HierMotor::idle(const Event* evt)
+{
+	if (evt->sig == SIG_START) {
+		++stats.nStart;
+		tran(ST_RUNNING);
+		return true;
+	}
+	return false;
+}
+
+bool HierMotor::running(const Event* evt)
+{
+	if (evt->sig == SIG_STOP) {
+		tran(ST_IDLE);
+		return true;
+	}
+	return false;
+}
+
+bool HierMotor::fault(const Event* evt)
+{
+	switch (evt->sig) {
+		case SIG_STATUS:
+			++stats.nStatus;
+			return true;
+		case SIG_RESET:
+			tran(ST_OPERATIONAL);
+			return true;
+	}
+	return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Builds the event stream: mostly status requests, a start/stop pair every
+// 16 events, and a fault/reset pair every 1024.
+
+static const Event** make_stream(const Event* evts, int n)
+{
+	const Event** stream = new const Event*[n];
+
+	for (int i=0; i<n; ++i) {
+		if (i % 1024 == 1000)
+			stream[i] = &evts[SIG_FAULT];
+		else if (i % 1024 == 1001)
+			stream[i] = &evts[SIG_RESET];
+		else if (i % 16 == 4)
+			stream[i] = &evts[SIG_START];
+		else if (i % 16 == 12)
+			stream[i] = &evts[SIG_STOP];
+		else
+			stream[i] = &evts[SIG_STATUS];
+	}
+	return stream;
+}
+
+template <typename M>
+static double run(M& m, const Event** stream, int n)
+{
+	MonotonicTime t0 = MonotonicTime::now();
+
+	for (int i=0; i<n; ++i)
+		m.dispatch(stream[i]);
+
+	tick_t dt = MonotonicTime::now().ticks() - t0.ticks();
+	return double(dt) / n;
+}
+
+static void report(const char* name, double nsPerEvt, const MotorStats& st)
+{
+	printf("%-18s %7.2f ns/event  (status %d, start %d, fault %d, enter %d)\n",
+		   name, nsPerEvt, st.nStatus, st.nStart, st.nFault, st.nEnter);
+}
+
+// --------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	int n = (argc > 1) ? atoi(argv[1]) : N_EVT;
+
+	Event evts[N_SIG];
+	for (int i=0; i<N_SIG; ++i) {
+		evts[i].sig = evt_sig_t(i);
+		evts[i].poolId = 0;
+		evts[i].refCnt = 0;
+	}
+
+	const Event** stream = make_stream(evts, n);
+
+	FlatMotor flat;
+	HierMotor hier;
+
+	// Warm up, then time each machine
+	run(flat, stream, n / 10);
+	run(hier, stream, n / 10);
+
+	flat.stats = MotorStats();
+	hier.stats = MotorStats();
+
+	double tFlat = run(flat, stream, n),
+		   tHier = run(hier, stream, n);
+
+	report("StateMachine", tFlat, flat.stats);
+	report("HierStateMachine", tHier, hier.stats);
+
+	bool ok = flat.stats.nStatus == hier.stats.nStatus &&
+			  flat.stats.nStart == hier.stats.nStart &&
+			  flat.stats.nFault == hier.stats.nFault &&
+			  flat.stats.nEnter == hier.stats.nEnter;
+
+	if (!ok)
+		printf("ERROR: The machines don't agree\n");
+
+	delete[] stream;
+	return ok ? 0 : 1;
+}
+